@@ -0,0 +1,180 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef BoundedQueue_h
+#define BoundedQueue_h
+
+
+#include <deque>
+#include <vector>
+
+#include "Threads.hpp"
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Queue between threads, first-in first-out, holding a limited number of
+ * items.<br/><br/>
+ *
+ * push blocks while full, and pop while empty -- so a fast producer waits for
+ * a slow consumer (backpressure). close wakes both, and makes them fail, for
+ * stopping early.<br/><br/>
+ *
+ * Items are copied (usually pointers, not owned).
+ *
+ * @invariants
+ * * items_m.size() <= capacity
+ */
+template<class T>
+class BoundedQueue
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit      BoundedQueue( udword capacity );
+
+private:
+                 BoundedQueue( const BoundedQueue& );
+   BoundedQueue& operator=( const BoundedQueue& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @return  true if added, false if closed
+    */
+           bool  push( const T& item );
+   /**
+    * @return  true if removed, false if closed
+    */
+           bool  pop( T& item );
+
+           void  close();
+
+   /**
+    * Remove all items left (after closing, to dispose of them).
+    */
+           void  removeAll( std::vector<T>& items );
+
+/// fields ---------------------------------------------------------------------
+private:
+   Mutex         mutex_m;
+   Semaphore     spaces_m;
+   Semaphore     filled_m;
+   std::deque<T> items_m;
+   bool          isClosed_m;
+};
+
+
+
+
+/// TEMPLATES ///
+
+/// standard object services ---------------------------------------------------
+template<class T>
+BoundedQueue<T>::BoundedQueue
+(
+   const udword capacity
+)
+ : mutex_m()
+ , spaces_m( (capacity >= 1) ? capacity : 1 )
+ , filled_m( 0 )
+ , items_m()
+ , isClosed_m( false )
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+template<class T>
+bool BoundedQueue<T>::push
+(
+   const T& item
+)
+{
+   spaces_m.wait();
+
+   MutexLock lock( mutex_m );
+
+   // (closed: pass the wake-up on, to any other waiter)
+   if( isClosed_m )
+   {
+      spaces_m.post();
+      return false;
+   }
+
+   items_m.push_back( item );
+   filled_m.post();
+
+   return true;
+}
+
+
+template<class T>
+bool BoundedQueue<T>::pop
+(
+   T& item
+)
+{
+   filled_m.wait();
+
+   MutexLock lock( mutex_m );
+
+   if( isClosed_m )
+   {
+      filled_m.post();
+      return false;
+   }
+
+   item = items_m.front();
+   items_m.pop_front();
+   spaces_m.post();
+
+   return true;
+}
+
+
+template<class T>
+void BoundedQueue<T>::close()
+{
+   MutexLock lock( mutex_m );
+
+   if( !isClosed_m )
+   {
+      isClosed_m = true;
+
+      spaces_m.post();
+      filled_m.post();
+   }
+}
+
+
+template<class T>
+void BoundedQueue<T>::removeAll
+(
+   std::vector<T>& items
+)
+{
+   MutexLock lock( mutex_m );
+
+   items.insert( items.end(), items_m.begin(), items_m.end() );
+   items_m.clear();
+}
+
+
+}//namespace
+
+
+
+
+#endif//BoundedQueue_h
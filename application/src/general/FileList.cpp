@@ -0,0 +1,184 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifdef _PLATFORM_WIN
+
+#include <windows.h>   // kernel32.lib
+
+#elif _PLATFORM_LINUX
+
+#include <glob.h>
+#include <sys/stat.h>
+
+#endif
+
+#include <algorithm>
+
+#include "FileList.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+#ifdef _PLATFORM_WIN
+const char SEPARATOR[] = "\\";
+#else
+const char SEPARATOR[] = "/";
+#endif
+
+
+/// functions ------------------------------------------------------------------
+#ifdef _PLATFORM_LINUX
+bool isRegularFile
+(
+   const char pathName[]
+);
+#endif
+
+}
+
+
+
+
+/// ----------------------------------------------------------------------------
+void hxa7241_general::files::listDirectory
+(
+   const char                i_directory[],
+   std::vector<std::string>& o_pathNames
+)
+{
+   std::string pattern( i_directory );
+   if( !pattern.empty() && (pattern.find_last_of( "/\\" ) !=
+      (pattern.length() - 1)) )
+   {
+      pattern += SEPARATOR;
+   }
+
+   listMatches( (pattern + "*").c_str(), o_pathNames );
+}
+
+
+#ifdef _PLATFORM_WIN
+
+bool hxa7241_general::files::isDirectory
+(
+   const char i_pathName[]
+)
+{
+   const DWORD attributes = ::GetFileAttributes( i_pathName );
+
+   return (INVALID_FILE_ATTRIBUTES != attributes) &&
+      (0 != (attributes & FILE_ATTRIBUTE_DIRECTORY));
+}
+
+
+void hxa7241_general::files::listMatches
+(
+   const char                i_pattern[],
+   std::vector<std::string>& o_pathNames
+)
+{
+   // (find gives bare names, so keep the pattern's directory part)
+   const std::string pattern( i_pattern );
+   const size_t      slash = pattern.find_last_of( "/\\:" );
+   const std::string directory( (std::string::npos != slash) ?
+      pattern.substr( 0, slash + 1 ) : std::string() );
+
+   std::vector<std::string> pathNames;
+
+   WIN32_FIND_DATA found;
+   const HANDLE    find = ::FindFirstFile( i_pattern, &found );
+   if( INVALID_HANDLE_VALUE != find )
+   {
+      do
+      {
+         if( 0 == (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) )
+         {
+            pathNames.push_back( directory + found.cFileName );
+         }
+      }
+      while( ::FindNextFile( find, &found ) );
+
+      ::FindClose( find );
+   }
+
+   std::sort( pathNames.begin(), pathNames.end() );
+   o_pathNames.insert( o_pathNames.end(), pathNames.begin(), pathNames.end() );
+}
+
+#elif _PLATFORM_LINUX
+
+bool hxa7241_general::files::isDirectory
+(
+   const char i_pathName[]
+)
+{
+   struct stat status;
+
+   return (0 == ::stat( i_pathName, &status )) && S_ISDIR(status.st_mode);
+}
+
+
+void hxa7241_general::files::listMatches
+(
+   const char                i_pattern[],
+   std::vector<std::string>& o_pathNames
+)
+{
+   std::vector<std::string> pathNames;
+
+   // (glob sorts by name)
+   glob_t matches;
+   if( 0 == ::glob( i_pattern, 0, 0, &matches ) )
+   {
+      for( size_t i = 0;  i < matches.gl_pathc;  ++i )
+      {
+         if( isRegularFile( matches.gl_pathv[i] ) )
+         {
+            pathNames.push_back( matches.gl_pathv[i] );
+         }
+      }
+   }
+   ::globfree( &matches );
+
+   std::sort( pathNames.begin(), pathNames.end() );
+   o_pathNames.insert( o_pathNames.end(), pathNames.begin(), pathNames.end() );
+}
+
+#endif
+
+
+
+
+/// implementation -------------------------------------------------------------
+namespace
+{
+
+#ifdef _PLATFORM_LINUX
+
+bool isRegularFile
+(
+   const char pathName[]
+)
+{
+   struct stat status;
+
+   return (0 == ::stat( pathName, &status )) && S_ISREG(status.st_mode);
+}
+
+#endif
+
+}
@@ -0,0 +1,67 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef FileList_h
+#define FileList_h
+
+
+#include <string>
+#include <vector>
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Lists of files: directory contents and wildcard matches.<br/><br/>
+ *
+ * Lists are sorted by name, and hold only regular files (no directories).
+ */
+namespace files
+{
+
+   bool isDirectory
+   (
+      const char pathName[]
+   );
+
+
+   /**
+    * @directory  directory to list, with or without trailing separator
+    * @pathNames  appended with path names: directory joined with file name
+    */
+   void listDirectory
+   (
+      const char                directory[],
+      std::vector<std::string>& pathNames
+   );
+
+
+   /**
+    * @pattern    path name with * and ? wildcards in its last part
+    * @pathNames  appended with matching path names
+    */
+   void listMatches
+   (
+      const char                pattern[],
+      std::vector<std::string>& pathNames
+   );
+
+}//namespace
+
+}//namespace
+
+
+
+
+#endif//FileList_h
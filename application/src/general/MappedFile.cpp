@@ -0,0 +1,264 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifdef _PLATFORM_WIN
+
+#include <windows.h>   // kernel32.lib
+
+#elif _PLATFORM_LINUX
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+#include <stddef.h>
+
+#include "MappedFile.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+namespace
+{
+
+/// functions ------------------------------------------------------------------
+void* mapFile
+(
+   const char pathName[],
+   bool       isWrite,
+   qword&     size
+);
+
+void  unmapFile
+(
+   void* pBytes,
+   qword size
+);
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+MappedFile::MappedFile()
+ : pBytes_m( 0 )
+ , size_m  ( 0 )
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+   MappedFile::close();
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+bool MappedFile::openRead
+(
+   const char pathName[]
+)
+{
+   close();
+
+   qword size = 0;
+   pBytes_m = static_cast<ubyte*>( mapFile( pathName, false, size ) );
+   size_m   = pBytes_m ? size : 0;
+
+   return 0 != pBytes_m;
+}
+
+
+bool MappedFile::openWrite
+(
+   const char  pathName[],
+   const qword size
+)
+{
+   close();
+
+   qword size_ = size;
+   pBytes_m = static_cast<ubyte*>( mapFile( pathName, true, size_ ) );
+   size_m   = pBytes_m ? size : 0;
+
+   return 0 != pBytes_m;
+}
+
+
+void MappedFile::close()
+{
+   if( pBytes_m )
+   {
+      unmapFile( pBytes_m, size_m );
+   }
+
+   pBytes_m = 0;
+   size_m   = 0;
+}
+
+
+ubyte* MappedFile::getBytes()
+{
+   return pBytes_m;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+const ubyte* MappedFile::getBytes() const
+{
+   return pBytes_m;
+}
+
+
+qword MappedFile::getSize() const
+{
+   return size_m;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+namespace
+{
+
+#ifdef _PLATFORM_WIN
+
+void* mapFile
+(
+   const char pathName[],
+   const bool isWrite,
+   qword&     size
+)
+{
+   const HANDLE file = ::CreateFile( pathName, isWrite ?
+      (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, isWrite ? 0 :
+      FILE_SHARE_READ, 0, isWrite ? CREATE_ALWAYS : OPEN_EXISTING,
+      isWrite ? FILE_ATTRIBUTE_NORMAL : FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+   if( INVALID_HANDLE_VALUE == file )
+   {
+      return 0;
+   }
+
+   // reading: size from file
+   if( !isWrite )
+   {
+      DWORD high = 0;
+      const DWORD low = ::GetFileSize( file, &high );
+      size = (static_cast<qword>(high) << 32) | low;
+   }
+
+   // (mapping sizes the file, when writing; the view keeps mapping and file
+   // alive after their handles close)
+   const bool isFit = (size > 0) && (static_cast<uqword>(size) <=
+      static_cast<uqword>(static_cast<size_t>(-1) / 2u));
+   const HANDLE mapping = isFit ? ::CreateFileMapping( file, 0, isWrite ?
+      PAGE_READWRITE : PAGE_READONLY,
+      static_cast<DWORD>(static_cast<uqword>(size) >> 32),
+      static_cast<DWORD>(size), 0 ) : 0;
+   void* pBytes = mapping ? ::MapViewOfFile( mapping, isWrite ?
+      FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 ) : 0;
+   if( mapping )
+   {
+      ::CloseHandle( mapping );
+   }
+   ::CloseHandle( file );
+
+   return pBytes;
+}
+
+
+void unmapFile
+(
+   void*const  pBytes,
+   const qword //size
+)
+{
+   ::UnmapViewOfFile( pBytes );
+}
+
+#elif _PLATFORM_LINUX
+
+void* mapFile
+(
+   const char pathName[],
+   const bool isWrite,
+   qword&     size
+)
+{
+   const int file = isWrite ?
+      ::open( pathName, O_RDWR | O_CREAT | O_TRUNC, 0666 ) :
+      ::open( pathName, O_RDONLY );
+   if( -1 == file )
+   {
+      return 0;
+   }
+
+   // reading: size from file (regular files only)
+   bool isOk = true;
+   if( !isWrite )
+   {
+      struct stat status;
+      isOk = (0 == ::fstat( file, &status )) && S_ISREG(status.st_mode);
+      size = isOk ? static_cast<qword>(status.st_size) : 0;
+   }
+   // writing: size file, reserving disk space
+   else
+   {
+      isOk = (size > 0) &&
+         (0 == ::posix_fallocate( file, 0, static_cast<off_t>(size) ));
+   }
+
+   isOk &= (size > 0) && (static_cast<uqword>(size) <=
+      static_cast<uqword>(static_cast<size_t>(-1) / 2u));
+
+   void* pBytes = isOk ? ::mmap( 0, static_cast<size_t>(size), isWrite ?
+      (PROT_READ | PROT_WRITE) : PROT_READ, isWrite ? MAP_SHARED :
+      MAP_PRIVATE, file, 0 ) : MAP_FAILED;
+   ::close( file );
+
+   if( MAP_FAILED == pBytes )
+   {
+      return 0;
+   }
+
+   // (read through once, front to back)
+   if( !isWrite )
+   {
+      ::madvise( pBytes, static_cast<size_t>(size), MADV_SEQUENTIAL );
+   }
+
+   return pBytes;
+}
+
+
+void unmapFile
+(
+   void*const  pBytes,
+   const qword size
+)
+{
+   ::munmap( pBytes, static_cast<size_t>(size) );
+}
+
+#endif
+
+}
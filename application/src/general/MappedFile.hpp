@@ -0,0 +1,77 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef MappedFile_h
+#define MappedFile_h
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * A whole file mapped into memory, for reading, or for writing at a size set
+ * beforehand.<br/><br/>
+ *
+ * Opening fails softly (returns false) for anything that cannot be mapped --
+ * empty files, pipes, devices -- so callers can fall back to streams.
+ * Written files are sized (and disk space reserved) before mapping, so a full
+ * disk fails at open instead of at access. Closing (or destruction) unmaps.
+ */
+class MappedFile
+{
+/// standard object services ---------------------------------------------------
+public:
+            MappedFile();
+
+           ~MappedFile();
+private:
+            MappedFile( const MappedFile& );
+   MappedFile& operator=( const MappedFile& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @return  true if mapped, else false (and left closed)
+    */
+           bool   openRead ( const char pathName[] );
+   /**
+    * Create (or truncate) file, at size, and map it.
+    *
+    * @return  true if mapped, else false (and left closed)
+    */
+           bool   openWrite( const char pathName[],
+                             qword      size );
+
+           void   close();
+
+           ubyte* getBytes();
+
+
+/// queries --------------------------------------------------------------------
+           const ubyte* getBytes()                                        const;
+           qword        getSize()                                         const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   ubyte* pBytes_m;
+   qword  size_m;
+};
+
+}//namespace
+
+
+
+
+#endif//MappedFile_h
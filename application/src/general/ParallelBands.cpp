@@ -0,0 +1,194 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <new>
+#include <vector>
+
+#include "ParallelBands.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+const char UNANNOTATED_EXCEPTION_MESSAGE[] = "unannotated exception, in band";
+
+
+/// globals --------------------------------------------------------------------
+udword threadCount_g = 0;
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+ParallelBands::ParallelBands()
+ : mutex_m()
+ , rows_m        ( 0 )
+ , bandRows_m    ( 1 )
+ , next_m        ( 0 )
+ , isFailed_m    ( false )
+ , isAllocation_m( false )
+ , pMessage_m    ( 0 )
+{
+}
+
+
+ParallelBands::~ParallelBands()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void ParallelBands::setThreadCount
+(
+   const udword count
+)
+{
+   threadCount_g = count;
+}
+
+
+void ParallelBands::run
+(
+   const dword rows,
+   const dword bandRows
+)
+{
+   rows_m         = (rows > 0) ? rows : 0;
+   bandRows_m     = (bandRows > 1) ? bandRows : 1;
+   next_m         = 0;
+   isFailed_m     = false;
+   isAllocation_m = false;
+   pMessage_m     = 0;
+
+   // a thread per processor, but no more than bands
+   const qword bands   = (rows_m + bandRows_m - 1) / bandRows_m;
+   const qword threads = (getThreadCount() < bands) ? getThreadCount() : bands;
+
+   // start helpers, then join in on this thread
+   // (if a helper cannot start, make do with those that did)
+   std::vector<Thread*> helpers;
+   try
+   {
+      for( qword i = 1;  i < threads;  ++i )
+      {
+         helpers.push_back( 0 );
+         helpers.back() = new Thread( &threadMain, this );
+      }
+   }
+   catch( ... )
+   {
+   }
+
+   takeBands();
+
+   // wait for helpers
+   for( udword i = 0;  i < helpers.size();  ++i )
+   {
+      delete helpers[i];
+   }
+
+   if( isFailed_m )
+   {
+      if( isAllocation_m )
+      {
+         throw std::bad_alloc();
+      }
+      throw pMessage_m;
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+udword ParallelBands::getThreadCount()
+{
+   return threadCount_g ? threadCount_g : getProcessorCount();
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void ParallelBands::takeBands()
+{
+   for( ;; )
+   {
+      // take next band, unless done or failed
+      qword begin = 0;
+      qword end   = 0;
+      {
+         MutexLock lock( mutex_m );
+
+         if( isFailed_m || (next_m >= rows_m) )
+         {
+            break;
+         }
+         begin  = next_m;
+         end    = (rows_m - begin > bandRows_m) ? begin + bandRows_m : rows_m;
+         next_m = end;
+      }
+
+      // handle exceptions
+      try
+      {
+         doBand( static_cast<dword>(begin), static_cast<dword>(end) );
+      }
+      catch( const std::bad_alloc& )
+      {
+         fail( 0, true );
+      }
+      catch( const char*const exceptionString )
+      {
+         fail( exceptionString, false );
+      }
+      catch( ... )
+      {
+         fail( UNANNOTATED_EXCEPTION_MESSAGE, false );
+      }
+   }
+}
+
+
+void ParallelBands::fail
+(
+   const char* pMessage,
+   const bool  isAllocation
+)
+{
+   MutexLock lock( mutex_m );
+
+   // keep the first
+   if( !isFailed_m )
+   {
+      isFailed_m     = true;
+      isAllocation_m = isAllocation;
+      pMessage_m     = pMessage;
+   }
+}
+
+
+void ParallelBands::threadMain
+(
+   void* pBands
+)
+{
+   static_cast<ParallelBands*>( pBands )->takeBands();
+}
@@ -0,0 +1,104 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef ParallelBands_h
+#define ParallelBands_h
+
+
+#include "Threads.hpp"
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Work on an image's rows, in bands, spread across threads.<br/><br/>
+ *
+ * Subclass with the work for a band, then call run: bands are taken in order
+ * by a thread per processor (including the caller), and run returns when all
+ * are done. With one thread, or one band, all run on the caller.<br/><br/>
+ *
+ * Bands should touch only their own rows (or their own parts of shared
+ * storage), so results do not depend on timing.
+ *
+ * @exceptions
+ * the first exception a band throws -- char[] message or allocation (others
+ * become a char[] message) -- stops bands not yet started, and is rethrown
+ * from run
+ */
+class ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+            ParallelBands();
+
+   virtual ~ParallelBands();
+private:
+            ParallelBands( const ParallelBands& );
+   ParallelBands& operator=( const ParallelBands& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Set how many threads run bands. Not thread-safe: call before running.
+    *
+    * @count  0 for processor count (the default)
+    */
+   static  void   setThreadCount( udword count );
+
+   /**
+    * @rows      rows to cover, from 0
+    * @bandRows  rows per band (last may be fewer), >= 1
+    */
+           void   run( dword rows,
+                       dword bandRows );
+
+
+/// queries --------------------------------------------------------------------
+   static  udword getThreadCount();
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   /**
+    * Do the work for rows begin to end (exclusive).
+    */
+   virtual void   doBand( dword begin,
+                          dword end ) = 0;
+
+private:
+           void   takeBands();
+           void   fail( const char* pMessage,
+                        bool        isAllocation );
+   static  void   threadMain( void* pBands );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Mutex       mutex_m;
+   qword       rows_m;
+   qword       bandRows_m;
+   qword       next_m;
+
+   bool        isFailed_m;
+   bool        isAllocation_m;
+   const char* pMessage_m;
+};
+
+}//namespace
+
+
+
+
+#endif//ParallelBands_h
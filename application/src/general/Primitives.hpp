@@ -32,6 +32,15 @@ namespace hxa7241
    typedef  signed   int    dword;
    typedef  unsigned int    udword;
 
+#if defined(_MSC_VER)
+   typedef  signed   __int64  qword;
+   typedef  unsigned __int64  uqword;
+#else
+   // (long long is not C++98, so ask for the 64-bit mode directly)
+   typedef  signed   int    qword  __attribute__((__mode__(__DI__)));
+   typedef  unsigned int    uqword __attribute__((__mode__(__DI__)));
+#endif
+
    typedef  float           fp;
 
 
@@ -65,6 +74,10 @@ namespace hxa7241
    const int    UDWORD_BITS = 32;
 
 
+   const int    QWORD_BITS  = 64;
+   const int    UQWORD_BITS = 64;
+
+
    const float  FLOAT_MIN_POS     = static_cast<float>(FLT_MIN);
    const float  FLOAT_MIN_NEG     = static_cast<float>(-FLT_MAX);
    const float  FLOAT_MAX         = static_cast<float>(FLT_MAX);
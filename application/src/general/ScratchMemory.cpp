@@ -0,0 +1,549 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifdef _PLATFORM_WIN
+
+#include <windows.h>   // kernel32.lib
+
+#elif _PLATFORM_LINUX
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#endif
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ScratchMemory.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+const char SIZE_EXCEPTION_MESSAGE[]   = "scratch block size out of range";
+const char CREATE_EXCEPTION_MESSAGE[] = "could not create scratch file";
+const char MAP_EXCEPTION_MESSAGE[]    = "could not map scratch file";
+
+const char SCRATCH_FILE_PREFIX[] = "p3wb";
+
+const udword IS_HEAP   = 0x48454150;   // 'HEAP'
+const udword IS_MAPPED = 0x4D415050;   // 'MAPP'
+const udword IS_FILE   = 0x46494C45;   // 'FILE'
+
+
+/// types ----------------------------------------------------------------------
+/**
+ * Record before each block: its size and kind (and, for a mapped file, the
+ * whole mapping around it).
+ *
+ * Padded to a cache line, so the block after it keeps the heap's alignment.
+ */
+union Header
+{
+   struct
+   {
+      qword  bytes;
+      udword kind;
+      void*  pFileBase;
+      qword  fileTotal;
+   } h;
+
+   ubyte padding[64];
+};
+
+
+/// globals --------------------------------------------------------------------
+qword       memoryLimit_g = 0;
+std::string directory_g;
+
+
+/// functions ------------------------------------------------------------------
+void* mapScratch
+(
+   qword total
+);
+
+void  unmapScratch
+(
+   void* pBase,
+   qword total
+);
+
+Header* mapFileView
+(
+   const char pathName[],
+   qword      offset,
+   qword      bytes
+);
+
+}
+
+
+
+
+/// ----------------------------------------------------------------------------
+void hxa7241_general::scratch::setOutOfCore
+(
+   const qword      memoryLimit,
+   const char*const directoryPathName
+)
+{
+   memoryLimit_g = (memoryLimit > 0) ? memoryLimit : 0;
+   directory_g   = directoryPathName ? directoryPathName : "";
+}
+
+
+void* hxa7241_general::scratch::allocate
+(
+   const qword bytes
+)
+{
+   const qword total = bytes + static_cast<qword>(sizeof(Header));
+
+   // size must fit the address space (32-bit builds)
+   if( (bytes < 0) || (static_cast<uqword>(total) >
+      static_cast<uqword>(static_cast<size_t>(-1) / 2u)) )
+   {
+      throw SIZE_EXCEPTION_MESSAGE;
+   }
+
+   // big: mapped scratch file, else heap
+   const bool isMapped = (0 != memoryLimit_g) && (bytes > memoryLimit_g);
+   Header* pHeader = static_cast<Header*>( isMapped ? mapScratch( total ) :
+      ::operator new( static_cast<size_t>(total) ) );
+
+   pHeader->h.bytes = bytes;
+   pHeader->h.kind  = isMapped ? IS_MAPPED : IS_HEAP;
+
+   return pHeader + 1;
+}
+
+
+void hxa7241_general::scratch::release
+(
+   void*const pBlock
+)
+{
+   if( pBlock )
+   {
+      Header* pHeader = static_cast<Header*>(pBlock) - 1;
+
+      if( IS_MAPPED == pHeader->h.kind )
+      {
+         unmapScratch( pHeader, pHeader->h.bytes +
+            static_cast<qword>(sizeof(Header)) );
+      }
+      else if( IS_FILE == pHeader->h.kind )
+      {
+         unmapScratch( pHeader->h.pFileBase, pHeader->h.fileTotal );
+      }
+      else
+      {
+         ::operator delete( pHeader );
+      }
+   }
+}
+
+
+void* hxa7241_general::scratch::mapFile
+(
+   const char  pathName[],
+   const qword offset,
+   const qword bytes
+)
+{
+   // (header must be aligned, and size must fit the address space)
+   if( (offset < 0) || (0 != (offset & 7)) || (bytes <= 0) ||
+      (static_cast<uqword>(bytes) > static_cast<uqword>(
+      static_cast<size_t>(-1) / 4u)) )
+   {
+      return 0;
+   }
+
+   Header* pHeader = mapFileView( pathName, offset, bytes );
+   if( !pHeader )
+   {
+      return 0;
+   }
+
+   pHeader->h.bytes = bytes;
+   pHeader->h.kind  = IS_FILE;
+
+   return pHeader + 1;
+}
+
+
+bool hxa7241_general::scratch::isMapped
+(
+   const void*const pBlock
+)
+{
+   const udword kind = pBlock ?
+      (static_cast<const Header*>(pBlock) - 1)->h.kind : IS_HEAP;
+
+   return (IS_MAPPED == kind) || (IS_FILE == kind);
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+namespace
+{
+
+#ifdef _PLATFORM_WIN
+
+void* mapScratch
+(
+   const qword total
+)
+{
+   // make uniquely named file in directory
+   char directory[ MAX_PATH ] = "\0";
+   if( directory_g.empty() )
+   {
+      ::GetTempPath( MAX_PATH, directory );
+   }
+   else
+   {
+      directory_g.copy( directory, MAX_PATH - 1 );
+   }
+   char pathName[ MAX_PATH ] = "\0";
+   if( 0 == ::GetTempFileName( directory, SCRATCH_FILE_PREFIX, 0, pathName ) )
+   {
+      throw CREATE_EXCEPTION_MESSAGE;
+   }
+
+   // open it, to be deleted when last handle closes
+   const HANDLE file = ::CreateFile( pathName, GENERIC_READ | GENERIC_WRITE, 0,
+      0, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+      0 );
+   if( INVALID_HANDLE_VALUE == file )
+   {
+      ::DeleteFile( pathName );
+      throw CREATE_EXCEPTION_MESSAGE;
+   }
+
+   // size and map it
+   // (the view keeps the mapping and file alive after their handles close)
+   const HANDLE mapping = ::CreateFileMapping( file, 0, PAGE_READWRITE,
+      static_cast<DWORD>(static_cast<uqword>(total) >> 32),
+      static_cast<DWORD>(total), 0 );
+   void* pBase = mapping ? ::MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0,
+      0 ) : 0;
+   if( mapping )
+   {
+      ::CloseHandle( mapping );
+   }
+   ::CloseHandle( file );
+
+   if( !pBase )
+   {
+      throw MAP_EXCEPTION_MESSAGE;
+   }
+
+   return pBase;
+}
+
+
+void unmapScratch
+(
+   void*const  pBase,
+   const qword //total
+)
+{
+   ::UnmapViewOfFile( pBase );
+}
+
+
+Header* mapFileView
+(
+   const char  pathName[],
+   const qword offset,
+   const qword bytes
+)
+{
+   // view must start on the allocation granularity, and have room for the
+   // header before the block
+   SYSTEM_INFO info;
+   ::GetSystemInfo( &info );
+   const qword granularity = info.dwAllocationGranularity;
+   const qword start       = (offset / granularity) * granularity;
+   const qword lead        = offset - start;
+   if( lead < static_cast<qword>(sizeof(Header)) )
+   {
+      return 0;
+   }
+
+   const HANDLE file = ::CreateFile( pathName, GENERIC_READ, FILE_SHARE_READ,
+      0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+   if( INVALID_HANDLE_VALUE == file )
+   {
+      return 0;
+   }
+
+   DWORD high = 0;
+   const DWORD low = ::GetFileSize( file, &high );
+   const bool isFit = ((offset + bytes) <=
+      ((static_cast<qword>(high) << 32) | low));
+
+   // copy-on-write view
+   // (the view keeps the mapping and file alive after their handles close)
+   const HANDLE mapping = isFit ? ::CreateFileMapping( file, 0, PAGE_WRITECOPY,
+      0, 0, 0 ) : 0;
+   void* pBase = mapping ? ::MapViewOfFile( mapping, FILE_MAP_COPY,
+      static_cast<DWORD>(static_cast<uqword>(start) >> 32),
+      static_cast<DWORD>(start), static_cast<SIZE_T>(lead + bytes) ) : 0;
+   if( mapping )
+   {
+      ::CloseHandle( mapping );
+   }
+   ::CloseHandle( file );
+
+   if( !pBase )
+   {
+      return 0;
+   }
+
+   Header* pHeader = reinterpret_cast<Header*>(static_cast<ubyte*>(pBase) +
+      lead) - 1;
+   pHeader->h.pFileBase = pBase;
+   pHeader->h.fileTotal = lead + bytes;
+
+   return pHeader;
+}
+
+#elif _PLATFORM_LINUX
+
+void* mapScratch
+(
+   const qword total
+)
+{
+   // make uniquely named file in directory
+   std::string pattern( directory_g );
+   if( pattern.empty() )
+   {
+      const char* pTmpDir = ::getenv( "TMPDIR" );
+      pattern = (pTmpDir && *pTmpDir) ? pTmpDir : "/tmp";
+   }
+   pattern += std::string("/") + SCRATCH_FILE_PREFIX + "-scratch-XXXXXX";
+   std::vector<char> pathName( pattern.begin(), pattern.end() );
+   pathName.push_back( 0 );
+
+   const int file = ::mkstemp( &(pathName[0]) );
+   if( -1 == file )
+   {
+      throw CREATE_EXCEPTION_MESSAGE;
+   }
+
+   // unlink at once, so it goes when unmapped (or the process ends)
+   ::unlink( &(pathName[0]) );
+
+   // reserve disk space (so a full disk fails here, not as SIGBUS later),
+   // and map it
+   // (the mapping keeps the file alive after its descriptor closes)
+   void* pBase = MAP_FAILED;
+   if( 0 == ::posix_fallocate( file, 0, static_cast<off_t>(total) ) )
+   {
+      pBase = ::mmap( 0, static_cast<size_t>(total), PROT_READ | PROT_WRITE,
+         MAP_SHARED, file, 0 );
+   }
+   ::close( file );
+
+   if( MAP_FAILED == pBase )
+   {
+      throw MAP_EXCEPTION_MESSAGE;
+   }
+
+   return pBase;
+}
+
+
+void unmapScratch
+(
+   void*const  pBase,
+   const qword total
+)
+{
+   ::munmap( pBase, static_cast<size_t>(total) );
+}
+
+
+Header* mapFileView
+(
+   const char  pathName[],
+   const qword offset,
+   const qword bytes
+)
+{
+   // view must start on a page: so reserve a page more in front, for the
+   // header before the block
+   const qword page  = static_cast<qword>( ::sysconf( _SC_PAGESIZE ) );
+   const qword start = (offset / page) * page;
+   const qword lead  = offset - start;
+   const qword total = page + lead + bytes;
+
+   const int file = ::open( pathName, O_RDONLY );
+   if( -1 == file )
+   {
+      return 0;
+   }
+
+   struct stat status;
+   const bool isFit = (0 == ::fstat( file, &status )) &&
+      S_ISREG(status.st_mode) &&
+      ((offset + bytes) <= static_cast<qword>(status.st_size));
+
+   // reserve, then put the file copy-on-write over all but the first page
+   void* pBase = isFit ? ::mmap( 0, static_cast<size_t>(total),
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) :
+      MAP_FAILED;
+   if( (MAP_FAILED != pBase) && (MAP_FAILED == ::mmap( static_cast<ubyte*>(
+      pBase) + page, static_cast<size_t>(lead + bytes),
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file,
+      static_cast<off_t>(start) )) )
+   {
+      ::munmap( pBase, static_cast<size_t>(total) );
+      pBase = MAP_FAILED;
+   }
+   ::close( file );
+
+   if( MAP_FAILED == pBase )
+   {
+      return 0;
+   }
+
+   Header* pHeader = reinterpret_cast<Header*>(static_cast<ubyte*>(pBase) +
+      page + lead) - 1;
+   pHeader->h.pFileBase = pBase;
+   pHeader->h.fileTotal = total;
+
+   return pHeader;
+}
+
+#endif
+
+}
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <ostream>
+
+
+namespace hxa7241_general
+{
+namespace scratch
+{
+   using namespace hxa7241;
+
+
+bool test_scratch
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   //seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_scratch ]\n\n";
+
+
+   // heap and mapped blocks hold their contents, and release
+   {
+      const qword LENGTH = 300000;
+
+      bool isOk_ = true;
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         // (first all heap, then over the limit mapped)
+         setOutOfCore( k ? LENGTH : 0, 0 );
+
+         Ptr<udword> small( 1000 );
+         Ptr<udword> big( LENGTH );
+
+         isOk_ &= !isMapped( small.get() );
+         isOk_ &= (0 != k) == isMapped( big.get() );
+
+         for( qword i = LENGTH;  i-- > 0; )
+         {
+            big.get()[i] = static_cast<udword>(i * 2654435761u);
+         }
+         for( qword i = LENGTH;  i-- > 0; )
+         {
+            isOk_ &= (static_cast<udword>(i * 2654435761u) == big.get()[i]);
+         }
+
+         if( pOut && isVerbose ) *pOut << (k ? "mapped" : "heap") << " " <<
+            isOk_ << "\n";
+      }
+      setOutOfCore( 0, 0 );
+
+      if( pOut && isVerbose ) *pOut << "\n";
+
+      if( pOut ) *pOut << "blocks : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // unusable directory is reported
+   {
+      bool isOk_ = false;
+      setOutOfCore( 1, "/nonexistent/p3wb" );
+      try
+      {
+         Ptr<ubyte> block( 2 );
+      }
+      catch( const char[] )
+      {
+         isOk_ = true;
+      }
+      setOutOfCore( 0, 0 );
+
+      if( pOut ) *pOut << "bad directory : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+}//namespace
+}//namespace
+
+
+#endif//TESTING
@@ -0,0 +1,138 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef ScratchMemory_h
+#define ScratchMemory_h
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Storage for large blocks (image pixels), in memory or out-of-core.<br/><br/>
+ *
+ * Blocks bigger than the memory limit are put in a memory-mapped scratch file
+ * instead of the heap, so they can be bigger than physical memory -- the OS
+ * pages them in and out as they are used. The file is deleted when the block
+ * is released (or the process ends).<br/><br/>
+ *
+ * A block can also be a file's contents, mapped copy-on-write -- so reading
+ * it needs no copy, and changing it leaves the file as it was.<br/><br/>
+ *
+ * Sizes are 64-bit. Any kind of block is freed with release.
+ *
+ * @exceptions
+ * allocate throws char[] messages and allocation exceptions
+ */
+namespace scratch
+{
+
+   /**
+    * Set where big blocks go. Not thread-safe: call before allocating.
+    *
+    * @memoryLimit        blocks bigger than this many bytes are mapped, or 0
+    *                     for no limit (all on the heap, the default)
+    * @directoryPathName  where scratch files are made, or 0 or empty for the
+    *                     system temporary directory
+    */
+   void  setOutOfCore
+   (
+      qword      memoryLimit,
+      const char directoryPathName[]
+   );
+
+
+   void* allocate
+   (
+      qword bytes
+   );
+
+
+   /**
+    * Map part of a file as a block, copy-on-write.
+    *
+    * @offset  where the block starts in the file: a multiple of 8 (else
+    *          unmappable)
+    * @return  block, or 0 if that part of the file could not be mapped (so
+    *          read it into an allocated block instead)
+    */
+   void* mapFile
+   (
+      const char pathName[],
+      qword      offset,
+      qword      bytes
+   );
+
+
+   void  release
+   (
+      void* pBlock
+   );
+
+
+   /**
+    * @return  true if in a scratch file, or a mapped file
+    */
+   bool  isMapped
+   (
+      const void* pBlock
+   );
+
+
+   /**
+    * Simplified auto_ptr for a block of T.
+    */
+   template<class T>
+   class Ptr
+   {
+   public:
+      explicit Ptr( qword length = 0 )
+       : ptr_m( length ? static_cast<T*>( allocate( length * sizeof(T) ) ) :
+            0 )
+      {
+      }
+
+      ~Ptr()
+      {
+         scratch::release( ptr_m );
+      }
+
+   private:
+      Ptr( const Ptr& );
+      Ptr& operator=( const Ptr& );
+   public:
+
+      T* get() const
+      {
+         return ptr_m;
+      }
+
+      T* release()
+      {
+         T* p = ptr_m;
+         ptr_m = 0;
+         return p;
+      }
+
+   private:
+      T* ptr_m;
+   };
+
+}//namespace
+
+}//namespace
+
+
+
+
+#endif//ScratchMemory_h
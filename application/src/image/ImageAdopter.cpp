@@ -8,10 +8,13 @@
 --------------------------------------------------------------------*/
 
 
+#include "ScratchMemory.hpp"
+
 #include "ImageAdopter.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -121,9 +124,9 @@ void ImageAdopter::set
 //   void*const       pPixels
 )
 {
-   // check dimensions positive, and length <= DWORD_MAX
-   if( (width < 0) || (height < 0) || (height > (DWORD_MAX / 3)) ||
-      ((0 != height) && (width > (DWORD_MAX / height * 3))) )
+   // check dimensions positive
+   // (length is 64-bit, so cannot overflow)
+   if( (width < 0) || (height < 0) )
    {
       throw SIZE_INVALID_MESSAGE;
    }
@@ -233,7 +236,7 @@ void ImageAdopter::destruct
 //   void*      pPixels
 )
 {
-   delete[] pPixels;
+   scratch::release( pPixels );
 
 //   switch( pixelType )
 //   {
@@ -25,6 +25,9 @@ namespace hxa7241_image
  * A record of image file data. Absence is represented by zeros, for scaling,
  * primaries, gamma, and quantMax.<br/><br/>
  *
+ * Pixels are width * height float triples (the length may exceed 32 bits),
+ * adopted from scratch::allocate -- so they may be out-of-core.<br/><br/>
+ *
  * @exceptions
  * constructors and set can throw
  */
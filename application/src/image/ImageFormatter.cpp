@@ -8,20 +8,28 @@
 --------------------------------------------------------------------*/
 
 
+#include <string.h>
 #include <ctype.h>
 #include <fstream>
 
+#include "ScratchMemory.hpp"
+#include "PixelsPtr.hpp"
+#include "ScanlineCodec.hpp"
+
 #include "exr.hpp"
 #include "rgbe.hpp"
 #include "png.hpp"
 #include "ppm.hpp"
+#include "pfm.hpp"
 #include "ImageAdopter.hpp"
+#include "IndexedImage.hpp"
 #include "ImageQuantizing.hpp"
 
 #include "ImageFormatter.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -40,6 +48,8 @@ const char FILE_OPEN_EXCEPTION_MESSAGE[] =
    "could not open image file";
 const char HALF_PIXELS_EXCEPTION_MESSAGE[] =
    "Half type pixels not implemented";
+const char NO_INDEXED_FORMATTER_EXCEPTION_MESSAGE[] =
+   "could not write indexed image format";
 
 
 std::string getFileNameExtension
@@ -47,10 +57,18 @@ std::string getFileNameExtension
    const char i_filePathname[]
 );
 
-void deleteTriples
+bool readHeaderSize
+(
+   const std::string& nameExt,
+   std::istream&      inBytes,
+   dword&             width,
+   dword&             height
+);
+
+void openOutStream
 (
-   const dword quantMax,
-   void*       pTriplesInt
+   const char     filePathname[],
+   std::ofstream& outBytes
 );
 
 }
@@ -62,6 +80,11 @@ void deleteTriples
 ImageFormatter::ImageFormatter()
  : exrLibraryPathName_m()
  , pngLibraryPathName_m()
+ , exrCompression_m    ( exr::PIZ_COMPRESSION )
+ , exrTileSize_m       ( 0 )
+ , pngLevel_m          ( png::Encoding().level )
+ , pngStrategy_m       ( png::Encoding().strategy )
+ , pngFilter_m         ( png::Encoding().filter )
 {
 }
 
@@ -73,6 +96,11 @@ ImageFormatter::ImageFormatter
 )
  : exrLibraryPathName_m()
  , pngLibraryPathName_m()
+ , exrCompression_m    ( exr::PIZ_COMPRESSION )
+ , exrTileSize_m       ( 0 )
+ , pngLevel_m          ( png::Encoding().level )
+ , pngStrategy_m       ( png::Encoding().strategy )
+ , pngFilter_m         ( png::Encoding().filter )
 {
    ImageFormatter::set( exrLibraryPathName, pngLibraryPathName );
 }
@@ -101,6 +129,11 @@ ImageFormatter& ImageFormatter::operator=
    {
       exrLibraryPathName_m = that.exrLibraryPathName_m;
       pngLibraryPathName_m = that.pngLibraryPathName_m;
+      exrCompression_m     = that.exrCompression_m;
+      exrTileSize_m        = that.exrTileSize_m;
+      pngLevel_m           = that.pngLevel_m;
+      pngStrategy_m        = that.pngStrategy_m;
+      pngFilter_m          = that.pngFilter_m;
    }
 
    return *this;
@@ -121,6 +154,55 @@ void ImageFormatter::set
 }
 
 
+bool ImageFormatter::setExrCompression
+(
+   const char compression[]
+)
+{
+   // empty for default
+   exr::ECompression found = exr::PIZ_COMPRESSION;
+   const bool isFound = (0 == compression) || (0 == compression[0]) ||
+      exr::findCompression( compression, found );
+
+   if( isFound )
+   {
+      exrCompression_m = found;
+   }
+
+   return isFound;
+}
+
+
+void ImageFormatter::setExrTileSize
+(
+   const dword tileSize
+)
+{
+   exrTileSize_m = (tileSize > 0) ? tileSize : 0;
+}
+
+
+bool ImageFormatter::setPngEncoding
+(
+   const char encoding[]
+)
+{
+   // empty for default
+   png::Encoding found;
+   const bool isFound = (0 == encoding) || (0 == encoding[0]) ||
+      png::findEncoding( encoding, found );
+
+   if( isFound )
+   {
+      pngLevel_m    = found.level;
+      pngStrategy_m = found.strategy;
+      pngFilter_m   = found.filter;
+   }
+
+   return isFound;
+}
+
+
 
 
 /// queries --------------------------------------------------------------------
@@ -152,6 +234,12 @@ void ImageFormatter::readImage
       exr::read( exrLibraryPathName_m.c_str(), i_filePathname, 0, width, height,
          primaries, scalingToGetCdm2, pTriplesFp );
    }
+   // PFM (pfm)
+   // (memory-mapped, or if not mappable, streamed)
+   else if( (nameExt == "pfm") && pfm::readFile( i_filePathname, width,
+      height, pTriplesFp ) )
+   {
+   }
    else
    {
       // make file in-stream
@@ -168,11 +256,21 @@ void ImageFormatter::readImage
          float exposure = 0.0f;
 
          // read image file into data
-         rgbe::read( inBytes, false, width, height, primaries, exposure,
-            pTriplesFp );
+         // (memory-mapped, or if not mappable, streamed)
+         if( !rgbe::readFile( i_filePathname, 0, width, height, primaries,
+            exposure, pTriplesFp ) )
+         {
+            rgbe::read( inBytes, 0, width, height, primaries, exposure,
+               pTriplesFp );
+         }
 
          scalingToGetCdm2 = (exposure != 0.0f) ? 1.0f / exposure : 0.0f;
       }
+      // PFM (pfm)
+      else if( nameExt == "pfm" )
+      {
+         pfm::read( inBytes, width, height, pTriplesFp );
+      }
       // PNG or PPM (png ppm)
       else if( (nameExt == "png") || (nameExt == "ppm") )
       {
@@ -193,7 +291,12 @@ void ImageFormatter::readImage
          else
          {
             // read image file into data
-            ppm::read( inBytes, 0, width, height, quantMax, pTriplesInt );
+            // (memory-mapped, or if not mappable, streamed)
+            if( !ppm::readFile( i_filePathname, 0, width, height, quantMax,
+               pTriplesInt ) )
+            {
+               ppm::read( inBytes, 0, width, height, quantMax, pTriplesInt );
+            }
          }
 
          try
@@ -204,11 +307,11 @@ void ImageFormatter::readImage
                i_deGamma : deGamma, width, height, quantMax, pTriplesInt,
                0, pTriplesFp );
 
-            deleteTriples( quantMax, pTriplesInt );
+            scratch::release( pTriplesInt );
          }
          catch( ... )
          {
-            deleteTriples( quantMax, pTriplesInt );
+            scratch::release( pTriplesInt );
             throw;
          }
       }
@@ -241,17 +344,19 @@ void ImageFormatter::writeImage
    const std::string nameExt( getFileNameExtension( i_filePathname ) );
 
    // make file out-stream
-   std::ofstream outBytes( i_filePathname, std::ofstream::binary );
-   if( !outBytes )
+   // (PPM and PFM map the file instead, if they can, so open it later)
+   std::ofstream outBytes;
+   if( (nameExt != "ppm") && (nameExt != "pfm") )
    {
-      throw FILE_OPEN_EXCEPTION_MESSAGE;
+      openOutStream( i_filePathname, outBytes );
    }
 
    // OpenEXR (exr)
    if( nameExt == "exr" )
    {
       exr::write( exrLibraryPathName_m.c_str(), width, height, pPrimaries8,
-         i_image.getScaling(), 0, i_image.getPixels(), i_filePathname );
+         i_image.getScaling(), 0, i_image.getPixels(), i_filePathname,
+         static_cast<exr::ECompression>(exrCompression_m), exrTileSize_m );
    }
    // Radiance (rgbe pic hdr rad)
    else if( (nameExt == "hdr") || (nameExt == "rad") ||
@@ -263,6 +368,17 @@ void ImageFormatter::writeImage
       rgbe::write( HXA7241_URI, width, height, pPrimaries8, exposure, 0,
          i_image.getPixels(), outBytes );
    }
+   // PFM (pfm)
+   else if( nameExt == "pfm" )
+   {
+      // write image data to file memory-mapped, or if not mappable, to stream
+      if( !pfm::writeFile( width, height, i_image.getPixels(),
+         i_filePathname ) )
+      {
+         openOutStream( i_filePathname, outBytes );
+         pfm::write( width, height, i_image.getPixels(), outBytes );
+      }
+   }
    // PNG or PPM (png ppm)
    else if( (nameExt == "png") || (nameExt == "ppm") )
    {
@@ -280,23 +396,32 @@ void ImageFormatter::writeImage
          // PPM
          if( nameExt == "ppm" )
          {
-            // write image data to stream
-            ppm::write( HXA7241_URI, width, height, quantMax, 0, pTriplesInt,
-               outBytes );
+            // write image data to file memory-mapped, or if not mappable,
+            // to stream
+            if( !ppm::writeFile( HXA7241_URI, width, height, quantMax, 0,
+               pTriplesInt, i_filePathname ) )
+            {
+               openOutStream( i_filePathname, outBytes );
+               ppm::write( HXA7241_URI, width, height, quantMax, 0,
+                  pTriplesInt, outBytes );
+            }
          }
          // PNG
          else
          {
             // write image data to stream
             png::write( pngLibraryPathName_m.c_str(), width, height, pPrimaries8,
-               enGamma, (quantMax >= 256), 0, pTriplesInt, outBytes );
+               enGamma, (quantMax >= 256), 0, pTriplesInt, outBytes,
+               png::Encoding( pngLevel_m,
+                  static_cast<png::EStrategy>(pngStrategy_m),
+                  static_cast<png::EFilter>(pngFilter_m) ) );
          }
 
-         deleteTriples( quantMax, pTriplesInt );
+         scratch::release( pTriplesInt );
       }
       catch( ... )
       {
-         deleteTriples( quantMax, pTriplesInt );
+         scratch::release( pTriplesInt );
          throw;
       }
    }
@@ -308,6 +433,386 @@ void ImageFormatter::writeImage
 
 
 
+bool ImageFormatter::readIndexedImage
+(
+   const char    i_filePathname[],
+   const float   i_deGamma,
+   IndexedImage& o_image
+) const
+{
+   // only PNG has palette images
+   if( getFileNameExtension( i_filePathname ) != "png" )
+   {
+      return false;
+   }
+
+   // make file in-stream
+   std::ifstream inBytes( i_filePathname, std::ifstream::binary );
+   if( !inBytes )
+   {
+      throw FILE_OPEN_EXCEPTION_MESSAGE;
+   }
+
+   // declare image data to be filled
+   dword  width        = 0;
+   dword  height       = 0;
+   dword  bitDepth     = 0;
+   float  primaries[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+   float  deGamma      = 0.0f;
+   std::vector<ubyte> palette;
+   std::vector<ubyte> alphas;
+   std::vector<ubyte> indices;
+
+   // read image file into data, if palette image
+   if( !png::readIndexed( pngLibraryPathName_m.c_str(), inBytes, 0, primaries,
+      deGamma, width, height, bitDepth, palette, alphas, indices ) ||
+      palette.empty() )
+   {
+      return false;
+   }
+
+   // convert palette to float pixels, as a one-row image
+   // (parameter gamma overrides file gamma)
+   const dword entries  = static_cast<dword>(palette.size() / 3);
+   float*      pPalette = 0;
+   quantizing::makeFloatImage( (0.0f != i_deGamma) ? i_deGamma : deGamma,
+      entries, 1, 255, &(palette[0]), 0, pPalette );
+
+   // set image with data, adopting storage
+   o_image.getPalette().set( entries, 1, 0.0f, primaries, deGamma, 255,
+      pPalette );
+   o_image.set( width, height, bitDepth, alphas, indices );
+
+   return true;
+}
+
+
+void ImageFormatter::writeIndexedImage
+(
+   const char          i_filePathname[],
+   const float         i_enGamma,
+   const IndexedImage& i_image
+) const
+{
+   if( getFileNameExtension( i_filePathname ) != "png" )
+   {
+      throw NO_INDEXED_FORMATTER_EXCEPTION_MESSAGE;
+   }
+
+   // make file out-stream
+   std::ofstream outBytes( i_filePathname, std::ofstream::binary );
+   if( !outBytes )
+   {
+      throw FILE_OPEN_EXCEPTION_MESSAGE;
+   }
+
+   const ImageAdopter& palette = i_image.getPalette();
+   const float         enGamma = palette.getGamma();
+   const dword         entries = palette.getWidth();
+
+   // convert palette to integer pixels
+   void* pPaletteInt = 0;
+   quantizing::makeIntegerImage( (0.0f != i_enGamma) ? i_enGamma : enGamma,
+      entries, 1, 255, palette.getPixels(), 0, pPaletteInt );
+   const ubyte* pPaletteBytes = static_cast<ubyte*>(pPaletteInt);
+   const std::vector<ubyte> paletteBytes( pPaletteBytes, pPaletteBytes +
+      (entries * 3) );
+   scratch::release( pPaletteInt );
+
+   // write image data to stream
+   png::writeIndexed( pngLibraryPathName_m.c_str(), i_image.getWidth(),
+      i_image.getHeight(), palette.getPrimaries(), enGamma,
+      i_image.getBitDepth(), paletteBytes, i_image.getAlphas(), 0,
+      i_image.getIndices(), outBytes );
+}
+
+
+bool ImageFormatter::readSize
+(
+   const char i_filePathname[],
+   dword&     o_width,
+   dword&     o_height
+) const
+{
+   std::ifstream inBytes( i_filePathname, std::ifstream::binary );
+
+   dword width  = 0;
+   dword height = 0;
+   const bool isRead = inBytes && readHeaderSize( getFileNameExtension(
+      i_filePathname ), inBytes, width, height ) && (width > 0) && (height > 0);
+
+   if( isRead )
+   {
+      o_width  = width;
+      o_height = height;
+   }
+
+   return isRead;
+}
+
+
+namespace
+{
+
+/**
+ * An integer-pixel reader, with its rows converted to float triples.
+ */
+class FloatReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   FloatReader( ScanlineReader* pReader,
+                dword           width,
+                dword           quantMax,
+                float           deGamma );
+
+   virtual ~FloatReader();
+private:
+   FloatReader( const FloatReader& );
+   FloatReader& operator=( const FloatReader& );
+public:
+
+/// commands -------------------------------------------------------------------
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   ScanlineReader* pReader_m;
+   dword           width_m;
+   dword           quantMax_m;
+   float           deGamma_m;
+};
+
+
+/**
+ * An integer-pixel writer, given rows of float triples.
+ */
+class IntegerWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   IntegerWriter( ScanlineWriter* pWriter,
+                  dword           width,
+                  dword           quantMax,
+                  float           enGamma );
+
+   virtual ~IntegerWriter();
+private:
+   IntegerWriter( const IntegerWriter& );
+   IntegerWriter& operator=( const IntegerWriter& );
+public:
+
+/// commands -------------------------------------------------------------------
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   ScanlineWriter* pWriter_m;
+   dword           width_m;
+   dword           quantMax_m;
+   float           enGamma_m;
+};
+
+}
+
+
+ScanlineReader* ImageFormatter::openImageReader
+(
+   const char    i_filePathname[],
+   const float   i_deGamma,
+   ImageAdopter& o_header
+) const
+{
+   // declare image data to be filled
+   dword width            = 0;
+   dword height           = 0;
+   dword quantMax         = 0;
+   float primaries[8]     = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+   float scalingToGetCdm2 = 0.0f;
+   float deGamma          = 0.0f;
+
+   // choose formatter and open (some data may be left as zero)
+   ScanlineReader* pReader = 0;
+
+   // get name ext
+   const std::string nameExt( getFileNameExtension( i_filePathname ) );
+
+   // OpenEXR (exr)
+   if( nameExt == "exr" )
+   {
+      pReader = exr::openReader( exrLibraryPathName_m.c_str(), i_filePathname,
+         width, height, primaries, scalingToGetCdm2 );
+   }
+   // Radiance (rgbe pic hdr rad)
+   else if( (nameExt == "hdr") || (nameExt == "rad") ||
+      (nameExt == "rgbe") || (nameExt == "pic") )
+   {
+      float exposure = 0.0f;
+      pReader = rgbe::openReader( i_filePathname, width, height, primaries,
+         exposure );
+
+      scalingToGetCdm2 = (exposure != 0.0f) ? 1.0f / exposure : 0.0f;
+   }
+   // PFM (pfm)
+   else if( nameExt == "pfm" )
+   {
+      pReader = pfm::openReader( i_filePathname, width, height );
+   }
+   // PNG or PPM (png ppm)
+   else if( (nameExt == "png") || (nameExt == "ppm") )
+   {
+      // PNG
+      if( nameExt == "png" )
+      {
+         bool is48Bit = false;
+         pReader = png::openReader( pngLibraryPathName_m.c_str(),
+            i_filePathname, primaries, deGamma, width, height, is48Bit );
+
+         quantMax = !is48Bit ? 255 : 65535;
+      }
+      // PPM
+      else
+      {
+         pReader = ppm::openReader( i_filePathname, width, height, quantMax );
+      }
+
+      // convert rows to float pixels
+      // (parameter gamma overrides file gamma)
+      if( pReader )
+      {
+         try
+         {
+            pReader = new FloatReader( pReader, width, quantMax,
+               (0.0f != i_deGamma) ? i_deGamma : deGamma );
+         }
+         catch( ... )
+         {
+            delete pReader;
+            throw;
+         }
+      }
+   }
+   else
+   {
+      throw NO_READ_FORMATTER_EXCEPTION_MESSAGE;
+   }
+
+   // set header with data, and no pixels
+   if( pReader )
+   {
+      try
+      {
+         o_header.set( width, height, scalingToGetCdm2, primaries, deGamma,
+            quantMax, 0 );
+      }
+      catch( ... )
+      {
+         delete pReader;
+         throw;
+      }
+   }
+
+   return pReader;
+}
+
+
+ScanlineWriter* ImageFormatter::openImageWriter
+(
+   const char          i_filePathname[],
+   const float         i_enGamma,
+   const ImageAdopter& i_header
+) const
+{
+   // extract image data
+   const dword  width       = i_header.getWidth();
+   const dword  height      = i_header.getHeight();
+   const float* pPrimaries8 = i_header.getPrimaries();
+
+   // get name ext
+   const std::string nameExt( getFileNameExtension( i_filePathname ) );
+
+   ScanlineWriter* pWriter = 0;
+
+   // OpenEXR (exr)
+   if( nameExt == "exr" )
+   {
+      pWriter = exr::openWriter( exrLibraryPathName_m.c_str(), width, height,
+         i_header.getScaling(), i_filePathname,
+         static_cast<exr::ECompression>(exrCompression_m), exrTileSize_m );
+   }
+   // Radiance (rgbe pic hdr rad)
+   else if( (nameExt == "hdr") || (nameExt == "rad") ||
+      (nameExt == "rgbe") || (nameExt == "pic") )
+   {
+      const float exposure = (i_header.getScaling() != 0.0f) ?
+         1.0f / i_header.getScaling() : 0.0f;
+
+      pWriter = rgbe::openWriter( HXA7241_URI, width, height, pPrimaries8,
+         exposure, i_filePathname );
+   }
+   // PFM (pfm)
+   else if( nameExt == "pfm" )
+   {
+      pWriter = pfm::openWriter( width, height, i_filePathname );
+   }
+   // PNG or PPM (png ppm)
+   else if( (nameExt == "png") || (nameExt == "ppm") )
+   {
+      const float enGamma  = i_header.getGamma();
+      const dword quantMax = i_header.getQuantMax();
+
+      // (integer pixels need a quantization)
+      if( (quantMax < 1) || (quantMax > 65535) )
+      {
+         throw NO_WRITE_FORMATTER_EXCEPTION_MESSAGE;
+      }
+
+      // PPM
+      if( nameExt == "ppm" )
+      {
+         pWriter = ppm::openWriter( HXA7241_URI, width, height, quantMax,
+            i_filePathname );
+      }
+      // PNG
+      else
+      {
+         pWriter = png::openWriter( pngLibraryPathName_m.c_str(), width,
+            height, pPrimaries8, enGamma, (quantMax >= 256), i_filePathname,
+            png::Encoding( pngLevel_m,
+               static_cast<png::EStrategy>(pngStrategy_m),
+               static_cast<png::EFilter>(pngFilter_m) ) );
+      }
+
+      // convert rows to integer pixels
+      if( pWriter )
+      {
+         try
+         {
+            pWriter = new IntegerWriter( pWriter, width, quantMax,
+               (0.0f != i_enGamma) ? i_enGamma : enGamma );
+         }
+         catch( ... )
+         {
+            delete pWriter;
+            throw;
+         }
+      }
+   }
+   else
+   {
+      throw NO_WRITE_FORMATTER_EXCEPTION_MESSAGE;
+   }
+
+   return pWriter;
+}
+
+
+
 
 /// implementation -------------------------------------------------------------
 namespace
@@ -338,20 +843,261 @@ std::string getFileNameExtension
 }
 
 
-void deleteTriples
+void openOutStream
 (
-   const dword quantMax,
-   void*       pTriplesInt
+   const char     i_filePathname[],
+   std::ofstream& o_outBytes
 )
 {
-   if( quantMax <= 255 )
+   o_outBytes.open( i_filePathname, std::ofstream::binary );
+   if( !o_outBytes )
    {
-      delete[] static_cast<ubyte*>(pTriplesInt);
+      throw FILE_OPEN_EXCEPTION_MESSAGE;
    }
-   else
+}
+
+
+udword readBytesLittle
+(
+   const ubyte* pBytes,
+   const dword  count
+)
+{
+   udword u = 0;
+   for( dword i = count;  i-- > 0; )
    {
-      delete[] static_cast<uword*>(pTriplesInt);
+      u = (u << 8) | pBytes[i];
    }
+
+   return u;
 }
 
+
+bool readHeaderSize
+(
+   const std::string& nameExt,
+   std::istream&      in,
+   dword&             width,
+   dword&             height
+)
+{
+   // OpenEXR: magic and version, then attributes (name, type, size, value)
+   // until the data window
+   if( nameExt == "exr" )
+   {
+      ubyte start[8];
+      in.read( reinterpret_cast<char*>(start), sizeof(start) );
+      if( !in || (0x01312F76 != readBytesLittle( start, 4 )) )
+      {
+         return false;
+      }
+
+      for( dword i = 0;  (i < 1024) && in;  ++i )
+      {
+         std::string name;
+         std::string type;
+         std::getline( in, name, '\0' );
+         std::getline( in, type, '\0' );
+         ubyte size[4];
+         in.read( reinterpret_cast<char*>(size), sizeof(size) );
+         const udword bytes = readBytesLittle( size, 4 );
+         if( !in || name.empty() )
+         {
+            break;
+         }
+
+         if( (name == "dataWindow") && (type == "box2i") && (16 == bytes) )
+         {
+            ubyte box[16];
+            in.read( reinterpret_cast<char*>(box), sizeof(box) );
+            width  = static_cast<dword>(readBytesLittle( box + 8,  4 ) -
+               readBytesLittle( box + 0, 4 )) + 1;
+            height = static_cast<dword>(readBytesLittle( box + 12, 4 ) -
+               readBytesLittle( box + 4, 4 )) + 1;
+            return !!in;
+         }
+         in.ignore( bytes );
+      }
+   }
+   // Radiance: text lines to a blank one, then the resolution string
+   else if( (nameExt == "hdr") || (nameExt == "rad") ||
+      (nameExt == "rgbe") || (nameExt == "pic") )
+   {
+      std::string line;
+      for( dword i = 0;  (i < 1024) && std::getline( in, line );  ++i )
+      {
+         if( line.empty() )
+         {
+            // (rows axis first: -Y h +X w normally)
+            char  sign[2];
+            char  axis[2];
+            dword size[2];
+            for( dword a = 0;  a < 2;  ++a )
+            {
+               in >> sign[a] >> axis[a] >> size[a];
+            }
+            if( !in || ((axis[0] | 0x20) == (axis[1] | 0x20)) )
+            {
+               return false;
+            }
+            const bool isRowsFirst = ('Y' == (axis[0] & ~0x20));
+            width  = size[isRowsFirst ? 1 : 0];
+            height = size[isRowsFirst ? 0 : 1];
+            return true;
+         }
+      }
+   }
+   // PNG: signature, then the IHDR chunk (big-endian)
+   else if( nameExt == "png" )
+   {
+      ubyte start[24];
+      in.read( reinterpret_cast<char*>(start), sizeof(start) );
+      if( in && (0 == std::string( reinterpret_cast<char*>(start + 12), 4 )
+         .compare( "IHDR" )) )
+      {
+         width  = static_cast<dword>((start[16] << 24) | (start[17] << 16) |
+            (start[18] << 8) | start[19]);
+         height = static_cast<dword>((start[20] << 24) | (start[21] << 16) |
+            (start[22] << 8) | start[23]);
+         return true;
+      }
+   }
+   // PFM: PF or Pf, then width and height
+   else if( nameExt == "pfm" )
+   {
+      std::string id;
+      in >> id >> width >> height;
+      return in && ((id == "PF") || (id == "Pf"));
+   }
+   // PPM: P6, then width and height, with comments between
+   else if( nameExt == "ppm" )
+   {
+      char p[2] = { 0, 0 };
+      in.read( p, 2 );
+      if( in && ('P' == p[0]) && ('6' == p[1]) )
+      {
+         dword* pSizes[2] = { &width, &height };
+         for( dword i = 0;  (i < 2) && in; )
+         {
+            in >> std::ws;
+            if( '#' == in.peek() )
+            {
+               std::string comment;
+               std::getline( in, comment );
+            }
+            else
+            {
+               in >> *(pSizes[i++]);
+            }
+         }
+         return !!in;
+      }
+   }
+
+   return false;
+}
+
+
+/// FloatReader ----------------------------------------------------------------
+FloatReader::FloatReader
+(
+   ScanlineReader* pReader,
+   const dword     width,
+   const dword     quantMax,
+   const float     deGamma
+)
+ : pReader_m ( pReader )
+ , width_m   ( width )
+ , quantMax_m( quantMax )
+ , deGamma_m ( deGamma )
+{
+}
+
+
+FloatReader::~FloatReader()
+{
+   delete pReader_m;
+}
+
+
+void FloatReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( rows > 0 )
+   {
+      // read integer rows, and convert
+      PixelsPtr pTriplesInt( (quantMax_m >= 256), static_cast<qword>(
+         width_m) * rows * 3 );
+      pReader_m->readRows( rows, pTriplesInt.get() );
+
+      float* pTriplesFp = 0;
+      quantizing::makeFloatImage( deGamma_m, width_m, rows, quantMax_m,
+         pTriplesInt.get(), 0, pTriplesFp );
+
+      ::memcpy( pTriples, pTriplesFp, static_cast<size_t>(width_m) * rows * 3 *
+         sizeof(float) );
+      scratch::release( pTriplesFp );
+   }
+}
+
+
+/// IntegerWriter --------------------------------------------------------------
+IntegerWriter::IntegerWriter
+(
+   ScanlineWriter* pWriter,
+   const dword     width,
+   const dword     quantMax,
+   const float     enGamma
+)
+ : pWriter_m ( pWriter )
+ , width_m   ( width )
+ , quantMax_m( quantMax )
+ , enGamma_m ( enGamma )
+{
+}
+
+
+IntegerWriter::~IntegerWriter()
+{
+   delete pWriter_m;
+}
+
+
+void IntegerWriter::writeRows
+(
+   const dword rows,
+   const void* pTriples
+)
+{
+   if( rows > 0 )
+   {
+      // convert to integer rows, and write
+      void* pTriplesInt = 0;
+      quantizing::makeIntegerImage( enGamma_m, width_m, rows, quantMax_m,
+         static_cast<const float*>(pTriples), 0, pTriplesInt );
+
+      try
+      {
+         pWriter_m->writeRows( rows, pTriplesInt );
+
+         scratch::release( pTriplesInt );
+      }
+      catch( ... )
+      {
+         scratch::release( pTriplesInt );
+         throw;
+      }
+   }
+}
+
+
+void IntegerWriter::finish()
+{
+   pWriter_m->finish();
+}
+
+
 }
@@ -28,6 +28,8 @@ namespace hxa7241_image
  * Supports OpenEXR, Radiance-RGBE, PNG, and PPM to read, and PNG and PPM to
  * write.<br/><br/>
  *
+ * PNG palette images can also be read and written kept indexed.<br/><br/>
+ *
  * @exceptions queries throw char[] messages, all throw allocation exceptions
  */
 class ImageFormatter
@@ -47,29 +49,110 @@ public:
            void  set( const char exrLibraryPathName[],
                       const char pngLibraryPathName[] );
 
+   /**
+    * @compression  OpenEXR compression to write with, by name: none rle zips
+    *               zip piz pxr24 b44 (or 0 or empty for default: piz)
+    * @return       false if unrecognised (and left as it was)
+    */
+           bool  setExrCompression( const char compression[] );
+   /**
+    * @tileSize  OpenEXR tile width and height to write with, or 0 for
+    *            scanlines (the default)
+    */
+           void  setExrTileSize( dword tileSize );
+   /**
+    * @encoding  PNG encoding to write with, by name: fast, small, or
+    *            level_strategy_filter (eg: 6_rle_up) (or 0 or empty for
+    *            default: small)
+    * @return    false if unrecognised (and left as it was)
+    */
+           bool  setPngEncoding( const char encoding[] );
+
 
 /// queries --------------------------------------------------------------------
    /**
     * @filePathname extension must be one of:
-    *               .exr .rgbe. .pic .hdr .rad .png .ppm
+    *               .exr .rgbe. .pic .hdr .rad .png .ppm .pfm
     * @deGamma      gamma to decode with, or 0 for default
     */
            void  readImage ( const char    filePathname[],
                              float         deGamma,
                              ImageAdopter& image )                        const;
    /**
-    * @filePathname extension must be one of: .png .ppm
+    * @filePathname extension must be one of: .png .ppm .pfm
     * @enGamma      gamma to encode with, or 0 for image value
     */
            void  writeImage( const char          filePathname[],
                              float               enGamma,
                              const ImageAdopter& image )                  const;
 
+   /**
+    * Read an image kept indexed, if it is a palette image.
+    *
+    * @filePathname extension must be: .png (others are left unread)
+    * @deGamma      gamma to decode palette with, or 0 for default
+    * @return       true if read, false if not a palette image
+    */
+           bool  readIndexedImage ( const char    filePathname[],
+                                    float         deGamma,
+                                    IndexedImage& image )                 const;
+   /**
+    * @filePathname extension must be: .png
+    * @enGamma      gamma to encode palette with, or 0 for image value
+    */
+           void  writeIndexedImage( const char          filePathname[],
+                                    float               enGamma,
+                                    const IndexedImage& image )           const;
+
+   /**
+    * Read just the size of an image, from its file header -- cheaply, without
+    * the external libraries or any pixels.
+    *
+    * @filePathname extension as readImage
+    * @return       true if read, false if unknown or unreadable
+    */
+           bool  readSize( const char filePathname[],
+                           dword&     width,
+                           dword&     height )                            const;
+
+   /**
+    * Open an image to read in strips of rows, top first, as float triples --
+    * so a whole image need never be in memory.
+    *
+    * @filePathname extension as readImage
+    * @deGamma      gamma to decode with, or 0 for default
+    * @header       set with everything but pixels (those are left null)
+    * @return       reader (caller owns), or 0 if the file cannot be read as
+    *               strips (so use readImage)
+    */
+           ScanlineReader* openImageReader( const char    filePathname[],
+                                            float         deGamma,
+                                            ImageAdopter& header )        const;
+   /**
+    * Open an image to write in strips of rows, top first, as float triples.
+    * It is complete only after the writer's finish.
+    *
+    * @filePathname extension as writeImage
+    * @enGamma      gamma to encode with, or 0 for header value
+    * @header       size and metadata, as writeImage (pixels unused)
+    * @return       writer (caller owns), or 0 if the file cannot be written as
+    *               strips (so use writeImage)
+    */
+           ScanlineWriter* openImageWriter( const char          filePathname[],
+                                            float               enGamma,
+                                            const ImageAdopter& header )
+                                                                          const;
+
 
 /// fields ---------------------------------------------------------------------
 private:
    std::string exrLibraryPathName_m;
    std::string pngLibraryPathName_m;
+   dword       exrCompression_m;
+   dword       exrTileSize_m;
+   dword       pngLevel_m;
+   dword       pngStrategy_m;
+   dword       pngFilter_m;
 };
 
 
@@ -9,11 +9,18 @@
 
 
 #include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "ScratchMemory.hpp"
+#include "ParallelBands.hpp"
 
 #include "ImageQuantizing.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -28,6 +35,8 @@ const float SRGB_GAMMA = 1.0f / 2.2f;
 const float GAMMA_MIN  = 1.0f / 8.0f;
 const float GAMMA_MAX  = 8.0f;
 
+const dword BAND_ROWS  = 16;
+
 const char DIMENSIONS_EXCEPTION_MESSAGE[] =
    "image dimensions invalid, in ImageQuantizing";
 const char NULL_POINTER_EXCEPTION_MESSAGE[] =
@@ -49,6 +58,36 @@ void checkGamma
 );
 
 
+/**
+ * Converts rows of integer channels to float, through a table of decoded
+ * values -- one per possible integer.
+ */
+class FloatConverter
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   FloatConverter( const float* pTable,
+                   dword        width,
+                   dword        quantMax,
+                   const void*  pTriplesI,
+                   float*       pTriplesF );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   const float* pTable_m;
+   dword        width_m;
+   dword        quantMax_m;
+   const void*  pTriplesI_m;
+   float*       pTriplesF_m;
+};
+
+
 inline
 float clamp01
 (
@@ -69,6 +108,96 @@ dword clamp0Max
    return (i >= 0) ? (i <= max ? i : max) : 0;
 }
 
+
+/**
+ * Gamma encode and quantize one channel -- the definitive way.
+ */
+inline
+dword encodeChannel
+(
+   const float f,
+   const float enGamma,
+   const dword quantMax
+)
+{
+   // clamp to [0,1], and gamma encode
+   const float encoded = ::powf( clamp01( f ), enGamma );
+
+   // scale, round, and clamp to [0,quantMax]
+   const dword integer = static_cast<dword>( ::floorf(
+      (encoded * static_cast<float>(quantMax)) + 0.5f ) );
+   return clamp0Max( integer, quantMax );
+}
+
+
+/**
+ * Gamma encode and quantize, by finding where the output steps.<br/><br/>
+ *
+ * The result only changes at quantMax points in [0,1]: those steps are found
+ * once (exactly, with encodeChannel), then each value is placed among them.
+ * An index on the float bits -- a roughly logarithmic scale, suiting a power
+ * curve -- narrows each search to a few steps.
+ */
+class GammaEncoder
+{
+/// standard object services ---------------------------------------------------
+public:
+   GammaEncoder( float enGamma,
+                 dword quantMax );
+
+/// queries --------------------------------------------------------------------
+   dword encode( float f )                                                const;
+
+/// implementation -------------------------------------------------------------
+private:
+   static float   findStep( float approximate,
+                            dword output,
+                            float enGamma,
+                            dword quantMax );
+   static float   toFloat( udword bits );
+   static udword  toBits( float f );
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword               quantMax_m;
+
+   // least value giving each output above 0 (then a 2 as end marker)
+   std::vector<float>  steps_m;
+
+   // first output for each cell of float bits, from steps_m[0] bits
+   std::vector<uword>  cells_m;
+   udword              cellBase_m;
+   udword              cellShift_m;
+};
+
+
+/**
+ * Converts rows of float channels to integer (ubyte or uword).
+ */
+template<class CHANNEL>
+class IntegerConverter
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   IntegerConverter( const GammaEncoder& encoder,
+                     dword               width,
+                     const float*        pTriplesF,
+                     CHANNEL*            pTriplesI );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   const GammaEncoder* pEncoder_m;
+   dword               width_m;
+   const float*        pTriplesF_m;
+   CHANNEL*            pTriplesI_m;
+};
+
 }
 
 
@@ -95,31 +224,36 @@ void hxa7241_image::quantizing::makeFloatImage
    const float deGamma = (0.0f >= i_deGamma) ? (1.0f / SRGB_GAMMA) :
       ((1.0f > i_deGamma) ? (1.0f / i_deGamma) : i_deGamma);
 
-   // allocate float storage
-   const dword length = i_width * i_height * 3;
-   float* pTriplesF = new float[ length ];
-
-   // convert pixels
-   for( dword t = 0;  t < length;  t += 3 )
+   // make decode table
+   // (few inputs are possible, so decode each once -- including any above
+   // quantMax, which clamp to 1)
+   std::vector<float> table( (i_quantMax <= 255) ? 256 : 65536 );
+   for( dword i = 0;  i < static_cast<dword>(table.size());  ++i )
    {
-      // convert channels
-      for( dword c = 0;  c < 3;  ++c )
-      {
-         // get channel value
-         const udword channel = static_cast<udword>( (i_quantMax <= 255) ?
-            static_cast<const ubyte*>(i_pTriplesI)[t + c] :
-            static_cast<const uword*>(i_pTriplesI)[t + c] );
+      // scale to [0,1]
+      const float fraction = static_cast<float>(i) /
+         static_cast<float>(i_quantMax);
 
-         // scale to [0,1]
-         const float fraction = static_cast<float>(channel) /
-            static_cast<float>(i_quantMax);
+      // gamma decode, clamped to [0,1]
+      table[i] = clamp01( ::powf( fraction, deGamma ) );
+   }
 
-         // gamma decode
-         const float decoded = ::powf( fraction, deGamma );
+   // allocate float storage
+   const qword length = static_cast<qword>(i_width) * i_height * 3;
+   float* pTriplesF = static_cast<float*>( scratch::allocate( length *
+      sizeof(float) ) );
 
-         // write, clamped to [0,1]
-         pTriplesF[t + c] = clamp01( decoded );
-      }
+   // convert pixels, rows in parallel
+   try
+   {
+      FloatConverter converter( &(table[0]), i_width, i_quantMax, i_pTriplesI,
+         pTriplesF );
+      converter.run( i_height, BAND_ROWS );
+   }
+   catch( ... )
+   {
+      scratch::release( pTriplesF );
+      throw;
    }
 
    // set outputs
@@ -154,38 +288,34 @@ void hxa7241_image::quantizing::makeIntegerImage
    const float enGamma = (0.0f >= i_enGamma) ? SRGB_GAMMA :
       ((1.0f < i_enGamma) ? (1.0f / i_enGamma) : i_enGamma);
 
+   // find output steps
+   const GammaEncoder encoder( enGamma, i_quantMax );
+
    // allocate integer storage
-   const dword length = i_width * i_height * 3;
-   void* pTriplesI = i_quantMax <= 255 ? static_cast<void*>(new ubyte[length]) :
-      static_cast<void*>(new uword[length]);
+   const qword length = static_cast<qword>(i_width) * i_height * 3;
+   void* pTriplesI = scratch::allocate( length * ((i_quantMax <= 255) ?
+      sizeof(ubyte) : sizeof(uword)) );
 
-   // convert pixels
-   for( dword t = 0;  t < length;  t += 3 )
+   // convert pixels, rows in parallel
+   try
    {
-      // convert channels
-      for( dword c = 0;  c < 3;  ++c )
+      if( i_quantMax <= 255 )
       {
-         // get channel value, clamped to [0,1]
-         const float channel = clamp01( i_pTriplesF[t + c] );
-
-         // gamma encode
-         const float encoded = ::powf( channel, enGamma );
-
-         // scale, round, and clamp to [0,quantMax]
-         dword integer = static_cast<dword>( ::floorf(
-            (encoded * static_cast<float>(i_quantMax)) + 0.5f ) );
-         integer = clamp0Max( integer, i_quantMax );
-
-         // write
-         if( i_quantMax <= 255 )
-         {
-            static_cast<ubyte*>(pTriplesI)[t + c] = static_cast<ubyte>(integer);
-         }
-         else
-         {
-            static_cast<uword*>(pTriplesI)[t + c] = static_cast<uword>(integer);
-         }
+         IntegerConverter<ubyte> converter( encoder, i_width, i_pTriplesF,
+            static_cast<ubyte*>(pTriplesI) );
+         converter.run( i_height, BAND_ROWS );
       }
+      else
+      {
+         IntegerConverter<uword> converter( encoder, i_width, i_pTriplesF,
+            static_cast<uword*>(pTriplesI) );
+         converter.run( i_height, BAND_ROWS );
+      }
+   }
+   catch( ... )
+   {
+      scratch::release( pTriplesI );
+      throw;
    }
 
    // set outputs
@@ -212,9 +342,9 @@ void checkDimensionsAndPointer
 )
 {
    // check size
+   // (lengths are 64-bit, so any positive dimensions fit)
    if( (quantMax < 1) || (quantMax > 65535) ||
-      (width <= 0) || (height <= 0) || (height > (DWORD_MAX / 3)) ||
-      (width > (DWORD_MAX / (height * 3))) )
+      (width <= 0) || (height <= 0) )
    {
       throw DIMENSIONS_EXCEPTION_MESSAGE;
    }
@@ -239,6 +369,275 @@ void checkGamma
    }
 }
 
+
+
+
+/// FloatConverter -------------------------------------------------------------
+
+FloatConverter::FloatConverter
+(
+   const float* pTable,
+   const dword  width,
+   const dword  quantMax,
+   const void*  pTriplesI,
+   float*       pTriplesF
+)
+ : pTable_m   ( pTable )
+ , width_m    ( width )
+ , quantMax_m ( quantMax )
+ , pTriplesI_m( pTriplesI )
+ , pTriplesF_m( pTriplesF )
+{
+}
+
+
+void FloatConverter::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   const qword rowLength = static_cast<qword>(width_m) * 3;
+   const qword first     = rowLength * begin;
+   const qword length    = rowLength * (end - begin);
+
+   const float* pTable = pTable_m;
+   float*       pOut   = pTriplesF_m + first;
+
+   // (channel size chosen once, outside the loop)
+   if( quantMax_m <= 255 )
+   {
+      const ubyte* pIn = static_cast<const ubyte*>(pTriplesI_m) + first;
+      for( qword i = 0;  i < length;  ++i )
+      {
+         pOut[i] = pTable[ pIn[i] ];
+      }
+   }
+   else
+   {
+      const uword* pIn = static_cast<const uword*>(pTriplesI_m) + first;
+      for( qword i = 0;  i < length;  ++i )
+      {
+         pOut[i] = pTable[ pIn[i] ];
+      }
+   }
+}
+
+
+
+
+/// GammaEncoder ---------------------------------------------------------------
+
+GammaEncoder::GammaEncoder
+(
+   const float enGamma,
+   const dword quantMax
+)
+ : quantMax_m ( quantMax )
+ , steps_m    ( quantMax + 1 )
+ , cellBase_m ( 0 )
+ , cellShift_m( 0 )
+{
+   // find steps
+   // (each from the analytic inverse, adjusted to agree with encodeChannel)
+   const float deGamma = 1.0f / enGamma;
+   for( dword i = 0;  i < quantMax;  ++i )
+   {
+      const float approximate = ::powf( (static_cast<float>(i) + 0.5f) /
+         static_cast<float>(quantMax), deGamma );
+      steps_m[i] = findStep( approximate, i + 1, enGamma, quantMax );
+   }
+   steps_m[quantMax] = 2.0f;
+
+   // index: cells of float bits, from the first step up to 1
+   // (16 per output for bytes, 2 for words -- few steps to search in each)
+   cellBase_m = toBits( steps_m[0] );
+   const udword span     = toBits( 1.0f ) - cellBase_m;
+   const udword cellsMax = static_cast<udword>(quantMax + 1) * ((quantMax <=
+      255) ? 16 : 2);
+   while( (span >> cellShift_m) >= cellsMax )
+   {
+      ++cellShift_m;
+   }
+
+   // first output in each cell: steps at or below cell start
+   cells_m.resize( (span >> cellShift_m) + 1 );
+   dword output = 0;
+   for( udword c = 0;  c < static_cast<udword>(cells_m.size());  ++c )
+   {
+      const float start = toFloat( cellBase_m + (c << cellShift_m) );
+      while( (output < quantMax) && (steps_m[output] <= start) )
+      {
+         ++output;
+      }
+      cells_m[c] = static_cast<uword>(output);
+   }
+}
+
+
+inline
+dword GammaEncoder::encode
+(
+   const float f
+) const
+{
+   // below first step (or negative)
+   if( !(f >= steps_m[0]) )
+   {
+      return 0;
+   }
+   // at or above 1
+   if( f >= 1.0f )
+   {
+      return quantMax_m;
+   }
+
+   // start at cell, then step up (end marker stops it)
+   dword output = cells_m[ (toBits( f ) - cellBase_m) >> cellShift_m ];
+   while( f >= steps_m[output] )
+   {
+      ++output;
+   }
+
+   return output;
+}
+
+
+/**
+ * Find least value in [0,1] that encodeChannel makes output or more.
+ *
+ * Searches float bits (ordered like the values, for positives): out from the
+ * approximate value, doubling the distance, then by halves.
+ */
+float GammaEncoder::findStep
+(
+   const float approximate,
+   const dword output,
+   const float enGamma,
+   const dword quantMax
+)
+{
+   const udword one = toBits( 1.0f );
+
+   // bracket: lo gives less than output, hi gives output or more
+   // (0 gives 0, 1 gives quantMax, so both ends are always usable)
+   udword lo = 0;
+   udword hi = toBits( approximate );
+   hi = (hi < 1) ? 1 : ((hi > one) ? one : hi);
+
+   if( encodeChannel( toFloat( hi ), enGamma, quantMax ) >= output )
+   {
+      // search down
+      for( udword step = 1;  ;  step *= 2 )
+      {
+         lo = (hi > step) ? (hi - step) : 0;
+         if( (0 == lo) ||
+            (encodeChannel( toFloat( lo ), enGamma, quantMax ) < output) )
+         {
+            break;
+         }
+         hi = lo;
+      }
+   }
+   else
+   {
+      // search up
+      lo = hi;
+      for( udword step = 1;  ;  step *= 2 )
+      {
+         hi = ((one - lo) > step) ? (lo + step) : one;
+         if( (one == hi) ||
+            (encodeChannel( toFloat( hi ), enGamma, quantMax ) >= output) )
+         {
+            break;
+         }
+         lo = hi;
+      }
+   }
+
+   // halve bracket
+   while( (hi - lo) > 1 )
+   {
+      const udword mid = lo + ((hi - lo) / 2);
+      if( encodeChannel( toFloat( mid ), enGamma, quantMax ) >= output )
+      {
+         hi = mid;
+      }
+      else
+      {
+         lo = mid;
+      }
+   }
+
+   return toFloat( hi );
+}
+
+
+inline
+float GammaEncoder::toFloat
+(
+   const udword bits
+)
+{
+   float f;
+   ::memcpy( &f, &bits, sizeof(f) );
+   return f;
+}
+
+
+inline
+udword GammaEncoder::toBits
+(
+   const float f
+)
+{
+   udword bits;
+   ::memcpy( &bits, &f, sizeof(bits) );
+   return bits;
+}
+
+
+
+
+/// IntegerConverter -----------------------------------------------------------
+
+template<class CHANNEL>
+IntegerConverter<CHANNEL>::IntegerConverter
+(
+   const GammaEncoder& encoder,
+   const dword         width,
+   const float*        pTriplesF,
+   CHANNEL*            pTriplesI
+)
+ : pEncoder_m ( &encoder )
+ , width_m    ( width )
+ , pTriplesF_m( pTriplesF )
+ , pTriplesI_m( pTriplesI )
+{
+}
+
+
+template<class CHANNEL>
+void IntegerConverter<CHANNEL>::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   const qword rowLength = static_cast<qword>(width_m) * 3;
+   const qword first     = rowLength * begin;
+   const qword length    = rowLength * (end - begin);
+
+   const GammaEncoder& encoder = *pEncoder_m;
+   const float*        pIn     = pTriplesF_m + first;
+   CHANNEL*            pOut    = pTriplesI_m + first;
+
+   for( qword i = 0;  i < length;  ++i )
+   {
+      pOut[i] = static_cast<CHANNEL>( encoder.encode( pIn[i] ) );
+   }
+}
+
 }
 
 
@@ -342,6 +741,25 @@ bool test_quantizing
             }
             if( pOut && isVerbose ) *pOut << "monotonicity: " << isOk2 << "\n";
             isOk &= isOk2;
+
+            // check same as decoding each channel, and with one thread
+            bool isOk4 = true;
+            ParallelBands::setThreadCount( 1 );
+            float* pTriplesF1 = 0;
+            makeFloatImage( 0.0f, width, width, maxVal, &(image[0]),
+               0, pTriplesF1 );
+            ParallelBands::setThreadCount( 0 );
+            for( dword i = 0;  i < imageLength * 3;  ++i )
+            {
+               const float reference = clamp01( ::powf( static_cast<float>(
+                  i / 3) / static_cast<float>(maxVal), 1.0f / SRGB_GAMMA ) );
+
+               isOk4 &= (reference == pTriplesF[i]) &&
+                  (pTriplesF1[i] == pTriplesF[i]);
+            }
+            scratch::release( pTriplesF1 );
+            if( pOut && isVerbose ) *pOut << "per channel: " << isOk4 << "\n";
+            isOk &= isOk4;
          }
 
          // make integer image
@@ -380,16 +798,79 @@ bool test_quantizing
          if( pOut && isVerbose ) *pOut << "identity: " << isOk3 << "\n\n";
          isOk &= isOk3;
 
-         delete[] pTriplesF;
-         if( 2 == pixelSize )
-         {
-            delete[] reinterpret_cast<uword*>(pTriplesI);
-         }
-         else
+         scratch::release( pTriplesF );
+         scratch::release( pTriplesI );
+      }
+      if( pOut && isVerbose ) *pOut << "\n";
+   }
+
+
+   // values above quantMax
+   {
+      const ubyte image[] = { 0, 100, 101, 200, 255, 50 };
+
+      float* pTriplesF = 0;
+      makeFloatImage( 2.0f, 2, 1, 100, image, 0, pTriplesF );
+
+      const bool isOk_ = (0.0f == pTriplesF[0]) && (1.0f == pTriplesF[1]) &&
+         (1.0f == pTriplesF[2]) && (1.0f == pTriplesF[3]) &&
+         (1.0f == pTriplesF[4]) && (0.25f == pTriplesF[5]);
+      scratch::release( pTriplesF );
+
+      if( pOut && isVerbose ) *pOut << "above max: " << isOk_ << "\n\n";
+      isOk &= isOk_;
+   }
+
+
+   // encode same as each channel by itself
+   {
+      static const float GAMMAS[]    = { 0.0f, 1.0f, 8.0f, 0.7f };
+      static const dword QUANTMAXS[] = { 255, 65535, 1, 100, 4095 };
+
+      // values: across all float bits in [0,1] (and a little beyond), and
+      // some negative
+      std::vector<float> values;
+      for( udword b = 0;  b < 0x3F900000u;  b += 4093 )
+      {
+         float f;
+         ::memcpy( &f, &b, sizeof(f) );
+         values.push_back( f );
+         values.push_back( (0 == (b & 7)) ? -f : f * 0.5f );
+      }
+      const dword width  = 1024;
+      const dword height = static_cast<dword>(values.size() / 3) / width;
+
+      ParallelBands::setThreadCount( 4 );
+      for( dword g = 0;  g < dword(sizeof(GAMMAS)/sizeof(GAMMAS[0]));  ++g )
+      {
+         for( dword q = 0;  q < dword(sizeof(QUANTMAXS)/sizeof(QUANTMAXS[0]));
+            ++q )
          {
-            delete[] reinterpret_cast<ubyte*>(pTriplesI);
+            const dword quantMax = QUANTMAXS[q];
+
+            float enGamma   = 0.0f;
+            void* pTriplesI = 0;
+            makeIntegerImage( GAMMAS[g], width, height, quantMax, &(values[0]),
+               &enGamma, pTriplesI );
+
+            dword errors = 0;
+            for( dword i = 0;  i < width * height * 3;  ++i )
+            {
+               const dword a = encodeChannel( values[i], enGamma, quantMax );
+               const dword b = (quantMax <= 255) ?
+                  static_cast<dword>(static_cast<ubyte*>(pTriplesI)[i]) :
+                  static_cast<dword>(static_cast<uword*>(pTriplesI)[i]);
+               errors += (a != b);
+            }
+            scratch::release( pTriplesI );
+
+            if( pOut && isVerbose ) *pOut << "encode " << enGamma << " " <<
+               quantMax << " : " << errors << "\n";
+            isOk &= (0 == errors);
          }
       }
+      ParallelBands::setThreadCount( 0 );
+
       if( pOut && isVerbose ) *pOut << "\n";
    }
 
@@ -26,11 +26,13 @@ namespace quantizing
 /**
  * Convert integer image to float [0,1] image (three channels).<br/><br/>
  *
+ * Values are decoded through a table, rows in parallel (see ParallelBands).
+ *
  * @i_deGamma    gamma to decode with, or 0 for default (sRGB 2.2)
  * @i_quantMax   max value of quantization, 1 to 65535
  * @i_pTriplesI  if i_quantMax <= 255 then ubyte* else uword*
  * @o_pDeGamma   gamma that was used to decode with
- * @o_pTriplesF  orphaned storage
+ * @o_pTriplesF  orphaned storage (free with scratch::release)
  *
  * @exceptions throws storage allocation and char* exceptions
  */
@@ -49,11 +51,14 @@ void makeFloatImage
 /**
  * Convert float [0,1] image to integer image (three channels).<br/><br/>
  *
+ * Values are placed among precomputed output steps (the same result as
+ * encoding each), rows in parallel (see ParallelBands).
+ *
  * @i_enGamma    gamma to encode with, or 0 for default (sRGB 1/2.2)
  * @i_quantMax   max value of quantization, 1 to 65535
  * @o_pEnGamma   gamma that was used to encode with
  * @o_pTriplesI  if i_quantMax <= 255 then ubyte* else uword*
- *               orphaned storage
+ *               orphaned storage (free with scratch::release)
  *
  * @exceptions throws storage allocation and char* exceptions
  */
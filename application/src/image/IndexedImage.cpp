@@ -0,0 +1,143 @@
+/*--------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+--------------------------------------------------------------------*/
+
+
+#include "IndexedImage.hpp"
+
+
+using namespace hxa7241_image;
+
+
+
+
+namespace
+{
+
+const char SIZE_INVALID_MESSAGE[] = "size out of range, in IndexedImage";
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+IndexedImage::IndexedImage()
+ : width_m   ( 0 )
+ , height_m  ( 0 )
+ , bitDepth_m( 8 )
+ , palette_m ()
+ , alphas_m  ()
+ , indices_m ()
+{
+}
+
+
+IndexedImage::~IndexedImage()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void IndexedImage::set
+(
+   const dword         width,
+   const dword         height,
+   const dword         bitDepth,
+   std::vector<ubyte>& alphas,
+   std::vector<ubyte>& indices
+)
+{
+   // check dimensions positive, and match indices
+   if( (width < 0) || (height < 0) ||
+      (static_cast<uqword>(indices.size()) != (static_cast<uqword>(width) *
+      static_cast<uqword>(height))) )
+   {
+      throw SIZE_INVALID_MESSAGE;
+   }
+
+   width_m    = width;
+   height_m   = height;
+   bitDepth_m = bitDepth;
+
+   alphas_m.swap( alphas );
+   indices_m.swap( indices );
+}
+
+
+ImageAdopter& IndexedImage::getPalette()
+{
+   return palette_m;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword IndexedImage::getWidth() const
+{
+   return width_m;
+}
+
+
+dword IndexedImage::getHeight() const
+{
+   return height_m;
+}
+
+
+dword IndexedImage::getBitDepth() const
+{
+   return bitDepth_m;
+}
+
+
+const ImageAdopter& IndexedImage::getPalette() const
+{
+   return palette_m;
+}
+
+
+const std::vector<ubyte>& IndexedImage::getAlphas() const
+{
+   return alphas_m;
+}
+
+
+const ubyte* IndexedImage::getIndices() const
+{
+   return !indices_m.empty() ? &(indices_m[0]) : 0;
+}
+
+
+void IndexedImage::getIndexWeights
+(
+   std::vector<float>& o_weights
+) const
+{
+   const dword paletteSize = palette_m.getWidth();
+
+   // histogram
+   // (indices beyond the palette are ignored)
+   std::vector<qword> counts( 256, 0 );
+   for( qword i = static_cast<qword>(indices_m.size());  i-- > 0; )
+   {
+      ++counts[ indices_m[i] ];
+   }
+
+   // scale by opacity
+   o_weights.resize( paletteSize );
+   for( dword i = paletteSize;  i-- > 0; )
+   {
+      const float opacity = (static_cast<udword>(i) < alphas_m.size()) ?
+         (static_cast<float>(alphas_m[i]) / 255.0f) : 1.0f;
+      o_weights[i] = static_cast<float>(counts[i]) * opacity;
+   }
+}
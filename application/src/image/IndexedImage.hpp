@@ -0,0 +1,95 @@
+/*--------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+--------------------------------------------------------------------*/
+
+
+#ifndef IndexedImage_h
+#define IndexedImage_h
+
+
+#include <vector>
+
+#include "ImageAdopter.hpp"
+
+
+
+
+#include "hxa7241_image.hpp"
+namespace hxa7241_image
+{
+
+
+/**
+ * A palette image, kept indexed.<br/><br/>
+ *
+ * The palette is a one-row image of float colors (with the file metadata), and
+ * each pixel is a byte index into it. Palette entries can have alpha bytes
+ * (those without are opaque).<br/><br/>
+ *
+ * @exceptions
+ * set can throw
+ */
+class IndexedImage
+{
+/// standard object services ---------------------------------------------------
+public:
+            IndexedImage();
+           ~IndexedImage();
+private:
+            IndexedImage( const IndexedImage& );
+   IndexedImage& operator=( const IndexedImage& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Adopts alphas and indices contents (by swapping).
+    *
+    * @bitDepth  bits per index in file: 1, 2, 4, or 8
+    */
+           void          set( dword               width,
+                              dword               height,
+                              dword               bitDepth,
+                              std::vector<ubyte>& alphas,
+                              std::vector<ubyte>& indices );
+
+           ImageAdopter& getPalette();
+
+
+/// queries --------------------------------------------------------------------
+           dword               getWidth()                                 const;
+           dword               getHeight()                                const;
+           dword               getBitDepth()                              const;
+           const ImageAdopter& getPalette()                               const;
+           const std::vector<ubyte>& getAlphas()                          const;
+           const ubyte*        getIndices()                               const;
+
+   /**
+    * Count of pixels using each palette entry, scaled by entry opacity.
+    */
+           void                getIndexWeights( std::vector<float>& )     const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword              width_m;
+   dword              height_m;
+   dword              bitDepth_m;
+
+   ImageAdopter       palette_m;
+   std::vector<ubyte> alphas_m;
+   std::vector<ubyte> indices_m;
+};
+
+
+}//namespace
+
+
+
+
+#endif//IndexedImage_h
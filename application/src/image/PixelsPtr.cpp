@@ -8,10 +8,13 @@
 ------------------------------------------------------------------------------*/
 
 
+#include "ScratchMemory.hpp"
+
 #include "PixelsPtr.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -27,7 +30,7 @@ PixelsPtr::PixelsPtr()
 PixelsPtr::PixelsPtr
 (
    const bool  is48Bit,
-   const dword length
+   const qword length
 )
  : is48Bit_m( false )
  , ptr_m    ( 0 )
@@ -48,11 +51,11 @@ PixelsPtr::~PixelsPtr()
 void PixelsPtr::set
 (
    const bool  is48Bit,
-   const dword length
+   const qword length
 )
 {
-   void* ptr = !is48Bit ? static_cast<void*>(new ubyte[length]) :
-      static_cast<void*>(new uword[length]);
+   void* ptr = scratch::allocate( length * (!is48Bit ? sizeof(ubyte) :
+      sizeof(uword)) );
 
    PixelsPtr::destruct();
 
@@ -74,12 +77,5 @@ void* PixelsPtr::release()
 /// implementation -------------------------------------------------------------
 void PixelsPtr::destruct()
 {
-   if( !is48Bit_m )
-   {
-      delete[] static_cast<ubyte*>( ptr_m );
-   }
-   else
-   {
-      delete[] static_cast<uword*>( ptr_m );
-   }
+   scratch::release( ptr_m );
 }
@@ -22,6 +22,8 @@ namespace hxa7241_image
 /**
  * Simplified auto_ptr for void-polymorphic pixels.<br/><br/>
  *
+ * Storage is from scratch::allocate, so may be out-of-core.<br/><br/>
+ *
  * No copying.<br/><br/>
  *
  * @implementation
@@ -48,7 +50,7 @@ class PixelsPtr
 public:
    PixelsPtr();
    PixelsPtr( const bool  is48Bit,
-              const dword length );
+              const qword length );
    ~PixelsPtr();
 
 private:
@@ -59,7 +61,7 @@ public:
 
 /// commands -------------------------------------------------------------------
    void  set( const bool  is48Bit,
-              const dword length );
+              const qword length );
 
    void* release();
 
@@ -0,0 +1,94 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef ScanlineCodec_h
+#define ScanlineCodec_h
+
+
+
+
+#include "hxa7241_image.hpp"
+namespace hxa7241_image
+{
+
+/**
+ * An image file read a strip of rows at a time.<br/><br/>
+ *
+ * So an image can go through in pieces, never all in memory. Rows come top
+ * first, R then G then B. Pixels are as the format has them: byte triples, or
+ * word triples if more than 8 bit, for integer formats (PNG, PPM) -- float
+ * triples for the rest. ImageFormatter's readers give float triples for all.
+ * <br/><br/>
+ *
+ * Made by the codecs' openReader functions (and ImageFormatter); destruction
+ * closes the file.
+ *
+ * @exceptions
+ * readRows throws char[] messages and allocation exceptions
+ */
+class ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   virtual ~ScanlineReader() {}
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Read the next rows.
+    *
+    * @rows      how many: no more than are left
+    * @pTriples  storage for rows * width triples
+    */
+   virtual void readRows( dword rows,
+                          void* pTriples ) = 0;
+};
+
+
+
+
+/**
+ * An image file written a strip of rows at a time.<br/><br/>
+ *
+ * Rows and pixels as ScanlineReader. The file is complete only after finish
+ * -- destruction without it closes the file unfinished.
+ *
+ * @exceptions
+ * commands throw char[] messages and allocation exceptions
+ */
+class ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   virtual ~ScanlineWriter() {}
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Write the next rows.
+    *
+    * @rows      how many: no more than are left
+    * @pTriples  rows * width triples
+    */
+   virtual void writeRows( dword       rows,
+                           const void* pTriples ) = 0;
+
+   /**
+    * Complete the file, after all rows are written.
+    */
+   virtual void finish() = 0;
+};
+
+}//namespace
+
+
+
+
+#endif//ScanlineCodec_h
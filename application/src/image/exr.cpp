@@ -8,6 +8,9 @@
 ------------------------------------------------------------------------------*/
 
 
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
 #include <vector>
 #include <string>
 #include <utility>
@@ -15,7 +18,11 @@
 #include "ImfCRgbaFile.h"
 
 #include "DynamicLibraryInterface.hpp"
+#include "Threads.hpp"
+#include "ParallelBands.hpp"
+#include "ScratchMemory.hpp"
 #include "StreamExceptionSet.hpp"
+#include "ScanlineCodec.hpp"
 
 #include "exr.hpp"
 
@@ -41,6 +48,15 @@ const char NEW_HEADER_EXCEPTION_MESSAGE[] =
 
 const char HXA7241_URI[] = "http://www.hxa7241.org/";
 
+// (rows per band, converting in parallel)
+const dword BAND_ROWS = 16;
+
+// (rows per chunk, reading in parallel: a multiple of the biggest compression
+// block -- 32 rows -- so no block is decompressed for two chunks)
+const dword CHUNK_ROWS = 64;
+
+const ImfHalf HALF_ONE = 0x3C00;
+
 const char LIB_PATHNAME_DEFAULT[] =
 #ifdef _PLATFORM_WIN
    "IlmImf_dll.dll";
@@ -52,7 +68,9 @@ const char LIB_PATHNAME_DEFAULT[] =
 
 
 /// globals
+// (loaded on first use, and kept -- so a batch of images loads them only once)
 void* libraries_g[] = { 0, 0, 0, 0 };
+Mutex librariesMutex_g;
 
 
 /// ----------------------------------------------------------------------------
@@ -70,21 +88,243 @@ void readHeader
    const ImfInputFile* pExrInFile,
    dword&              width,
    dword&              height,
+   int&                xMin,
+   int&                yMin,
    bool&               isLowTop,
    float*              pPrimaries8,
    float&              scalingToGetCdm2
 );
 
-void readPixels
+class InputHandles;
+
+void readRows
 (
-   ImfInputFile* pExrInFile,
+   InputHandles& handles,
+   const float*  pHalfTable,
    dword         width,
-   dword         height,
-   bool          isLowTop,
-   dword         orderingFlags,
+   int           xMin,
+   int           yFirst,
+   dword         rows,
+   bool          isFlipped,
+   bool          isBgr,
+   ImfRgba*      pRgbas,
    float*        pTriples
 );
 
+void makeHalfTable
+(
+   std::vector<float>& halfTable
+);
+
+
+/// write sub-procedure declarations -------------------------------------------
+ImfHeader* makeHeader
+(
+   dword width,
+   dword height,
+   float scalingToGetCdm2,
+   dword compression
+);
+
+void encodeRows
+(
+   dword        width,
+   dword        rows,
+   bool         isFlipped,
+   bool         isBgr,
+   const float* pTriples,
+   ImfRgba*     pRgbas
+);
+
+ImfHalf floatToHalf
+(
+   float f
+);
+
+
+/// types ----------------------------------------------------------------------
+/**
+ * Converts rows of half RGBA to float triples (ignoring alpha), through a
+ * table of all halves.
+ */
+class HalfDecoder
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   HalfDecoder( const float*   pHalfTable,
+                dword          width,
+                dword          rows,
+                bool           isFlipped,
+                bool           isBgr,
+                const ImfRgba* pRgbas,
+                float*         pTriples );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   const float*   pHalfTable_m;
+   dword          width_m;
+   dword          rows_m;
+   bool           isFlipped_m;
+   bool           isBgr_m;
+   const ImfRgba* pRgbas_m;
+   float*         pTriples_m;
+};
+
+
+/**
+ * Handles on one input file, for reading parts of it in parallel (the library
+ * decompresses in the calling thread, so needs a handle per thread).<br/><br/>
+ *
+ * Handles are opened as needed, kept for reuse, and closed on destruction.
+ * Thread-safe.
+ */
+class InputHandles
+{
+/// standard object services ---------------------------------------------------
+public:
+            InputHandles();
+
+           ~InputHandles();
+private:
+            InputHandles( const InputHandles& );
+   InputHandles& operator=( const InputHandles& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @return  first handle (for the header -- and to take after)
+    */
+   ImfInputFile* open( const char pathName[] );
+
+   ImfInputFile* take();
+   void          give( ImfInputFile* pExrInFile );
+
+/// fields ---------------------------------------------------------------------
+private:
+   std::string                pathName_m;
+   std::vector<ImfInputFile*> opened_m;
+   std::vector<ImfInputFile*> free_m;
+   Mutex                      mutex_m;
+};
+
+
+/**
+ * Reads rows in chunks, then converts them, chunks in parallel -- each through
+ * a handle of its own.
+ */
+class ChunkReader
+   : public HalfDecoder
+{
+/// standard object services ---------------------------------------------------
+public:
+   ChunkReader( InputHandles& handles,
+                const float*  pHalfTable,
+                dword         width,
+                int           xMin,
+                int           yFirst,
+                dword         rows,
+                bool          isFlipped,
+                bool          isBgr,
+                ImfRgba*      pRgbas,
+                float*        pTriples );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   InputHandles* pHandles_m;
+   dword         width_m;
+   int           xMin_m;
+   int           yFirst_m;
+   ImfRgba*      pRgbas_m;
+};
+
+
+/**
+ * Converts rows of float triples to half RGBA (alpha one).
+ */
+class HalfEncoder
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   HalfEncoder( dword        width,
+                dword        rows,
+                bool         isFlipped,
+                bool         isBgr,
+                const float* pTriples,
+                ImfRgba*     pRgbas );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword        width_m;
+   dword        rows_m;
+   bool         isFlipped_m;
+   bool         isBgr_m;
+   const float* pTriples_m;
+   ImfRgba*     pRgbas_m;
+};
+
+
+/**
+ * An output file of scanlines, or of tiles.
+ */
+class OutputFile
+{
+/// standard object services ---------------------------------------------------
+public:
+            OutputFile();
+
+           ~OutputFile();
+private:
+            OutputFile( const OutputFile& );
+   OutputFile& operator=( const OutputFile& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @tileSize  tile width and height, or 0 for scanlines
+    */
+   void open( const char       pathName[],
+              const ImfHeader* pExrHeader,
+              dword            width,
+              dword            tileSize );
+
+   /**
+    * Write rows, converted. Tiled, they must start on a tile row, and be
+    * whole tile rows or reach the bottom.
+    */
+   void writePixels( dword          yFirst,
+                     dword          rows,
+                     const ImfRgba* pRgbas );
+
+   /**
+    * @return  false if the file could not be finished
+    */
+   bool close();
+
+/// fields ---------------------------------------------------------------------
+private:
+   ImfOutputFile*      pScanlineFile_m;
+   ImfTiledOutputFile* pTiledFile_m;
+   dword               width_m;
+   dword               tileSize_m;
+};
+
 }
 
 
@@ -143,289 +383,1058 @@ void hxa7241_image::exr::read
 {
    loadLibraries( i_exrLibraryPathName );
 
-   ImfInputFile* pExrInFile = 0;
+   // open file (handles closed on leaving)
+   InputHandles handles;
+   ImfInputFile* pExrInFile = handles.open( i_filePathName );
+
+   // read header
+   dword width          = 0;
+   dword height         = 0;
+   int   xMin           = 0;
+   int   yMin           = 0;
+   float pPrimaries8[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+   float scalingToGetCdm2 = 0.0f;
+   bool  isLowTop       = true;
+   readHeader( pExrInFile, width, height, xMin, yMin, isLowTop,
+      pPrimaries8, scalingToGetCdm2 );
+   handles.give( pExrInFile );
+
+   // allocate storage
+   scratch::Ptr<float> pTriples( static_cast<qword>(width) * height * 3 );
+
+   // read pixels: in chunks, in parallel, converting each
+   {
+      scratch::Ptr<ImfRgba> pRgbas( static_cast<qword>(width) * height );
+      std::vector<float>    halfTable;
+      makeHalfTable( halfTable );
+
+      readRows( handles, &(halfTable[0]), width, xMin, yMin, height,
+         ((i_orderingFlags & exr::IS_LOW_TOP) != 0) ^ isLowTop,
+         (i_orderingFlags & exr::IS_BGR) != 0, pRgbas.get(),
+         pTriples.get() );
+   }
+
+   // set outputs (now that no exceptions can happen)
+   o_width  = width;
+   o_height = height;
+   for( int i = 8;  i-- > 0;  o_pPrimaries8[i] = pPrimaries8[i] );
+   o_scalingToGetCdm2 = scalingToGetCdm2;
+   o_pTriples         = pTriples.release();
+}
+
+
+namespace
+{
+
+void readHeader
+(
+   const ImfInputFile* pExrInFile,
+   dword&              width,
+   dword&              height,
+   int&                xMin,
+   int&                yMin,
+   bool&               isLowTop,
+   float*              pPrimaries8,
+   float&              scalingToGetCdm2
+)
+{
+   // get header
+   const ImfHeader* pExrHeader = ::ImfInputHeader( pExrInFile );
+   if( !pExrHeader )
+   {
+      //const char* ::ImfErrorMessage();
+      throw OPEN_FILE_EXCEPTION_MESSAGE;
+   }
+
+   // get dimensions
+   {
+      int xMax;
+      int yMax;
+      ::ImfHeaderDataWindow( pExrHeader, &xMin, &yMin, &xMax, &yMax );
+      width  = xMax - xMin + 1;
+      height = yMax - yMin + 1;
+
+      width  = (width  >= 0) ? width  : 0;
+      height = (height >= 0) ? height : 0;
+   }
+
+   // get some attributes
+   {
+      // row order
+      isLowTop = ::ImfHeaderLineOrder( pExrHeader ) == IMF_INCREASING_Y;
+
+      // pixel value scaling
+      // whiteLuminance
+      // cd/m^2 of white
+      // and 'white' is rgb(1,1,1)
+      // so, equals scalingToGetCdm2
+      scalingToGetCdm2 = 0.0f;
+      if( 0 == ::ImfHeaderFloatAttribute(
+         pExrHeader, "whiteLuminance", &scalingToGetCdm2 ) )
+      {
+         scalingToGetCdm2 = 0.0f;
+      }
+
+      // color space
+      // (not possible)
+      {
+//          if( 0 == ImfHeader__Attribute(
+//             pExrHeader, "chromaticities",  );
+         {
+            for( dword i = 8;  i-- > 0; )
+            {
+               pPrimaries8[i] = 0.0f;
+            }
+         }
+      }
+   }
+}
+
+
+/**
+ * Read rows (of the data window) in chunks -- each with one frame buffer and
+ * one library call -- and convert them, chunks in parallel.
+ *
+ * @pRgbas    storage for the rows as read
+ * @pTriples  storage for the rows converted (in reverse order if flipped)
+ */
+void readRows
+(
+   InputHandles& handles,
+   const float*  pHalfTable,
+   const dword   width,
+   const int     xMin,
+   const int     yFirst,
+   const dword   rows,
+   const bool    isFlipped,
+   const bool    isBgr,
+   ImfRgba*      pRgbas,
+   float*        pTriples
+)
+{
+   if( rows > 0 )
+   {
+      ChunkReader reader( handles, pHalfTable, width, xMin, yFirst, rows,
+         isFlipped, isBgr, pRgbas, pTriples );
+      reader.run( rows, CHUNK_ROWS );
+   }
+}
+
+
+/**
+ * Make the float value of every half, exactly.
+ */
+void makeHalfTable
+(
+   std::vector<float>& halfTable
+)
+{
+   halfTable.resize( 65536 );
+
+   for( udword h = 0;  h < 65536;  ++h )
+   {
+      const udword sign     = (h & 0x8000u) << 16;
+      dword        exponent = static_cast<dword>((h >> 10) & 0x1Fu);
+      udword       mantissa = h & 0x03FFu;
+
+      udword bits = 0;
+      // zero
+      if( (0 == exponent) && (0 == mantissa) )
+      {
+         bits = sign;
+      }
+      // infinity and NaN (keeping its payload)
+      else if( 31 == exponent )
+      {
+         bits = sign | 0x7F800000u | (mantissa << 13);
+      }
+      else
+      {
+         // denormal: normalize
+         if( 0 == exponent )
+         {
+            while( 0 == (mantissa & 0x0400u) )
+            {
+               mantissa <<= 1;
+               --exponent;
+            }
+            ++exponent;
+            mantissa &= ~0x0400u;
+         }
+
+         bits = sign | (static_cast<udword>(exponent + (127 - 15)) << 23) |
+            (mantissa << 13);
+      }
+
+      ::memcpy( &(halfTable[h]), &bits, sizeof(float) );
+   }
+}
+
+}
+
+
+
+
+/// write ----------------------------------------------------------------------
+void hxa7241_image::exr::write
+(
+   const char         i_exrLibraryPathName[],
+   const dword        i_width,
+   const dword        i_height,
+   const float* const ,//i_pPrimaries8,
+   const float        i_scalingToGetCdm2,
+   const dword        i_orderingFlags,
+   const float* const i_pTriples,
+   const char         i_filePathName[],
+   const ECompression i_compression,
+   const dword        i_tileSize
+)
+{
+   loadLibraries( i_exrLibraryPathName );
+
+   ImfHeader* pExrHeader = 0;
 
    try
    {
-      // open file
-      pExrInFile = ::ImfOpenInputFile( i_filePathName );
-      if( !pExrInFile )
+      // make header
+      pExrHeader = makeHeader( i_width, i_height, i_scalingToGetCdm2,
+         i_compression );
+
+      // open file (closed on leaving)
+      OutputFile exrOutFile;
+      exrOutFile.open( i_filePathName, pExrHeader, i_width, i_tileSize );
+
+      // write pixels: all converted, in parallel, then in one call
+      if( i_height > 0 )
       {
-         //const char* ::ImfErrorMessage();
-         throw OPEN_FILE_EXCEPTION_MESSAGE;
+         scratch::Ptr<ImfRgba> pRgbas( static_cast<qword>(i_width) *
+            i_height );
+
+         encodeRows( i_width, i_height,
+            (i_orderingFlags & exr::IS_LOW_TOP) == 0,
+            (i_orderingFlags & exr::IS_BGR) != 0, i_pTriples, pRgbas.get() );
+         exrOutFile.writePixels( 0, i_height, pRgbas.get() );
       }
 
-      // read header
-      dword width          = 0;
-      dword height         = 0;
-      float pPrimaries8[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
-      float scalingToGetCdm2 = 0.0f;
-      bool  isLowTop       = true;
-      readHeader( pExrInFile, width, height, isLowTop,
-         pPrimaries8, scalingToGetCdm2 );
+      if( !exrOutFile.close() )
+      {
+         throw OUT_STREAM_EXCEPTION_MESSAGE;
+      }
+      ::ImfDeleteHeader( pExrHeader );
+   }
+   catch( ... )
+   {
+      ::ImfDeleteHeader( pExrHeader );
 
-      // allocate storage
-      std::auto_ptr<float> pTriples( new float[ width * height * 3 ] );
+      throw;
+   }
+}
 
-      // read pixels
-      readPixels( pExrInFile, width, height, isLowTop, i_orderingFlags,
-         pTriples.get() );
 
-      // close file
-      ::ImfCloseInputFile( pExrInFile );
+namespace
+{
 
-      freeLibraries();
+ImfHeader* makeHeader
+(
+   const dword width,
+   const dword height,
+   const float scalingToGetCdm2,
+   const dword compression
+)
+{
+   ImfHeader* pExrHeader = ::ImfNewHeader();
+   if( !pExrHeader )
+   {
+      //const char* ::ImfErrorMessage();
+      throw NEW_HEADER_EXCEPTION_MESSAGE;
+   }
+
+   // copy header
+   ::ImfHeaderSetDisplayWindow( pExrHeader, 0, 0, width - 1, height - 1 );
+   ::ImfHeaderSetDataWindow( pExrHeader, 0, 0, width - 1, height - 1 );
+   ::ImfHeaderSetScreenWindowWidth( pExrHeader, static_cast<float>(width) );
+   ::ImfHeaderSetLineOrder( pExrHeader, IMF_INCREASING_Y );
+   ::ImfHeaderSetCompression( pExrHeader, static_cast<int>(compression) );
 
-      // set outputs (now that no exceptions can happen)
-      o_width  = width;
-      o_height = height;
-      for( int i = 8;  i-- > 0;  o_pPrimaries8[i] = pPrimaries8[i] );
-      o_scalingToGetCdm2 = scalingToGetCdm2;
-      o_pTriples         = pTriples.release();
+   // pixel value scaling
+   if( 0.0f != scalingToGetCdm2 )
+   {
+      ::ImfHeaderSetFloatAttribute( pExrHeader, "whiteLuminance",
+         scalingToGetCdm2 );
+   }
+
+   // primaries (not possible)
+   //if( i_pPrimaries8 )
+   //{
+   //   ::ImfHeaderSet__Attribute( pExrHeader, "chromaticities",
+   //      i_pPrimaries8 );
+   //}
+
+   ::ImfHeaderSetStringAttribute( pExrHeader, "software", HXA7241_URI );
+
+   return pExrHeader;
+}
+
+
+/**
+ * Convert rows, rows in parallel.
+ *
+ * @pTriples  rows to convert (in reverse order if flipped)
+ * @pRgbas    storage for the rows converted
+ */
+void encodeRows
+(
+   const dword  width,
+   const dword  rows,
+   const bool   isFlipped,
+   const bool   isBgr,
+   const float* pTriples,
+   ImfRgba*     pRgbas
+)
+{
+   if( rows > 0 )
+   {
+      HalfEncoder encoder( width, rows, isFlipped, isBgr, pTriples, pRgbas );
+      encoder.run( rows, BAND_ROWS );
+   }
+}
+
+
+/**
+ * Convert float to half, rounding to nearest (ties to even) -- the same as
+ * the OpenEXR library.
+ */
+inline
+ImfHalf floatToHalf
+(
+   const float f
+)
+{
+   udword bits;
+   ::memcpy( &bits, &f, sizeof(bits) );
+
+   const udword sign     = (bits >> 16) & 0x8000u;
+   const dword  exponent = static_cast<dword>((bits >> 23) & 0xFFu) -
+      (127 - 15);
+   udword       mantissa = bits & 0x007FFFFFu;
+
+   udword half = 0;
+   // zero or denormal
+   if( exponent <= 0 )
+   {
+      // (too small for a denormal: zero)
+      if( exponent >= -10 )
+      {
+         mantissa |= 0x00800000u;
+         const dword  shift = 14 - exponent;
+         const udword round = (1u << (shift - 1)) - 1;
+         const udword odd   = (mantissa >> shift) & 1u;
+         half = (mantissa + round + odd) >> shift;
+      }
+   }
+   // infinity and NaN (keeping a NaN a NaN)
+   else if( exponent == (0xFF - (127 - 15)) )
+   {
+      mantissa >>= 13;
+      half = 0x7C00u | mantissa | ((0 != (bits & 0x007FFFFFu)) & (0 ==
+         mantissa));
+   }
+   else
+   {
+      // round, carrying into the exponent
+      mantissa = mantissa + 0x0FFFu + ((mantissa >> 13) & 1u);
+      dword e = exponent;
+      if( 0 != (mantissa & 0x00800000u) )
+      {
+         mantissa = 0;
+         ++e;
+      }
+
+      // overflow to infinity
+      half = (e > 30) ? 0x7C00u : ((static_cast<udword>(e) << 10) |
+         (mantissa >> 13));
+   }
+
+   return static_cast<ImfHalf>( sign | half );
+}
+
+
+/// HalfDecoder ----------------------------------------------------------------
+HalfDecoder::HalfDecoder
+(
+   const float*   pHalfTable,
+   const dword    width,
+   const dword    rows,
+   const bool     isFlipped,
+   const bool     isBgr,
+   const ImfRgba* pRgbas,
+   float*         pTriples
+)
+ : pHalfTable_m( pHalfTable )
+ , width_m     ( width )
+ , rows_m      ( rows )
+ , isFlipped_m ( isFlipped )
+ , isBgr_m     ( isBgr )
+ , pRgbas_m    ( pRgbas )
+ , pTriples_m  ( pTriples )
+{
+}
+
+
+void HalfDecoder::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   const float* pTable = pHalfTable_m;
+   const dword  first  = isBgr_m ? 2 : 0;
+   const dword  last   = 2 - first;
+
+   for( dword y = begin;  y < end;  ++y )
+   {
+      const ImfRgba* pIn  = pRgbas_m + (static_cast<qword>(y) * width_m);
+      float*         pOut = pTriples_m + (static_cast<qword>(isFlipped_m ?
+         rows_m - 1 - y : y) * width_m * 3);
+
+      for( dword x = 0;  x < width_m;  ++x, pOut += 3 )
+      {
+         pOut[first] = pTable[ pIn[x].r ];
+         pOut[1]     = pTable[ pIn[x].g ];
+         pOut[last]  = pTable[ pIn[x].b ];
+      }
+   }
+}
+
+
+/// InputHandles ---------------------------------------------------------------
+InputHandles::InputHandles()
+ : pathName_m()
+ , opened_m  ()
+ , free_m    ()
+ , mutex_m   ()
+{
+}
+
+
+InputHandles::~InputHandles()
+{
+   for( size_t i = opened_m.size();  i-- > 0; )
+   {
+      ::ImfCloseInputFile( opened_m[i] );
+   }
+}
+
+
+ImfInputFile* InputHandles::open
+(
+   const char pathName[]
+)
+{
+   pathName_m = pathName;
+
+   return take();
+}
+
+
+ImfInputFile* InputHandles::take()
+{
+   // a free one
+   {
+      MutexLock lock( mutex_m );
+
+      if( !free_m.empty() )
+      {
+         ImfInputFile* pExrInFile = free_m.back();
+         free_m.pop_back();
+         return pExrInFile;
+      }
+   }
+
+   // or a new one (opened unlocked, so others can open in parallel)
+   ImfInputFile* pExrInFile = ::ImfOpenInputFile( pathName_m.c_str() );
+   if( !pExrInFile )
+   {
+      //const char* ::ImfErrorMessage();
+      throw OPEN_FILE_EXCEPTION_MESSAGE;
+   }
+
+   try
+   {
+      MutexLock lock( mutex_m );
+
+      opened_m.push_back( pExrInFile );
+      free_m.reserve( opened_m.size() );
    }
    catch( ... )
    {
       ::ImfCloseInputFile( pExrInFile );
+      throw;
+   }
 
-      freeLibraries();
+   return pExrInFile;
+}
 
-      throw;
+
+void InputHandles::give
+(
+   ImfInputFile* pExrInFile
+)
+{
+   MutexLock lock( mutex_m );
+
+   // (reserved when opened, so cannot throw)
+   free_m.push_back( pExrInFile );
+}
+
+
+/// ChunkReader ----------------------------------------------------------------
+ChunkReader::ChunkReader
+(
+   InputHandles& handles,
+   const float*  pHalfTable,
+   const dword   width,
+   const int     xMin,
+   const int     yFirst,
+   const dword   rows,
+   const bool    isFlipped,
+   const bool    isBgr,
+   ImfRgba*      pRgbas,
+   float*        pTriples
+)
+ : HalfDecoder( pHalfTable, width, rows, isFlipped, isBgr, pRgbas, pTriples )
+ , pHandles_m ( &handles )
+ , width_m    ( width )
+ , xMin_m     ( xMin )
+ , yFirst_m   ( yFirst )
+ , pRgbas_m   ( pRgbas )
+{
+}
+
+
+void ChunkReader::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   // (a handle that throws is not given back -- just closed at the end)
+   ImfInputFile* pExrInFile = pHandles_m->take();
+
+   // (the frame buffer is addressed by data window coordinates -- so its
+   // base is offset back to the origin)
+   const std::ptrdiff_t origin = (static_cast<std::ptrdiff_t>(yFirst_m) *
+      width_m) + xMin_m;
+   if( !::ImfInputSetFrameBuffer( pExrInFile, pRgbas_m - origin, 1,
+      width_m ) || !::ImfInputReadPixels( pExrInFile, yFirst_m +
+      static_cast<int>(begin), yFirst_m + static_cast<int>(end) - 1 ) )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
    }
+
+   pHandles_m->give( pExrInFile );
+
+   HalfDecoder::doBand( begin, end );
 }
 
 
+/// HalfEncoder ----------------------------------------------------------------
+HalfEncoder::HalfEncoder
+(
+   const dword  width,
+   const dword  rows,
+   const bool   isFlipped,
+   const bool   isBgr,
+   const float* pTriples,
+   ImfRgba*     pRgbas
+)
+ : width_m    ( width )
+ , rows_m     ( rows )
+ , isFlipped_m( isFlipped )
+ , isBgr_m    ( isBgr )
+ , pTriples_m ( pTriples )
+ , pRgbas_m   ( pRgbas )
+{
+}
+
+
+void HalfEncoder::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   const dword first = isBgr_m ? 2 : 0;
+   const dword last  = 2 - first;
+
+   for( dword y = begin;  y < end;  ++y )
+   {
+      const float* pIn  = pTriples_m + (static_cast<qword>(isFlipped_m ?
+         rows_m - 1 - y : y) * width_m * 3);
+      ImfRgba*     pOut = pRgbas_m + (static_cast<qword>(y) * width_m);
+
+      for( dword x = 0;  x < width_m;  ++x, pIn += 3 )
+      {
+         pOut[x].r = floatToHalf( pIn[first] );
+         pOut[x].g = floatToHalf( pIn[1] );
+         pOut[x].b = floatToHalf( pIn[last] );
+         pOut[x].a = HALF_ONE;
+      }
+   }
+}
+
+
+/// OutputFile -----------------------------------------------------------------
+OutputFile::OutputFile()
+ : pScanlineFile_m( 0 )
+ , pTiledFile_m   ( 0 )
+ , width_m        ( 0 )
+ , tileSize_m     ( 0 )
+{
+}
+
+
+OutputFile::~OutputFile()
+{
+   OutputFile::close();
+}
+
+
+void OutputFile::open
+(
+   const char       pathName[],
+   const ImfHeader* pExrHeader,
+   const dword      width,
+   const dword      tileSize
+)
+{
+   if( tileSize > 0 )
+   {
+      pTiledFile_m = ::ImfOpenTiledOutputFile( pathName, pExrHeader,
+         IMF_WRITE_RGB, tileSize, tileSize, IMF_ONE_LEVEL, IMF_ROUND_DOWN );
+   }
+   else
+   {
+      pScanlineFile_m = ::ImfOpenOutputFile( pathName, pExrHeader,
+         IMF_WRITE_RGB );
+   }
+
+   if( !pTiledFile_m && !pScanlineFile_m )
+   {
+      //const char* ::ImfErrorMessage();
+      throw OPEN_FILE_EXCEPTION_MESSAGE;
+   }
+
+   width_m    = width;
+   tileSize_m = tileSize;
+}
+
+
+void OutputFile::writePixels
+(
+   const dword    yFirst,
+   const dword    rows,
+   const ImfRgba* pRgbas
+)
+{
+   if( rows > 0 )
+   {
+      // (the frame buffer is addressed by data window coordinates -- so its
+      // base is offset back to the origin)
+      const ImfRgba* pBase = pRgbas - (static_cast<std::ptrdiff_t>(yFirst) *
+         width_m);
+
+      bool isOk = false;
+      if( pTiledFile_m )
+      {
+         // every tile in the rows' tile rows
+         isOk = (0 != ::ImfTiledOutputSetFrameBuffer( pTiledFile_m, pBase, 1,
+            width_m ));
+
+         const dword tilesX = (width_m + tileSize_m - 1) / tileSize_m;
+         const dword tilesY = (yFirst + rows + tileSize_m - 1) / tileSize_m;
+         for( dword y = yFirst / tileSize_m;  isOk && (y < tilesY);  ++y )
+         {
+            for( dword x = 0;  isOk && (x < tilesX);  ++x )
+            {
+               isOk = (0 != ::ImfTiledOutputWriteTile( pTiledFile_m, x, y, 0,
+                  0 ));
+            }
+         }
+      }
+      else
+      {
+         // all in one call
+         isOk = (0 != ::ImfOutputSetFrameBuffer( pScanlineFile_m, pBase, 1,
+            width_m )) && (0 != ::ImfOutputWritePixels( pScanlineFile_m,
+            static_cast<int>(rows) ));
+      }
+
+      if( !isOk )
+      {
+         throw OUT_STREAM_EXCEPTION_MESSAGE;
+      }
+   }
+}
+
+
+bool OutputFile::close()
+{
+   bool isClosed = true;
+
+   if( pTiledFile_m )
+   {
+      isClosed = (0 != ::ImfCloseTiledOutputFile( pTiledFile_m ));
+      pTiledFile_m = 0;
+   }
+   if( pScanlineFile_m )
+   {
+      isClosed = (0 != ::ImfCloseOutputFile( pScanlineFile_m ));
+      pScanlineFile_m = 0;
+   }
+
+   return isClosed;
+}
+
+}
+
+
+
+
+/// scanlines ------------------------------------------------------------------
 namespace
 {
 
-void readHeader
+/**
+ * Rows read from a file, a few at a time, top first.
+ */
+class RowReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowReader();
+
+   virtual ~RowReader();
+private:
+   RowReader( const RowReader& );
+   RowReader& operator=( const RowReader& );
+public:
+
+/// commands -------------------------------------------------------------------
+           void open( const char pathName[],
+                      dword&     width,
+                      dword&     height,
+                      float*     pPrimaries8,
+                      float&     scalingToGetCdm2 );
+
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   InputHandles         handles_m;
+   dword                width_m;
+   dword                height_m;
+   int                  xMin_m;
+   int                  yMin_m;
+   bool                 isLowTop_m;
+   dword                next_m;
+   std::vector<float>   halfTable_m;
+   std::vector<ImfRgba> rgbas_m;
+};
+
+
+RowReader::RowReader()
+ : handles_m   ()
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , xMin_m      ( 0 )
+ , yMin_m      ( 0 )
+ , isLowTop_m  ( true )
+ , next_m      ( 0 )
+ , halfTable_m ()
+ , rgbas_m     ()
+{
+}
+
+
+RowReader::~RowReader()
+{
+}
+
+
+void RowReader::open
+(
+   const char pathName[],
+   dword&     width,
+   dword&     height,
+   float*     pPrimaries8,
+   float&     scalingToGetCdm2
+)
+{
+   // open file
+   ImfInputFile* pExrInFile = handles_m.open( pathName );
+
+   // read header
+   readHeader( pExrInFile, width_m, height_m, xMin_m, yMin_m, isLowTop_m,
+      pPrimaries8, scalingToGetCdm2 );
+   handles_m.give( pExrInFile );
+
+   makeHalfTable( halfTable_m );
+
+   width  = width_m;
+   height = height_m;
+}
+
+
+void RowReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // the next rows down, or up, the data window -- in chunks, in parallel
+   rgbas_m.resize( static_cast<size_t>(width_m) * (rows ? rows : 1) );
+   const dword first = isLowTop_m ? next_m : height_m - (next_m + rows);
+   ::readRows( handles_m, &(halfTable_m[0]), width_m, xMin_m, yMin_m +
+      static_cast<int>(first), rows, !isLowTop_m, false, &(rgbas_m[0]),
+      static_cast<float*>(pTriples) );
+
+   next_m += rows;
+}
+
+
+/**
+ * Rows written to a file, a few at a time, top first -- tiled, gathered into
+ * whole tile rows.
+ */
+class RowWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowWriter();
+
+   virtual ~RowWriter();
+private:
+   RowWriter( const RowWriter& );
+   RowWriter& operator=( const RowWriter& );
+public:
+
+/// commands -------------------------------------------------------------------
+           void open( dword      width,
+                      dword      height,
+                      float      scalingToGetCdm2,
+                      dword      compression,
+                      dword      tileSize,
+                      const char pathName[] );
+
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   ImfHeader*           pExrHeader_m;
+   OutputFile           exrOutFile_m;
+   dword                width_m;
+   dword                height_m;
+   dword                tileSize_m;
+   dword                next_m;
+   dword                pending_m;
+   std::vector<ImfRgba> rgbas_m;
+};
+
+
+RowWriter::RowWriter()
+ : pExrHeader_m ( 0 )
+ , exrOutFile_m ()
+ , width_m      ( 0 )
+ , height_m     ( 0 )
+ , tileSize_m   ( 0 )
+ , next_m       ( 0 )
+ , pending_m    ( 0 )
+ , rgbas_m      ()
+{
+}
+
+
+RowWriter::~RowWriter()
+{
+   exrOutFile_m.close();
+   ::ImfDeleteHeader( pExrHeader_m );
+}
+
+
+void RowWriter::open
+(
+   const dword width,
+   const dword height,
+   const float scalingToGetCdm2,
+   const dword compression,
+   const dword tileSize,
+   const char  pathName[]
+)
+{
+   // make header, and open file
+   pExrHeader_m = makeHeader( width, height, scalingToGetCdm2, compression );
+
+   exrOutFile_m.open( pathName, pExrHeader_m, width, tileSize );
+
+   width_m    = width;
+   height_m   = height;
+   tileSize_m = tileSize;
+}
+
+
+void RowWriter::writeRows
 (
-   const ImfInputFile* pExrInFile,
-   dword&              width,
-   dword&              height,
-   bool&               isLowTop,
-   float*              pPrimaries8,
-   float&              scalingToGetCdm2
+   const dword rows,
+   const void* pTriples
 )
 {
-   // get header
-   const ImfHeader* pExrHeader = ::ImfInputHeader( pExrInFile );
-   if( !pExrHeader )
+   if( (rows < 0) || (rows > height_m - next_m) || !pTriples )
    {
-      //const char* ::ImfErrorMessage();
-      throw OPEN_FILE_EXCEPTION_MESSAGE;
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
    }
 
-   // get dimensions
-   {
-      int xMin;
-      int xMax;
-      int yMin;
-      int yMax;
-      ::ImfHeaderDataWindow( pExrHeader, &xMin, &yMin, &xMax, &yMax );
-      width  = xMax - xMin + 1;
-      height = yMax - yMin + 1;
-
-      width  = (width  >= 0) ? width  : 0;
-      height = (height >= 0) ? height : 0;
-   }
+   // the next rows down: scanlines all in one call, tiles a tile row at a
+   // time (the last may be part)
+   const dword bufferRows = (tileSize_m > 0) ? tileSize_m : rows;
+   rgbas_m.resize( static_cast<size_t>(width_m) * (bufferRows ? bufferRows :
+      1) );
 
-   // get some attributes
+   const float* pIn = static_cast<const float*>(pTriples);
+   for( dword left = rows;  left > 0; )
    {
-      // row order
-      isLowTop = ::ImfHeaderLineOrder( pExrHeader ) == IMF_INCREASING_Y;
+      const dword part = (left < (bufferRows - pending_m)) ? left :
+         bufferRows - pending_m;
+      encodeRows( width_m, part, false, false, pIn, &(rgbas_m[0]) +
+         (static_cast<size_t>(pending_m) * width_m) );
 
-      // pixel value scaling
-      // whiteLuminance
-      // cd/m^2 of white
-      // and 'white' is rgb(1,1,1)
-      // so, equals scalingToGetCdm2
-      scalingToGetCdm2 = 0.0f;
-      if( 0 == ::ImfHeaderFloatAttribute(
-         pExrHeader, "whiteLuminance", &scalingToGetCdm2 ) )
-      {
-         scalingToGetCdm2 = 0.0f;
-      }
+      pIn       += static_cast<size_t>(part) * width_m * 3;
+      left      -= part;
+      pending_m += part;
+      next_m    += part;
 
-      // color space
-      // (not possible)
+      if( (pending_m == bufferRows) || (next_m == height_m) )
       {
-//          if( 0 == ImfHeader__Attribute(
-//             pExrHeader, "chromaticities",  );
-         {
-            for( dword i = 8;  i-- > 0; )
-            {
-               pPrimaries8[i] = 0.0f;
-            }
-         }
+         exrOutFile_m.writePixels( next_m - pending_m, pending_m,
+            &(rgbas_m[0]) );
+         pending_m = 0;
       }
    }
 }
 
 
-void readPixels
-(
-   ImfInputFile* pExrInFile,
-   const dword   width,
-   const dword   height,
-   const bool    isLowTop,
-   const dword   orderingFlags,
-   float*        pTriples
-)
+void RowWriter::finish()
 {
-   // allocate buffer
-   std::vector<ImfRgba> exrLine( width );
-
-   // step thru rows
-   for( dword y = 0;  y < height;  ++y )
+   if( next_m != height_m )
    {
-      // read into line buffer (subtracting from pointer? wtf???)
-      ::ImfInputSetFrameBuffer(
-         pExrInFile, &(exrLine[0]) - (y * width), 1, width );
-      ::ImfInputReadPixels( pExrInFile, y, y );
-
-      const dword row = ((orderingFlags & exr::IS_LOW_TOP) != 0) ^ isLowTop ?
-         height - y - 1 : y;
-      float* pPixel = pTriples + (row * width * 3);
-
-      // step thru pixels
-      for( dword x = 0;  x < width;  ++x )
-      {
-         ImfHalf rgb[3] = { exrLine[x].r, exrLine[x].g, exrLine[x].b };
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
 
-         // convert channels
-         for( dword c = 0;  c < 3;  ++c )
-         {
-            const dword i = (orderingFlags & exr::IS_BGR) ? 2 - c : c;
-            pPixel[x * 3 + c] = ::ImfHalfToFloat( rgb[ i ] );
-            //*(pPixel++) = ::ImfHalfToFloat( rgb[ i ] );
-         }
-      }
+   if( !exrOutFile_m.close() )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
    }
 }
 
 }
 
 
+ScanlineReader* hxa7241_image::exr::openReader
+(
+   const char i_exrLibraryPathName[],
+   const char i_filePathName[],
+   dword&     o_width,
+   dword&     o_height,
+   float*     o_pPrimaries8,
+   float&     o_scalingToGetCdm2
+)
+{
+   loadLibraries( i_exrLibraryPathName );
+
+   RowReader* pReader = new RowReader;
+   try
+   {
+      pReader->open( i_filePathName, o_width, o_height, o_pPrimaries8,
+         o_scalingToGetCdm2 );
+   }
+   catch( ... )
+   {
+      delete pReader;
+      throw;
+   }
+
+   return pReader;
+}
 
 
-/// write ----------------------------------------------------------------------
-void hxa7241_image::exr::write
+ScanlineWriter* hxa7241_image::exr::openWriter
 (
    const char         i_exrLibraryPathName[],
    const dword        i_width,
    const dword        i_height,
-   const float* const ,//i_pPrimaries8,
    const float        i_scalingToGetCdm2,
-   const dword        i_orderingFlags,
-   const float* const i_pTriples,
-   const char         i_filePathName[]
+   const char         i_filePathName[],
+   const ECompression i_compression,
+   const dword        i_tileSize
 )
 {
    loadLibraries( i_exrLibraryPathName );
 
-   ImfHeader*     pExrHeader  = 0;
-   ImfOutputFile* pExrOutFile = 0;
-
+   RowWriter* pWriter = new RowWriter;
    try
    {
-      pExrHeader = ::ImfNewHeader();
-      if( !pExrHeader )
-      {
-         //const char* ::ImfErrorMessage();
-         throw NEW_HEADER_EXCEPTION_MESSAGE;
-      }
-
-      // copy header
-      {
-         ::ImfHeaderSetDisplayWindow( pExrHeader, 0, 0, i_width - 1,
-            i_height - 1 );
-         ::ImfHeaderSetDataWindow( pExrHeader, 0, 0, i_width - 1,
-            i_height - 1 );
-         ::ImfHeaderSetScreenWindowWidth( pExrHeader,
-            static_cast<float>(i_width) );
-         ::ImfHeaderSetLineOrder( pExrHeader, IMF_INCREASING_Y );
-         ::ImfHeaderSetCompression( pExrHeader, IMF_PIZ_COMPRESSION );
-            //IMF_ZIP_COMPRESSION
-
-         // pixel value scaling
-         if( 0.0f != i_scalingToGetCdm2 )
-         {
-            ::ImfHeaderSetFloatAttribute( pExrHeader, "whiteLuminance",
-               i_scalingToGetCdm2 );
-         }
+      pWriter->open( i_width, i_height, i_scalingToGetCdm2, i_compression,
+         i_tileSize, i_filePathName );
+   }
+   catch( ... )
+   {
+      delete pWriter;
+      throw;
+   }
 
-         // primaries (not possible)
-         //if( i_pPrimaries8 )
-         //{
-         //   ::ImfHeaderSet__Attribute( pExrHeader, "chromaticities",
-         //      i_pPrimaries8 );
-         //}
+   return pWriter;
+}
 
-         ::ImfHeaderSetStringAttribute( pExrHeader, "software", HXA7241_URI );
-      }
 
-      // open file
-      pExrOutFile = ::ImfOpenOutputFile( i_filePathName, pExrHeader,
-         IMF_WRITE_RGB );
-      if( !pExrOutFile )
-      {
-         //const char* ::ImfErrorMessage();
-         throw OPEN_FILE_EXCEPTION_MESSAGE;
-      }
+bool hxa7241_image::exr::findCompression
+(
+   const char    i_name[],
+   ECompression& o_compression
+)
+{
+   static const char* NAMES[] = {
+      "none", "rle", "zips", "zip", "piz", "pxr24", "b44" };
+   static const ECompression COMPRESSIONS[] = {
+      NO_COMPRESSION, RLE_COMPRESSION, ZIPS_COMPRESSION, ZIP_COMPRESSION,
+      PIZ_COMPRESSION, PXR24_COMPRESSION, B44_COMPRESSION };
+
+   // (ignoring case)
+   std::string name( i_name ? i_name : "" );
+   for( size_t i = 0;  i < name.size();  ++i )
+   {
+      name[i] = static_cast<char>( ::tolower( name[i] ) );
+   }
 
-      // write pixels
+   for( dword i = 0;  i < dword(sizeof(NAMES) / sizeof(NAMES[0]));  ++i )
+   {
+      if( name == NAMES[i] )
       {
-         // allocate line buffer
-         std::vector<ImfRgba> exrLine( i_width );
-
-         // step thru rows
-         for( dword y = 0;  y < i_height;  ++y )
-         {
-            // set row pointer
-            const dword row = ((i_orderingFlags & exr::IS_LOW_TOP) == 0) ?
-               i_height - y - 1 : y;
-            const float* pPixel = i_pTriples + (row * i_width * 3);
-
-            // step thru pixels
-            for( dword x = 0;  x < i_width;  ++x )
-            {
-               ImfHalf rgb[3];
-
-               // convert channels
-               for( dword c = 0;  c < 3;  ++c )
-               {
-                  const dword i = (i_orderingFlags & exr::IS_BGR) ? 2 - c : c;
-                  ::ImfFloatToHalf( pPixel[x * 3 + c], &(rgb[i]) );
-               }
-
-               // copy to line buffer
-               exrLine[x].r = rgb[0];
-               exrLine[x].g = rgb[1];
-               exrLine[x].b = rgb[2];
-               ::ImfFloatToHalf( 1.0f, &(exrLine[x].a) );
-            }
-
-            // write line buffer (subtracting from pointer? wtf???)
-            ::ImfOutputSetFrameBuffer( pExrOutFile, &(exrLine[0]) -
-               (y * i_width), 1, i_width );
-            ::ImfOutputWritePixels( pExrOutFile, 1 );
-         }
+         o_compression = COMPRESSIONS[i];
+         return true;
       }
-
-      ::ImfCloseOutputFile( pExrOutFile );
-      ::ImfDeleteHeader( pExrHeader );
-
-      freeLibraries();
    }
-   catch( ... )
-   {
-      ::ImfCloseOutputFile( pExrOutFile );
-      ::ImfDeleteHeader( pExrHeader );
-
-      freeLibraries();
 
-      throw;
-   }
+   return false;
 }
 
 
@@ -440,6 +1449,14 @@ void loadLibraries
    const char exrLibraryPathName[]
 )
 {
+   MutexLock lock( librariesMutex_g );
+
+   // already loaded
+   if( libraries_g[0] )
+   {
+      return;
+   }
+
    // use default name if nothing given
    const char* pExrLibraryPathName = exrLibraryPathName;
    if( (0 == exrLibraryPathName) || (0 == exrLibraryPathName[0]) )
@@ -685,24 +1702,6 @@ int ImfInputReadPixels
 }
 
 
-float ImfHalfToFloat
-(
-   ImfHalf h
-)
-{
-   typedef float (*PFunction)(
-      ImfHalf
-   );
-
-   PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( libraries_g[0], "ImfHalfToFloat" ) );
-
-   return (function)(
-      h
-   );
-}
-
-
 const char* ImfErrorMessage()
 {
    typedef const char* (*PFunction)();
@@ -923,27 +1922,6 @@ ImfOutputFile* ImfOpenOutputFile
 }
 
 
-void ImfFloatToHalf
-(
-   float    f,
-   ImfHalf* h
-)
-{
-   typedef void (*PFunction)(
-      float,
-      ImfHalf*
-   );
-
-   PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( libraries_g[0], "ImfFloatToHalf" ) );
-
-   (function)(
-      f,
-      h
-   );
-}
-
-
 int ImfOutputSetFrameBuffer
 (
    ImfOutputFile* out,
@@ -1028,6 +2006,118 @@ void ImfDeleteHeader
 }
 
 
+ImfTiledOutputFile* ImfOpenTiledOutputFile
+(
+   const char       name[],
+   const ImfHeader* hdr,
+   int              channels,
+   int              xSize,
+   int              ySize,
+   int              mode,
+   int              rmode
+)
+{
+   typedef ImfTiledOutputFile* (*PFunction)(
+      const char[],
+      const ImfHeader*,
+      int,
+      int,
+      int,
+      int,
+      int
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( libraries_g[0], "ImfOpenTiledOutputFile" ) );
+
+   return (function)(
+      name,
+      hdr,
+      channels,
+      xSize,
+      ySize,
+      mode,
+      rmode
+   );
+}
+
+
+int ImfTiledOutputSetFrameBuffer
+(
+   ImfTiledOutputFile* out,
+   const ImfRgba*      base,
+   size_t              xStride,
+   size_t              yStride
+)
+{
+   typedef int (*PFunction)(
+      ImfTiledOutputFile*,
+      const ImfRgba*,
+      size_t,
+      size_t
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( libraries_g[0],
+      "ImfTiledOutputSetFrameBuffer" ) );
+
+   return (function)(
+      out,
+      base,
+      xStride,
+      yStride
+   );
+}
+
+
+int ImfTiledOutputWriteTile
+(
+   ImfTiledOutputFile* out,
+   int                 dx,
+   int                 dy,
+   int                 lx,
+   int                 ly
+)
+{
+   typedef int (*PFunction)(
+      ImfTiledOutputFile*,
+      int,
+      int,
+      int,
+      int
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( libraries_g[0], "ImfTiledOutputWriteTile" ) );
+
+   return (function)(
+      out,
+      dx,
+      dy,
+      lx,
+      ly
+   );
+}
+
+
+int ImfCloseTiledOutputFile
+(
+   ImfTiledOutputFile* out
+)
+{
+   typedef int (*PFunction)(
+      ImfTiledOutputFile*
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( libraries_g[0], "ImfCloseTiledOutputFile" ) );
+
+   return (function)(
+      out
+   );
+}
+
+
 
 
 
@@ -1063,6 +2153,103 @@ bool test_exr
    if( pOut ) *pOut << "[ test_exr ]\n\n";
 
 
+   // half conversion: every half goes to float and back unchanged, and floats
+   // between halves round to nearest (ties to even), as the library does
+   {
+      std::vector<float> table;
+      makeHalfTable( table );
+
+      dword fails = 0;
+      for( udword h = 0;  h < 65536;  ++h )
+      {
+         fails += (floatToHalf( table[h] ) != h);
+      }
+
+      // (positive finites: 0x0000 to 0x7BFF)
+      for( udword h = 0;  h < 0x7BFF;  ++h )
+      {
+         const float mid = static_cast<float>( (static_cast<double>(
+            table[h]) + static_cast<double>(table[h + 1])) * 0.5 );
+         const float above = static_cast<float>( static_cast<double>(mid) +
+            (static_cast<double>(table[h + 1]) - static_cast<double>(mid)) *
+            0.25 );
+
+         fails += (floatToHalf( mid ) != ((h & 1) ? h + 1 : h));
+         fails += (floatToHalf( above ) != h + 1);
+         fails += (floatToHalf( -mid ) != (((h & 1) ? h + 1 : h) | 0x8000));
+      }
+
+      // overflow, underflow, and specials
+      fails += (floatToHalf( 65519.0f ) != 0x7BFF);
+      fails += (floatToHalf( 65520.0f ) != 0x7C00);
+      fails += (floatToHalf( 1e10f )    != 0x7C00);
+      fails += (floatToHalf( -1e10f )   != 0xFC00);
+      fails += (floatToHalf( 1e-10f )   != 0x0000);
+      fails += (floatToHalf( 1.0f )     != HALF_ONE);
+      {
+         const udword nanBits = 0x7F800001u;
+         float nan;
+         ::memcpy( &nan, &nanBits, sizeof(nan) );
+         const ImfHalf h = floatToHalf( nan );
+         fails += !((0x7C00 == (h & 0x7C00)) && (0 != (h & 0x03FF)));
+      }
+
+      if( pOut && isVerbose ) *pOut << "half conversion fails: " << fails <<
+         "\n";
+
+      const bool isOk_ = (0 == fails);
+      if( pOut ) *pOut << "half conversion : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= isOk_;
+   }
+
+   // rows: encoded then decoded, flipped and swapped both ways, give back
+   // what they were -- across thread counts
+   {
+      const dword WIDTH  = 7;
+      const dword HEIGHT = 53;
+
+      std::vector<float> table;
+      makeHalfTable( table );
+
+      // (all exactly halves)
+      std::vector<float> triples( WIDTH * HEIGHT * 3 );
+      for( udword i = 0;  i < triples.size();  ++i )
+      {
+         triples[i] = table[ (i * 7919u) % 0x7C00u ];
+      }
+
+      bool isOk_ = true;
+      for( dword k = 0;  k < 8;  ++k )
+      {
+         ParallelBands::setThreadCount( (k & 4) ? 4 : 1 );
+
+         std::vector<ImfRgba> rgbas( WIDTH * HEIGHT );
+         std::vector<float>   read( triples.size() );
+         HalfEncoder encoder( WIDTH, HEIGHT, 0 != (k & 1), 0 != (k & 2),
+            &(triples[0]), &(rgbas[0]) );
+         encoder.run( HEIGHT, BAND_ROWS );
+         HalfDecoder decoder( &(table[0]), WIDTH, HEIGHT, 0 != (k & 1),
+            0 != (k & 2), &(rgbas[0]), &(read[0]) );
+         decoder.run( HEIGHT, BAND_ROWS );
+
+         // (file rows flipped, channels swapped, and alpha one)
+         const dword  row    = (k & 1) ? HEIGHT - 1 : 0;
+         const dword  first  = (k & 2) ? 2 : 0;
+         const ImfRgba& rgba = rgbas[0];
+         isOk_ &= (0 == ::memcmp( &(read[0]), &(triples[0]),
+            triples.size() * sizeof(float) )) &&
+            (floatToHalf( triples[(row * WIDTH * 3) + first] ) == rgba.r) &&
+            (HALF_ONE == rgba.a);
+      }
+      ParallelBands::setThreadCount( 0 );
+
+      if( pOut ) *pOut << "rows : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= isOk_;
+   }
+
+
    static const char LIB_FILE[] = "C:\\h\\dev\\projects\\p3tonemapper\\temp\\exe\\IlmImf_dll.dll";//"temp\\IlmImf_dll.dll";
 
 
@@ -1165,7 +2352,7 @@ bool test_exr
          if( pOut && isVerbose ) *pOut << "unannotated exception\n";
       }
 
-      delete[] pTriples;
+      scratch::release( pTriples );
 
       if( pOut && isVerbose ) *pOut << "\n";
    }
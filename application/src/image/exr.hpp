@@ -39,6 +39,24 @@ namespace exr
       IS_BGR       = 2
    };
 
+   /**
+    * Pixel compression to write with (values as the library's).
+    *
+    * NO is fastest, and big; ZIPS and RLE are fast; ZIP and PIZ are smallest
+    * (PIZ best for noisy renders), but slowest; PXR24 and B44 are lossy.
+    * B44 needs OpenEXR 1.6 or later.
+    */
+   enum ECompression
+   {
+      NO_COMPRESSION    = 0,
+      RLE_COMPRESSION   = 1,
+      ZIPS_COMPRESSION  = 2,
+      ZIP_COMPRESSION   = 3,
+      PIZ_COMPRESSION   = 4,
+      PXR24_COMPRESSION = 5,
+      B44_COMPRESSION   = 6
+   };
+
 
    /**
     * Report whether the stream is a EXR file.
@@ -53,6 +71,9 @@ namespace exr
    /**
     * Read EXR image.<br/><br/>
     *
+    * Rows are read in chunks, in parallel, each through its own handle on the
+    * file (so decompression is spread across threads).
+    *
     * @i_exrLibraryPathName if path not included then a standard system search
     *                       strategy is used.
     * @o_pPrimaries8        chromaticities of RGB and white:
@@ -86,6 +107,9 @@ namespace exr
     * @i_scalingToGetCdm2   scaling needed to make cd/m^2.
     *                       if zero, it is not written to image metadata
     * @i_orderingFlags      bit combination of EOrderingFlags values
+    * @i_compression        pixel compression
+    * @i_tileSize           width and height of tiles to write, or 0 for
+    *                       scanlines
     *
     * @exceptions throws char[] message exceptions
     */
@@ -98,7 +122,62 @@ namespace exr
       float        i_scalingToGetCdm2,
       dword        i_orderingFlags,
       const float* i_pTriples,
-      const char   i_filePathName[]
+      const char   i_filePathName[],
+      ECompression i_compression = PIZ_COMPRESSION,
+      dword        i_tileSize    = 0
+   );
+
+
+   /**
+    * Open EXR image file to read a strip of rows at a time.<br/><br/>
+    *
+    * Rows top first, as float triples. Parameters as read.
+    *
+    * @return  reader (orphaned -- delete it)
+    *
+    * @exceptions throws allocation and char[] message exceptions
+    */
+   ScanlineReader* openReader
+   (
+      const char i_exrLibraryPathName[],
+      const char i_filePathName[],
+      dword&     o_width,
+      dword&     o_height,
+      float*     o_pPrimaries8,
+      float&     o_scalingToGetCdm2
+   );
+
+
+   /**
+    * Open EXR image file to write a strip of rows at a time.<br/><br/>
+    *
+    * Rows top first, as float triples. Parameters as write.
+    *
+    * @return  writer (orphaned -- delete it)
+    *
+    * @exceptions throws allocation and char[] message exceptions
+    */
+   ScanlineWriter* openWriter
+   (
+      const char   i_exrLibraryPathName[],
+      dword        i_width,
+      dword        i_height,
+      float        i_scalingToGetCdm2,
+      const char   i_filePathName[],
+      ECompression i_compression = PIZ_COMPRESSION,
+      dword        i_tileSize    = 0
+   );
+
+
+   /**
+    * Find a compression by name (any case): none rle zips zip piz pxr24 b44.
+    *
+    * @return  false if unrecognised
+    */
+   bool findCompression
+   (
+      const char    i_name[],
+      ECompression& o_compression
    );
 }
 
@@ -28,7 +28,10 @@ namespace hxa7241_image
    //ImageQuantizing
    class ImageAdopter;
    class ImageFormatter;
+   class IndexedImage;
    class PixelsPtr;
+   class ScanlineReader;
+   class ScanlineWriter;
    class StreamExceptionSet;
 }
 
@@ -0,0 +1,1151 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ScratchMemory.hpp"
+#include "MappedFile.hpp"
+#include "StreamExceptionSet.hpp"
+#include "ScanlineCodec.hpp"
+
+#include "pfm.hpp"
+
+
+using namespace hxa7241_image;
+using namespace hxa7241_general;
+
+
+
+
+/*
+
+( From: http://netpbm.sourceforge.net/doc/pfm.html )
+
+* Identifier Line: "PF" for a color image, or "Pf" for a greyscale image.
+* Dimensions Line: width then height, in ASCII decimal, separated by a space.
+* Scale Factor / Endianness: a nonzero ASCII decimal number. Negative means
+  little-endian, positive means big-endian. Its magnitude is a scale factor.
+* Each of the three lines ends with a single whitespace character (usually a
+  newline).
+* Raster: width x height pixels, each one (grey) or three (R, G, B) IEEE 32-bit
+  floats, in the given byte order. Rows are in order from bottom to top, and
+  each row from left to right.
+
+*/
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+
+const char PFM_COLOR_ID[] = "PF";
+const char PFM_GREY_ID[]  = "Pf";
+
+const char IN_FORMAT_EXCEPTION_MESSAGE[] =
+   "unrecognized file format, in PFM read";
+const char IN_DIMENSIONS_EXCEPTION_MESSAGE[] =
+   "image dimensions invalid, in PFM read";
+const char IN_STREAM_EXCEPTION_MESSAGE[] =
+   "stream read failure, in PFM read";
+const char OUT_DIMENSIONS_EXCEPTION_MESSAGE[] =
+   "image dimensions invalid, in PFM write";
+const char OUT_NULL_POINTER_EXCEPTION_MESSAGE[] =
+   "pixel pointer null, in PFM write";
+const char OUT_STREAM_EXCEPTION_MESSAGE[] =
+   "stream write failure, in PFM write";
+
+
+void checkDimensions
+(
+   dword       width,
+   dword       height,
+   const char* pMessage
+);
+
+bool parseHeader
+(
+   const ubyte* pBytes,
+   qword        size,
+   bool&        isColor,
+   dword&       width,
+   dword&       height,
+   bool&        isLittle,
+   qword&       headerSize
+);
+
+std::string makeHeader
+(
+   dword width,
+   dword height
+);
+
+bool isMachineLittle();
+
+void copyFloats
+(
+   const ubyte* pFrom,
+   qword        pixels,
+   bool         isColor,
+   bool         isSwap,
+   float*       pTo
+);
+
+}
+
+
+
+
+void hxa7241_image::pfm::read
+(
+   istream& i_in,
+   dword&   o_width,
+   dword&   o_height,
+   float*&  o_pTriples
+)
+{
+   // enable stream exceptions
+   StreamExceptionSet streamExceptionSet( i_in,
+      istream::badbit | istream::failbit | istream::eofbit );
+
+   try
+   {
+      // read id, width, height, scale, then single blank
+      std::string id;
+      dword       width  = 0;
+      dword       height = 0;
+      std::string scale;
+      i_in >> id >> width >> height >> scale;
+      i_in.ignore();
+
+      // check validity
+      const bool   isColor = (id == PFM_COLOR_ID);
+      const double scaling = ::atof( scale.c_str() );
+      if( (!isColor && (id != PFM_GREY_ID)) || (0.0 == scaling) )
+      {
+         throw IN_FORMAT_EXCEPTION_MESSAGE;
+      }
+      checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+      const bool isSwap = ((scaling < 0.0) != isMachineLittle());
+
+      // allocate storage
+      scratch::Ptr<float> pTriples( static_cast<qword>(width) * height * 3 );
+
+      // read rows (bottom first, as stored), a whole row at a time
+      std::vector<char> rowBytes( static_cast<size_t>(width) *
+         (isColor ? 3 : 1) * sizeof(float) );
+      for( dword y = 0;  y < height;  ++y )
+      {
+         i_in.read( &(rowBytes[0]), static_cast<std::streamsize>(
+            rowBytes.size()) );
+
+         copyFloats( reinterpret_cast<const ubyte*>(&(rowBytes[0])), width,
+            isColor, isSwap, pTriples.get() + (static_cast<qword>(y) *
+            width * 3) );
+      }
+
+      // set outputs (now that no exceptions can happen)
+      o_width    = width;
+      o_height   = height;
+      o_pTriples = pTriples.release();
+   }
+   // translate exceptions
+   catch( const std::ios_base::failure& )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+
+
+
+void hxa7241_image::pfm::write
+(
+   const dword  i_width,
+   const dword  i_height,
+   const float* i_pTriples,
+   ostream&     o_out
+)
+{
+   // check preconditions
+   checkDimensions( i_width, i_height, OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+   if( !i_pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   // enable stream exceptions
+   StreamExceptionSet streamExceptionSet( o_out,
+      ostream::badbit | ostream::failbit | ostream::eofbit );
+
+   try
+   {
+      // write header
+      const std::string header( makeHeader( i_width, i_height ) );
+      o_out.write( header.data(), static_cast<std::streamsize>(
+         header.length()) );
+
+      // write rows (bottom first, as held), a whole row at a time
+      const qword rowLength = static_cast<qword>(i_width) * 3;
+      for( dword y = 0;  y < i_height;  ++y )
+      {
+         o_out.write( reinterpret_cast<const char*>(i_pTriples +
+            (static_cast<qword>(y) * rowLength)), static_cast<std::streamsize>(
+            rowLength * sizeof(float)) );
+      }
+   }
+   // translate exceptions
+   catch( const std::ios_base::failure& )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+
+
+
+bool hxa7241_image::pfm::readFile
+(
+   const char i_pathName[],
+   dword&     o_width,
+   dword&     o_height,
+   float*&    o_pTriples
+)
+{
+   MappedFile file;
+   if( !file.openRead( i_pathName ) )
+   {
+      return false;
+   }
+
+   // read header
+   bool  isColor    = false;
+   dword width      = 0;
+   dword height     = 0;
+   bool  isLittle   = false;
+   qword headerSize = 0;
+   if( !parseHeader( file.getBytes(), file.getSize(), isColor, width, height,
+      isLittle, headerSize ) )
+   {
+      throw IN_FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   // check validity, and that all pixels are there
+   checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+   const qword pixels = static_cast<qword>(width) * height;
+   const qword length = pixels * (isColor ? 3 : 1) *
+      static_cast<qword>(sizeof(float));
+   if( (file.getSize() - headerSize) < length )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+   const bool isSwap = (isLittle != isMachineLittle());
+
+   // color in machine order: the file is the pixels, so map them as storage
+   float* pMapped = (isColor & !isSwap) ? static_cast<float*>(
+      scratch::mapFile( i_pathName, headerSize, length )) : 0;
+
+   // else: copy, swap, or widen, straight from the file bytes
+   scratch::Ptr<float> pTriples( pMapped ? 0 : (pixels * 3) );
+   if( !pMapped )
+   {
+      copyFloats( file.getBytes() + headerSize, pixels, isColor, isSwap,
+         pTriples.get() );
+   }
+
+   // set outputs (now that no exceptions can happen)
+   o_width    = width;
+   o_height   = height;
+   o_pTriples = pMapped ? pMapped : pTriples.release();
+
+   return true;
+}
+
+
+
+
+bool hxa7241_image::pfm::writeFile
+(
+   const dword  i_width,
+   const dword  i_height,
+   const float* i_pTriples,
+   const char   o_pathName[]
+)
+{
+   // check preconditions
+   checkDimensions( i_width, i_height, OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+   if( !i_pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   // replace an existing (regular) file, instead of truncating it: the pixels
+   // might be it, mapped
+   struct stat status;
+   if( (0 == ::stat( o_pathName, &status )) &&
+      (S_IFREG == (status.st_mode & S_IFMT)) )
+   {
+      ::remove( o_pathName );
+   }
+
+   // make file at its whole size
+   const std::string header( makeHeader( i_width, i_height ) );
+   const qword length = static_cast<qword>(i_width) * i_height * 3 *
+      static_cast<qword>(sizeof(float));
+
+   MappedFile file;
+   if( !file.openWrite( o_pathName, static_cast<qword>(header.length()) +
+      length ) )
+   {
+      return false;
+   }
+
+   // write header, then pixels (bottom first, as held) straight into the file
+   // bytes, in one copy
+   ::memcpy( file.getBytes(), header.data(), header.length() );
+   ::memcpy( file.getBytes() + header.length(), i_pTriples,
+      static_cast<size_t>(length) );
+
+   return true;
+}
+
+
+
+
+/// scanlines ------------------------------------------------------------------
+namespace
+{
+
+/**
+ * Rows read straight from a mapped file, top first (so from the file's end).
+ */
+class RowReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowReader();
+
+/// commands -------------------------------------------------------------------
+           bool open( const char pathName[],
+                      dword&     width,
+                      dword&     height );
+
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   MappedFile file_m;
+   dword      width_m;
+   dword      height_m;
+   bool       isColor_m;
+   bool       isSwap_m;
+   qword      headerSize_m;
+   dword      next_m;
+};
+
+
+RowReader::RowReader()
+ : file_m      ()
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , isColor_m   ( false )
+ , isSwap_m    ( false )
+ , headerSize_m( 0 )
+ , next_m      ( 0 )
+{
+}
+
+
+bool RowReader::open
+(
+   const char pathName[],
+   dword&     width,
+   dword&     height
+)
+{
+   if( !file_m.openRead( pathName ) )
+   {
+      return false;
+   }
+
+   // read header
+   bool isLittle = false;
+   if( !parseHeader( file_m.getBytes(), file_m.getSize(), isColor_m, width,
+      height, isLittle, headerSize_m ) )
+   {
+      throw IN_FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   // check validity, and that all pixels are there
+   checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+   const qword length = static_cast<qword>(width) * height *
+      (isColor_m ? 3 : 1) * static_cast<qword>(sizeof(float));
+   if( (file_m.getSize() - headerSize_m) < length )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   width_m  = width;
+   height_m = height;
+   isSwap_m = (isLittle != isMachineLittle());
+
+   return true;
+}
+
+
+void RowReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw IN_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   const qword rowLength = static_cast<qword>(width_m) * (isColor_m ? 3 : 1) *
+      static_cast<qword>(sizeof(float));
+
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      const dword y = height_m - 1 - (next_m + r);
+
+      copyFloats( file_m.getBytes() + headerSize_m +
+         (static_cast<qword>(y) * rowLength), width_m, isColor_m, isSwap_m,
+         static_cast<float*>(pTriples) + (static_cast<qword>(r) * width_m *
+         3) );
+   }
+
+   next_m += rows;
+}
+
+
+/**
+ * Rows written straight into a mapped file, top first (so from the file's
+ * end).
+ */
+class RowWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowWriter();
+
+/// commands -------------------------------------------------------------------
+           bool open( dword      width,
+                      dword      height,
+                      const char pathName[] );
+
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   MappedFile file_m;
+   dword      width_m;
+   dword      height_m;
+   qword      headerSize_m;
+   dword      next_m;
+};
+
+
+RowWriter::RowWriter()
+ : file_m      ()
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , headerSize_m( 0 )
+ , next_m      ( 0 )
+{
+}
+
+
+bool RowWriter::open
+(
+   const dword width,
+   const dword height,
+   const char  pathName[]
+)
+{
+   checkDimensions( width, height, OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   // replace an existing (regular) file, instead of truncating it: it might
+   // be mapped, being read
+   struct stat status;
+   if( (0 == ::stat( pathName, &status )) &&
+      (S_IFREG == (status.st_mode & S_IFMT)) )
+   {
+      ::remove( pathName );
+   }
+
+   // make file at its whole size, and write header
+   const std::string header( makeHeader( width, height ) );
+   const qword length = static_cast<qword>(width) * height * 3 *
+      static_cast<qword>(sizeof(float));
+   if( !file_m.openWrite( pathName, static_cast<qword>(header.length()) +
+      length ) )
+   {
+      return false;
+   }
+   ::memcpy( file_m.getBytes(), header.data(), header.length() );
+
+   width_m      = width;
+   height_m     = height;
+   headerSize_m = header.length();
+
+   return true;
+}
+
+
+void RowWriter::writeRows
+(
+   const dword rows,
+   const void* pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+   if( !pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   const qword rowLength = static_cast<qword>(width_m) * 3 *
+      static_cast<qword>(sizeof(float));
+
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      const dword y = height_m - 1 - (next_m + r);
+
+      ::memcpy( file_m.getBytes() + headerSize_m +
+         (static_cast<qword>(y) * rowLength), static_cast<const ubyte*>(
+         pTriples) + (static_cast<qword>(r) * rowLength),
+         static_cast<size_t>(rowLength) );
+   }
+
+   next_m += rows;
+}
+
+
+void RowWriter::finish()
+{
+   if( next_m != height_m )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   file_m.close();
+}
+
+}
+
+
+ScanlineReader* hxa7241_image::pfm::openReader
+(
+   const char i_pathName[],
+   dword&     o_width,
+   dword&     o_height
+)
+{
+   RowReader* pReader = new RowReader;
+   try
+   {
+      if( !pReader->open( i_pathName, o_width, o_height ) )
+      {
+         delete pReader;
+         pReader = 0;
+      }
+   }
+   catch( ... )
+   {
+      delete pReader;
+      throw;
+   }
+
+   return pReader;
+}
+
+
+ScanlineWriter* hxa7241_image::pfm::openWriter
+(
+   const dword i_width,
+   const dword i_height,
+   const char  o_pathName[]
+)
+{
+   RowWriter* pWriter = new RowWriter;
+   try
+   {
+      if( !pWriter->open( i_width, i_height, o_pathName ) )
+      {
+         delete pWriter;
+         pWriter = 0;
+      }
+   }
+   catch( ... )
+   {
+      delete pWriter;
+      throw;
+   }
+
+   return pWriter;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+namespace
+{
+
+void checkDimensions
+(
+   const dword width,
+   const dword height,
+   const char* pMessage
+)
+{
+   // (lengths are 64-bit, so any positive dimensions fit)
+   if( (width <= 0) || (height <= 0) )
+   {
+      throw pMessage;
+   }
+}
+
+
+/**
+ * Parse header in memory, as read does from a stream.
+ *
+ * @headerSize  bytes up to the pixels
+ * @return      false if not a PFM, or cut short
+ */
+bool parseHeader
+(
+   const ubyte* pBytes,
+   const qword  size,
+   bool&        isColor,
+   dword&       width,
+   dword&       height,
+   bool&        isLittle,
+   qword&       headerSize
+)
+{
+   // id
+   if( (size < 3) || (PFM_COLOR_ID[0] != pBytes[0]) ||
+      ((PFM_COLOR_ID[1] != pBytes[1]) && (PFM_GREY_ID[1] != pBytes[1])) ||
+      !::isspace( pBytes[2] ) )
+   {
+      return false;
+   }
+
+   // width, height, scale
+   qword pos = 2;
+   std::string tokens[3];
+   for( dword i = 0;  i < 3;  ++i )
+   {
+      // skip blanks
+      while( (pos < size) && ::isspace( pBytes[pos] ) )
+      {
+         ++pos;
+      }
+
+      // next token (non-blank chunk)
+      const qword start = pos;
+      while( (pos < size) && !::isspace( pBytes[pos] ) )
+      {
+         ++pos;
+      }
+      if( start == pos )
+      {
+         return false;
+      }
+      tokens[i].assign( reinterpret_cast<const char*>(pBytes + start),
+         static_cast<size_t>(pos - start) );
+   }
+
+   // single blank
+   const double scale = ::atof( tokens[2].c_str() );
+   if( (pos >= size) || (0.0 == scale) )
+   {
+      return false;
+   }
+
+   isColor    = (PFM_COLOR_ID[1] == pBytes[1]);
+   width      = ::atoi( tokens[0].c_str() );
+   height     = ::atoi( tokens[1].c_str() );
+   isLittle   = (scale < 0.0);
+   headerSize = pos + 1;
+
+   return true;
+}
+
+
+std::string makeHeader
+(
+   const dword width,
+   const dword height
+)
+{
+   std::ostringstream header;
+
+   // ID, width and height, scale (sign is byte order)
+   header << PFM_COLOR_ID << '\n';
+   header << width << ' ' << height << '\n';
+   header << (isMachineLittle() ? "-1" : "1");
+
+   // pad scale with zeros, so the header (with newline) is a multiple of 16
+   std::string s( header.str() );
+   const size_t pad = (16 - ((s.length() + 1) & 15)) & 15;
+   if( pad > 0 )
+   {
+      s += '.';
+      s.append( pad - 1, '0' );
+   }
+   s += '\n';
+
+   return s;
+}
+
+
+bool isMachineLittle()
+{
+   const udword one = 1;
+   return 1 == *reinterpret_cast<const ubyte*>(&one);
+}
+
+
+/**
+ * Copy floats into triples: byte-swapped, and widened from grey, as needed.
+ *
+ * (plain loops, over the whole run, are left for the compiler to vectorize)
+ */
+void copyFloats
+(
+   const ubyte* pFrom,
+   const qword  pixels,
+   const bool   isColor,
+   const bool   isSwap,
+   float*       pTo
+)
+{
+   const size_t length = static_cast<size_t>(pixels) * (isColor ? 3 : 1);
+
+   // byte-swapped, or straight, copy
+   if( isSwap )
+   {
+      for( size_t i = 0;  i < length;  ++i )
+      {
+         udword u;
+         ::memcpy( &u, pFrom + (i * sizeof(float)), sizeof(float) );
+         u = (u >> 24) | ((u >> 8) & 0x0000FF00u) | ((u << 8) & 0x00FF0000u) |
+            (u << 24);
+         ::memcpy( pTo + i, &u, sizeof(float) );
+      }
+   }
+   else
+   {
+      ::memcpy( pTo, pFrom, length * sizeof(float) );
+   }
+
+   // widen grey to triples
+   // (backwards, so each grey is read before a triple overwrites it)
+   if( !isColor )
+   {
+      for( size_t i = length;  i-- > 0; )
+      {
+         const float grey = pTo[i];
+         pTo[(i * 3) + 0] = grey;
+         pTo[(i * 3) + 1] = grey;
+         pTo[(i * 3) + 2] = grey;
+      }
+   }
+}
+
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <fstream>
+#include <iterator>
+
+
+namespace hxa7241_image
+{
+namespace pfm
+{
+   using namespace hxa7241;
+
+   bool test_roundTrip
+   (
+      std::ostream* pOut,
+      const bool    isVerbose,
+      const dword   seed
+   );
+
+   bool test_foreign
+   (
+      std::ostream* pOut,
+      const bool    isVerbose,
+      const dword   seed
+   );
+
+   bool test_scanlines
+   (
+      std::ostream* pOut,
+      const bool    isVerbose,
+      const dword   seed
+   );
+
+
+bool test_pfm
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_pfm ]\n\n";
+
+
+   isOk &= test_roundTrip( pOut, isVerbose, seed );
+   isOk &= test_foreign( pOut, isVerbose, seed );
+   isOk &= test_scanlines( pOut, isVerbose, seed );
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+bool test_roundTrip
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   const char FILE_NAME[] = "zzztestmapped.pfm";
+
+   udword random = seed ? seed : 521288629u;
+
+   // mapped write matches streamed write, and mapped and streamed read match
+   // what was written -- for a few sizes (so a few header lengths)
+   for( dword k = 0;  k < 4;  ++k )
+   {
+      const dword width  = 1 + (k * 37);
+      const dword height = 1 + (k * 11);
+      const dword length = width * height * 3;
+
+      // (any bits, so NaNs and infinities too)
+      std::vector<float> triples( length );
+      for( dword i = 0;  i < length;  ++i )
+      {
+         random = 18000u * (random & 0xFFFFu) + (random >> 16);
+         const udword bits = (random << 16) ^ (random >> 3);
+         ::memcpy( &(triples[i]), &bits, sizeof(float) );
+      }
+
+      std::ostringstream streamed( std::ostringstream::binary );
+      write( width, height, &(triples[0]), streamed );
+
+      // (header padded to align pixels)
+      bool isOk_ = (0 == ((streamed.str().length() - (length * 4)) % 16));
+
+      isOk_ &= writeFile( width, height, &(triples[0]), FILE_NAME );
+      {
+         std::ifstream inf( FILE_NAME, std::ifstream::binary );
+         const std::string mapped( (std::istreambuf_iterator<char>( inf )),
+            std::istreambuf_iterator<char>() );
+         isOk_ &= (mapped == streamed.str());
+      }
+
+      for( dword r = 0;  r < 2;  ++r )
+      {
+         dword  widthR  = 0;
+         dword  heightR = 0;
+         float* pRead   = 0;
+         if( 0 == r )
+         {
+            // (mapped as storage, and writable without changing the file)
+            isOk_ &= readFile( FILE_NAME, widthR, heightR, pRead ) &&
+               scratch::isMapped( pRead );
+            if( pRead )
+            {
+               pRead[length - 1] = 0.0f;
+               pRead[length - 1] = triples[length - 1];
+            }
+         }
+         else
+         {
+            std::istringstream in( streamed.str(), std::istringstream::binary );
+            read( in, widthR, heightR, pRead );
+         }
+
+         isOk_ &= (width == widthR) & (height == heightR) && pRead &&
+            (0 == ::memcmp( pRead, &(triples[0]), length * sizeof(float) ));
+         scratch::release( pRead );
+      }
+
+      if( pOut && isVerbose ) *pOut << width << " x " << height << " : " <<
+         isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   ::remove( FILE_NAME );
+
+   if( pOut && isVerbose ) *pOut << "\n";
+
+   if( pOut ) *pOut << "round trip : " <<
+      (isOk ? "--- succeeded" : "*** failed") << "\n\n";
+
+   return isOk;
+}
+
+
+bool test_foreign
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   //seed
+)
+{
+   bool isOk = true;
+
+   const char FILE_NAME[] = "zzztestforeign.pfm";
+
+   // 2 x 1 grey, big-endian: 1.0 0.5
+   // 2 x 1 color, little-endian, unaligned: 1.0 0.5 0.25  2.0 -1.0 0.0
+   const char  grey[]  = "Pf\n2 1\n1.0\n\x3F\x80\x00\x00\x3F\x00\x00\x00";
+   const char  color[] = "PF\n2 1\n-1.0\n"
+      "\x00\x00\x80\x3F\x00\x00\x00\x3F\x00\x00\x80\x3E"
+      "\x00\x00\x00\x40\x00\x00\x80\xBF\x00\x00\x00\x00";
+   const float pixels[2][6] = { { 1.0f, 1.0f, 1.0f, 0.5f, 0.5f, 0.5f },
+      { 1.0f, 0.5f, 0.25f, 2.0f, -1.0f, 0.0f } };
+   const std::string files[2] = { std::string( grey, sizeof(grey) - 1 ),
+      std::string( color, sizeof(color) - 1 ) };
+
+   // mapped and streamed read
+   for( dword f = 0;  f < 2;  ++f )
+   {
+      {
+         std::ofstream outf( FILE_NAME, std::ofstream::binary );
+         outf << files[f];
+      }
+
+      for( dword r = 0;  r < 2;  ++r )
+      {
+         bool   isOk_  = true;
+         dword  width  = 0;
+         dword  height = 0;
+         float* pRead  = 0;
+         if( 0 == r )
+         {
+            isOk_ &= readFile( FILE_NAME, width, height, pRead ) &&
+               !scratch::isMapped( pRead );
+         }
+         else
+         {
+            std::istringstream in( files[f], std::istringstream::binary );
+            read( in, width, height, pRead );
+         }
+
+         isOk_ &= (2 == width) & (1 == height) && pRead;
+         for( dword i = 0;  isOk_ && (i < 6);  ++i )
+         {
+            isOk_ &= (pixels[f][i] == pRead[i]);
+         }
+         scratch::release( pRead );
+
+         if( pOut && isVerbose ) *pOut << (f ? "color" : "grey") << " " <<
+            (r ? "streamed" : "mapped") << " : " << isOk_ << "\n";
+
+         isOk &= isOk_;
+      }
+   }
+
+   // cut-short file is reported
+   {
+      {
+         std::ofstream outf( FILE_NAME, std::ofstream::binary );
+         outf << "PF\n4 4\n-1\n" << std::string( 40, 'x' );
+      }
+
+      bool   isOk_  = false;
+      dword  width  = 0;
+      dword  height = 0;
+      float* pRead  = 0;
+      try
+      {
+         readFile( FILE_NAME, width, height, pRead );
+         scratch::release( pRead );
+      }
+      catch( const char[] )
+      {
+         isOk_ = true;
+      }
+
+      if( pOut && isVerbose ) *pOut << "cut short : " << isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   ::remove( FILE_NAME );
+
+   if( pOut && isVerbose ) *pOut << "\n";
+
+   if( pOut ) *pOut << "foreign : " <<
+      (isOk ? "--- succeeded" : "*** failed") << "\n\n";
+
+   return isOk;
+}
+
+
+bool test_scanlines
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   const char FILE_NAME_WHOLE[] = "zzztestwhole.pfm";
+   const char FILE_NAME_STRIP[] = "zzzteststrip.pfm";
+
+   udword random = seed ? seed : 521288629u;
+
+   // strips of various heights write the same file as whole, and read back
+   // what was written (top first, so flipped) -- for a few sizes
+   for( dword k = 0;  k < 3;  ++k )
+   {
+      const dword width  = 1 + (k * 29);
+      const dword height = 1 + (k * 7);
+      const dword length = width * height * 3;
+
+      std::vector<float> triples( length );
+      for( dword i = 0;  i < length;  ++i )
+      {
+         random = 18000u * (random & 0xFFFFu) + (random >> 16);
+         triples[i] = static_cast<float>(random & 0xFFFFu) / 256.0f;
+      }
+      std::vector<float> topFirst( length );
+      for( dword y = 0;  y < height;  ++y )
+      {
+         ::memcpy( &(topFirst[y * width * 3]), &(triples[(height - 1 - y) *
+            width * 3]), width * 3 * sizeof(float) );
+      }
+
+      bool isOk_ = writeFile( width, height, &(triples[0]), FILE_NAME_WHOLE );
+
+      // write in strips
+      {
+         ScanlineWriter* pWriter = openWriter( width, height,
+            FILE_NAME_STRIP );
+         isOk_ &= (0 != pWriter);
+         if( pWriter )
+         {
+            for( dword y = 0, rows = 1;  y < height;  y += rows, ++rows )
+            {
+               rows = (height - y) < rows ? (height - y) : rows;
+               pWriter->writeRows( rows, &(topFirst[y * width * 3]) );
+            }
+            pWriter->finish();
+            delete pWriter;
+         }
+
+         std::ifstream inWhole( FILE_NAME_WHOLE, std::ifstream::binary );
+         std::ifstream inStrip( FILE_NAME_STRIP, std::ifstream::binary );
+         const std::string whole( (std::istreambuf_iterator<char>( inWhole )),
+            std::istreambuf_iterator<char>() );
+         const std::string strip( (std::istreambuf_iterator<char>( inStrip )),
+            std::istreambuf_iterator<char>() );
+         isOk_ &= !whole.empty() && (whole == strip);
+      }
+
+      // read in strips
+      {
+         dword widthR  = 0;
+         dword heightR = 0;
+         ScanlineReader* pReader = openReader( FILE_NAME_STRIP, widthR,
+            heightR );
+         isOk_ &= (0 != pReader) && (width == widthR) && (height == heightR);
+         if( pReader )
+         {
+            std::vector<float> read( length );
+            for( dword y = 0, rows = 3;  y < height;  y += rows )
+            {
+               rows = (height - y) < rows ? (height - y) : rows;
+               pReader->readRows( rows, &(read[y * width * 3]) );
+            }
+            delete pReader;
+
+            isOk_ &= (0 == ::memcmp( &(read[0]), &(topFirst[0]), length *
+               sizeof(float) ));
+         }
+      }
+
+      if( pOut && isVerbose ) *pOut << width << " x " << height << " : " <<
+         isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   ::remove( FILE_NAME_WHOLE );
+   ::remove( FILE_NAME_STRIP );
+
+   if( pOut && isVerbose ) *pOut << "\n";
+
+   if( pOut ) *pOut << "scanlines : " <<
+      (isOk ? "--- succeeded" : "*** failed") << "\n\n";
+
+   return isOk;
+}
+
+
+}//namespace
+}//namespace
+
+
+#endif//TESTING
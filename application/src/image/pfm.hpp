@@ -0,0 +1,169 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef pfm_h
+#define pfm_h
+
+
+#include <iosfwd>
+
+
+
+
+#include "hxa7241_image.hpp"
+namespace hxa7241_image
+{
+   using std::istream;
+   using std::ostream;
+
+
+/**
+ * IO for the PFM (portable float map) format.<br/><br/>
+ *
+ * PFMs are uncompressed 32-bit float RGB (or grey) images.
+ * (just: ID, then width and height, then scale, then floats)
+ * Rows are bottom first -- as held here -- and the sign of the scale gives
+ * the byte order, so a little-endian color file is the image, byte for
+ * byte. readFile then maps it, instead of reading. The scale's magnitude is
+ * ignored.<br/><br/>
+ *
+ * <cite>http://netpbm.sourceforge.net/doc/pfm.html</cite>
+ */
+namespace pfm
+{
+
+   /**
+    * Read PFM image.<br/><br/>
+    *
+    * Grey images are read as RGB. Does not condition values -- you get what
+    * is in the file, valid or not.
+    *
+    * @o_pTriples  array of float triples, bottom row first. orphaned storage
+    *              (free with scratch::release)
+    *
+    * @exceptions throws char[] message and allocation exceptions
+    */
+   void read
+   (
+      istream& i_inBytes,
+      dword&   o_width,
+      dword&   o_height,
+      float*&  o_pTriples
+   );
+
+
+   /**
+    * Write PFM image, color, in the machine's byte order.<br/><br/>
+    *
+    * The header is padded (with zeros in the scale) to a multiple of 16
+    * bytes, so the pixels are aligned in the file, for readFile to map.
+    *
+    * @i_pTriples  array of float triples, bottom row first
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   void write
+   (
+      dword        i_width,
+      dword        i_height,
+      const float* i_pTriples,
+      ostream&     o_outBytes
+   );
+
+
+   /**
+    * Read PFM image file, memory-mapped.<br/><br/>
+    *
+    * As read, but a color file in the machine's byte order, with aligned
+    * pixels, is mapped copy-on-write as the pixel storage, and not copied.
+    * Other files are copied (or byte-swapped, or widened from grey) in bulk,
+    * straight from the file's bytes.
+    *
+    * @return  true if read, false if the file could not be mapped (so nothing
+    *          was read -- use read with a stream instead)
+    *
+    * @exceptions throws char[] message and allocation exceptions
+    */
+   bool readFile
+   (
+      const char i_pathName[],
+      dword&     o_width,
+      dword&     o_height,
+      float*&    o_pTriples
+   );
+
+
+   /**
+    * Write PFM image file, memory-mapped.<br/><br/>
+    *
+    * As write, but the file is sized beforehand, and pixels copied straight
+    * into its bytes. An existing file is replaced, not overwritten (it might
+    * be mapped as the pixels being written).
+    *
+    * @return  true if written, false if the file could not be mapped (so
+    *          nothing was written -- use write with a stream instead)
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   bool writeFile
+   (
+      dword        i_width,
+      dword        i_height,
+      const float* i_pTriples,
+      const char   o_pathName[]
+   );
+
+
+   /**
+    * Open PFM image file to read a strip of rows at a time, memory-mapped.
+    * <br/><br/>
+    *
+    * Rows top first (the file's last first), as float triples.
+    *
+    * @return  reader (orphaned -- delete it), or 0 if the file could not be
+    *          mapped
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   ScanlineReader* openReader
+   (
+      const char i_pathName[],
+      dword&     o_width,
+      dword&     o_height
+   );
+
+
+   /**
+    * Open PFM image file to write a strip of rows at a time, memory-mapped.
+    * <br/><br/>
+    *
+    * Rows top first (into the file's end first), as float triples. An
+    * existing file is replaced, as writeFile.
+    *
+    * @return  writer (orphaned -- delete it), or 0 if the file could not be
+    *          mapped
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   ScanlineWriter* openWriter
+   (
+      dword      i_width,
+      dword      i_height,
+      const char o_pathName[]
+   );
+}
+
+
+}//namespace
+
+
+
+
+#endif//pfm_h
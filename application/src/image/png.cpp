@@ -8,8 +8,11 @@
 ------------------------------------------------------------------------------*/
 
 
+#include <string.h>
+#include <ctype.h>
 #include <istream>
 #include <ostream>
+#include <fstream>
 #include <string>
 #include <vector>
 //#include <setjmp.h>
@@ -17,8 +20,11 @@
 #include "png.h"
 
 #include "DynamicLibraryInterface.hpp"
+#include "Threads.hpp"
+#include "ParallelBands.hpp"
 #include "PixelsPtr.hpp"
 #include "StreamExceptionSet.hpp"
+#include "ScanlineCodec.hpp"
 
 #include "png.hpp"
 
@@ -63,6 +69,15 @@ const char IN_STREAM_EXCEPTION_MESSAGE[] =
    "stream read failure, in PNG read";
 const char OUT_STREAM_EXCEPTION_MESSAGE[] =
    "stream write failure, in PNG write";
+const char OUT_PALETTE_EXCEPTION_MESSAGE[] =
+   "palette empty, in PNG write";
+const char ZLIB_EXCEPTION_MESSAGE[] =
+   "zlib failure, in PNG write";
+
+// (bytes per block deflated in parallel -- as pigz -- and deflate's window,
+// primed from the block before)
+const dword DEFLATE_BLOCK_BYTES = 131072;
+const dword DEFLATE_WINDOW      = 32768;
 
 
 const char LIB_PATHNAME_DEFAULT[] =
@@ -74,9 +89,22 @@ const char LIB_PATHNAME_DEFAULT[] =
    "";
 #endif
 
+const char ZLIB_PATHNAME_DEFAULT[] =
+#ifdef _PLATFORM_WIN
+   "zlib1.dll";
+#elif _PLATFORM_LINUX
+   "libz.so.1";
+#else
+   "";
+#endif
+
 
 /// globals
+// (loaded on first use, and kept -- so a batch of images loads it only once)
 void* library_g = 0;
+void* zlib_g    = 0;
+bool  isZlibTried_g = false;
+Mutex libraryMutex_g;
 
 
 const char* getLibraryPathName
@@ -93,6 +121,67 @@ const char* getLibraryPathName
    return pPngLibraryPathName;
 }
 
+
+void loadLibrary
+(
+   const char* pPngLibraryPathName
+)
+{
+   MutexLock lock( libraryMutex_g );
+
+   if( !library_g )
+   {
+      dynamiclink::loadLibrary( getLibraryPathName( pPngLibraryPathName ),
+         library_g );
+   }
+}
+
+
+/**
+ * Load zlib, to deflate in parallel (else libpng deflates, serially).
+ *
+ * @return  true if loaded
+ */
+bool loadZlib()
+{
+   MutexLock lock( libraryMutex_g );
+
+   // (tried once only)
+   if( !zlib_g && !isZlibTried_g )
+   {
+      isZlibTried_g = true;
+      try
+      {
+         dynamiclink::loadLibrary( ZLIB_PATHNAME_DEFAULT, zlib_g );
+      }
+      catch( ... )
+      {
+         zlib_g = 0;
+      }
+   }
+
+   return 0 != zlib_g;
+}
+
+
+/**
+ * Deflate in parallel? -- if there are threads and more than a block, and zlib
+ * loads (else libpng's own deflate is as good).
+ */
+bool isDeflateParallel
+(
+   const dword width,
+   const bool  is48Bit,
+   const dword height
+)
+{
+   const qword rowBytes = static_cast<qword>(width) * (is48Bit ? 6 : 3);
+
+   return (ParallelBands::getThreadCount() > 1) &&
+      ((static_cast<qword>(height) * (rowBytes + 1)) > DEFLATE_BLOCK_BYTES) &&
+      loadZlib();
+}
+
 void checkDimensions
 (
    const dword width,
@@ -100,8 +189,8 @@ void checkDimensions
    const char* pMessage
 )
 {
-   if( (width <= 0) || (height <= 0) ||
-      (height > (DWORD_MAX / 3)) || (width > (DWORD_MAX / (height * 3))) )
+   // (lengths are 64-bit, so any positive dimensions fit)
+   if( (width <= 0) || (height <= 0) )
    {
       throw pMessage;
    }
@@ -152,6 +241,159 @@ static void attendToPngWarning
 );
 
 
+/// libpng helpers interface ---------------------------------------------------
+static void readColorMetadata
+(
+   png_structp pPngObj,
+   png_infop   pPngInfo,
+   float*      o_pPrimaries8,
+   float&      o_gamma
+);
+
+static void writeColorMetadata
+(
+   png_structp  pPngObj,
+   png_infop    pPngInfo,
+   const float* pPrimaries8,
+   float        gamma
+);
+
+static bool setRgbTransforms
+(
+   png_structp pPngObj,
+   png_infop   pPngInfo,
+   dword       orderingFlags
+);
+
+static void writeRgbHeader
+(
+   png_structp          pPngObj,
+   png_infop            pPngInfo,
+   dword                width,
+   dword                height,
+   const float*         pPrimaries8,
+   float                gamma,
+   bool                 is48Bit,
+   dword                orderingFlags,
+   const png::Encoding& encoding
+);
+
+
+/// parallel deflate interface -------------------------------------------------
+namespace
+{
+
+/**
+ * Filters and deflates rows into a zlib stream, blocks of rows in parallel
+ * (as pigz): each block is deflated alone -- primed with the window before it
+ * as dictionary, and flushed to a byte boundary -- so they simply join.
+ * <br/><br/>
+ *
+ * Rows can come in any number of calls. The stream is put out a block at a
+ * time.
+ */
+class RowDeflater
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowDeflater( dword                width,
+                bool                 is48Bit,
+                dword                orderingFlags,
+                const png::Encoding& encoding );
+
+   virtual ~RowDeflater();
+private:
+   RowDeflater( const RowDeflater& );
+   RowDeflater& operator=( const RowDeflater& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @ppRows  pointers to rows, top first, pixels as png::write
+    */
+           void writeRows( dword              rows,
+                           const void* const* ppRows );
+           void finish();
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void put( const ubyte* pBytes,
+                     dword        length ) = 0;
+
+   virtual void doBand( dword begin,
+                        dword end );
+
+private:
+           void filterRows( dword               begin,
+                            dword               end,
+                            std::vector<ubyte>& filtered )                const;
+           void makeDictionary( dword               end,
+                                std::vector<ubyte>& dictionary )          const;
+           void deflateBlock( std::vector<ubyte>&       filtered,
+                              const std::vector<ubyte>& dictionary,
+                              std::vector<ubyte>&       deflated )        const;
+           void toPngOrder( const void* pRow,
+                            ubyte*      pBytes )                          const;
+           void putStart( std::vector<ubyte>& bytes );
+
+/// fields ---------------------------------------------------------------------
+private:
+   // format
+   dword                width_m;
+   dword                pixelBytes_m;
+   dword                rowBytes_m;
+   bool                 isBgr_m;
+   bool                 isSwapped_m;
+   png::Encoding        encoding_m;
+   dword                blockRows_m;
+
+   // stream so far
+   bool                 isStarted_m;
+   uLong                adler_m;
+   std::vector<ubyte>   lastRow_m;
+   std::vector<ubyte>   window_m;
+
+   // rows being written
+   const void* const*   ppRows_m;
+   dword                rows_m;
+   dword                batchFirst_m;
+   std::vector< std::vector<ubyte> > deflated_m;
+   std::vector<uLong>   adlers_m;
+   std::vector<dword>   lengths_m;
+};
+
+
+/**
+ * Puts a deflated stream into IDAT chunks.
+ */
+class IdatWriter
+   : public RowDeflater
+{
+/// standard object services ---------------------------------------------------
+public:
+   IdatWriter( png_structp          pPngObj,
+               dword                width,
+               bool                 is48Bit,
+               dword                orderingFlags,
+               const png::Encoding& encoding );
+
+/// commands -------------------------------------------------------------------
+           void writeEnd();
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void put( const ubyte* pBytes,
+                     dword        length );
+
+/// fields ---------------------------------------------------------------------
+private:
+   png_structp pPngObj_m;
+};
+
+}
+
+
 
 bool hxa7241_image::png::isRecognised
 (
@@ -206,8 +448,7 @@ void hxa7241_image::png::read
    void*&       o_pTriples
 )
 {
-   dynamiclink::Library pngLibrary( getLibraryPathName( i_pngLibraryPathName ),
-      library_g );
+   loadLibrary( i_pngLibraryPathName );
 
    // disable stream exceptions
    StreamExceptionSet streamExceptionSet( i_in, istream::goodbit );
@@ -267,107 +508,14 @@ void hxa7241_image::png::read
       ::png_read_info( pPngObj, pPngInfo );
 
       // read colorspace and gamma
-      // sRGB
       float primaries[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
       float gamma         = 0.0f;
-      if( ::png_get_valid( pPngObj, pPngInfo, PNG_INFO_sRGB ) )
-      {
-         for( int i = 8;  i-- > 0; )
-         {
-            primaries[i] = SRGB_COLORSPACE[i];
-         }
-
-         gamma = SRGB_GAMMA;
-      }
-      // maybe specified
-      else
-      {
-         double primariesD[8];
-         if( ::png_get_cHRM( pPngObj, pPngInfo,
-            primariesD + 6, primariesD + 7,
-            primariesD + 0, primariesD + 1,
-            primariesD + 2, primariesD + 3,
-            primariesD + 4, primariesD + 5 ) )
-         {
-            for( int i = 8;  i-- > 0; )
-            {
-               primaries[i] = static_cast<float>(primariesD[i]);
-            }
-         }
-
-         double gammaD;
-         if( ::png_get_gAMA( pPngObj, pPngInfo, &gammaD ) )
-         {
-            gamma = static_cast<float>(gammaD);
-         }
-      }
+      readColorMetadata( pPngObj, pPngInfo, primaries, gamma );
 
       // set transformations
       // to convert any image into either 24 bit or 48 bit RGB
-      bool is48Bit = false;
-      {
-         const png_byte colorType = ::png_get_color_type( pPngObj, pPngInfo );
-         const png_byte bitDepth  = ::png_get_bit_depth( pPngObj, pPngInfo );
-
-         is48Bit = (16 == bitDepth);
-
-         // make grayscale image RGB
-         if( (colorType == PNG_COLOR_TYPE_GRAY) |
-            (colorType == PNG_COLOR_TYPE_GRAY_ALPHA) )
-         {
-            if( bitDepth < 8 )
-            {
-               ::png_set_expand_gray_1_2_4_to_8( pPngObj );
-            }
-            ::png_set_gray_to_rgb( pPngObj );
-         }
-         // make palette image RGB
-         else if( colorType == PNG_COLOR_TYPE_PALETTE )
-         {
-            ::png_set_palette_to_rgb( pPngObj );
-         }
-         // make packed-pixel image 1 pixel per byte
-         else if( bitDepth < 8 )
-         {
-            ::png_set_packing( pPngObj );
-         }
-
-         // make transparent or RGBA image RGB -- composite onto background
-         if( (colorType & PNG_COLOR_MASK_ALPHA) ||
-            ::png_get_valid( pPngObj, pPngInfo, PNG_INFO_tRNS ) )
-         {
-            png_color_16p imageBackground;
-            if( ::png_get_bKGD( pPngObj, pPngInfo, &imageBackground ) )
-            {
-               const dword n = (colorType == PNG_COLOR_TYPE_PALETTE) ? 1 : 0;
-               ::png_set_background( pPngObj, imageBackground,
-                  PNG_BACKGROUND_GAMMA_FILE, n, 1.0 );
-            }
-            else
-            {
-               png_color_16 background = { static_cast<byte>(0), 0, 0, 0, 0 };
-               ::png_set_background( pPngObj, &background,
-                  PNG_BACKGROUND_GAMMA_SCREEN, 0, 1.0 );
-            }
-
-            if( colorType & PNG_COLOR_MASK_ALPHA )
-            {
-               ::png_set_strip_alpha( pPngObj );
-            }
-         }
-
-         if( i_orderingFlags & IS_BGR )
-         {
-            ::png_set_bgr( pPngObj );
-         }
-
-         if( is48Bit & !(i_orderingFlags & IS_LO_ENDIAN) )
-         {
-            ::png_set_swap( pPngObj );
-         }
-
-         ::png_read_update_info( pPngObj, pPngInfo );
-      }
+      const bool is48Bit = setRgbTransforms( pPngObj, pPngInfo,
+         i_orderingFlags );
 
       // read pixels
       dword     width  = 0;
@@ -380,7 +528,7 @@ void hxa7241_image::png::read
          checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
 
          // allocate storage
-         pTriples.set( is48Bit, (width * height * 3) );
+         pTriples.set( is48Bit, static_cast<qword>(width) * height * 3 );
 
          // set row pointers
          std::vector<void*> rowPtrs( height );
@@ -388,7 +536,8 @@ void hxa7241_image::png::read
          {
             const dword row = (i_orderingFlags & IS_TOP_FIRST) ?
                i : (height - 1) - i;
-            const dword offset = row * (width * (3 << (is48Bit ? 1 : 0)));
+            const qword offset = static_cast<qword>(row) *
+               (width * (3 << (is48Bit ? 1 : 0)));
             rowPtrs[i] = static_cast<ubyte*>(pTriples.get()) + offset;
          }
 
@@ -426,19 +575,20 @@ void hxa7241_image::png::read
 
 void hxa7241_image::png::write
 (
-   const char   pngLibraryPathName[],
-   dword        width,
-   dword        height,
-   const float* pPrimaries8,
-   const float  gamma,
-   const bool   is48Bit,
-   const dword  orderingFlags,
-   const void*  pTriples,
-   ostream&     out
+   const char      pngLibraryPathName[],
+   dword           width,
+   dword           height,
+   const float*    pPrimaries8,
+   const float     gamma,
+   const bool      is48Bit,
+   const dword     orderingFlags,
+   const void*     pTriples,
+   ostream&        out,
+   const Encoding& encoding
 )
 {
-   dynamiclink::Library pngLibrary( getLibraryPathName( pngLibraryPathName ),
-      library_g );
+   loadLibrary( pngLibraryPathName );
+   const bool isParallel = isDeflateParallel( width, is48Bit, height );
 
    // disable stream exceptions
    StreamExceptionSet streamExceptionSet( out, ostream::goodbit );
@@ -474,289 +624,2193 @@ void hxa7241_image::png::write
          throw PNG_EXCEPTION_MESSAGE;
       }
 
-      // set some general callbacks and options
+      // set some general callbacks
+      ::png_set_write_fn( pPngObj, &out, writePngData, flushPngData );
+      //::png_set_write_status_fn( pPngObj, attendToPngRowWritten );
+         //void attendToPngRowWritten( png_ptr, png_uint_32 row, int pass );
+
+      // write before-image stuff, and set pixel byte ordering
+      writeRgbHeader( pPngObj, pPngInfo, width, height, pPrimaries8, gamma,
+         is48Bit, orderingFlags, encoding );
+
+      // set row pointers
+      std::vector<void*> rowPtrs( height );
+      for( dword i = height;  i-- > 0; )
       {
-         ::png_set_write_fn( pPngObj, &out, writePngData, flushPngData );
-         //::png_set_write_status_fn( pPngObj, attendToPngRowWritten );
-            //void attendToPngRowWritten( png_ptr, png_uint_32 row, int pass );
+         const dword row = (orderingFlags & IS_TOP_FIRST) ?
+            i : (height - 1) - i;
+         const qword offset = static_cast<qword>(row) *
+            (width * (3 << (is48Bit ? 1 : 0)));
+         rowPtrs[i] =
+            static_cast<ubyte*>(const_cast<void*>(pTriples)) + offset;
+      }
 
-         ::png_set_filter( pPngObj, 0, PNG_ALL_FILTERS );
-         ::png_set_compression_level( pPngObj, 9 );//Z_BEST_COMPRESSION );
+      // write pixels, and finish: deflated in parallel
+      if( isParallel )
+      {
+         IdatWriter idatWriter( pPngObj, width, is48Bit, orderingFlags,
+            encoding );
+         idatWriter.writeRows( height, &(rowPtrs[0]) );
+         idatWriter.finish();
+         idatWriter.writeEnd();
       }
+      // or by libpng
+      else
+      {
+         ::png_write_image(
+            pPngObj, reinterpret_cast<png_bytepp>(&(rowPtrs[0])) );
 
-      // set some specific chunks
+         ::png_write_end( pPngObj, 0 );
+      }
+
+      // delete basic png objects
+      ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+   }
+   catch( ... )
+   {
+      if( pPngObj )
       {
-         ::png_set_IHDR( pPngObj, pPngInfo,
-            width, height, 8 << dword(is48Bit),
-            PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
-            PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+         ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+      }
+
+      throw;
+   }
+}
+
+
+
+
+/// ----------------------------------------------------------------------------
+bool hxa7241_image::png::readIndexed
+(
+   const char          i_pngLibraryPathName[],
+   istream&            i_in,
+   const dword         i_orderingFlags,
+   float* const        o_pPrimaries8,
+   float&              o_gamma,
+   dword&              o_width,
+   dword&              o_height,
+   dword&              o_bitDepth,
+   std::vector<ubyte>& o_palette,
+   std::vector<ubyte>& o_alphas,
+   std::vector<ubyte>& o_indices
+)
+{
+   loadLibrary( i_pngLibraryPathName );
+
+   // disable stream exceptions
+   StreamExceptionSet streamExceptionSet( i_in, istream::goodbit );
+
+   // check png signature
+   static const dword SIGNATURE_LENGTH = 8;
+   {
+      char signature[SIGNATURE_LENGTH];
+      i_in.read( signature, SIGNATURE_LENGTH );
+      if( i_in.fail() )
+      {
+         throw IN_STREAM_EXCEPTION_MESSAGE;
+      }
+
+      if( ::png_sig_cmp( reinterpret_cast<png_bytep>(signature), 0,
+         SIGNATURE_LENGTH ) )
+      {
+         throw IN_FORMAT_EXCEPTION_MESSAGE;
+      }
+   }
+
+   png_structp pPngObj  = 0;
+   png_infop   pPngInfo = 0;
+   std::string pngErrorMsg;
+
+   bool isIndexed = false;
 
-         if( pPrimaries8 )
+   // (storage outside the png 'exception' jump)
+   std::vector<ubyte> palette;
+   std::vector<ubyte> alphas;
+   std::vector<ubyte> indices;
+   std::vector<void*> rowPtrs;
+
+   try
+   {
+      // create basic png objects
+      {
+         pPngObj = ::png_create_read_struct( PNG_LIBPNG_VER_STRING,
+            &pngErrorMsg, attendToPngError, attendToPngWarning );
+         if( !pPngObj )
          {
-            ::png_set_cHRM( pPngObj, pPngInfo,
-               pPrimaries8[6], pPrimaries8[7],
-               pPrimaries8[0], pPrimaries8[1],
-               pPrimaries8[2], pPrimaries8[3],
-               pPrimaries8[4], pPrimaries8[5] );
+            throw PNG_INIT_FAIL_MESSAGE;
          }
 
-         if( 0.0f != gamma )
+         pPngInfo = ::png_create_info_struct( pPngObj );
+         if( !pPngInfo )
          {
-            ::png_set_gAMA( pPngObj, pPngInfo, gamma );
+            throw PNG_INIT_FAIL_MESSAGE;
          }
+      }
 
-         png_text texts[] = { {
-               PNG_TEXT_COMPRESSION_NONE,
-               const_cast<char*>("Software"),
-               const_cast<char*>(HXA7241_URI),
-               0 } };
-         ::png_set_text( pPngObj, pPngInfo, texts, 1 );
+      // set the target for the png 'exception' jump
+      if( ::setjmp( pPngObj->jmpbuf ) )
+      {
+         throw PNG_EXCEPTION_MESSAGE;
       }
 
-      // write before-image stuff
-      ::png_write_info( pPngObj, pPngInfo );
+      /// set stream read callback
+      ::png_set_read_fn( pPngObj, &i_in, readPngData );
+
+      // move read-position past signature
+      ::png_set_sig_bytes( pPngObj, SIGNATURE_LENGTH );
 
-      // set pixel byte ordering
+      // read info
+      ::png_read_info( pPngObj, pPngInfo );
+
+      // only palette images, others are left unread
+      isIndexed = (PNG_COLOR_TYPE_PALETTE ==
+         ::png_get_color_type( pPngObj, pPngInfo ));
+      if( isIndexed )
       {
-         if( orderingFlags & IS_BGR )
+         // read colorspace and gamma
+         float primaries[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+            0.0f };
+         float gamma        = 0.0f;
+         readColorMetadata( pPngObj, pPngInfo, primaries, gamma );
+
+         // read palette, and transparency (alphas for the first entries)
          {
-            ::png_set_bgr( pPngObj );
+            png_colorp pColors    = 0;
+            int        colorCount = 0;
+            if( ::png_get_PLTE( pPngObj, pPngInfo, &pColors, &colorCount ) )
+            {
+               for( int i = 0;  i < colorCount;  ++i )
+               {
+                  palette.push_back( pColors[i].red );
+                  palette.push_back( pColors[i].green );
+                  palette.push_back( pColors[i].blue );
+               }
+            }
+
+            png_bytep     pTrans       = 0;
+            int           transCount   = 0;
+            png_color_16p pTransValues = 0;
+            if( ::png_get_tRNS( pPngObj, pPngInfo, &pTrans, &transCount,
+               &pTransValues ) && pTrans )
+            {
+               alphas.assign( pTrans, pTrans + transCount );
+            }
          }
 
-         if( is48Bit & (0 == (orderingFlags & IS_LO_ENDIAN)) )
+         // make packed indices 1 per byte
+         const dword bitDepth = ::png_get_bit_depth( pPngObj, pPngInfo );
+         if( bitDepth < 8 )
          {
-            ::png_set_swap( pPngObj );
+            ::png_set_packing( pPngObj );
          }
 
-         //::png_set_write_user_transform_fn( pPngObj, reOrderBytes );
-      }
+         ::png_read_update_info( pPngObj, pPngInfo );
 
-      // write pixels
-      {
-         std::vector<void*> rowPtrs( height );
-         for( dword i = height;  i-- > 0; )
+         // read indices
+         const dword width  = ::png_get_image_width( pPngObj, pPngInfo );
+         const dword height = ::png_get_image_height( pPngObj, pPngInfo );
+
+         checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+
+         indices.resize( width * height );
          {
-            const dword row = (orderingFlags & IS_TOP_FIRST) ?
-               i : (height - 1) - i;
-            const dword offset = row * (width * (3 << (is48Bit ? 1 : 0)));
-            rowPtrs[i] =
-               static_cast<ubyte*>(const_cast<void*>(pTriples)) + offset;
+            // set row pointers
+            rowPtrs.resize( height );
+            for( dword i = height;  i-- > 0; )
+            {
+               const dword row = (i_orderingFlags & IS_TOP_FIRST) ?
+                  i : (height - 1) - i;
+               rowPtrs[i] = &(indices[ static_cast<size_t>(row) * width ]);
+            }
+
+            ::png_read_image( pPngObj,
+               reinterpret_cast<png_bytepp>(&(rowPtrs[0])) );
          }
 
-         ::png_write_image(
-            pPngObj, reinterpret_cast<png_bytepp>(&(rowPtrs[0])) );
+         // finish reading
+         ::png_read_end( pPngObj, 0 );
+
+         // set outputs (now that no exceptions can happen)
+         for( int i = 8;  i-- > 0;  o_pPrimaries8[i] = primaries[i] );
+         o_gamma    = gamma;
+         o_width    = width;
+         o_height   = height;
+         o_bitDepth = bitDepth;
+         o_palette.swap( palette );
+         o_alphas.swap( alphas );
+         o_indices.swap( indices );
       }
 
-      // finish writing
-      ::png_write_end( pPngObj, 0 );
-
-      // delete basic png objects
-      ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+      // destruct
+      ::png_destroy_read_struct( &pPngObj, &pPngInfo, 0 );
    }
    catch( ... )
    {
       if( pPngObj )
       {
-         ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+         ::png_destroy_read_struct( &pPngObj, &pPngInfo, 0 );
       }
 
       throw;
    }
+
+   return isIndexed;
 }
 
 
 
 
-/// libpng callbacks -----------------------------------------------------------
-void readPngData
+void hxa7241_image::png::writeIndexed
 (
-   png_structp pPngObj,
-   png_bytep   pData,
-   png_size_t  length
+   const char                pngLibraryPathName[],
+   dword                     width,
+   dword                     height,
+   const float*              pPrimaries8,
+   const float               gamma,
+   const dword               bitDepth,
+   const std::vector<ubyte>& palette,
+   const std::vector<ubyte>& alphas,
+   const dword               orderingFlags,
+   const ubyte*              pIndices,
+   ostream&                  out
 )
 {
-   istream* pIstream = reinterpret_cast<istream*>( ::png_get_io_ptr(pPngObj) );
+   loadLibrary( pngLibraryPathName );
 
-   pIstream->read( reinterpret_cast<char*>(pData), length );
-   if( pIstream->fail() )
-   {
-      throw IN_STREAM_EXCEPTION_MESSAGE;
-   }
-}
+   // disable stream exceptions
+   StreamExceptionSet streamExceptionSet( out, ostream::goodbit );
 
+   png_structp pPngObj  = 0;
+   png_infop   pPngInfo = 0;
+   std::string pngErrorMsg;
 
-void writePngData
-(
+   try
+   {
+      width  = (width  >= 0) ? width  : 0;
+      height = (height >= 0) ? height : 0;
+
+      if( palette.size() < 3 )
+      {
+         throw OUT_PALETTE_EXCEPTION_MESSAGE;
+      }
+
+      // make palette in libpng form (before the jump target)
+      std::vector<png_color> colors( palette.size() / 3 );
+      for( dword i = colors.size();  i-- > 0; )
+      {
+         colors[i].red   = palette[ (i * 3) + 0 ];
+         colors[i].green = palette[ (i * 3) + 1 ];
+         colors[i].blue  = palette[ (i * 3) + 2 ];
+      }
+      std::vector<png_byte> trans( alphas.begin(), alphas.end() );
+      std::vector<void*>    rowPtrs( height );
+
+      // create basic png objects
+      {
+         pPngObj = ::png_create_write_struct( PNG_LIBPNG_VER_STRING,
+            &pngErrorMsg, attendToPngError, attendToPngWarning );
+         if( !pPngObj )
+         {
+            throw PNG_INIT_FAIL_MESSAGE;
+         }
+
+         pPngInfo = ::png_create_info_struct( pPngObj );
+         if( !pPngInfo )
+         {
+            throw PNG_INIT_FAIL_MESSAGE;
+         }
+      }
+
+      // set the target for the png 'exception' jump
+      if( ::setjmp( pPngObj->jmpbuf ) )
+      {
+         throw PNG_EXCEPTION_MESSAGE;
+      }
+
+      // set some general callbacks and options
+      {
+         ::png_set_write_fn( pPngObj, &out, writePngData, flushPngData );
+
+         // (filtering rarely helps indices)
+         ::png_set_filter( pPngObj, 0, PNG_FILTER_NONE );
+         ::png_set_compression_level( pPngObj, 9 );//Z_BEST_COMPRESSION );
+      }
+
+      // set some specific chunks
+      {
+         ::png_set_IHDR( pPngObj, pPngInfo,
+            width, height, bitDepth,
+            PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+            PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+
+         ::png_set_PLTE( pPngObj, pPngInfo, &(colors[0]),
+            static_cast<int>(colors.size()) );
+
+         if( !trans.empty() )
+         {
+            ::png_set_tRNS( pPngObj, pPngInfo, &(trans[0]),
+               static_cast<int>(trans.size()), 0 );
+         }
+
+         writeColorMetadata( pPngObj, pPngInfo, pPrimaries8, gamma );
+      }
+
+      // write before-image stuff
+      ::png_write_info( pPngObj, pPngInfo );
+
+      // pack sub-byte indices
+      if( bitDepth < 8 )
+      {
+         ::png_set_packing( pPngObj );
+      }
+
+      // write indices
+      {
+         for( dword i = height;  i-- > 0; )
+         {
+            const dword row = (orderingFlags & IS_TOP_FIRST) ?
+               i : (height - 1) - i;
+            rowPtrs[i] = const_cast<ubyte*>(pIndices) +
+               (static_cast<qword>(row) * width);
+         }
+
+         ::png_write_image(
+            pPngObj, reinterpret_cast<png_bytepp>(&(rowPtrs[0])) );
+      }
+
+      // finish writing
+      ::png_write_end( pPngObj, 0 );
+
+      // delete basic png objects
+      ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+   }
+   catch( ... )
+   {
+      if( pPngObj )
+      {
+         ::png_destroy_write_struct( &pPngObj, &pPngInfo );
+      }
+
+      throw;
+   }
+}
+
+
+
+
+/// scanlines ------------------------------------------------------------------
+namespace
+{
+
+/**
+ * Rows read from a file stream, a few at a time, top first.
+ */
+class RowReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowReader();
+
+   virtual ~RowReader();
+private:
+   RowReader( const RowReader& );
+   RowReader& operator=( const RowReader& );
+public:
+
+/// commands -------------------------------------------------------------------
+           bool open( const char pathName[],
+                      float*     pPrimaries8,
+                      float&     gamma,
+                      dword&     width,
+                      dword&     height,
+                      bool&      is48Bit );
+
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   std::ifstream in_m;
+   png_structp   pPngObj_m;
+   png_infop     pPngInfo_m;
+   std::string   pngErrorMsg_m;
+
+   dword         width_m;
+   dword         height_m;
+   bool          is48Bit_m;
+   dword         next_m;
+};
+
+
+RowReader::RowReader()
+ : in_m         ()
+ , pPngObj_m    ( 0 )
+ , pPngInfo_m   ( 0 )
+ , pngErrorMsg_m()
+ , width_m      ( 0 )
+ , height_m     ( 0 )
+ , is48Bit_m    ( false )
+ , next_m       ( 0 )
+{
+}
+
+
+RowReader::~RowReader()
+{
+   if( pPngObj_m )
+   {
+      ::png_destroy_read_struct( &pPngObj_m, &pPngInfo_m, 0 );
+   }
+}
+
+
+bool RowReader::open
+(
+   const char pathName[],
+   float*     pPrimaries8,
+   float&     gamma,
+   dword&     width,
+   dword&     height,
+   bool&      is48Bit
+)
+{
+   in_m.open( pathName, std::ifstream::binary );
+   if( !in_m )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // check png signature
+   static const dword SIGNATURE_LENGTH = 8;
+   {
+      char signature[SIGNATURE_LENGTH];
+      in_m.read( signature, SIGNATURE_LENGTH );
+      if( in_m.fail() )
+      {
+         throw IN_STREAM_EXCEPTION_MESSAGE;
+      }
+
+      if( ::png_sig_cmp( reinterpret_cast<png_bytep>(signature), 0,
+         SIGNATURE_LENGTH ) )
+      {
+         throw IN_FORMAT_EXCEPTION_MESSAGE;
+      }
+   }
+
+   // create basic png objects
+   pPngObj_m = ::png_create_read_struct( PNG_LIBPNG_VER_STRING,
+      &pngErrorMsg_m, attendToPngError, attendToPngWarning );
+   if( !pPngObj_m )
+   {
+      throw PNG_INIT_FAIL_MESSAGE;
+   }
+
+   pPngInfo_m = ::png_create_info_struct( pPngObj_m );
+   if( !pPngInfo_m )
+   {
+      throw PNG_INIT_FAIL_MESSAGE;
+   }
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   // set stream read callback, and move read-position past signature
+   ::png_set_read_fn( pPngObj_m, &in_m, readPngData );
+   ::png_set_sig_bytes( pPngObj_m, SIGNATURE_LENGTH );
+
+   // read info
+   ::png_read_info( pPngObj_m, pPngInfo_m );
+
+   // palette images are read kept indexed, and interlaced images need all
+   // rows at once
+   if( (::png_get_color_type( pPngObj_m, pPngInfo_m ) ==
+      PNG_COLOR_TYPE_PALETTE) || (::png_get_interlace_type( pPngObj_m,
+      pPngInfo_m ) != PNG_INTERLACE_NONE) )
+   {
+      return false;
+   }
+
+   readColorMetadata( pPngObj_m, pPngInfo_m, pPrimaries8, gamma );
+
+   is48Bit_m = setRgbTransforms( pPngObj_m, pPngInfo_m, 0 );
+
+   width_m  = ::png_get_image_width( pPngObj_m, pPngInfo_m );
+   height_m = ::png_get_image_height( pPngObj_m, pPngInfo_m );
+   checkDimensions( width_m, height_m, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   width   = width_m;
+   height  = height_m;
+   is48Bit = is48Bit_m;
+
+   return true;
+}
+
+
+void RowReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw IN_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   // set row pointers
+   std::vector<void*> rowPtrs( rows );
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      rowPtrs[r] = static_cast<ubyte*>(pTriples) + (static_cast<qword>(r) *
+         (width_m * (3 << (is48Bit_m ? 1 : 0))));
+   }
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   if( rows > 0 )
+   {
+      ::png_read_rows( pPngObj_m, reinterpret_cast<png_bytepp>(
+         &(rowPtrs[0])), 0, rows );
+   }
+
+   next_m += rows;
+}
+
+
+/**
+ * Rows written to a file stream, a few at a time, top first -- deflated in
+ * parallel, if zlib loads.
+ */
+class RowWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowWriter();
+
+   virtual ~RowWriter();
+private:
+   RowWriter( const RowWriter& );
+   RowWriter& operator=( const RowWriter& );
+public:
+
+/// commands -------------------------------------------------------------------
+           void open( dword                width,
+                      dword                height,
+                      const float*         pPrimaries8,
+                      float                gamma,
+                      bool                 is48Bit,
+                      const char           pathName[],
+                      const png::Encoding& encoding );
+
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   std::ofstream out_m;
+   png_structp   pPngObj_m;
+   png_infop     pPngInfo_m;
+   std::string   pngErrorMsg_m;
+   IdatWriter*   pIdatWriter_m;
+
+   dword         width_m;
+   dword         height_m;
+   bool          is48Bit_m;
+   dword         next_m;
+};
+
+
+RowWriter::RowWriter()
+ : out_m        ()
+ , pPngObj_m    ( 0 )
+ , pPngInfo_m   ( 0 )
+ , pngErrorMsg_m()
+ , pIdatWriter_m( 0 )
+ , width_m      ( 0 )
+ , height_m     ( 0 )
+ , is48Bit_m    ( false )
+ , next_m       ( 0 )
+{
+}
+
+
+RowWriter::~RowWriter()
+{
+   delete pIdatWriter_m;
+
+   if( pPngObj_m )
+   {
+      ::png_destroy_write_struct( &pPngObj_m, &pPngInfo_m );
+   }
+}
+
+
+void RowWriter::open
+(
+   const dword          width,
+   const dword          height,
+   const float*         pPrimaries8,
+   const float          gamma,
+   const bool           is48Bit,
+   const char           pathName[],
+   const png::Encoding& encoding
+)
+{
+   checkDimensions( width, height, OUT_STREAM_EXCEPTION_MESSAGE );
+
+   out_m.open( pathName, std::ofstream::binary );
+   if( !out_m )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // create basic png objects
+   pPngObj_m = ::png_create_write_struct( PNG_LIBPNG_VER_STRING,
+      &pngErrorMsg_m, attendToPngError, attendToPngWarning );
+   if( !pPngObj_m )
+   {
+      throw PNG_INIT_FAIL_MESSAGE;
+   }
+
+   pPngInfo_m = ::png_create_info_struct( pPngObj_m );
+   if( !pPngInfo_m )
+   {
+      throw PNG_INIT_FAIL_MESSAGE;
+   }
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   // set stream write callback, then write before-image stuff
+   ::png_set_write_fn( pPngObj_m, &out_m, writePngData, flushPngData );
+   writeRgbHeader( pPngObj_m, pPngInfo_m, width, height, pPrimaries8, gamma,
+      is48Bit, 0, encoding );
+
+   // deflate in parallel, if possible
+   if( isDeflateParallel( width, is48Bit, height ) )
+   {
+      pIdatWriter_m = new IdatWriter( pPngObj_m, width, is48Bit, 0,
+         encoding );
+   }
+
+   width_m   = width;
+   height_m  = height;
+   is48Bit_m = is48Bit;
+}
+
+
+void RowWriter::writeRows
+(
+   const dword rows,
+   const void* pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) || !pTriples )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // set row pointers
+   std::vector<void*> rowPtrs( rows );
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      rowPtrs[r] = static_cast<ubyte*>(const_cast<void*>(pTriples)) +
+         (static_cast<qword>(r) * (width_m * (3 << (is48Bit_m ? 1 : 0))));
+   }
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   if( pIdatWriter_m )
+   {
+      pIdatWriter_m->writeRows( rows, rows ? &(rowPtrs[0]) : 0 );
+   }
+   else if( rows > 0 )
+   {
+      ::png_write_rows( pPngObj_m, reinterpret_cast<png_bytepp>(
+         &(rowPtrs[0])), rows );
+   }
+
+   next_m += rows;
+}
+
+
+void RowWriter::finish()
+{
+   if( next_m != height_m )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   // finish writing, and delete basic png objects
+   if( pIdatWriter_m )
+   {
+      pIdatWriter_m->finish();
+      pIdatWriter_m->writeEnd();
+   }
+   else
+   {
+      ::png_write_end( pPngObj_m, 0 );
+   }
+   ::png_destroy_write_struct( &pPngObj_m, &pPngInfo_m );
+   pPngObj_m = 0;
+
+   out_m.close();
+   if( !out_m )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+}
+
+
+ScanlineReader* hxa7241_image::png::openReader
+(
+   const char i_pngLibraryPathName[],
+   const char i_pathName[],
+   float*     o_pPrimaries8,
+   float&     o_gamma,
+   dword&     o_width,
+   dword&     o_height,
+   bool&      o_is48Bit
+)
+{
+   loadLibrary( i_pngLibraryPathName );
+
+   RowReader* pReader = new RowReader;
+   try
+   {
+      if( !pReader->open( i_pathName, o_pPrimaries8, o_gamma, o_width,
+         o_height, o_is48Bit ) )
+      {
+         delete pReader;
+         pReader = 0;
+      }
+   }
+   catch( ... )
+   {
+      delete pReader;
+      throw;
+   }
+
+   return pReader;
+}
+
+
+ScanlineWriter* hxa7241_image::png::openWriter
+(
+   const char      i_pngLibraryPathName[],
+   const dword     i_width,
+   const dword     i_height,
+   const float*    i_pPrimaries8,
+   const float     i_gamma,
+   const bool      i_is48Bit,
+   const char      o_pathName[],
+   const Encoding& i_encoding
+)
+{
+   loadLibrary( i_pngLibraryPathName );
+
+   RowWriter* pWriter = new RowWriter;
+   try
+   {
+      pWriter->open( i_width, i_height, i_pPrimaries8, i_gamma, i_is48Bit,
+         o_pathName, i_encoding );
+   }
+   catch( ... )
+   {
+      delete pWriter;
+      throw;
+   }
+
+   return pWriter;
+}
+
+
+hxa7241_image::png::Encoding::Encoding
+(
+   const dword     level,
+   const EStrategy strategy,
+   const EFilter   filter
+)
+ : level   ( level )
+ , strategy( strategy )
+ , filter  ( filter )
+{
+}
+
+
+bool hxa7241_image::png::findEncoding
+(
+   const char i_name[],
+   Encoding&  o_encoding
+)
+{
+   static const char* STRATEGIES[] = {
+      "default", "filtered", "huffman", "rle" };
+   static const char* FILTERS[] = {
+      "none", "sub", "up", "average", "paeth", "adaptive" };
+
+   // (ignoring case)
+   std::string name( i_name ? i_name : "" );
+   for( size_t i = 0;  i < name.size();  ++i )
+   {
+      name[i] = static_cast<char>( ::tolower( name[i] ) );
+   }
+
+   // profiles
+   if( name == "fast" )
+   {
+      o_encoding = Encoding( 1, DEFAULT_STRATEGY, NO_FILTER );
+      return true;
+   }
+   if( name == "small" )
+   {
+      o_encoding = Encoding();
+      return true;
+   }
+
+   // or level_strategy_filter
+   const size_t split1 = name.find( '_' );
+   const size_t split2 = (1 == split1) ? name.find( '_', 2 ) :
+      std::string::npos;
+   if( (std::string::npos == split2) || !::isdigit( name[0] ) )
+   {
+      return false;
+   }
+
+   const std::string strategy( name.substr( 2, split2 - 2 ) );
+   const std::string filter( name.substr( split2 + 1 ) );
+   dword s = 4;
+   while( (--s >= 0) && (strategy != STRATEGIES[s]) ) {}
+   dword f = 6;
+   while( (--f >= 0) && (filter != FILTERS[f]) ) {}
+   if( (s < 0) || (f < 0) )
+   {
+      return false;
+   }
+
+   o_encoding = Encoding( name[0] - '0', static_cast<EStrategy>(s),
+      static_cast<EFilter>(f) );
+   return true;
+}
+
+
+
+
+/// parallel deflate -----------------------------------------------------------
+namespace
+{
+
+/**
+ * A filtered byte: raw x, with a left, b above, c above-left.
+ */
+inline
+ubyte filterByte
+(
+   const dword type,
+   const dword x,
+   const dword a,
+   const dword b,
+   const dword c
+)
+{
+   switch( type )
+   {
+      case png::SUB_FILTER     : return static_cast<ubyte>( x - a );
+      case png::UP_FILTER      : return static_cast<ubyte>( x - b );
+      case png::AVERAGE_FILTER :
+         return static_cast<ubyte>( x - ((a + b) >> 1) );
+      case png::PAETH_FILTER   :
+      {
+         // the nearest of a, b, c to a + b - c
+         const dword p  = a + b - c;
+         const dword pa = (p > a) ? p - a : a - p;
+         const dword pb = (p > b) ? p - b : b - p;
+         const dword pc = (p > c) ? p - c : c - p;
+         return static_cast<ubyte>( x - (((pa <= pb) & (pa <= pc)) ? a :
+            ((pb <= pc) ? b : c)) );
+      }
+      default                  : return static_cast<ubyte>( x );
+   }
+}
+
+
+/**
+ * Filter a row of bytes (in PNG order), by a filter, or adaptively -- by the
+ * least sum of (signed) filtered bytes, as libpng.
+ *
+ * @pPrior  row above (zeros for the top)
+ * @pOut    filter type byte, then filtered row
+ */
+void filterRow
+(
+   const ubyte* pRow,
+   const ubyte* pPrior,
+   const dword  length,
+   const dword  pixelBytes,
+   const dword  filter,
+   ubyte*       pOut
+)
+{
+   dword type = filter;
+
+   // adaptive: try all
+   if( png::ADAPTIVE_FILTER == filter )
+   {
+      udword sums[] = { 0, 0, 0, 0, 0 };
+      for( dword i = 0;  i < length;  ++i )
+      {
+         const dword a = (i >= pixelBytes) ? pRow[i - pixelBytes]   : 0;
+         const dword c = (i >= pixelBytes) ? pPrior[i - pixelBytes] : 0;
+         for( dword t = 0;  t < 5;  ++t )
+         {
+            const dword v = filterByte( t, pRow[i], a, pPrior[i], c );
+            sums[t] += (v < 128) ? v : 256 - v;
+         }
+      }
+
+      type = png::NO_FILTER;
+      for( dword t = 1;  t < 5;  ++t )
+      {
+         type = (sums[t] < sums[type]) ? t : type;
+      }
+   }
+
+   pOut[0] = static_cast<ubyte>( type );
+   if( png::NO_FILTER == type )
+   {
+      ::memcpy( pOut + 1, pRow, length );
+   }
+   else
+   {
+      for( dword i = 0;  i < length;  ++i )
+      {
+         const dword a = (i >= pixelBytes) ? pRow[i - pixelBytes]   : 0;
+         const dword c = (i >= pixelBytes) ? pPrior[i - pixelBytes] : 0;
+         pOut[1 + i] = filterByte( type, pRow[i], a, pPrior[i], c );
+      }
+   }
+}
+
+
+/// RowDeflater ----------------------------------------------------------------
+RowDeflater::RowDeflater
+(
+   const dword          width,
+   const bool           is48Bit,
+   const dword          orderingFlags,
+   const png::Encoding& encoding
+)
+ : width_m     ( width )
+ , pixelBytes_m( is48Bit ? 6 : 3 )
+ , rowBytes_m  ( width * pixelBytes_m )
+ , isBgr_m     ( 0 != (orderingFlags & png::IS_BGR) )
+ , isSwapped_m ( is48Bit && (0 == (orderingFlags & png::IS_LO_ENDIAN)) )
+ , encoding_m  ( encoding )
+ , blockRows_m ( DEFLATE_BLOCK_BYTES / (rowBytes_m + 1) )
+ , isStarted_m ( false )
+ , adler_m     ( 1 )
+ , lastRow_m   ( rowBytes_m, 0 )
+ , window_m    ()
+ , ppRows_m    ( 0 )
+ , rows_m      ( 0 )
+ , batchFirst_m( 0 )
+ , deflated_m  ()
+ , adlers_m    ()
+ , lengths_m   ()
+{
+   // (at least a row per block)
+   blockRows_m = (blockRows_m > 0) ? blockRows_m : 1;
+}
+
+
+RowDeflater::~RowDeflater()
+{
+}
+
+
+void RowDeflater::writeRows
+(
+   const dword        rows,
+   const void* const* ppRows
+)
+{
+   ppRows_m = ppRows;
+   rows_m   = rows;
+
+   // blocks, a batch at a time (a few per thread): deflated in parallel, then
+   // put out in order
+   const dword blocks = (rows + blockRows_m - 1) / blockRows_m;
+   const dword batch  = static_cast<dword>(
+      ParallelBands::getThreadCount() * 4 );
+   for( dword first = 0;  first < blocks;  first += batch )
+   {
+      const dword count = (blocks - first > batch) ? batch : blocks - first;
+
+      batchFirst_m = first;
+      deflated_m.assign( count, std::vector<ubyte>() );
+      adlers_m.assign( count, 0 );
+      lengths_m.assign( count, 0 );
+
+      run( count, 1 );
+
+      for( dword b = 0;  b < count;  ++b )
+      {
+         putStart( deflated_m[b] );
+         put( &(deflated_m[b][0]), static_cast<dword>(deflated_m[b].size()) );
+         adler_m = ::adler32_combine( adler_m, adlers_m[b], lengths_m[b] );
+
+         std::vector<ubyte>().swap( deflated_m[b] );
+      }
+   }
+
+   // keep what later rows need: the window before them, and the row above
+   if( rows > 0 )
+   {
+      std::vector<ubyte> window;
+      makeDictionary( rows, window );
+      window_m.swap( window );
+
+      toPngOrder( ppRows[rows - 1], &(lastRow_m[0]) );
+   }
+
+   ppRows_m = 0;
+   rows_m   = 0;
+}
+
+
+void RowDeflater::finish()
+{
+   // a final empty block (fixed codes), then the checksum
+   std::vector<ubyte> end( 6, 0 );
+   end[0] = 0x03;
+   for( dword i = 0;  i < 4;  ++i )
+   {
+      end[2 + i] = static_cast<ubyte>( adler_m >> (24 - (i * 8)) );
+   }
+
+   putStart( end );
+   put( &(end[0]), static_cast<dword>(end.size()) );
+}
+
+
+void RowDeflater::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   for( dword b = begin;  b < end;  ++b )
+   {
+      const dword first = (batchFirst_m + b) * blockRows_m;
+      const dword last  = (rows_m - first > blockRows_m) ?
+         first + blockRows_m : rows_m;
+
+      std::vector<ubyte> dictionary;
+      makeDictionary( first, dictionary );
+      std::vector<ubyte> filtered;
+      filterRows( first, last, filtered );
+
+      deflateBlock( filtered, dictionary, deflated_m[b] );
+      adlers_m[b]  = ::adler32( ::adler32( 0, 0, 0 ), &(filtered[0]),
+         static_cast<uInt>(filtered.size()) );
+      lengths_m[b] = static_cast<dword>( filtered.size() );
+   }
+}
+
+
+/**
+ * Filter rows (of those being written), appending them.
+ */
+void RowDeflater::filterRows
+(
+   const dword         begin,
+   const dword         end,
+   std::vector<ubyte>& filtered
+) const
+{
+   std::vector<ubyte> prior( lastRow_m );
+   std::vector<ubyte> row( rowBytes_m );
+   if( begin > 0 )
+   {
+      toPngOrder( ppRows_m[begin - 1], &(prior[0]) );
+   }
+
+   const size_t start = filtered.size();
+   filtered.resize( start + (static_cast<size_t>(end - begin) *
+      (rowBytes_m + 1)) );
+
+   for( dword r = begin;  r < end;  ++r )
+   {
+      toPngOrder( ppRows_m[r], &(row[0]) );
+      filterRow( &(row[0]), &(prior[0]), rowBytes_m, pixelBytes_m,
+         encoding_m.filter, &(filtered[start]) +
+         (static_cast<size_t>(r - begin) * (rowBytes_m + 1)) );
+
+      row.swap( prior );
+   }
+}
+
+
+/**
+ * Make the window before a row (of those being written): the filtered rows
+ * before it, and the stream before them, if it reaches further.
+ */
+void RowDeflater::makeDictionary
+(
+   const dword         end,
+   std::vector<ubyte>& dictionary
+) const
+{
+   const dword reach = (DEFLATE_WINDOW + rowBytes_m) / (rowBytes_m + 1);
+   const dword begin = (end > reach) ? end - reach : 0;
+
+   dictionary.clear();
+   if( (end - begin) < reach )
+   {
+      dictionary = window_m;
+   }
+   filterRows( begin, end, dictionary );
+
+   if( dictionary.size() > static_cast<size_t>(DEFLATE_WINDOW) )
+   {
+      dictionary.erase( dictionary.begin(), dictionary.end() -
+         DEFLATE_WINDOW );
+   }
+}
+
+
+/**
+ * Deflate a block, raw, primed with a dictionary, and flushed to a byte
+ * boundary (but not final).
+ */
+void RowDeflater::deflateBlock
+(
+   std::vector<ubyte>&       filtered,
+   const std::vector<ubyte>& dictionary,
+   std::vector<ubyte>&       deflated
+) const
+{
+   z_stream stream;
+   ::memset( &stream, 0, sizeof(stream) );
+
+   // (raw: the zlib header and checksum are made for the whole stream)
+   if( Z_OK != deflateInit2( &stream, encoding_m.level, Z_DEFLATED, -15, 8,
+      encoding_m.strategy ) )
+   {
+      throw ZLIB_EXCEPTION_MESSAGE;
+   }
+
+   try
+   {
+      if( !dictionary.empty() && (Z_OK != ::deflateSetDictionary( &stream,
+         &(dictionary[0]), static_cast<uInt>(dictionary.size()) )) )
+      {
+         throw ZLIB_EXCEPTION_MESSAGE;
+      }
+
+      // (growing the output if it overflows)
+      deflated.resize( filtered.size() + (filtered.size() >> 3) + 64 );
+      stream.next_in  = &(filtered[0]);
+      stream.avail_in = static_cast<uInt>( filtered.size() );
+      size_t length = 0;
+      for( ;; )
+      {
+         stream.next_out  = &(deflated[length]);
+         stream.avail_out = static_cast<uInt>( deflated.size() - length );
+
+         const int result = ::deflate( &stream, Z_SYNC_FLUSH );
+         length = deflated.size() - stream.avail_out;
+         if( (Z_OK != result) && (Z_BUF_ERROR != result) )
+         {
+            throw ZLIB_EXCEPTION_MESSAGE;
+         }
+
+         if( 0 != stream.avail_out )
+         {
+            break;
+         }
+         deflated.resize( deflated.size() * 2 );
+      }
+      deflated.resize( length );
+   }
+   catch( ... )
+   {
+      ::deflateEnd( &stream );
+      throw;
+   }
+
+   ::deflateEnd( &stream );
+}
+
+
+/**
+ * Convert a row to PNG byte order (as libpng's bgr and swap transforms).
+ */
+void RowDeflater::toPngOrder
+(
+   const void* pRow,
+   ubyte*      pBytes
+) const
+{
+   const ubyte* pIn = static_cast<const ubyte*>(pRow);
+
+   if( !isBgr_m && !isSwapped_m )
+   {
+      ::memcpy( pBytes, pIn, rowBytes_m );
+   }
+   else
+   {
+      const dword sampleBytes = pixelBytes_m / 3;
+      for( dword p = 0;  p < rowBytes_m;  p += pixelBytes_m )
+      {
+         for( dword c = 0;  c < 3;  ++c )
+         {
+            const ubyte* pSample = pIn + p + ((isBgr_m ? 2 - c : c) *
+               sampleBytes);
+            ubyte*       pOut    = pBytes + p + (c * sampleBytes);
+
+            pOut[0] = pSample[isSwapped_m ? 1 : 0];
+            if( 2 == sampleBytes )
+            {
+               pOut[1] = pSample[isSwapped_m ? 0 : 1];
+            }
+         }
+      }
+   }
+}
+
+
+/**
+ * Put the zlib header before the first bytes out.
+ */
+void RowDeflater::putStart
+(
+   std::vector<ubyte>& bytes
+)
+{
+   if( !isStarted_m )
+   {
+      // deflate, 32K window, and level class -- checked to a multiple of 31
+      const dword level  = encoding_m.level;
+      const dword method = 0x78;
+      dword       flags  = ((level < 2) ? 0 : ((level < 6) ? 1 :
+         ((6 == level) ? 2 : 3))) << 6;
+      flags += 31 - (((method << 8) + flags) % 31);
+
+      const ubyte header[] = { static_cast<ubyte>(method),
+         static_cast<ubyte>(flags) };
+      bytes.insert( bytes.begin(), header, header + 2 );
+
+      isStarted_m = true;
+   }
+}
+
+
+/// IdatWriter -----------------------------------------------------------------
+IdatWriter::IdatWriter
+(
+   png_structp          pPngObj,
+   const dword          width,
+   const bool           is48Bit,
+   const dword          orderingFlags,
+   const png::Encoding& encoding
+)
+ : RowDeflater( width, is48Bit, orderingFlags, encoding )
+ , pPngObj_m  ( pPngObj )
+{
+}
+
+
+void IdatWriter::writeEnd()
+{
+   static png_byte IEND_NAME[] = { 73, 69, 78, 68, 0 };
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   // (no more chunks are pending: text was written before the image)
+   ::png_write_chunk( pPngObj_m, IEND_NAME, 0, 0 );
+}
+
+
+void IdatWriter::put
+(
+   const ubyte* pBytes,
+   const dword  length
+)
+{
+   static png_byte IDAT_NAME[] = { 73, 68, 65, 84, 0 };
+
+   // set the target for the png 'exception' jump
+   if( ::setjmp( pPngObj_m->jmpbuf ) )
+   {
+      throw PNG_EXCEPTION_MESSAGE;
+   }
+
+   ::png_write_chunk( pPngObj_m, IDAT_NAME, const_cast<ubyte*>(pBytes),
+      length );
+}
+
+}
+
+
+
+
+/// libpng callbacks -----------------------------------------------------------
+void readPngData
+(
+   png_structp pPngObj,
+   png_bytep   pData,
+   png_size_t  length
+)
+{
+   istream* pIstream = reinterpret_cast<istream*>( ::png_get_io_ptr(pPngObj) );
+
+   pIstream->read( reinterpret_cast<char*>(pData), length );
+   if( pIstream->fail() )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+
+void writePngData
+(
    png_structp pPngObj,
    png_bytep   pData,
    png_size_t  length
 )
 {
-   ostream* pOstream = reinterpret_cast<ostream*>( ::png_get_io_ptr(pPngObj) );
+   ostream* pOstream = reinterpret_cast<ostream*>( ::png_get_io_ptr(pPngObj) );
+
+   pOstream->write( reinterpret_cast<const char*>(pData), length );
+   if( pOstream->fail() )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+
+void flushPngData
+(
+   png_structp pPngObj
+)
+{
+   ostream* pOstream =
+      reinterpret_cast<ostream*>( ::png_get_io_ptr( pPngObj ) );
+
+   pOstream->flush();
+   if( pOstream->fail() )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+
+//void reOrderBytes
+//(
+// png_structp   pPngObj,
+// png_row_infop pRowInfo,
+// png_bytep     pData
+//)
+//{
+//}
+
+
+void attendToPngError
+(
+   png_structp     pPngObj,
+   png_const_charp pErrorMsg
+)
+{
+   std::string* pString =
+      reinterpret_cast<std::string*>( ::png_get_error_ptr(pPngObj) );
+   *pString = pErrorMsg;
+
+   ::longjmp( pPngObj->jmpbuf, 1 );
+}
+
+
+void attendToPngWarning
+(
+   png_structp,
+   png_const_charp //pWarningMsg
+)
+{
+// using hxa7241_general::Logger;
+// Logger() << Logger::EXC1 << PngWriter::CLASS_NAME() << " : " << pWarningMsg;
+}
+
+
+
+
+/// libpng helpers ------------------------------------------------------------
+void readColorMetadata
+(
+   png_structp pPngObj,
+   png_infop   pPngInfo,
+   float*      o_pPrimaries8,
+   float&      o_gamma
+)
+{
+   // sRGB
+   if( ::png_get_valid( pPngObj, pPngInfo, PNG_INFO_sRGB ) )
+   {
+      for( int i = 8;  i-- > 0; )
+      {
+         o_pPrimaries8[i] = SRGB_COLORSPACE[i];
+      }
+
+      o_gamma = SRGB_GAMMA;
+   }
+   // maybe specified
+   else
+   {
+      double primariesD[8];
+      if( ::png_get_cHRM( pPngObj, pPngInfo,
+         primariesD + 6, primariesD + 7,
+         primariesD + 0, primariesD + 1,
+         primariesD + 2, primariesD + 3,
+         primariesD + 4, primariesD + 5 ) )
+      {
+         for( int i = 8;  i-- > 0; )
+         {
+            o_pPrimaries8[i] = static_cast<float>(primariesD[i]);
+         }
+      }
+
+      double gammaD;
+      if( ::png_get_gAMA( pPngObj, pPngInfo, &gammaD ) )
+      {
+         o_gamma = static_cast<float>(gammaD);
+      }
+   }
+}
+
+
+void writeColorMetadata
+(
+   png_structp  pPngObj,
+   png_infop    pPngInfo,
+   const float* pPrimaries8,
+   const float  gamma
+)
+{
+   if( pPrimaries8 )
+   {
+      ::png_set_cHRM( pPngObj, pPngInfo,
+         pPrimaries8[6], pPrimaries8[7],
+         pPrimaries8[0], pPrimaries8[1],
+         pPrimaries8[2], pPrimaries8[3],
+         pPrimaries8[4], pPrimaries8[5] );
+   }
+
+   if( 0.0f != gamma )
+   {
+      ::png_set_gAMA( pPngObj, pPngInfo, gamma );
+   }
+
+   png_text texts[] = { {
+         PNG_TEXT_COMPRESSION_NONE,
+         const_cast<char*>("Software"),
+         const_cast<char*>(HXA7241_URI),
+         0 } };
+   ::png_set_text( pPngObj, pPngInfo, texts, 1 );
+}
+
+
+/**
+ * Set transformations to convert any image into either 24 bit or 48 bit RGB,
+ * after reading info.
+ *
+ * @return  true if 48 bit
+ */
+bool setRgbTransforms
+(
+   png_structp pPngObj,
+   png_infop   pPngInfo,
+   const dword orderingFlags
+)
+{
+   const png_byte colorType = ::png_get_color_type( pPngObj, pPngInfo );
+   const png_byte bitDepth  = ::png_get_bit_depth( pPngObj, pPngInfo );
+
+   const bool is48Bit = (16 == bitDepth);
+
+   // make grayscale image RGB
+   if( (colorType == PNG_COLOR_TYPE_GRAY) |
+      (colorType == PNG_COLOR_TYPE_GRAY_ALPHA) )
+   {
+      if( bitDepth < 8 )
+      {
+         ::png_set_expand_gray_1_2_4_to_8( pPngObj );
+      }
+      ::png_set_gray_to_rgb( pPngObj );
+   }
+   // make palette image RGB
+   else if( colorType == PNG_COLOR_TYPE_PALETTE )
+   {
+      ::png_set_palette_to_rgb( pPngObj );
+   }
+   // make packed-pixel image 1 pixel per byte
+   else if( bitDepth < 8 )
+   {
+      ::png_set_packing( pPngObj );
+   }
+
+   // make transparent or RGBA image RGB -- composite onto background
+   if( (colorType & PNG_COLOR_MASK_ALPHA) ||
+      ::png_get_valid( pPngObj, pPngInfo, PNG_INFO_tRNS ) )
+   {
+      png_color_16p imageBackground;
+      if( ::png_get_bKGD( pPngObj, pPngInfo, &imageBackground ) )
+      {
+         const dword n = (colorType == PNG_COLOR_TYPE_PALETTE) ? 1 : 0;
+         ::png_set_background( pPngObj, imageBackground,
+            PNG_BACKGROUND_GAMMA_FILE, n, 1.0 );
+      }
+      else
+      {
+         png_color_16 background = { static_cast<byte>(0), 0, 0, 0, 0 };
+         ::png_set_background( pPngObj, &background,
+            PNG_BACKGROUND_GAMMA_SCREEN, 0, 1.0 );
+      }
+
+      if( colorType & PNG_COLOR_MASK_ALPHA )
+      {
+         ::png_set_strip_alpha( pPngObj );
+      }
+   }
+
+   if( orderingFlags & png::IS_BGR )
+   {
+      ::png_set_bgr( pPngObj );
+   }
+
+   if( is48Bit & !(orderingFlags & png::IS_LO_ENDIAN) )
+   {
+      ::png_set_swap( pPngObj );
+   }
+
+
+   return is48Bit;
+}
+
+
+/**
+ * Set options, write chunks up to the image, and set pixel byte ordering.
+ */
+void writeRgbHeader
+(
+   png_structp          pPngObj,
+   png_infop            pPngInfo,
+   const dword          width,
+   const dword          height,
+   const float*         pPrimaries8,
+   const float          gamma,
+   const bool           is48Bit,
+   const dword          orderingFlags,
+   const png::Encoding& encoding
+)
+{
+   // set some general options (for when libpng deflates)
+   static const int FILTERS[] = { PNG_FILTER_NONE, PNG_FILTER_SUB,
+      PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH, PNG_ALL_FILTERS };
+   ::png_set_filter( pPngObj, 0, FILTERS[encoding.filter] );
+   ::png_set_compression_level( pPngObj, encoding.level );
+   ::png_set_compression_strategy( pPngObj, encoding.strategy );
+
+   // set some specific chunks
+   ::png_set_IHDR( pPngObj, pPngInfo,
+      width, height, 8 << dword(is48Bit),
+      PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+      PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+
+   writeColorMetadata( pPngObj, pPngInfo, pPrimaries8, gamma );
+
+   // write before-image stuff
+   ::png_write_info( pPngObj, pPngInfo );
+
+   // set pixel byte ordering
+   if( orderingFlags & png::IS_BGR )
+   {
+      ::png_set_bgr( pPngObj );
+   }
+
+   if( is48Bit & (0 == (orderingFlags & png::IS_LO_ENDIAN)) )
+   {
+      ::png_set_swap( pPngObj );
+   }
+
+   //::png_set_write_user_transform_fn( pPngObj, reOrderBytes );
+}
+
+
+
+
+/// libpng dynamic library forwarders ------------------------------------------
+
+// (generating these automatically with some kind of macro or template might be
+// good...)
+
+int  png_sig_cmp
+(
+   png_bytep  sig,
+   png_size_t start,
+   png_size_t num_to_check
+)
+{
+   typedef int (*PFunction)(
+      png_bytep,
+      png_size_t,
+      png_size_t
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_sig_cmp" ) );
+
+   return (function)(
+      sig,
+      start,
+      num_to_check
+   );
+}
+
+
+png_structp  png_create_read_struct
+(
+   png_const_charp user_png_ver,
+   png_voidp       error_ptr,
+   png_error_ptr   error_fn,
+   png_error_ptr   warn_fn
+)
+{
+   typedef png_structp (*PFunction)(
+      png_const_charp,
+      png_voidp,
+      png_error_ptr,
+      png_error_ptr
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_create_read_struct" ) );
+
+   return (function)(
+      user_png_ver,
+      error_ptr,
+      error_fn,
+      warn_fn
+   );
+}
+
+
+void  png_set_read_fn
+(
+   png_structp png_ptr,
+   png_voidp   io_ptr,
+   png_rw_ptr  read_data_fn
+)
+{
+   typedef void (*PFunction)(
+      png_structp,
+      png_voidp,
+      png_rw_ptr
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_read_fn" ) );
+
+   return (function)(
+      png_ptr,
+      io_ptr,
+      read_data_fn
+   );
+}
+
+
+void  png_set_sig_bytes
+(
+   png_structp png_ptr,
+   int         num_bytes
+)
+{
+   typedef void (*PFunction)(
+      png_structp,
+      int
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_sig_bytes" ) );
+
+   return (function)(
+      png_ptr,
+      num_bytes
+   );
+}
+
+
+void  png_read_info
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
+)
+{
+   typedef void (*PFunction)(
+      png_structp,
+      png_infop
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_read_info" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
+}
+
+
+png_uint_32  png_get_valid
+(
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   png_uint_32 flag
+)
+{
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop,
+      png_uint_32
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_valid" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr,
+      flag
+   );
+}
+
+
+png_uint_32  png_get_cHRM
+(
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   double*     white_x,
+   double*     white_y,
+   double*     red_x,
+   double*     red_y,
+   double*     green_x,
+   double*     green_y,
+   double*     blue_x,
+   double*     blue_y
+)
+{
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop,
+      double*,
+      double*,
+      double*,
+      double*,
+      double*,
+      double*,
+      double*,
+      double*
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_cHRM" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr,
+      white_x,
+      white_y,
+      red_x,
+      red_y,
+      green_x,
+      green_y,
+      blue_x,
+      blue_y
+   );
+}
+
+
+png_uint_32  png_get_gAMA
+(
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   double*     file_gamma
+)
+{
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop,
+      double*
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_gAMA" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr,
+      file_gamma
+   );
+}
+
+
+png_byte  png_get_color_type
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
+)
+{
+   typedef png_byte (*PFunction)(
+      png_structp,
+      png_infop
+   );
 
-   pOstream->write( reinterpret_cast<const char*>(pData), length );
-   if( pOstream->fail() )
-   {
-      throw OUT_STREAM_EXCEPTION_MESSAGE;
-   }
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_color_type" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
 }
 
 
-void flushPngData
+png_byte  png_get_interlace_type
 (
-   png_structp pPngObj
+   png_structp png_ptr,
+   png_infop   info_ptr
 )
 {
-   ostream* pOstream =
-      reinterpret_cast<ostream*>( ::png_get_io_ptr( pPngObj ) );
+   typedef png_byte (*PFunction)(
+      png_structp,
+      png_infop
+   );
 
-   pOstream->flush();
-   if( pOstream->fail() )
-   {
-      throw OUT_STREAM_EXCEPTION_MESSAGE;
-   }
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_interlace_type" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
 }
 
 
-//void reOrderBytes
-//(
-// png_structp   pPngObj,
-// png_row_infop pRowInfo,
-// png_bytep     pData
-//)
-//{
-//}
+png_byte  png_get_bit_depth
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
+)
+{
+   typedef png_byte (*PFunction)(
+      png_structp,
+      png_infop
+   );
 
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_bit_depth" ) );
 
-void attendToPngError
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
+}
+
+
+void  png_set_expand_gray_1_2_4_to_8
 (
-   png_structp     pPngObj,
-   png_const_charp pErrorMsg
+   png_structp png_ptr
 )
 {
-   std::string* pString =
-      reinterpret_cast<std::string*>( ::png_get_error_ptr(pPngObj) );
-   *pString = pErrorMsg;
+   typedef void (*PFunction)(
+      png_structp
+   );
 
-   ::longjmp( pPngObj->jmpbuf, 1 );
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_expand_gray_1_2_4_to_8" ) );
+
+   return (function)(
+      png_ptr
+   );
 }
 
 
-void attendToPngWarning
+void  png_set_gray_to_rgb
 (
-   png_structp,
-   png_const_charp //pWarningMsg
+   png_structp png_ptr
 )
 {
-// using hxa7241_general::Logger;
-// Logger() << Logger::EXC1 << PngWriter::CLASS_NAME() << " : " << pWarningMsg;
+   typedef void (*PFunction)(
+      png_structp
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_gray_to_rgb" ) );
+
+   return (function)(
+      png_ptr
+   );
 }
 
 
+void  png_set_palette_to_rgb
+(
+   png_structp png_ptr
+)
+{
+   typedef void (*PFunction)(
+      png_structp
+   );
 
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_palette_to_rgb" ) );
 
-/// libpng dynamic library forwarders ------------------------------------------
+   return (function)(
+      png_ptr
+   );
+}
 
-// (generating these automatically with some kind of macro or template might be
-// good...)
 
-int  png_sig_cmp
+void  png_set_packing
 (
-   png_bytep  sig,
-   png_size_t start,
-   png_size_t num_to_check
+   png_structp png_ptr
 )
 {
-   typedef int (*PFunction)(
-      png_bytep,
-      png_size_t,
-      png_size_t
+   typedef void (*PFunction)(
+      png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_sig_cmp" ) );
+      dynamiclink::getFunction( library_g, "png_set_packing" ) );
 
    return (function)(
-      sig,
-      start,
-      num_to_check
+      png_ptr
    );
 }
 
 
-png_structp  png_create_read_struct
+png_uint_32  png_get_bKGD
 (
-   png_const_charp user_png_ver,
-   png_voidp       error_ptr,
-   png_error_ptr   error_fn,
-   png_error_ptr   warn_fn
+   png_structp    png_ptr,
+   png_infop      info_ptr,
+   png_color_16p* background
+)
+{
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop,
+      png_color_16p*
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_bKGD" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr,
+      background
+   );
+}
+
+
+void  png_set_background
+(
+   png_structp   png_ptr,
+   png_color_16p background_color,
+   int           background_gamma_code,
+   int           need_expand,
+   double        background_gamma
+)
+{
+   typedef void (*PFunction)(
+      png_structp,
+      png_color_16p,
+      int,
+      int,
+      double
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_background" ) );
+
+   return (function)(
+      png_ptr,
+      background_color,
+      background_gamma_code,
+      need_expand,
+      background_gamma
+   );
+}
+
+
+void  png_set_strip_alpha
+(
+   png_structp png_ptr
+)
+{
+   typedef void (*PFunction)(
+      png_structp
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_set_strip_alpha" ) );
+
+   return (function)(
+      png_ptr
+   );
+}
+
+
+void  png_read_update_info
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
+)
+{
+   typedef void (*PFunction)(
+      png_structp,
+      png_infop
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_read_update_info" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
+}
+
+
+png_uint_32  png_get_image_width
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
+)
+{
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop
+   );
+
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( library_g, "png_get_image_width" ) );
+
+   return (function)(
+      png_ptr,
+      info_ptr
+   );
+}
+
+
+png_uint_32  png_get_image_height
+(
+   png_structp png_ptr,
+   png_infop   info_ptr
 )
 {
-   typedef png_structp (*PFunction)(
-      png_const_charp,
-      png_voidp,
-      png_error_ptr,
-      png_error_ptr
+   typedef png_uint_32 (*PFunction)(
+      png_structp,
+      png_infop
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_create_read_struct" ) );
+      dynamiclink::getFunction( library_g, "png_get_image_height" ) );
 
    return (function)(
-      user_png_ver,
-      error_ptr,
-      error_fn,
-      warn_fn
+      png_ptr,
+      info_ptr
    );
 }
 
 
-void  png_set_read_fn
+void  png_read_image
 (
    png_structp png_ptr,
-   png_voidp   io_ptr,
-   png_rw_ptr  read_data_fn
+   png_bytepp  image
 )
 {
    typedef void (*PFunction)(
       png_structp,
-      png_voidp,
-      png_rw_ptr
+      png_bytepp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_read_fn" ) );
+      dynamiclink::getFunction( library_g, "png_read_image" ) );
 
    return (function)(
       png_ptr,
-      io_ptr,
-      read_data_fn
+      image
    );
 }
 
 
-void  png_set_sig_bytes
+void  png_read_rows
 (
    png_structp png_ptr,
-   int         num_bytes
+   png_bytepp  row,
+   png_bytepp  display_row,
+   png_uint_32 num_rows
 )
 {
    typedef void (*PFunction)(
       png_structp,
-      int
+      png_bytepp,
+      png_bytepp,
+      png_uint_32
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_sig_bytes" ) );
+      dynamiclink::getFunction( library_g, "png_read_rows" ) );
 
    return (function)(
       png_ptr,
-      num_bytes
+      row,
+      display_row,
+      num_rows
    );
 }
 
 
-void  png_read_info
+void  png_read_end
 (
    png_structp png_ptr,
    png_infop   info_ptr
@@ -768,7 +2822,7 @@ void  png_read_info
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_read_info" ) );
+      dynamiclink::getFunction( library_g, "png_read_end" ) );
 
    return (function)(
       png_ptr,
@@ -777,286 +2831,342 @@ void  png_read_info
 }
 
 
-png_uint_32  png_get_valid
+void  png_destroy_read_struct
 (
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   png_uint_32 flag
+   png_structpp png_ptr_ptr,
+   png_infopp   info_ptr_ptr,
+   png_infopp   end_info_ptr_ptr
 )
 {
-   typedef png_uint_32 (*PFunction)(
-      png_structp,
-      png_infop,
-      png_uint_32
+   typedef void (*PFunction)(
+      png_structpp,
+      png_infopp,
+      png_infopp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_valid" ) );
+      dynamiclink::getFunction( library_g, "png_destroy_read_struct" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr,
-      flag
+      png_ptr_ptr,
+      info_ptr_ptr,
+      end_info_ptr_ptr
    );
 }
 
 
-png_uint_32  png_get_cHRM
+png_structp  png_create_write_struct
 (
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   double*     white_x,
-   double*     white_y,
-   double*     red_x,
-   double*     red_y,
-   double*     green_x,
-   double*     green_y,
-   double*     blue_x,
-   double*     blue_y
+   png_const_charp user_png_ver,
+   png_voidp       error_ptr,
+   png_error_ptr   error_fn,
+   png_error_ptr   warn_fn
 )
 {
-   typedef png_uint_32 (*PFunction)(
-      png_structp,
-      png_infop,
-      double*,
-      double*,
-      double*,
-      double*,
-      double*,
-      double*,
-      double*,
-      double*
+   typedef png_structp (*PFunction)(
+      png_const_charp,
+      png_voidp,
+      png_error_ptr,
+      png_error_ptr
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_cHRM" ) );
+      dynamiclink::getFunction( library_g, "png_create_write_struct" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr,
-      white_x,
-      white_y,
-      red_x,
-      red_y,
-      green_x,
-      green_y,
-      blue_x,
-      blue_y
+      user_png_ver,
+      error_ptr,
+      error_fn,
+      warn_fn
    );
 }
 
 
-png_uint_32  png_get_gAMA
+png_infop  png_create_info_struct
 (
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   double*     file_gamma
+   png_structp png_ptr
 )
 {
-   typedef png_uint_32 (*PFunction)(
-      png_structp,
-      png_infop,
-      double*
+   typedef png_infop (*PFunction)(
+      png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_gAMA" ) );
+      dynamiclink::getFunction( library_g, "png_create_info_struct" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr,
-      file_gamma
+      png_ptr
    );
 }
 
 
-png_byte  png_get_color_type
+void  png_set_write_fn
 (
-   png_structp png_ptr,
-   png_infop   info_ptr
+   png_structp   png_ptr,
+   png_voidp     io_ptr,
+   png_rw_ptr    write_data_fn,
+   png_flush_ptr output_flush_fn
 )
 {
-   typedef png_byte (*PFunction)(
+   typedef void (*PFunction)(
       png_structp,
-      png_infop
+      png_voidp,
+      png_rw_ptr,
+      png_flush_ptr
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_color_type" ) );
+      dynamiclink::getFunction( library_g, "png_set_write_fn" ) );
 
    return (function)(
       png_ptr,
-      info_ptr
+      io_ptr,
+      write_data_fn,
+      output_flush_fn
    );
 }
 
 
-png_byte  png_get_bit_depth
+//void  png_set_write_status_fn
+//(
+// png_structp          png_ptr,
+// png_write_status_ptr write_row_fn
+//)
+//{
+//}
+
+
+void  png_set_filter
 (
    png_structp png_ptr,
-   png_infop   info_ptr
+   int         method,
+   int         filters
 )
 {
-   typedef png_byte (*PFunction)(
+   typedef void (*PFunction)(
       png_structp,
-      png_infop
+      int,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_bit_depth" ) );
+      dynamiclink::getFunction( library_g, "png_set_filter" ) );
 
    return (function)(
       png_ptr,
-      info_ptr
+      method,
+      filters
    );
 }
 
 
-void  png_set_expand_gray_1_2_4_to_8
+void  png_set_compression_level
 (
-   png_structp png_ptr
+   png_structp png_ptr,
+   int         level
 )
 {
    typedef void (*PFunction)(
-      png_structp
+      png_structp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_expand_gray_1_2_4_to_8" ) );
+      dynamiclink::getFunction( library_g, "png_set_compression_level" ) );
 
    return (function)(
-      png_ptr
+      png_ptr,
+      level
    );
 }
 
-
-void  png_set_gray_to_rgb
+void  png_set_compression_strategy
 (
-   png_structp png_ptr
+   png_structp png_ptr,
+   int         strategy
 )
 {
    typedef void (*PFunction)(
-      png_structp
+      png_structp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_gray_to_rgb" ) );
+      dynamiclink::getFunction( library_g, "png_set_compression_strategy" ) );
 
    return (function)(
-      png_ptr
+      png_ptr,
+      strategy
    );
 }
 
 
-void  png_set_palette_to_rgb
+void  png_write_chunk
 (
-   png_structp png_ptr
+   png_structp png_ptr,
+   png_bytep   chunk_name,
+   png_bytep   data,
+   png_size_t  length
 )
 {
    typedef void (*PFunction)(
-      png_structp
+      png_structp,
+      png_bytep,
+      png_bytep,
+      png_size_t
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_palette_to_rgb" ) );
+      dynamiclink::getFunction( library_g, "png_write_chunk" ) );
 
    return (function)(
-      png_ptr
+      png_ptr,
+      chunk_name,
+      data,
+      length
    );
 }
 
 
-void  png_set_packing
+void  png_set_IHDR
 (
-   png_structp png_ptr
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   png_uint_32 width,
+   png_uint_32 height,
+   int         bit_depth,
+   int         color_type,
+   int         interlace_method,
+   int         compression_method,
+   int         filter_method
 )
 {
    typedef void (*PFunction)(
-      png_structp
+      png_structp,
+      png_infop,
+      png_uint_32,
+      png_uint_32,
+      int,
+      int,
+      int,
+      int,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_packing" ) );
+      dynamiclink::getFunction( library_g, "png_set_IHDR" ) );
 
    return (function)(
-      png_ptr
+      png_ptr,
+      info_ptr,
+      width,
+      height,
+      bit_depth,
+      color_type,
+      interlace_method,
+      compression_method,
+      filter_method
    );
 }
 
 
-png_uint_32  png_get_bKGD
+void  png_set_cHRM
 (
-   png_structp    png_ptr,
-   png_infop      info_ptr,
-   png_color_16p* background
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   double      white_x,
+   double      white_y,
+   double      red_x,
+   double      red_y,
+   double      green_x,
+   double      green_y,
+   double      blue_x,
+   double      blue_y
 )
 {
-   typedef png_uint_32 (*PFunction)(
+   typedef void (*PFunction)(
       png_structp,
       png_infop,
-      png_color_16p*
+      double,
+      double,
+      double,
+      double,
+      double,
+      double,
+      double,
+      double
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_bKGD" ) );
+      dynamiclink::getFunction( library_g, "png_set_cHRM" ) );
 
    return (function)(
       png_ptr,
       info_ptr,
-      background
+      white_x,
+      white_y,
+      red_x,
+      red_y,
+      green_x,
+      green_y,
+      blue_x,
+      blue_y
    );
 }
 
 
-void  png_set_background
+void  png_set_gAMA
 (
-   png_structp   png_ptr,
-   png_color_16p background_color,
-   int           background_gamma_code,
-   int           need_expand,
-   double        background_gamma
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   double      gamma
 )
 {
    typedef void (*PFunction)(
       png_structp,
-      png_color_16p,
-      int,
-      int,
+      png_infop,
       double
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_background" ) );
+      dynamiclink::getFunction( library_g, "png_set_gAMA" ) );
 
    return (function)(
       png_ptr,
-      background_color,
-      background_gamma_code,
-      need_expand,
-      background_gamma
+      info_ptr,
+      gamma
    );
 }
 
 
-void  png_set_strip_alpha
+void  png_set_text
 (
-   png_structp png_ptr
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   png_textp   text_ptr,
+   int         num_text
 )
 {
    typedef void (*PFunction)(
-      png_structp
+      png_structp,
+      png_infop,
+      png_textp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_strip_alpha" ) );
+      dynamiclink::getFunction( library_g, "png_set_text" ) );
 
    return (function)(
-      png_ptr
+      png_ptr,
+      info_ptr,
+      text_ptr,
+      num_text
    );
 }
 
 
-void  png_read_update_info
+void  png_write_info
 (
    png_structp png_ptr,
    png_infop   info_ptr
@@ -1068,7 +3178,7 @@ void  png_read_update_info
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_read_update_info" ) );
+      dynamiclink::getFunction( library_g, "png_write_info" ) );
 
    return (function)(
       png_ptr,
@@ -1077,49 +3187,52 @@ void  png_read_update_info
 }
 
 
-png_uint_32  png_get_image_width
+void  png_set_bgr
 (
-   png_structp png_ptr,
-   png_infop   info_ptr
+   png_structp png_ptr
 )
 {
-   typedef png_uint_32 (*PFunction)(
-      png_structp,
-      png_infop
+   typedef void (*PFunction)(
+      png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_image_width" ) );
+      dynamiclink::getFunction( library_g, "png_set_bgr" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr
+      png_ptr
    );
 }
 
 
-png_uint_32  png_get_image_height
+void  png_set_swap
 (
-   png_structp png_ptr,
-   png_infop   info_ptr
+   png_structp png_ptr
 )
 {
-   typedef png_uint_32 (*PFunction)(
-      png_structp,
-      png_infop
+   typedef void (*PFunction)(
+      png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_image_height" ) );
+      dynamiclink::getFunction( library_g, "png_set_swap" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr
+      png_ptr
    );
 }
 
 
-void  png_read_image
+//void  png_set_write_user_transform_fn
+//(
+// png_structp            png_ptr,
+// png_user_transform_ptr write_user_transform_fn
+//)
+//{
+//}
+
+
+void  png_write_image
 (
    png_structp png_ptr,
    png_bytepp  image
@@ -1131,7 +3244,7 @@ void  png_read_image
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_read_image" ) );
+      dynamiclink::getFunction( library_g, "png_write_image" ) );
 
    return (function)(
       png_ptr,
@@ -1140,89 +3253,62 @@ void  png_read_image
 }
 
 
-void  png_read_end
+void  png_write_rows
 (
    png_structp png_ptr,
-   png_infop   info_ptr
+   png_bytepp  row,
+   png_uint_32 num_rows
 )
 {
    typedef void (*PFunction)(
       png_structp,
-      png_infop
+      png_bytepp,
+      png_uint_32
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_read_end" ) );
+      dynamiclink::getFunction( library_g, "png_write_rows" ) );
 
    return (function)(
       png_ptr,
-      info_ptr
+      row,
+      num_rows
    );
 }
 
 
-void  png_destroy_read_struct
+void  png_write_end
 (
-   png_structpp png_ptr_ptr,
-   png_infopp   info_ptr_ptr,
-   png_infopp   end_info_ptr_ptr
+   png_structp png_ptr,
+   png_infop   info_ptr
 )
 {
    typedef void (*PFunction)(
-      png_structpp,
-      png_infopp,
-      png_infopp
-   );
-
-   PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_destroy_read_struct" ) );
-
-   return (function)(
-      png_ptr_ptr,
-      info_ptr_ptr,
-      end_info_ptr_ptr
-   );
-}
-
-
-png_structp  png_create_write_struct
-(
-   png_const_charp user_png_ver,
-   png_voidp       error_ptr,
-   png_error_ptr   error_fn,
-   png_error_ptr   warn_fn
-)
-{
-   typedef png_structp (*PFunction)(
-      png_const_charp,
-      png_voidp,
-      png_error_ptr,
-      png_error_ptr
+      png_structp,
+      png_infop
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_create_write_struct" ) );
+      dynamiclink::getFunction( library_g, "png_write_end" ) );
 
    return (function)(
-      user_png_ver,
-      error_ptr,
-      error_fn,
-      warn_fn
+      png_ptr,
+      info_ptr
    );
 }
 
 
-png_infop  png_create_info_struct
+png_voidp  png_get_io_ptr
 (
    png_structp png_ptr
 )
 {
-   typedef png_infop (*PFunction)(
+   typedef png_voidp (*PFunction)(
       png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_create_info_struct" ) );
+      dynamiclink::getFunction( library_g, "png_get_io_ptr" ) );
 
    return (function)(
       png_ptr
@@ -1230,389 +3316,378 @@ png_infop  png_create_info_struct
 }
 
 
-void  png_set_write_fn
-(
-   png_structp   png_ptr,
-   png_voidp     io_ptr,
-   png_rw_ptr    write_data_fn,
-   png_flush_ptr output_flush_fn
-)
-{
-   typedef void (*PFunction)(
-      png_structp,
-      png_voidp,
-      png_rw_ptr,
-      png_flush_ptr
-   );
-
-   PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_write_fn" ) );
-
-   return (function)(
-      png_ptr,
-      io_ptr,
-      write_data_fn,
-      output_flush_fn
-   );
-}
-
-
-//void  png_set_write_status_fn
-//(
-// png_structp          png_ptr,
-// png_write_status_ptr write_row_fn
-//)
-//{
-//}
-
-
-void  png_set_filter
+png_voidp  png_get_error_ptr
 (
-   png_structp png_ptr,
-   int         method,
-   int         filters
+   png_structp png_ptr
 )
 {
-   typedef void (*PFunction)(
-      png_structp,
-      int,
-      int
+   typedef png_voidp (*PFunction)(
+      png_structp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_filter" ) );
+      dynamiclink::getFunction( library_g, "png_get_error_ptr" ) );
 
    return (function)(
-      png_ptr,
-      method,
-      filters
+      png_ptr
    );
 }
 
 
-void  png_set_compression_level
+void  png_destroy_write_struct
 (
-   png_structp png_ptr,
-   int         level
+   png_structpp png_ptr_ptr,
+   png_infopp   info_ptr_ptr
 )
 {
    typedef void (*PFunction)(
-      png_structp,
-      int
+      png_structpp,
+      png_infopp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_compression_level" ) );
+      dynamiclink::getFunction( library_g, "png_destroy_write_struct" ) );
 
    return (function)(
-      png_ptr,
-      level
+      png_ptr_ptr,
+      info_ptr_ptr
    );
 }
 
-
-void  png_set_IHDR
-(
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   png_uint_32 width,
-   png_uint_32 height,
-   int         bit_depth,
-   int         color_type,
-   int         interlace_method,
-   int         compression_method,
-   int         filter_method
+
+png_uint_32  png_get_PLTE
+(
+   png_structp png_ptr,
+   png_infop   info_ptr,
+   png_colorp* palette,
+   int*        num_palette
 )
 {
-   typedef void (*PFunction)(
+   typedef png_uint_32 (*PFunction)(
       png_structp,
       png_infop,
-      png_uint_32,
-      png_uint_32,
-      int,
-      int,
-      int,
-      int,
-      int
+      png_colorp*,
+      int*
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_IHDR" ) );
+      dynamiclink::getFunction( library_g, "png_get_PLTE" ) );
 
    return (function)(
       png_ptr,
       info_ptr,
-      width,
-      height,
-      bit_depth,
-      color_type,
-      interlace_method,
-      compression_method,
-      filter_method
+      palette,
+      num_palette
    );
 }
 
 
-void  png_set_cHRM
+png_uint_32  png_get_tRNS
 (
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   double      white_x,
-   double      white_y,
-   double      red_x,
-   double      red_y,
-   double      green_x,
-   double      green_y,
-   double      blue_x,
-   double      blue_y
+   png_structp    png_ptr,
+   png_infop      info_ptr,
+   png_bytep*     trans,
+   int*           num_trans,
+   png_color_16p* trans_values
 )
 {
-   typedef void (*PFunction)(
+   typedef png_uint_32 (*PFunction)(
       png_structp,
       png_infop,
-      double,
-      double,
-      double,
-      double,
-      double,
-      double,
-      double,
-      double
+      png_bytep*,
+      int*,
+      png_color_16p*
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_cHRM" ) );
+      dynamiclink::getFunction( library_g, "png_get_tRNS" ) );
 
    return (function)(
       png_ptr,
       info_ptr,
-      white_x,
-      white_y,
-      red_x,
-      red_y,
-      green_x,
-      green_y,
-      blue_x,
-      blue_y
+      trans,
+      num_trans,
+      trans_values
    );
 }
 
 
-void  png_set_gAMA
+void  png_set_PLTE
 (
    png_structp png_ptr,
    png_infop   info_ptr,
-   double      gamma
+   png_colorp  palette,
+   int         num_palette
 )
 {
    typedef void (*PFunction)(
       png_structp,
       png_infop,
-      double
+      png_colorp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_gAMA" ) );
+      dynamiclink::getFunction( library_g, "png_set_PLTE" ) );
 
    return (function)(
       png_ptr,
       info_ptr,
-      gamma
+      palette,
+      num_palette
    );
 }
 
 
-void  png_set_text
+void  png_set_tRNS
 (
-   png_structp png_ptr,
-   png_infop   info_ptr,
-   png_textp   text_ptr,
-   int         num_text
+   png_structp   png_ptr,
+   png_infop     info_ptr,
+   png_bytep     trans,
+   int           num_trans,
+   png_color_16p trans_values
 )
 {
    typedef void (*PFunction)(
       png_structp,
       png_infop,
-      png_textp,
-      int
+      png_bytep,
+      int,
+      png_color_16p
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_text" ) );
+      dynamiclink::getFunction( library_g, "png_set_tRNS" ) );
 
    return (function)(
       png_ptr,
       info_ptr,
-      text_ptr,
-      num_text
+      trans,
+      num_trans,
+      trans_values
    );
 }
 
 
-void  png_write_info
+
+/// zlib dynamic library forwarders --------------------------------------------
+
+int  deflateInit2_
 (
-   png_structp png_ptr,
-   png_infop   info_ptr
+   z_streamp   strm,
+   int         level,
+   int         method,
+   int         windowBits,
+   int         memLevel,
+   int         strategy,
+   const char* version,
+   int         stream_size
 )
 {
-   typedef void (*PFunction)(
-      png_structp,
-      png_infop
+   typedef int (*PFunction)(
+      z_streamp,
+      int,
+      int,
+      int,
+      int,
+      int,
+      const char*,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_write_info" ) );
+      dynamiclink::getFunction( zlib_g, "deflateInit2_" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr
+      strm,
+      level,
+      method,
+      windowBits,
+      memLevel,
+      strategy,
+      version,
+      stream_size
    );
 }
 
 
-void  png_set_bgr
+int  deflateSetDictionary
 (
-   png_structp png_ptr
+   z_streamp    strm,
+   const Bytef* dictionary,
+   uInt         dictLength
 )
 {
-   typedef void (*PFunction)(
-      png_structp
+   typedef int (*PFunction)(
+      z_streamp,
+      const Bytef*,
+      uInt
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_bgr" ) );
+      dynamiclink::getFunction( zlib_g, "deflateSetDictionary" ) );
 
    return (function)(
-      png_ptr
+      strm,
+      dictionary,
+      dictLength
    );
 }
 
 
-void  png_set_swap
+int  deflate
 (
-   png_structp png_ptr
+   z_streamp strm,
+   int       flush
 )
 {
-   typedef void (*PFunction)(
-      png_structp
+   typedef int (*PFunction)(
+      z_streamp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_set_swap" ) );
+      dynamiclink::getFunction( zlib_g, "deflate" ) );
 
    return (function)(
-      png_ptr
+      strm,
+      flush
    );
 }
 
 
-//void  png_set_write_user_transform_fn
-//(
-// png_structp            png_ptr,
-// png_user_transform_ptr write_user_transform_fn
-//)
-//{
-//}
+int  deflateEnd
+(
+   z_streamp strm
+)
+{
+   typedef int (*PFunction)(
+      z_streamp
+   );
 
+   PFunction function = reinterpret_cast<PFunction>(
+      dynamiclink::getFunction( zlib_g, "deflateEnd" ) );
 
-void  png_write_image
+   return (function)(
+      strm
+   );
+}
+
+
+uLong  adler32
 (
-   png_structp png_ptr,
-   png_bytepp  image
+   uLong        adler,
+   const Bytef* buf,
+   uInt         len
 )
 {
-   typedef void (*PFunction)(
-      png_structp,
-      png_bytepp
+   typedef uLong (*PFunction)(
+      uLong,
+      const Bytef*,
+      uInt
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_write_image" ) );
+      dynamiclink::getFunction( zlib_g, "adler32" ) );
 
    return (function)(
-      png_ptr,
-      image
+      adler,
+      buf,
+      len
    );
 }
 
 
-void  png_write_end
+uLong  adler32_combine
 (
-   png_structp png_ptr,
-   png_infop   info_ptr
+   uLong   adler1,
+   uLong   adler2,
+   z_off_t len2
 )
 {
-   typedef void (*PFunction)(
-      png_structp,
-      png_infop
+   typedef uLong (*PFunction)(
+      uLong,
+      uLong,
+      z_off_t
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_write_end" ) );
+      dynamiclink::getFunction( zlib_g, "adler32_combine" ) );
 
    return (function)(
-      png_ptr,
-      info_ptr
+      adler1,
+      adler2,
+      len2
    );
 }
 
 
-png_voidp  png_get_io_ptr
+#ifdef TESTING
+
+int  inflateInit_
 (
-   png_structp png_ptr
+   z_streamp   strm,
+   const char* version,
+   int         stream_size
 )
 {
-   typedef png_voidp (*PFunction)(
-      png_structp
+   typedef int (*PFunction)(
+      z_streamp,
+      const char*,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_io_ptr" ) );
+      dynamiclink::getFunction( zlib_g, "inflateInit_" ) );
 
    return (function)(
-      png_ptr
+      strm,
+      version,
+      stream_size
    );
 }
 
 
-png_voidp  png_get_error_ptr
+int  inflate
 (
-   png_structp png_ptr
+   z_streamp strm,
+   int       flush
 )
 {
-   typedef png_voidp (*PFunction)(
-      png_structp
+   typedef int (*PFunction)(
+      z_streamp,
+      int
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_get_error_ptr" ) );
+      dynamiclink::getFunction( zlib_g, "inflate" ) );
 
    return (function)(
-      png_ptr
+      strm,
+      flush
    );
 }
 
 
-void  png_destroy_write_struct
+int  inflateEnd
 (
-   png_structpp png_ptr_ptr,
-   png_infopp   info_ptr_ptr
+   z_streamp strm
 )
 {
-   typedef void (*PFunction)(
-      png_structpp,
-      png_infopp
+   typedef int (*PFunction)(
+      z_streamp
    );
 
    PFunction function = reinterpret_cast<PFunction>(
-      dynamiclink::getFunction( library_g, "png_destroy_write_struct" ) );
+      dynamiclink::getFunction( zlib_g, "inflateEnd" ) );
 
    return (function)(
-      png_ptr_ptr,
-      info_ptr_ptr
+      strm
    );
 }
 
+#endif//TESTING
+
 
 
 
@@ -1628,6 +3703,108 @@ void  png_destroy_write_struct
 #include <sstream>
 
 
+namespace
+{
+
+/**
+ * Collects a deflated stream.
+ */
+class TestDeflater
+   : public RowDeflater
+{
+public:
+   TestDeflater( dword                width,
+                 bool                 is48Bit,
+                 dword                orderingFlags,
+                 const png::Encoding& encoding )
+    : RowDeflater( width, is48Bit, orderingFlags, encoding )
+    , bytes_m    ()
+   {
+   }
+
+protected:
+   virtual void put( const ubyte* pBytes,
+                     dword        length )
+   {
+      bytes_m.insert( bytes_m.end(), pBytes, pBytes + length );
+   }
+
+public:
+   std::vector<ubyte> bytes_m;
+};
+
+
+/**
+ * Inflate and unfilter a stream, back to PNG-order rows.
+ */
+bool testInflate
+(
+   const std::vector<ubyte>& deflated,
+   const dword               rowBytes,
+   const dword               pixelBytes,
+   const dword               height,
+   std::vector<ubyte>&       rows
+)
+{
+   std::vector<ubyte> filtered( (rowBytes + 1) * height + 1 );
+
+   z_stream stream;
+   ::memset( &stream, 0, sizeof(stream) );
+   if( Z_OK != inflateInit( &stream ) )
+   {
+      return false;
+   }
+   stream.next_in   = const_cast<ubyte*>( &(deflated[0]) );
+   stream.avail_in  = static_cast<uInt>( deflated.size() );
+   stream.next_out  = &(filtered[0]);
+   stream.avail_out = static_cast<uInt>( filtered.size() );
+   const int result = ::inflate( &stream, Z_FINISH );
+   const bool isOk  = (Z_STREAM_END == result) && (0 == stream.avail_in) &&
+      (1 == stream.avail_out);
+   ::inflateEnd( &stream );
+
+   rows.assign( rowBytes * height, 0 );
+   const std::vector<ubyte> zeros( rowBytes, 0 );
+   for( dword r = 0;  isOk && (r < height);  ++r )
+   {
+      const ubyte* pIn    = &(filtered[r * (rowBytes + 1)]);
+      ubyte*       pRow   = &(rows[r * rowBytes]);
+      const ubyte* pPrior = r ? pRow - rowBytes : &(zeros[0]);
+      for( dword i = 0;  i < rowBytes;  ++i )
+      {
+         const dword a = (i >= pixelBytes) ? pRow[i - pixelBytes]   : 0;
+         const dword b = pPrior[i];
+         const dword c = (i >= pixelBytes) ? pPrior[i - pixelBytes] : 0;
+         dword predictor = 0;
+         switch( pIn[0] )
+         {
+            case 1 : predictor = a;  break;
+            case 2 : predictor = b;  break;
+            case 3 : predictor = (a + b) >> 1;  break;
+            case 4 :
+            {
+               const dword p  = a + b - c;
+               const dword pa = (p > a) ? p - a : a - p;
+               const dword pb = (p > b) ? p - b : b - p;
+               const dword pc = (p > c) ? p - c : c - p;
+               predictor = ((pa <= pb) & (pa <= pc)) ? a :
+                  ((pb <= pc) ? b : c);
+               break;
+            }
+            default : break;
+         }
+         pRow[i] = static_cast<ubyte>( pIn[1 + i] + predictor );
+      }
+   }
+
+   return isOk;
+}
+
+}
+
+
+
+
 namespace hxa7241_image
 {
 namespace png
@@ -1647,6 +3824,102 @@ bool test_png
    if( pOut ) *pOut << "[ test_png ]\n\n";
 
 
+   // parallel deflate
+   if( !loadZlib() )
+   {
+      if( pOut ) *pOut << "parallel deflate : (no zlib, not run)\n\n";
+   }
+   else
+   {
+      bool isFail = false;
+
+      // somewhat compressible pixels, several blocks high
+      const dword width  = 67;
+      const dword height = 1500;
+      std::vector<ubyte> pixels( width * height * 6 );
+      for( dword i = 0, r = 1;  i < dword(pixels.size());  ++i )
+      {
+         r = (r * 1103515245) + 12345;
+         pixels[i] = static_cast<ubyte>( ((i % 6) * 40) + ((i / 400) % 50) +
+            ((r >> 16) & 7) );
+      }
+
+      const udword threads = ParallelBands::getThreadCount();
+
+      // 8 and 16 bit, orderings, filters
+      for( dword c = 0;  c < 4 * 6;  ++c )
+      {
+         const bool  is48Bit    = 0 != (c & 1);
+         const dword flags      = (c & 2) ? (png::IS_BGR | png::IS_LO_ENDIAN) :
+            0;
+         const dword pixelBytes = is48Bit ? 6 : 3;
+         const dword rowBytes   = width * pixelBytes;
+         const Encoding encoding( 1 + (c % 9),
+            static_cast<EStrategy>((c / 2) % 4), static_cast<EFilter>(c / 4) );
+
+         std::vector<const void*> rowPtrs( height );
+         for( dword r = 0;  r < height;  ++r )
+         {
+            rowPtrs[r] = &(pixels[r * rowBytes]);
+         }
+
+         // one thread and several, all at once, and in uneven parts
+         ParallelBands::setThreadCount( 1 );
+         TestDeflater deflater1( width, is48Bit, flags, encoding );
+         deflater1.writeRows( height, &(rowPtrs[0]) );
+         deflater1.finish();
+
+         ParallelBands::setThreadCount( 4 );
+         TestDeflater deflater4( width, is48Bit, flags, encoding );
+         deflater4.writeRows( height, &(rowPtrs[0]) );
+         deflater4.finish();
+
+         TestDeflater deflaterParts( width, is48Bit, flags, encoding );
+         for( dword r = 0, n = 1;  r < height;  r += n, n = (n * 7) + 3 )
+         {
+            n = (height - r > n) ? n : height - r;
+            deflaterParts.writeRows( n, &(rowPtrs[r]) );
+         }
+         deflaterParts.finish();
+
+         // same stream for any threads, and both inflate back to the pixels
+         isFail |= deflater1.bytes_m != deflater4.bytes_m;
+
+         std::vector<ubyte> rows;
+         std::vector<ubyte> rowsParts;
+         isFail |= !testInflate( deflater4.bytes_m, rowBytes, pixelBytes,
+            height, rows );
+         isFail |= !testInflate( deflaterParts.bytes_m, rowBytes, pixelBytes,
+            height, rowsParts );
+         isFail |= rows != rowsParts;
+
+         for( dword i = 0;  !isFail && (i < rowBytes * height);  ++i )
+         {
+            const dword sample = (i % pixelBytes) / (pixelBytes / 3);
+            const dword source = (flags & png::IS_BGR) ? 2 - sample : sample;
+            const dword byte   = ((is48Bit & !(flags & png::IS_LO_ENDIAN)) ?
+               1 - (i & 1) : (i & 1)) & dword(is48Bit);
+            isFail |= rows[i] != pixels[(i - (i % pixelBytes)) +
+               (source * (pixelBytes / 3)) + byte];
+         }
+
+         if( pOut && isVerbose ) *pOut << (is48Bit ? 48 : 24) << "bit  " <<
+            flags << " flags  " << encoding.level << "_" <<
+            dword(encoding.strategy) << "_" << dword(encoding.filter) << "  " <<
+            deflater4.bytes_m.size() <<
+            " bytes  " << (isFail ? "*" : "") << "\n";
+      }
+
+      ParallelBands::setThreadCount( threads );
+
+      if( pOut && isVerbose ) *pOut << "\n";
+
+      if( pOut ) *pOut << "parallel deflate : " <<
+         (!isFail ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= !isFail;
+   }
+
+
    static const float SRGB_PRIMARIES[] =
    {
       // x      y
@@ -1936,6 +4209,58 @@ bool test_png
    }
 
 
+   // indexed write and read
+   {
+      // make palette (with some alphas), and 4 bit indices
+      const dword width  = 8;
+      const dword height = 4;
+
+      std::vector<ubyte> palette;
+      std::vector<ubyte> alphas;
+      for( dword i = 0;  i < 16;  ++i )
+      {
+         palette.push_back( ubyte(i * 17) );
+         palette.push_back( ubyte(255 - (i * 17)) );
+         palette.push_back( ubyte(i * 5) );
+      }
+      alphas.push_back( 0 );
+      alphas.push_back( 128 );
+
+      ubyte indices[ width * height ];
+      for( dword i = width * height;  i-- > 0; )
+      {
+         indices[i] = ubyte((i * 7) & 0x0F);
+      }
+
+      // stream out, then back in
+      std::ostringstream outI( std::ostringstream::binary );
+      hxa7241_image::png::writeIndexed( LIB_FILE, width, height,
+         SRGB_PRIMARIES, 1.0f, 4, palette, alphas, 0, indices, outI );
+
+      std::istringstream inI( outI.str(), std::istringstream::binary );
+      float primaries[8];
+      float gamma    = 0.0f;
+      dword widthI   = 0;
+      dword heightI  = 0;
+      dword bitDepth = 0;
+      std::vector<ubyte> paletteI;
+      std::vector<ubyte> alphasI;
+      std::vector<ubyte> indicesI;
+      const bool isIndexed = hxa7241_image::png::readIndexed( LIB_FILE, inI, 0,
+         primaries, gamma, widthI, heightI, bitDepth, paletteI, alphasI,
+         indicesI );
+
+      bool isFail = !isIndexed || (width != widthI) || (height != heightI) ||
+         (4 != bitDepth) || (palette != paletteI) || (alphas != alphasI) ||
+         (std::vector<ubyte>( indices, indices + (width * height) ) !=
+            indicesI);
+
+      if( pOut ) *pOut << "indexed write/read : " <<
+         (!isFail ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= !isFail;
+   }
+
+
    if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
       " completed " << "\n\n\n";
 
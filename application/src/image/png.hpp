@@ -13,6 +13,7 @@
 
 
 #include <iosfwd>
+#include <vector>
 
 
 
@@ -29,6 +30,7 @@ namespace hxa7241_image
  *
  * Supports these features:
  * * RGB
+ * * palette, kept indexed (read and written separately)
  * * 24 or 48 bit pixels
  * * can include primaries and gamma
  * * allows byte, channel, and row re-ordering
@@ -37,6 +39,11 @@ namespace hxa7241_image
  * This implementation requires the libpng and zlib dynamic libraries when run.
  * (from, for example, libpng-1.2.8-bin and libpng-1.2.8-dep archives)<br/><br/>
  *
+ * Bigger RGB images (over 128KB), with more than one thread, are written with
+ * zlib directly when it can be loaded (zlib1.dll or libz.so.1): rows are
+ * deflated in blocks in parallel, joined into one stream. Otherwise libpng
+ * deflates them, serially.<br/><br/>
+ *
  * <cite>http://www.libpng.org/</cite>
  */
 namespace png
@@ -48,6 +55,49 @@ namespace png
       IS_LO_ENDIAN = 4
    };
 
+   /**
+    * zlib strategy to write with (values as zlib's).
+    */
+   enum EStrategy
+   {
+      DEFAULT_STRATEGY  = 0,
+      FILTERED_STRATEGY = 1,
+      HUFFMAN_STRATEGY  = 2,
+      RLE_STRATEGY      = 3
+   };
+
+   /**
+    * Row filter to write with (values as PNG's, and adaptive: each row the
+    * best of all, by libpng's measure).
+    */
+   enum EFilter
+   {
+      NO_FILTER       = 0,
+      SUB_FILTER      = 1,
+      UP_FILTER       = 2,
+      AVERAGE_FILTER  = 3,
+      PAETH_FILTER    = 4,
+      ADAPTIVE_FILTER = 5
+   };
+
+   /**
+    * Encoding to write with.<br/><br/>
+    *
+    * The default ('small') is level 9, adaptive filter. 'fast' -- level 1, no
+    * filter -- writes much faster, but bigger.
+    */
+   struct Encoding
+   {
+      Encoding( dword     level    = 9,
+                EStrategy strategy = DEFAULT_STRATEGY,
+                EFilter   filter   = ADAPTIVE_FILTER );
+
+      /// zlib level: 0 (none) to 9 (smallest)
+      dword     level;
+      EStrategy strategy;
+      EFilter   filter;
+   };
+
 
    /**
     * Report whether the stream is a PNG file.
@@ -69,7 +119,8 @@ namespace png
     *                       { rx, ry, gx, gy, bx, by, wx, wy }
     * @o_is48Bit            true for 48 bit triples, false for 24
     * @o_pTriples           array of byte triples, or word triples if is48Bit is
-    *                       true. orphaned storage
+    *                       true. orphaned storage (free with
+    *                       scratch::release)
     *
     * @exceptions throws allocation and char[] message exceptions
     */
@@ -102,20 +153,143 @@ namespace png
     * @i_orderingFlags      bit combination of EOrderingFlags values
     * @i_pTriples           array of byte triples, or word triples if is48Bit is
     *                       true
+    * @i_encoding           zlib level and strategy, and row filter
     *
-    * @exceptions throws char[] message exceptions
+    * @exceptions throws allocation and char[] message exceptions
     */
    void write
    (
-      const char   i_pngLibraryPathName[],
-      dword        i_width,
-      dword        i_height,
-      const float* i_pPrimaries8,
-      float        i_gamma,
-      bool         i_is48Bit,
-      dword        i_orderingFlags,
-      const void*  i_pTriples,
-      ostream&     o_outBytes
+      const char      i_pngLibraryPathName[],
+      dword           i_width,
+      dword           i_height,
+      const float*    i_pPrimaries8,
+      float           i_gamma,
+      bool            i_is48Bit,
+      dword           i_orderingFlags,
+      const void*     i_pTriples,
+      ostream&        o_outBytes,
+      const Encoding& i_encoding = Encoding()
+   );
+
+
+   /**
+    * Read PNG palette image, keeping it indexed.<br/><br/>
+    *
+    * Other images are left unread, and nothing is set.
+    *
+    * @i_pngLibraryPathName if path not included then a standard system search
+    *                       strategy is used.
+    * @i_orderingFlags      bit combination of EOrderingFlags values
+    *                       (only IS_TOP_FIRST applies)
+    * @o_pPrimaries8        chromaticities of RGB and white:
+    *                       { rx, ry, gx, gy, bx, by, wx, wy }
+    * @o_bitDepth           bits per index in file: 1, 2, 4, or 8
+    * @o_palette            byte triples, R then G then B, one per entry
+    * @o_alphas             alpha byte for each of the first entries, may be
+    *                       fewer than the palette (the rest are opaque)
+    * @o_indices            byte index per pixel
+    *
+    * @return  true if a palette image, and read
+    *
+    * @exceptions throws allocation and char[] message exceptions
+    */
+   bool readIndexed
+   (
+      const char          i_pngLibraryPathName[],
+      istream&            i_inBytes,
+      dword               i_orderingFlags,
+      float*              o_pPrimaries8,
+      float&              o_gamma,
+      dword&              o_width,
+      dword&              o_height,
+      dword&              o_bitDepth,
+      std::vector<ubyte>& o_palette,
+      std::vector<ubyte>& o_alphas,
+      std::vector<ubyte>& o_indices
+   );
+
+
+   /**
+    * Write PNG palette image.<br/><br/>
+    *
+    * Parameters as readIndexed, and write. Indices must fit in i_bitDepth.
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   void writeIndexed
+   (
+      const char                i_pngLibraryPathName[],
+      dword                     i_width,
+      dword                     i_height,
+      const float*              i_pPrimaries8,
+      float                     i_gamma,
+      dword                     i_bitDepth,
+      const std::vector<ubyte>& i_palette,
+      const std::vector<ubyte>& i_alphas,
+      dword                     i_orderingFlags,
+      const ubyte*              i_pIndices,
+      ostream&                  o_outBytes
+   );
+
+
+   /**
+    * Open PNG image file to read a strip of rows at a time.<br/><br/>
+    *
+    * Rows top first, pixels as read (see ScanlineReader). Palette and
+    * interlaced images are left unread (read palette images kept indexed,
+    * interlaced ones whole).
+    *
+    * @return  reader (orphaned -- delete it), or 0 if a palette or interlaced
+    *          image
+    *
+    * @exceptions throws allocation and char[] message exceptions
+    */
+   ScanlineReader* openReader
+   (
+      const char i_pngLibraryPathName[],
+      const char i_pathName[],
+      float*     o_pPrimaries8,
+      float&     o_gamma,
+      dword&     o_width,
+      dword&     o_height,
+      bool&      o_is48Bit
+   );
+
+
+   /**
+    * Open PNG image file to write a strip of rows at a time.<br/><br/>
+    *
+    * Rows top first, pixels as write (see ScanlineWriter).
+    *
+    * @return  writer (orphaned -- delete it)
+    *
+    * @exceptions throws allocation and char[] message exceptions
+    */
+   ScanlineWriter* openWriter
+   (
+      const char      i_pngLibraryPathName[],
+      dword           i_width,
+      dword           i_height,
+      const float*    i_pPrimaries8,
+      float           i_gamma,
+      bool            i_is48Bit,
+      const char      o_pathName[],
+      const Encoding& i_encoding = Encoding()
+   );
+
+
+   /**
+    * Find an encoding by name (any case): fast, small, or
+    * level_strategy_filter -- a level 0 to 9, a strategy of default filtered
+    * huffman rle, and a filter of none sub up average paeth adaptive
+    * (eg: 6_rle_up).
+    *
+    * @return  false if unrecognised
+    */
+   bool findEncoding
+   (
+      const char i_name[],
+      Encoding&  o_encoding
    );
 }
 
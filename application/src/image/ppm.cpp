@@ -8,18 +8,28 @@
 ------------------------------------------------------------------------------*/
 
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
 #include <istream>
 #include <ostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "ScratchMemory.hpp"
+#include "MappedFile.hpp"
 #include "PixelsPtr.hpp"
 #include "StreamExceptionSet.hpp"
+#include "ScanlineCodec.hpp"
 
 #include "ppm.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -101,6 +111,42 @@ void checkDimensions
    const char* pMessage
 );
 
+bool parseHeader
+(
+   const ubyte* pBytes,
+   qword        size,
+   dword&       width,
+   dword&       height,
+   dword&       maxval,
+   qword&       headerSize
+);
+
+std::string makeHeader
+(
+   const char* pComment,
+   dword       width,
+   dword       height,
+   dword       maxval
+);
+
+void unpackRow
+(
+   const ubyte* pFrom,
+   dword        width,
+   bool         is48Bit,
+   bool         isBgr,
+   void*        pTo
+);
+
+void packRow
+(
+   const void* pFrom,
+   dword       width,
+   bool        is48Bit,
+   bool        isBgr,
+   ubyte*      pTo
+);
+
 }
 
 
@@ -206,44 +252,25 @@ void hxa7241_image::ppm::read
       checkDimensions( width, height, maxval, IN_DIMENSIONS_EXCEPTION_MESSAGE );
 
       // allocate storage
-      PixelsPtr pTriples( (maxval >= 256), (width * height * 3) );
+      PixelsPtr pTriples( (maxval >= 256), static_cast<qword>(width) * height *
+         3 );
 
-      // read rows (top first)
+      // read rows (top first), a whole row at a time
+      const dword sampleBytes = pTriples.is48Bit() ? 2 : 1;
+      std::vector<char> rowBytes( static_cast<size_t>(width) * 3 *
+         sampleBytes );
       for( dword y = 0;  y < height;  ++y )
       {
-         // read pixels (left first)
-         for( dword x = 0;  x < width;  ++x )
-         {
-            const dword row    = (i_orderingFlags & IS_TOP_FIRST) ?
-               y : height - 1 - y;
-            const dword offset = ((row * width) + x) * 3;
-
-            // read channels (R then G then B)
-            for( dword c = 0;  c < 3;  ++c )
-            {
-               const dword i = (i_orderingFlags & IS_BGR) ? 2 - c : c;
+         const dword row = (i_orderingFlags & IS_TOP_FIRST) ? y :
+            height - 1 - y;
 
-               // read value
-               // 24 bit
-               if( !pTriples.is48Bit() )
-               {
-                  char* pTriple = static_cast<char*>(pTriples.get()) + offset;
-
-                  i_in.read( pTriple + i, 1 );
-               }
-               // 48 bit
-               else
-               {
-                  uword* pTriple = static_cast<uword*>(pTriples.get()) + offset;
+         i_in.read( &(rowBytes[0]), static_cast<std::streamsize>(
+            rowBytes.size()) );
 
-                  // most significant byte first
-                  char b[2];
-                  i_in.read( b, 2 );
-                  pTriple[i] = static_cast<uword>( (static_cast<ubyte>(b[0]) <<
-                     8) | static_cast<ubyte>(b[1]) );
-               }
-            }
-         }
+         unpackRow( reinterpret_cast<const ubyte*>(&(rowBytes[0])), width,
+            pTriples.is48Bit(), (0 != (i_orderingFlags & IS_BGR)),
+            static_cast<ubyte*>(pTriples.get()) + (static_cast<qword>(row) *
+            width * 3 * sampleBytes) );
       }
 
       // set outputs (now that no exceptions can happen)
@@ -288,68 +315,445 @@ void hxa7241_image::ppm::write
    try
    {
       // write header
+      const std::string header( makeHeader( i_pComment, i_width, i_height,
+         i_quantMax ) );
+      o_out.write( header.data(), static_cast<std::streamsize>(
+         header.length()) );
+
+      // write rows (top first), a whole row at a time
+      const bool  is48Bit     = (i_quantMax > 255);
+      const dword sampleBytes = is48Bit ? 2 : 1;
+      std::vector<char> rowBytes( static_cast<size_t>(i_width) * 3 *
+         sampleBytes );
+      for( dword y = i_height;  y-- > 0; )
       {
-         // ID
-         o_out << PPM_ID << '\n';
-
-         // comment
-         if( i_pComment )
-         {
-            // max length and truncate at first newline
-            const std::string comment( std::string(i_pComment).substr(0, 128) );
-            const udword pn = comment.find_first_of( "\n\r" );
+         const dword row = (i_orderingFlags & IS_TOP_FIRST) ?
+            i_height - 1 - y : y;
 
-            o_out << "# " << comment.substr( 0, pn ) << '\n';
-         }
+         packRow( static_cast<const ubyte*>(i_pTriples) +
+            (static_cast<qword>(row) * i_width * 3 * sampleBytes), i_width,
+            is48Bit, (0 != (i_orderingFlags & IS_BGR)),
+            reinterpret_cast<ubyte*>(&(rowBytes[0])) );
 
-         // width, height, maxval
-         o_out << i_width <<  ' ' << i_height << '\n';
-         o_out << i_quantMax << '\n';
+         o_out.write( &(rowBytes[0]), static_cast<std::streamsize>(
+            rowBytes.size()) );
       }
+   }
+   // translate exceptions
+   catch( const std::ios_base::failure& )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
 
-      // write rows (top first)
-      for( dword y = i_height;  y-- > 0; )
-      {
-         // write pixels (left first)
-         for( dword x = 0;  x < i_width;  ++x )
-         {
-            const dword row    = (i_orderingFlags & IS_TOP_FIRST) ?
-               i_height - 1 - y : y;
-            const dword offset = ((row * i_width) + x) * 3;
 
-            // write channels (R then G then B)
-            for( dword c = 0;  c < 3;  ++c )
-            {
-               const dword i = (i_orderingFlags & IS_BGR) ? 2 - c : c;
 
-               // write value
-               // 24 bit
-               if( i_quantMax <= 255 )
-               {
-                  const ubyte* pTriple =
-                     static_cast<const ubyte*>(i_pTriples) + offset;
+bool hxa7241_image::ppm::readFile
+(
+   const char  i_pathName[],
+   const dword i_orderingFlags,
+   dword&      o_width,
+   dword&      o_height,
+   dword&      o_quantMax,
+   void*&      o_pTriples
+)
+{
+   MappedFile file;
+   if( !file.openRead( i_pathName ) )
+   {
+      return false;
+   }
 
-                  o_out << pTriple[i];
-               }
-               // 48 bit
-               else
-               {
-                  const uword* pTriple =
-                     static_cast<const uword*>(i_pTriples) + offset;
+   // read header
+   dword width      = 0;
+   dword height     = 0;
+   dword maxval     = 0;
+   qword headerSize = 0;
+   if( !parseHeader( file.getBytes(), file.getSize(), width, height, maxval,
+      headerSize ) )
+   {
+      throw IN_FORMAT_EXCEPTION_MESSAGE;
+   }
 
-                  // most significant byte first
-                  o_out << static_cast<ubyte>((pTriple[i] & 0xFF00) >> 8);
-                  o_out << static_cast<ubyte>( pTriple[i] & 0xFF);
-               }
-            }
-         }
+   // check validity, and that all pixels are there
+   checkDimensions( width, height, maxval, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+   const dword sampleBytes = (maxval >= 256) ? 2 : 1;
+   const qword rowLength   = static_cast<qword>(width) * 3 * sampleBytes;
+   if( (file.getSize() - headerSize) / rowLength < height )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // allocate storage
+   PixelsPtr pTriples( (maxval >= 256), static_cast<qword>(width) * height *
+      3 );
+
+   // copy rows (top first) straight from the file bytes
+   const ubyte* pRows = file.getBytes() + headerSize;
+   for( dword y = 0;  y < height;  ++y )
+   {
+      const dword row = (i_orderingFlags & IS_TOP_FIRST) ? y : height - 1 - y;
+
+      unpackRow( pRows + (static_cast<qword>(y) * rowLength), width,
+         pTriples.is48Bit(), (0 != (i_orderingFlags & IS_BGR)),
+         static_cast<ubyte*>(pTriples.get()) + (static_cast<qword>(row) *
+         rowLength) );
+   }
+
+   // set outputs (now that no exceptions can happen)
+   o_width    = width;
+   o_height   = height;
+   o_quantMax = maxval;
+   o_pTriples = pTriples.release();
+
+   return true;
+}
+
+
+
+
+bool hxa7241_image::ppm::writeFile
+(
+   const char* i_pComment,
+   const dword i_width,
+   const dword i_height,
+   const dword i_quantMax,
+   const dword i_orderingFlags,
+   const void* i_pTriples,
+   const char  o_pathName[]
+)
+{
+   // check preconditions
+   checkDimensions( i_width, i_height, i_quantMax,
+      OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+   if( !i_pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   // make file at its whole size
+   const std::string header( makeHeader( i_pComment, i_width, i_height,
+      i_quantMax ) );
+   const bool  is48Bit   = (i_quantMax > 255);
+   const qword rowLength = static_cast<qword>(i_width) * 3 * (is48Bit ? 2 : 1);
+
+   MappedFile file;
+   if( !file.openWrite( o_pathName, static_cast<qword>(header.length()) +
+      (rowLength * i_height) ) )
+   {
+      return false;
+   }
+
+   // write header, then rows (top first) straight into the file bytes
+   ::memcpy( file.getBytes(), header.data(), header.length() );
+
+   ubyte* pRows = file.getBytes() + header.length();
+   for( dword y = 0;  y < i_height;  ++y )
+   {
+      const dword row = (i_orderingFlags & IS_TOP_FIRST) ? y :
+         i_height - 1 - y;
+
+      packRow( static_cast<const ubyte*>(i_pTriples) +
+         (static_cast<qword>(row) * rowLength), i_width, is48Bit,
+         (0 != (i_orderingFlags & IS_BGR)), pRows +
+         (static_cast<qword>(y) * rowLength) );
+   }
+
+   return true;
+}
+
+
+
+
+/// scanlines ------------------------------------------------------------------
+namespace
+{
+
+/**
+ * Rows read straight from a mapped file, top first.
+ */
+class RowReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowReader();
+
+/// commands -------------------------------------------------------------------
+           bool open( const char pathName[],
+                      dword&     width,
+                      dword&     height,
+                      dword&     maxval );
+
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   MappedFile file_m;
+   dword      width_m;
+   dword      height_m;
+   bool       is48Bit_m;
+   qword      headerSize_m;
+   dword      next_m;
+};
+
+
+RowReader::RowReader()
+ : file_m      ()
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , is48Bit_m   ( false )
+ , headerSize_m( 0 )
+ , next_m      ( 0 )
+{
+}
+
+
+bool RowReader::open
+(
+   const char pathName[],
+   dword&     width,
+   dword&     height,
+   dword&     maxval
+)
+{
+   if( !file_m.openRead( pathName ) )
+   {
+      return false;
+   }
+
+   // read header
+   if( !parseHeader( file_m.getBytes(), file_m.getSize(), width, height,
+      maxval, headerSize_m ) )
+   {
+      throw IN_FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   // check validity, and that all pixels are there
+   checkDimensions( width, height, maxval, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+   const qword rowLength = static_cast<qword>(width) * 3 *
+      ((maxval >= 256) ? 2 : 1);
+   if( (file_m.getSize() - headerSize_m) / rowLength < height )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   width_m   = width;
+   height_m  = height;
+   is48Bit_m = (maxval >= 256);
+
+   return true;
+}
+
+
+void RowReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw IN_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   const qword rowLength = static_cast<qword>(width_m) * 3 *
+      (is48Bit_m ? 2 : 1);
+   const ubyte* pRows = file_m.getBytes() + headerSize_m +
+      (static_cast<qword>(next_m) * rowLength);
+
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      unpackRow( pRows + (static_cast<qword>(r) * rowLength), width_m,
+         is48Bit_m, false, static_cast<ubyte*>(pTriples) +
+         (static_cast<qword>(r) * rowLength) );
+   }
+
+   next_m += rows;
+}
+
+
+/**
+ * Rows written straight into a mapped file, top first.
+ */
+class RowWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowWriter();
+
+/// commands -------------------------------------------------------------------
+           bool open( const char* pComment,
+                      dword       width,
+                      dword       height,
+                      dword       maxval,
+                      const char  pathName[] );
+
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   MappedFile file_m;
+   dword      width_m;
+   dword      height_m;
+   bool       is48Bit_m;
+   qword      headerSize_m;
+   dword      next_m;
+};
+
+
+RowWriter::RowWriter()
+ : file_m      ()
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , is48Bit_m   ( false )
+ , headerSize_m( 0 )
+ , next_m      ( 0 )
+{
+}
+
+
+bool RowWriter::open
+(
+   const char* pComment,
+   const dword width,
+   const dword height,
+   const dword maxval,
+   const char  pathName[]
+)
+{
+   checkDimensions( width, height, maxval, OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   // replace an existing (regular) file, instead of truncating it: it might
+   // be mapped, being read
+   struct stat status;
+   if( (0 == ::stat( pathName, &status )) &&
+      (S_IFREG == (status.st_mode & S_IFMT)) )
+   {
+      ::remove( pathName );
+   }
+
+   // make file at its whole size, and write header
+   const std::string header( makeHeader( pComment, width, height, maxval ) );
+   const qword rowLength = static_cast<qword>(width) * 3 *
+      ((maxval > 255) ? 2 : 1);
+   if( !file_m.openWrite( pathName, static_cast<qword>(header.length()) +
+      (rowLength * height) ) )
+   {
+      return false;
+   }
+   ::memcpy( file_m.getBytes(), header.data(), header.length() );
+
+   width_m      = width;
+   height_m     = height;
+   is48Bit_m    = (maxval > 255);
+   headerSize_m = header.length();
+
+   return true;
+}
+
+
+void RowWriter::writeRows
+(
+   const dword rows,
+   const void* pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+   if( !pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   const qword rowLength = static_cast<qword>(width_m) * 3 *
+      (is48Bit_m ? 2 : 1);
+   ubyte* pRows = file_m.getBytes() + headerSize_m +
+      (static_cast<qword>(next_m) * rowLength);
+
+   for( dword r = 0;  r < rows;  ++r )
+   {
+      packRow( static_cast<const ubyte*>(pTriples) +
+         (static_cast<qword>(r) * rowLength), width_m, is48Bit_m, false,
+         pRows + (static_cast<qword>(r) * rowLength) );
+   }
+
+   next_m += rows;
+}
+
+
+void RowWriter::finish()
+{
+   if( next_m != height_m )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   file_m.close();
+}
+
+}
+
+
+ScanlineReader* hxa7241_image::ppm::openReader
+(
+   const char i_pathName[],
+   dword&     o_width,
+   dword&     o_height,
+   dword&     o_quantMax
+)
+{
+   RowReader* pReader = new RowReader;
+   try
+   {
+      if( !pReader->open( i_pathName, o_width, o_height, o_quantMax ) )
+      {
+         delete pReader;
+         pReader = 0;
       }
    }
-   // translate exceptions
-   catch( const std::ios_base::failure& )
+   catch( ... )
    {
-      throw OUT_STREAM_EXCEPTION_MESSAGE;
+      delete pReader;
+      throw;
+   }
+
+   return pReader;
+}
+
+
+ScanlineWriter* hxa7241_image::ppm::openWriter
+(
+   const char* i_pComment,
+   const dword i_width,
+   const dword i_height,
+   const dword i_quantMax,
+   const char  o_pathName[]
+)
+{
+   RowWriter* pWriter = new RowWriter;
+   try
+   {
+      if( !pWriter->open( i_pComment, i_width, i_height, i_quantMax,
+         o_pathName ) )
+      {
+         delete pWriter;
+         pWriter = 0;
+      }
+   }
+   catch( ... )
+   {
+      delete pWriter;
+      throw;
    }
+
+   return pWriter;
 }
 
 
@@ -367,13 +771,209 @@ void checkDimensions
    const char* pMessage
 )
 {
-   if( (maxval < 1) || (maxval > 65535) || (width <= 0) || (height <= 0) ||
-      (height > (DWORD_MAX / 3)) || (width > (DWORD_MAX / (height * 3))) )
+   // (lengths are 64-bit, so any positive dimensions fit)
+   if( (maxval < 1) || (maxval > 65535) || (width <= 0) || (height <= 0) )
    {
       throw pMessage;
    }
 }
 
+
+/**
+ * Parse header in memory, as read does from a stream.
+ *
+ * @headerSize  bytes up to the pixels
+ * @return      false if not a PPM, or cut short
+ */
+bool parseHeader
+(
+   const ubyte* pBytes,
+   const qword  size,
+   dword&       width,
+   dword&       height,
+   dword&       maxval,
+   qword&       headerSize
+)
+{
+   // id
+   if( (size < 2) || (PPM_ID[0] != pBytes[0]) || (PPM_ID[1] != pBytes[1]) )
+   {
+      return false;
+   }
+
+   // width, height, maxval
+   qword pos = 2;
+   dword ints[3];
+   for( dword i = 0;  i < 3;  ++i )
+   {
+      // skip blanks and comments (to after newline)
+      for( ;; )
+      {
+         while( (pos < size) && ::isspace( pBytes[pos] ) )
+         {
+            ++pos;
+         }
+         if( (pos >= size) || ('#' != pBytes[pos]) )
+         {
+            break;
+         }
+         while( (pos < size) && ('\n' != pBytes[pos++]) )
+         {
+         }
+      }
+
+      // next token (non-blank chunk), as integer
+      const qword start = pos;
+      while( (pos < size) && !::isspace( pBytes[pos] ) )
+      {
+         ++pos;
+      }
+      if( start == pos )
+      {
+         return false;
+      }
+      const std::string token( reinterpret_cast<const char*>(pBytes + start),
+         static_cast<size_t>(pos - start) );
+      ints[i] = ::atoi( token.c_str() );
+   }
+
+   // single blank
+   if( pos >= size )
+   {
+      return false;
+   }
+
+   width      = ints[0];
+   height     = ints[1];
+   maxval     = ints[2];
+   headerSize = pos + 1;
+
+   return true;
+}
+
+
+std::string makeHeader
+(
+   const char* pComment,
+   const dword width,
+   const dword height,
+   const dword maxval
+)
+{
+   std::ostringstream header;
+
+   // ID
+   header << PPM_ID << '\n';
+
+   // comment
+   if( pComment )
+   {
+      // max length and truncate at first newline
+      const std::string comment( std::string(pComment).substr(0, 128) );
+      const udword pn = comment.find_first_of( "\n\r" );
+
+      header << "# " << comment.substr( 0, pn ) << '\n';
+   }
+
+   // width, height, maxval
+   header << width <<  ' ' << height << '\n';
+   header << maxval << '\n';
+
+   return header.str();
+}
+
+
+void unpackRow
+(
+   const ubyte* pFrom,
+   const dword  width,
+   const bool   is48Bit,
+   const bool   isBgr,
+   void*        pTo
+)
+{
+   const size_t length = static_cast<size_t>(width) * 3;
+
+   // 24 bit: straight copy
+   if( !is48Bit )
+   {
+      ubyte* pBytes = static_cast<ubyte*>(pTo);
+      ::memcpy( pBytes, pFrom, length );
+
+      if( isBgr )
+      {
+         for( size_t i = 0;  i < length;  i += 3 )
+         {
+            const ubyte r = pBytes[i];
+            pBytes[i]     = pBytes[i + 2];
+            pBytes[i + 2] = r;
+         }
+      }
+   }
+   // 48 bit: most significant byte first
+   // (a plain loop, with no dependencies, so the compiler vectorizes it)
+   else
+   {
+      uword* pWords = static_cast<uword*>(pTo);
+      for( size_t i = 0;  i < length;  ++i )
+      {
+         pWords[i] = static_cast<uword>( (pFrom[i * 2] << 8) |
+            pFrom[(i * 2) + 1] );
+      }
+
+      if( isBgr )
+      {
+         for( size_t i = 0;  i < length;  i += 3 )
+         {
+            const uword r = pWords[i];
+            pWords[i]     = pWords[i + 2];
+            pWords[i + 2] = r;
+         }
+      }
+   }
+}
+
+
+void packRow
+(
+   const void* pFrom,
+   const dword width,
+   const bool  is48Bit,
+   const bool  isBgr,
+   ubyte*      pTo
+)
+{
+   const size_t length = static_cast<size_t>(width) * 3;
+
+   // 24 bit: straight copy
+   if( !is48Bit )
+   {
+      ::memcpy( pTo, pFrom, length );
+
+      if( isBgr )
+      {
+         for( size_t i = 0;  i < length;  i += 3 )
+         {
+            const ubyte r = pTo[i];
+            pTo[i]     = pTo[i + 2];
+            pTo[i + 2] = r;
+         }
+      }
+   }
+   // 48 bit: most significant byte first
+   else
+   {
+      const uword* pWords = static_cast<const uword*>(pFrom);
+      for( size_t i = 0;  i < length;  ++i )
+      {
+         const size_t j = isBgr ? (i - (i % 3)) + (2 - (i % 3)) : i;
+
+         pTo[i * 2]       = static_cast<ubyte>(pWords[j] >> 8);
+         pTo[(i * 2) + 1] = static_cast<ubyte>(pWords[j]);
+      }
+   }
+}
+
 }
 
 
@@ -387,8 +987,10 @@ void checkDimensions
 #ifdef TESTING
 
 
+#include <stdio.h>
 #include <fstream>
 #include <sstream>
+#include <iterator>
 
 
 namespace hxa7241_image
@@ -425,29 +1027,26 @@ namespace ppm
       const dword   seed
    );
 
-   void writeImageFiles
+   bool test_file
    (
       std::ostream* pOut,
       const bool    isVerbose,
       const dword   seed
    );
 
+   bool test_scanlines
+   (
+      std::ostream* pOut,
+      const bool    isVerbose,
+      const dword   seed
+   );
 
-void deleteTriples
-(
-   const bool is48Bit,
-   void*      pTriples
-)
-{
-   if( !is48Bit )
-   {
-      delete[] static_cast<ubyte*>(pTriples);
-   }
-   else
-   {
-      delete[] static_cast<uword*>(pTriples);
-   }
-}
+   void writeImageFiles
+   (
+      std::ostream* pOut,
+      const bool    isVerbose,
+      const dword   seed
+   );
 
 
 bool test_ppm
@@ -468,6 +1067,9 @@ bool test_ppm
    isOk &= test_write24Bit( pOut, isVerbose, seed );
    isOk &= test_write48Bit( pOut, isVerbose, seed );
 
+   isOk &= test_file( pOut, isVerbose, seed );
+   isOk &= test_scanlines( pOut, isVerbose, seed );
+
    //writeImageFiles( pOut, isVerbose, seed );
 
 
@@ -551,11 +1153,11 @@ bool test_read24Bit
          if( pOut && isVerbose ) *pOut << "\n";
       }
 
-      deleteTriples( quantMax >= 256, pTriples );
+      scratch::release( pTriples );
    }
    catch( ... )
    {
-      deleteTriples( quantMax >= 256, pTriples );
+      scratch::release( pTriples );
       throw;
    }
 
@@ -638,11 +1240,11 @@ bool test_read48Bit
          if( pOut && isVerbose ) *pOut << "\n";
       }
 
-      deleteTriples( quantMax >= 256, pTriples );
+      scratch::release( pTriples );
    }
    catch( ... )
    {
-      deleteTriples( quantMax >= 256, pTriples );
+      scratch::release( pTriples );
       throw;
    }
 
@@ -795,6 +1397,247 @@ bool test_write48Bit
 }
 
 
+bool test_file
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   const char  FILE_NAME[] = "zzztestmapped.ppm";
+   const dword WIDTH       = 37;
+   const dword HEIGHT      = 11;
+
+   udword random = seed ? seed : 521288629u;
+
+   // mapped write matches streamed write, and mapped and streamed read match
+   // what was written -- for each depth and ordering
+   for( dword k = 0;  k < 8;  ++k )
+   {
+      const bool  is48Bit  = (0 != (k & 4));
+      const dword flags    = k & (IS_TOP_FIRST | IS_BGR);
+      const dword quantMax = is48Bit ? 65535 : 255;
+      const dword length   = WIDTH * HEIGHT * 3;
+
+      std::vector<uword> words( length );
+      std::vector<ubyte> bytes( length );
+      for( dword i = 0;  i < length;  ++i )
+      {
+         random = 18000u * (random & 0xFFFFu) + (random >> 16);
+         words[i] = static_cast<uword>(random);
+         bytes[i] = static_cast<ubyte>(random >> 8);
+      }
+      const void* pTriples = is48Bit ? static_cast<const void*>(&(words[0])) :
+         static_cast<const void*>(&(bytes[0]));
+
+      std::ostringstream streamed( std::ostringstream::binary );
+      write( "mapped", WIDTH, HEIGHT, quantMax, flags, pTriples, streamed );
+
+      bool isOk_ = writeFile( "mapped", WIDTH, HEIGHT, quantMax, flags,
+         pTriples, FILE_NAME );
+      {
+         std::ifstream inf( FILE_NAME, std::ifstream::binary );
+         const std::string mapped( (std::istreambuf_iterator<char>( inf )),
+            std::istreambuf_iterator<char>() );
+         isOk_ &= (mapped == streamed.str());
+      }
+
+      for( dword r = 0;  r < 2;  ++r )
+      {
+         dword width     = 0;
+         dword height    = 0;
+         dword quantMaxR = 0;
+         void* pRead     = 0;
+         if( 0 == r )
+         {
+            isOk_ &= readFile( FILE_NAME, flags, width, height, quantMaxR,
+               pRead );
+         }
+         else
+         {
+            std::istringstream in( streamed.str(), std::istringstream::binary );
+            read( in, flags, width, height, quantMaxR, pRead );
+         }
+
+         isOk_ &= (WIDTH == width) & (HEIGHT == height) &
+            (quantMax == quantMaxR) && pRead && (0 == ::memcmp( pRead,
+            pTriples, length * (is48Bit ? 2 : 1) ));
+         scratch::release( pRead );
+      }
+
+      if( pOut && isVerbose ) *pOut << (is48Bit ? "48" : "24") << " bit, " <<
+         "flags " << flags << " : " << isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   // cut-short file is reported
+   {
+      {
+         std::ofstream outf( FILE_NAME, std::ofstream::binary );
+         outf << "P6\n4 4\n255\n" << std::string( 40, 'x' );
+      }
+
+      bool  isOk_    = false;
+      dword width    = 0;
+      dword height   = 0;
+      dword quantMax = 0;
+      void* pRead    = 0;
+      try
+      {
+         readFile( FILE_NAME, 0, width, height, quantMax, pRead );
+         scratch::release( pRead );
+      }
+      catch( const char[] )
+      {
+         isOk_ = true;
+      }
+
+      if( pOut && isVerbose ) *pOut << "cut short : " << isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   ::remove( FILE_NAME );
+
+   if( pOut && isVerbose ) *pOut << "\n";
+
+   if( pOut ) *pOut << "mapped file : " <<
+      (isOk ? "--- succeeded" : "*** failed") << "\n\n";
+
+   return isOk;
+}
+
+
+bool test_scanlines
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   const char  FILE_NAME_WHOLE[] = "zzztestwhole.ppm";
+   const char  FILE_NAME_STRIP[] = "zzzteststrip.ppm";
+   const dword WIDTH             = 23;
+   const dword HEIGHT            = 13;
+
+   udword random = seed ? seed : 521288629u;
+
+   // strips of various heights write the same file as whole, and read back
+   // what was written -- for each depth
+   for( dword k = 0;  k < 2;  ++k )
+   {
+      const bool  is48Bit  = (0 != k);
+      const dword quantMax = is48Bit ? 65535 : 255;
+      const dword length   = WIDTH * HEIGHT * 3;
+      const dword rowBytes = WIDTH * 3 * (is48Bit ? 2 : 1);
+
+      std::vector<ubyte> triples( length * 2 );
+      for( dword i = 0;  i < length * 2;  ++i )
+      {
+         random = 18000u * (random & 0xFFFFu) + (random >> 16);
+         triples[i] = static_cast<ubyte>(random >> 8);
+      }
+
+      bool isOk_ = writeFile( "strips", WIDTH, HEIGHT, quantMax, IS_TOP_FIRST,
+         &(triples[0]), FILE_NAME_WHOLE );
+
+      // write in strips
+      {
+         ScanlineWriter* pWriter = openWriter( "strips", WIDTH, HEIGHT,
+            quantMax, FILE_NAME_STRIP );
+         isOk_ &= (0 != pWriter);
+         if( pWriter )
+         {
+            for( dword y = 0, rows = 1;  y < HEIGHT;  y += rows, ++rows )
+            {
+               rows = (HEIGHT - y) < rows ? (HEIGHT - y) : rows;
+               pWriter->writeRows( rows, &(triples[y * rowBytes]) );
+            }
+            pWriter->finish();
+            delete pWriter;
+         }
+
+         std::ifstream inWhole( FILE_NAME_WHOLE, std::ifstream::binary );
+         std::ifstream inStrip( FILE_NAME_STRIP, std::ifstream::binary );
+         const std::string whole( (std::istreambuf_iterator<char>( inWhole )),
+            std::istreambuf_iterator<char>() );
+         const std::string strip( (std::istreambuf_iterator<char>( inStrip )),
+            std::istreambuf_iterator<char>() );
+         isOk_ &= !whole.empty() && (whole == strip);
+      }
+
+      // read in strips
+      {
+         dword width     = 0;
+         dword height    = 0;
+         dword quantMaxR = 0;
+         ScanlineReader* pReader = openReader( FILE_NAME_STRIP, width, height,
+            quantMaxR );
+         isOk_ &= (0 != pReader) && (WIDTH == width) && (HEIGHT == height) &&
+            (quantMax == quantMaxR);
+         if( pReader )
+         {
+            std::vector<ubyte> read( triples.size() );
+            for( dword y = 0, rows = 3;  y < HEIGHT;  y += rows )
+            {
+               rows = (HEIGHT - y) < rows ? (HEIGHT - y) : rows;
+               pReader->readRows( rows, &(read[y * rowBytes]) );
+            }
+            delete pReader;
+
+            isOk_ &= (0 == ::memcmp( &(read[0]), &(triples[0]), HEIGHT *
+               rowBytes ));
+         }
+      }
+
+      if( pOut && isVerbose ) *pOut << (is48Bit ? "48" : "24") << " bit : " <<
+         isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   // writing too few rows is reported
+   {
+      bool isOk_ = false;
+      ScanlineWriter* pWriter = openWriter( "strips", WIDTH, HEIGHT, 255,
+         FILE_NAME_STRIP );
+      if( pWriter )
+      {
+         const std::vector<ubyte> row( WIDTH * 3 );
+         try
+         {
+            pWriter->writeRows( 1, &(row[0]) );
+            pWriter->finish();
+         }
+         catch( const char[] )
+         {
+            isOk_ = true;
+         }
+         delete pWriter;
+      }
+
+      if( pOut && isVerbose ) *pOut << "too few rows : " << isOk_ << "\n";
+
+      isOk &= isOk_;
+   }
+
+   ::remove( FILE_NAME_WHOLE );
+   ::remove( FILE_NAME_STRIP );
+
+   if( pOut && isVerbose ) *pOut << "\n";
+
+   if( pOut ) *pOut << "scanlines : " <<
+      (isOk ? "--- succeeded" : "*** failed") << "\n\n";
+
+   return isOk;
+}
+
+
 void writeImageFiles
 (
    std::ostream* pOut,
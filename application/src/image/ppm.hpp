@@ -59,13 +59,13 @@ namespace ppm
     * Read PPM image.<br/><br/>
     *
     * Only first image read.<br/>
-    * Triples are bottom row first, R then G then B.<br/>
-    * width * height * 3 will be <= DWORD_MAX
+    * Triples are bottom row first, R then G then B.
     *
     * @i_orderingFlags combination of EOrderingFlags
     * @o_quantMax      max value of quantization, 1 to 65535
     * @o_pTriples      array of ubyte triples, or uword triples if
-    *                  o_quantMax >= 256. orphaned storage
+    *                  o_quantMax >= 256. orphaned storage (free with
+    *                  scratch::release)
     *
     * @exceptions throws char[] message exceptions
     */
@@ -83,8 +83,7 @@ namespace ppm
    /**
     * Write PPM image.<br/><br/>
     *
-    * Triples are bottom row first, R then G then B.<br/>
-    * width * height * 3 must be <= DWORD_MAX
+    * Triples are bottom row first, R then G then B.
     *
     * @i_pComment      no newlines allowed
     * @i_quantMax      max value of quantization, 1 to 65535
@@ -104,6 +103,94 @@ namespace ppm
       const void* i_pTriples,
       ostream&    o_outBytes
    );
+
+
+   /**
+    * Read PPM image file, memory-mapped.<br/><br/>
+    *
+    * As read, but straight from the file's bytes: rows are copied (or
+    * byte-swapped, if 16-bit) in bulk.
+    *
+    * @return  true if read, false if the file could not be mapped (so nothing
+    *          was read -- use read with a stream instead)
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   bool readFile
+   (
+      const char i_pathName[],
+      dword      i_orderingFlags,
+      dword&     o_width,
+      dword&     o_height,
+      dword&     o_quantMax,
+      void*&     o_pTriples
+   );
+
+
+   /**
+    * Write PPM image file, memory-mapped.<br/><br/>
+    *
+    * As write, but the file is sized beforehand, and rows written straight
+    * into its bytes.
+    *
+    * @return  true if written, false if the file could not be mapped (so
+    *          nothing was written -- use write with a stream instead)
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   bool writeFile
+   (
+      const char* i_pComment,
+      dword       i_width,
+      dword       i_height,
+      dword       i_quantMax,
+      dword       i_orderingFlags,
+      const void* i_pTriples,
+      const char  o_pathName[]
+   );
+
+
+   /**
+    * Open PPM image file to read a strip of rows at a time, memory-mapped.
+    * <br/><br/>
+    *
+    * Rows top first, pixels as read (see ScanlineReader).
+    *
+    * @o_quantMax  max value of quantization, 1 to 65535
+    * @return      reader (orphaned -- delete it), or 0 if the file could not
+    *              be mapped
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   ScanlineReader* openReader
+   (
+      const char i_pathName[],
+      dword&     o_width,
+      dword&     o_height,
+      dword&     o_quantMax
+   );
+
+
+   /**
+    * Open PPM image file to write a strip of rows at a time, memory-mapped.
+    * <br/><br/>
+    *
+    * Rows top first, pixels as write (see ScanlineWriter). An existing file
+    * is replaced, not overwritten (it might be mapped, being read).
+    *
+    * @return  writer (orphaned -- delete it), or 0 if the file could not be
+    *          mapped
+    *
+    * @exceptions throws char[] message exceptions
+    */
+   ScanlineWriter* openWriter
+   (
+      const char* i_pComment,
+      dword       i_width,
+      dword       i_height,
+      dword       i_quantMax,
+      const char  o_pathName[]
+   );
 }
 
 
@@ -9,19 +9,28 @@
 
 
 #include <math.h>
+#include <string.h>
 
 #include <istream>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <utility>
+#include <algorithm>
 #include <exception>
 
+#include "ScratchMemory.hpp"
+#include "MappedFile.hpp"
+#include "ParallelBands.hpp"
 #include "StreamExceptionSet.hpp"
+#include "ScanlineCodec.hpp"
 
 #include "rgbe.hpp"
 
 
 using namespace hxa7241_image;
+using namespace hxa7241_general;
 
 
 
@@ -60,38 +69,85 @@ const char OUT_NULL_POINTER_EXCEPTION_MESSAGE[] =
 const char OUT_STREAM_EXCEPTION_MESSAGE[] =
    "stream write failure, in RGBE write";
 
+// rows decoded per band (in parallel)
+const dword READ_BAND_ROWS   = 16;
+
+// rows encoded at a time (in parallel bands), then written in one go
+const dword WRITE_CHUNK_ROWS = 256;
+const dword WRITE_BAND_ROWS  = 16;
+
 
 /// declarations ---------------------------------------------------------------
-bool readTaggedValues
+void readBytes
 (
-   istream& in,
-   float*   pPrimaries8,
-   float&   exposure
+   const ubyte* pBytes,
+   qword        size,
+   dword        orderingFlags,
+   dword&       width,
+   dword&       height,
+   float*       pPrimaries8,
+   float&       exposure,
+   float*&      pTriples
 );
 
-bool readDimensions
+qword readHeader
 (
-   istream& in,
-   dword&   width,
-   dword&   height
+   const ubyte* pBytes,
+   qword        size,
+   float*       pPrimaries8,
+   float&       exposure,
+   bool&        isRle,
+   dword&       width,
+   dword&       height,
+   bool&        isInverted
+);
+
+bool readLine
+(
+   const ubyte* pBytes,
+   qword        size,
+   qword&       pos,
+   std::string& line
 );
 
 void readImage
 (
-   istream&    in,
-   const dword width,
-   const dword height,
-   const bool  isRle,
-   const bool  isBgr,
-   const bool  isInverted,
-   float*      pRgbTriples
+   const ubyte* pBytes,
+   qword        size,
+   dword        width,
+   dword        height,
+   bool         isRle,
+   bool         isBgr,
+   bool         isInverted,
+   float*       pRgbTriples
+);
+
+bool findRowStarts
+(
+   const ubyte*        pBytes,
+   qword               size,
+   dword               width,
+   dword               height,
+   bool                isRle,
+   std::vector<qword>& rowStarts
+);
+
+qword readRuns
+(
+   const ubyte* pBytes,
+   qword        size,
+   qword        pos,
+   dword        width,
+   ubyte*       pChannels
 );
 
 void convertRgbeToFloats
 (
-   bool        isBgr,
-   const ubyte rgbe[4],
-   float       rgb[3]
+   const ubyte* pChannels[4],
+   dword        stride,
+   dword        width,
+   bool         isBgr,
+   float*       pRgb
 );
 
 void writeHeader
@@ -99,6 +155,7 @@ void writeHeader
    const char*  i_pComment,
    const float* i_pPrimaries8,
    const float  i_exposure,
+   const bool   i_isRle,
    ostream&     o_out
 );
 
@@ -111,11 +168,20 @@ void writePixels
    ostream&     o_out
 );
 
+dword encodeRuns
+(
+   const ubyte* pBytes,
+   dword        length,
+   ubyte*       pRuns
+);
+
 void convertFloatsToRgbe
 (
-   bool        isBgr,
-   const float rgb[3],
-   ubyte       rgbe[4]
+   const float* pRgb,
+   dword        width,
+   bool         isBgr,
+   ubyte*       pChannels[4],
+   dword        stride
 );
 
 void checkDimensions
@@ -190,44 +256,26 @@ void hxa7241_image::rgbe::read
 )
 {
    // enable stream exceptions
-   StreamExceptionSet streamExceptionSet( i_in,
-      istream::badbit | istream::eofbit );   // istream::failbit
+   // (reading to the end sets eof and fail)
+   StreamExceptionSet streamExceptionSet( i_in, istream::badbit );
 
    try
    {
-      // read and check id
-      if( !isRecognised( i_in ) )
+      // slurp the rest of the stream, a chunk at a time
+      std::vector<ubyte> bytes;
+      std::vector<char>  chunk( 1 << 16 );
+      do
       {
-         throw IN_FORMAT_EXCEPTION_MESSAGE;
+         i_in.read( &(chunk[0]), static_cast<std::streamsize>(chunk.size()) );
+         bytes.insert( bytes.end(), chunk.begin(), chunk.begin() +
+            static_cast<size_t>(i_in.gcount()) );
       }
+      while( i_in );
 
-      // read info
-      float primaries[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
-      float exposure    = 0.0f;
-      const bool isRle = readTaggedValues( i_in, primaries, exposure );
-
-      // read dimensions
-      dword width  = 0;
-      dword height = 0;
-      const bool isInverted = readDimensions( i_in, width, height );
-
-      checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
-
-      // allocate pixels storage
-      std::auto_ptr<float> pTriples( new float[ width * height * 3 ] );
-
-      // read image
-      readImage( i_in, width, height, isRle,
-         (i_orderingFlags & IS_BGR) ? true : false,
-         isInverted ^ ((i_orderingFlags & IS_LOW_TOP) ? true : false),
-         pTriples.get() );
-
-      // set outputs
-      o_width  = width;
-      o_height = height;
-      for( int i = 8;  i-- > 0;  o_pPrimaries8[i] = primaries[i] );
-      o_exposure = exposure;
-      o_pTriples = pTriples.release();
+      // decode from memory
+      readBytes( bytes.empty() ? 0 : &(bytes[0]), static_cast<qword>(
+         bytes.size()), i_orderingFlags, o_width, o_height, o_pPrimaries8,
+         o_exposure, o_pTriples );
    }
    // translate exceptions
    catch( const std::ios_base::failure& )
@@ -237,94 +285,167 @@ void hxa7241_image::rgbe::read
 }
 
 
+bool hxa7241_image::rgbe::readFile
+(
+   const char  i_pathName[],
+   const dword i_orderingFlags,
+   dword&      o_width,
+   dword&      o_height,
+   float*      o_pPrimaries8,
+   float&      o_exposure,
+   float*&     o_pTriples
+)
+{
+   MappedFile file;
+   if( !file.openRead( i_pathName ) )
+   {
+      return false;
+   }
+
+   // decode straight from the file bytes
+   readBytes( file.getBytes(), file.getSize(), i_orderingFlags, o_width,
+      o_height, o_pPrimaries8, o_exposure, o_pTriples );
+
+   return true;
+}
+
+
 namespace
 {
 
-bool readTaggedValues
-(
-   istream& in,
-   float*   pPrimaries8,
-   float&   exposure
-)
+/**
+ * Scale for each exponent byte: 2^(e - (128 + 8)), or 0 for tiny exponents.
+ */
+class ExponentTable
 {
-   // zero outputs
+public:
+   ExponentTable()
    {
-      for( dword i = 8;  i-- > 0; )
+      for( dword e = 0;  e < 256;  ++e )
       {
-         pPrimaries8[i] = 0.0f;
+         scales[e] = (10 < e) ? ::ldexpf( 1.0f, e - (128 + 8) ) : 0.0f;
       }
-      exposure = 0.0f;
    }
 
-   // read tagged values
-   bool isRle = false;
+   float scales[256];
+};
+
+// (filled before main, so read-only after)
+const ExponentTable EXPONENTS_g;
+
+
+void readBytes
+(
+   const ubyte* pBytes,
+   const qword  size,
+   const dword  orderingFlags,
+   dword&       o_width,
+   dword&       o_height,
+   float*       o_pPrimaries8,
+   float&       o_exposure,
+   float*&      o_pTriples
+)
+{
+   // read info and dimensions
+   float primaries[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+   float exposure    = 0.0f;
+   bool  isRle       = false;
+   dword width       = 0;
+   dword height      = 0;
+   bool  isInverted  = false;
+   const qword headerSize = readHeader( pBytes, size, primaries, exposure,
+      isRle, width, height, isInverted );
+
+   checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   // allocate pixels storage
+   scratch::Ptr<float> pTriples( static_cast<qword>(width) * height * 3 );
+
+   // read image
+   readImage( pBytes + headerSize, size - headerSize, width, height, isRle,
+      (orderingFlags & rgbe::IS_BGR) ? true : false,
+      isInverted ^ ((orderingFlags & rgbe::IS_LOW_TOP) ? true : false),
+      pTriples.get() );
+
+   // set outputs
+   o_width  = width;
+   o_height = height;
+   for( int i = 8;  i-- > 0;  o_pPrimaries8[i] = primaries[i] );
+   o_exposure = exposure;
+   o_pTriples = pTriples.release();
+}
+
+
+/**
+ * Read header: id, tagged values to a blank line, then dimensions.
+ *
+ * @return  bytes up to the pixels
+ */
+qword readHeader
+(
+   const ubyte* pBytes,
+   const qword  size,
+   float*       pPrimaries8,
+   float&       exposure,
+   bool&        isRle,
+   dword&       width,
+   dword&       height,
+   bool&        isInverted
+)
+{
+   qword       pos = 0;
+   std::string line;
+
+   // read and check id
+   if( !readLine( pBytes, size, pos, line ) ||
+      ((line.substr( 0, sizeof(RADIANCE_ID) - 1 ) != RADIANCE_ID) &&
+      (line.substr( 0, sizeof(RADIANCE_ID) - 1 ) != RGBE_ID)) )
+   {
+      throw IN_FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   // read tagged values, up to blank line
    for( ;; )
    {
-      const istream::pos_type lineStart = in.tellg();
+      if( !readLine( pBytes, size, pos, line ) )
+      {
+         throw IN_STREAM_EXCEPTION_MESSAGE;
+      }
+      if( line.empty() )
+      {
+         break;
+      }
 
-      // read tag name, up to 9 chars (followed by '=')
-      char buf[] = "         ";
-      in.getline( buf, sizeof(buf), '=' );
-      in.clear();
+      const size_t equals = line.find( '=' );
+      const std::string tag( line.substr( 0, equals ) );
+      std::istringstream value( (std::string::npos != equals) ?
+         line.substr( equals + 1 ) : std::string() );
 
       // read primaries
-      if( std::string("PRIMARIES") == buf )
+      if( tag == "PRIMARIES" )
       {
          for( dword i = 0;  i < 8;  ++i )
          {
-            in >> pPrimaries8[i];
+            value >> pPrimaries8[i];
          }
       }
       // read exposure
-      else if( std::string("EXPOSURE") == buf )
+      else if( tag == "EXPOSURE" )
       {
          // accumulate multiplication
-         float e;
-         in >> e;
+         float e = 0.0f;
+         value >> e;
          if( 0.0f != e )
          {
-            if( 0.0f != exposure )
-            {
-               exposure *= e;
-            }
-            else
-            {
-               exposure = e;
-            }
+            exposure = (0.0f != exposure) ? exposure * e : e;
          }
       }
-//    // read color correction
-//    else if( std::string("COLORCORR") == buf )
-//    {
-//       // 3 floats
-//       // cumulative
-//    }
-//    // read pixel aspect ratio
-//    else if( std::string("PIXASPECT") == buf )
-//    {
-//       // float ?
-//       // cumulative
-//    }
-//    // read view
-//    else if( std::string("VIEW") == buf )
-//    {
-//       // view parameters ... ?
-//       // cumulative
-//    }
-//    // read software
-//    else if( std::string("SOFTWARE") == buf )
-//    {
-//       // string
-//    }
       // read format into isRle
-      else if( std::string("FORMAT") == buf )
+      else if( tag == "FORMAT" )
       {
-         char buf[] = "               ";
-         in.getline( buf, sizeof(buf), char(0x0A) );
-         in.clear();
-
-         const bool isRgb = (std::string("32-bit_rle_rgbe") == buf);
-         const bool isXyz = (std::string("32-bit_rle_xyze") == buf);
+         const std::string format( value.str().substr( 0, 15 ) );
+         const bool isRgb = (format == "32-bit_rle_rgbe");
+         const bool isXyz = (format == "32-bit_rle_xyze");
          isRle = isRgb | isXyz;
 
          if( isXyz )
@@ -335,77 +456,41 @@ bool readTaggedValues
             pPrimaries8[6] = 0.333333f;
             pPrimaries8[7] = 0.333333f;
          }
-
-         in.seekg( lineStart );
       }
-      else
-      {
-         // move back to start of line
-         in.seekg( lineStart );
-
-         // check if it was a blank line, which is the end of the header
-         if( char(0x0A) == buf[0] )
-         {
-            in.ignore( 1 );
-            // exit loop
-            break;
-         }
-      }
-
-      // ignore rest of line
-      in.ignore( DWORD_MAX, ubyte(0x0A) );
    }
 
-   return isRle;
-}
-
-
-bool readDimensions
-(
-   istream& in,
-   dword&   width,
-   dword&   height
-)
-{
+   // read dimensions: sign, axis, size, twice
+   if( !readLine( pBytes, size, pos, line ) )
+   {
+      throw IN_STREAM_EXCEPTION_MESSAGE;
+   }
+   std::istringstream dimensions( line );
    width  = 0;
    height = 0;
-
-   // loop twice
    for( dword i = 2;  i-- > 0; )
    {
-      // read - or +
-      char sign;
-      in >> sign;
+      char  sign   = 0;
+      char  axis   = 0;
+      dword length = 0;
+      dimensions >> sign >> axis >> length;
 
-      // read Y or X
-      char axis;
-      in >> axis;
-
-      // read integer
-      dword size;
-      in >> size;
-
-      size = ('-' == sign) ? -size : size;
+      length = ('-' == sign) ? -length : length;
 
       if( ('X' == axis) | ('x' == axis) )
       {
-         width = size;
+         width = length;
       }
       else
       {
-         height = size;
+         height = length;
       }
-
-      // read space
-      in.ignore( 1 );
    }
 
-    const bool isInverted = height < 0;
-    width  = width  < 0 ? -width  : width;
-    height = height < 0 ? -height : height;
-
-    return isInverted;
+   isInverted = height < 0;
+   width  = width  < 0 ? -width  : width;
+   height = height < 0 ? -height : height;
 
+   return pos;
 
 // different ordered X and Y means something:
 //
@@ -420,144 +505,299 @@ bool readDimensions
 }
 
 
+/**
+ * @return  false if no whole line left
+ */
+bool readLine
+(
+   const ubyte* pBytes,
+   const qword  size,
+   qword&       pos,
+   std::string& line
+)
+{
+   const ubyte* pEnd = pBytes ? static_cast<const ubyte*>( ::memchr(
+      pBytes + pos, 0x0A, static_cast<size_t>(size - pos) ) ) : 0;
+   if( !pEnd )
+   {
+      return false;
+   }
+
+   line.assign( reinterpret_cast<const char*>(pBytes + pos),
+      reinterpret_cast<const char*>(pEnd) );
+   pos = (pEnd - pBytes) + 1;
+
+   return true;
+}
+
+
+/**
+ * Decoding of rows, from where each starts, in parallel bands.
+ */
+class RowDecoder
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowDecoder( const ubyte* pBytes,
+               qword        size,
+               const qword* pRowStarts,
+               dword        width,
+               dword        height,
+               bool         isRle,
+               bool         isBgr,
+               bool         isInverted,
+               float*       pRgbTriples );
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   const ubyte* pBytes_m;
+   qword        size_m;
+   const qword* pRowStarts_m;
+   dword        width_m;
+   dword        height_m;
+   bool         isRle_m;
+   bool         isBgr_m;
+   bool         isInverted_m;
+   float*       pRgbTriples_m;
+};
+
+
+RowDecoder::RowDecoder
+(
+   const ubyte* pBytes,
+   const qword  size,
+   const qword* pRowStarts,
+   const dword  width,
+   const dword  height,
+   const bool   isRle,
+   const bool   isBgr,
+   const bool   isInverted,
+   float*       pRgbTriples
+)
+ : pBytes_m     ( pBytes )
+ , size_m       ( size )
+ , pRowStarts_m ( pRowStarts )
+ , width_m      ( width )
+ , height_m     ( height )
+ , isRle_m      ( isRle )
+ , isBgr_m      ( isBgr )
+ , isInverted_m ( isInverted )
+ , pRgbTriples_m( pRgbTriples )
+{
+}
+
+
+void RowDecoder::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   // (planar rgbe, for run-length decoding)
+   std::vector<ubyte> channels( isRle_m ? static_cast<size_t>(width_m) * 4 :
+      0 );
+
+   for( dword row = begin;  row < end;  ++row )
+   {
+      float* pRgb = pRgbTriples_m + (static_cast<qword>(isInverted_m ?
+         height_m - 1 - row : row) * width_m * 3);
+      const ubyte* pRow = pBytes_m + pRowStarts_m[row];
+
+      // plain: convert straight from the bytes
+      if( !isRle_m )
+      {
+         const ubyte* pChannels[] = { pRow, pRow + 1, pRow + 2, pRow + 3 };
+         convertRgbeToFloats( pChannels, 4, width_m, isBgr_m, pRgb );
+      }
+      // run-length encoded: decode into channels, then convert
+      else
+      {
+         readRuns( pBytes_m, size_m, pRowStarts_m[row], width_m,
+            &(channels[0]) );
+
+         const ubyte* pChannels[] = { &(channels[0]), &(channels[width_m]),
+            &(channels[width_m * 2]), &(channels[width_m * 3]) };
+         convertRgbeToFloats( pChannels, 1, width_m, isBgr_m, pRgb );
+      }
+   }
+}
+
+
+/**
+ * Read pixels: first find where each row starts, then decode rows in
+ * parallel.
+ */
 void readImage
 (
-   istream&    in,
-   const dword width,
-   const dword height,
-   const bool  isRle,
-   const bool  isBgr,
-   const bool  isInverted,
-   float*      pRgbTriples
+   const ubyte* pBytes,
+   const qword  size,
+   const dword  width,
+   const dword  height,
+   const bool   isRle,
+   const bool   isBgr,
+   const bool   isInverted,
+   float*       pRgbTriples
+)
+{
+   std::vector<qword> rowStarts( height );
+   const bool isRuns = findRowStarts( pBytes, size, width, height, isRle,
+      rowStarts );
+
+   RowDecoder decoder( pBytes, size, &(rowStarts[0]), width, height,
+      isRuns, isBgr, isInverted, pRgbTriples );
+   decoder.run( height, READ_BAND_ROWS );
+}
+
+
+/**
+ * Find where each row starts (for run-length encoding, a quick walk over the
+ * run counts).
+ *
+ * @rowStarts  height long
+ * @return     true if rows are run-length encoded, false if plain
+ */
+bool findRowStarts
+(
+   const ubyte*        pBytes,
+   const qword         size,
+   const dword         width,
+   const dword         height,
+   const bool          isRle,
+   std::vector<qword>& rowStarts
 )
 {
    // plain
-   if( !isRle | ((width < 8) | (width > 0x7FFF)) )
+   const bool isPlain = !isRle | ((width < 8) | (width > 0x7FFF));
+   if( isPlain )
    {
-      // read rows
-      for( dword y = 0;  y < height;  ++y )
+      const qword rowLength = static_cast<qword>(width) * 4;
+      if( size / rowLength < height )
       {
-         float* pPixel = pRgbTriples +
-            ((isInverted ? height - 1 - y : y) * width * 3);
-
-         // read pixels
-         for( dword x = 0;  x < width;  ++x, pPixel += 3 )
-         {
-            char rgbe[4];
-            in.read( rgbe, sizeof(rgbe) );
+         throw IN_STREAM_EXCEPTION_MESSAGE;
+      }
 
-            convertRgbeToFloats( isBgr, reinterpret_cast<ubyte*>(rgbe), pPixel);
-         }
+      for( dword row = 0;  row < height;  ++row )
+      {
+         rowStarts[row] = static_cast<qword>(row) * rowLength;
       }
    }
    // run-length encoded
+   // (the walk checks all runs are there, so decoding will not fail)
    else
    {
-      using std::vector;
-      vector<ubyte> channels[] = {
-         vector<ubyte>( width ),
-         vector<ubyte>( width ),
-         vector<ubyte>( width ),
-         vector<ubyte>( width ) };
-
-      // read rows
+      qword pos = 0;
       for( dword row = 0;  row < height;  ++row )
       {
-         // ignore leader
-         {
-            in.ignore( 4 );
+         rowStarts[row] = pos;
+         pos = readRuns( pBytes, size, pos, width, 0 );
+      }
+   }
 
-            // read 4 bytes
-            //char bytes[4];
-            //in.read( bytes, sizeof(bytes) );
+   return !isPlain;
+}
 
-            // check
-            // (bytes[0] == 2) & (bytes[1] == 2) & ((bytes[2] & 0x80) == 0)
-            // (dword(ubyte(bytes[2])) << 8) | dword(ubyte(bytes[3]))) == width
 
-            // ... why bother ?
-         }
+/**
+ * Read a run-length encoded row: leader, then runs, for each channel.
+ *
+ * @pChannels  planar storage for the row (4 * width), or 0 to only walk it
+ * @return     position after the row
+ */
+qword readRuns
+(
+   const ubyte* pBytes,
+   const qword  size,
+   qword        pos,
+   const dword  width,
+   ubyte*       pChannels
+)
+{
+   // ignore leader
+   // (2, 2, then width, big-endian -- why bother checking ?)
+   pos += 4;
 
-         // read pixels
+   // read channels
+   for( dword c = 0;  c < 4;  ++c )
+   {
+      // read runs
+      ubyte* pChannel = pChannels ? pChannels + (c * width) : 0;
+      for( dword p = 0;  p < width; )
+      {
+         // read run prefix byte
+         if( pos >= size )
          {
-            // read channels
-            for( dword c = 0;  c < 4;  ++c )
-            {
-               // read runs
-               ubyte* pChannel = &(channels[c][0]);
-               for( dword p = 0;  p < width; )
-               {
-                  // read run prefix byte
-                  const dword runPrefix = ubyte(in.get());
-                  const bool  isRunSame = runPrefix > 128;
+            throw IN_STREAM_EXCEPTION_MESSAGE;
+         }
+         const dword runPrefix = pBytes[pos++];
+         const bool  isRunSame = runPrefix > 128;
 
-                  // clamp length
-                  dword runLength = runPrefix - (isRunSame ? 128 : 0);
-                  {
-                     const dword remaining = width - p;
-                     runLength = (runLength <= remaining) ? runLength : remaining;
-                  }
+         // clamp length
+         dword runLength = runPrefix - (isRunSame ? 128 : 0);
+         {
+            const dword remaining = width - p;
+            runLength = (runLength <= remaining) ? runLength : remaining;
+         }
 
-                  // read or duplicate bytes
-                  if( isRunSame )
-                  {
-                     // read value
-                     const ubyte value = ubyte(in.get());
-
-                     // duplicate value
-                     for( dword r = runLength;  r-- > 0;  ++p )
-                     {
-                        pChannel[ p ] = value;
-                     }
-                  }
-                  else
-                  {
-                     // read values
-                     in.read( reinterpret_cast<char*>(pChannel + p), runLength );
-                     p += runLength;
-                  }
-               }
+         // duplicate value, or copy values
+         const dword valuesLength = isRunSame ? 1 : runLength;
+         if( (size - pos) < valuesLength )
+         {
+            throw IN_STREAM_EXCEPTION_MESSAGE;
+         }
+         if( pChannel )
+         {
+            if( isRunSame )
+            {
+               ::memset( pChannel + p, pBytes[pos], runLength );
             }
-
-            // collate channels into pixels
-            float* pPixel = pRgbTriples +
-               ((isInverted ? height - 1 - row : row) * width * 3);
-            for( dword p = 0;  p < width;  ++p, pPixel += 3 )
+            else
             {
-               ubyte rgbe[4];
-               for( dword c = 4;  c-- > 0; )
-               {
-                  rgbe[c] = channels[c][p];
-               }
-
-               convertRgbeToFloats( isBgr, rgbe, pPixel );
+               ::memcpy( pChannel + p, pBytes + pos, runLength );
             }
          }
+         pos += valuesLength;
+         p   += runLength;
       }
    }
+
+   return pos;
 }
 
 
+/**
+ * Convert a row of RGBE, interleaved (stride 4) or planar (stride 1), to
+ * float triples.
+ *
+ * (a table lookup per pixel, instead of ldexp, and the rest a plain loop,
+ * left for the compiler to vectorize)
+ */
 void convertRgbeToFloats
 (
-   const bool  i_isBgr,
-   const ubyte i_rgbe[4],
-   float       o_rgb[3]
+   const ubyte* pChannels[4],
+   const dword  stride,
+   const dword  width,
+   const bool   isBgr,
+   float*       pRgb
 )
 {
-   if( 10 < i_rgbe[3] )
-   {
-      const float a = ::ldexpf(1.0f, static_cast<dword>(i_rgbe[3]) - (128 + 8));
+   const ubyte* pR = pChannels[!isBgr ? 0 : 2];
+   const ubyte* pG = pChannels[1];
+   const ubyte* pB = pChannels[!isBgr ? 2 : 0];
+   const ubyte* pE = pChannels[3];
+   const float* scales = EXPONENTS_g.scales;
 
-      for( int i = 3;  i-- > 0; )
-      {
-         o_rgb[!i_isBgr ? i : 2 - i] = (static_cast<float>(i_rgbe[i]) + 0.5f) *
-            a;
-      }
-   }
-   else
+   for( dword p = 0, i = 0;  p < width;  ++p, i += stride )
    {
-      o_rgb[0] = o_rgb[1] = o_rgb[2] = 0.0f;
+      const float scale = scales[pE[i]];
+      pRgb[(p * 3) + 0] = (static_cast<float>(pR[i]) + 0.5f) * scale;
+      pRgb[(p * 3) + 1] = (static_cast<float>(pG[i]) + 0.5f) * scale;
+      pRgb[(p * 3) + 2] = (static_cast<float>(pB[i]) + 0.5f) * scale;
    }
 }
 
@@ -593,7 +833,9 @@ void hxa7241_image::rgbe::write
    try
    {
       // write header
-      writeHeader( i_pComment, i_pPrimaries8, i_exposure, o_out );
+      // (run-length encoding needs widths that fit the row leader)
+      writeHeader( i_pComment, i_pPrimaries8, i_exposure,
+         (i_width >= 8) & (i_width <= 0x7FFF), o_out );
 
       // write dimensions
       o_out << "-Y " << i_height << " +X " << i_width << '\n';
@@ -617,6 +859,7 @@ void writeHeader
    const char*  i_pComment,
    const float* i_pPrimaries8,
    const float  i_exposure,
+   const bool   i_isRle,
    ostream&     o_out
 )
 {
@@ -634,7 +877,8 @@ void writeHeader
    }
 
    // format
-   o_out << "FORMAT=32-bit_rgbe"  << '\n';
+   o_out << (i_isRle ? "FORMAT=32-bit_rle_rgbe" : "FORMAT=32-bit_rgbe") <<
+      '\n';
 
    //// software
    //if( i_pSoftware )
@@ -674,6 +918,152 @@ void writeHeader
 }
 
 
+/**
+ * Encoding of a chunk of rows, into fixed-size slots, in parallel bands.
+ */
+class RowEncoder
+   : public ParallelBands
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowEncoder( dword        width,
+               dword        height,
+               dword        orderingFlags,
+               const float* pTriples );
+
+/// commands -------------------------------------------------------------------
+           void encode( dword top,
+                        dword rows );
+
+/// queries --------------------------------------------------------------------
+           const ubyte* getRow( dword row )                               const;
+           dword        getRowLength( dword row )                         const;
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void doBand( dword begin,
+                        dword end );
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword              width_m;
+   dword              height_m;
+   dword              orderingFlags_m;
+   const float*       pTriples_m;
+   bool               isRle_m;
+
+   dword              top_m;
+   qword              slotLength_m;
+   std::vector<ubyte> slots_m;
+   std::vector<dword> lengths_m;
+};
+
+
+RowEncoder::RowEncoder
+(
+   const dword  width,
+   const dword  height,
+   const dword  orderingFlags,
+   const float* pTriples
+)
+ : width_m        ( width )
+ , height_m       ( height )
+ , orderingFlags_m( orderingFlags )
+ , pTriples_m     ( pTriples )
+ , isRle_m        ( (width >= 8) & (width <= 0x7FFF) )
+ , top_m          ( 0 )
+ // (worst case: leader, then all channels all literals, a count per 128)
+ , slotLength_m   ( isRle_m ? 4 + (static_cast<qword>(width + 128) * 4) :
+      static_cast<qword>(width) * 4 )
+ , slots_m        ( static_cast<size_t>(slotLength_m) * WRITE_CHUNK_ROWS )
+ , lengths_m      ( WRITE_CHUNK_ROWS )
+{
+}
+
+
+void RowEncoder::encode
+(
+   const dword top,
+   const dword rows
+)
+{
+   top_m = top;
+   ParallelBands::run( rows, WRITE_BAND_ROWS );
+}
+
+
+const ubyte* RowEncoder::getRow
+(
+   const dword row
+) const
+{
+   return &(slots_m[static_cast<size_t>(slotLength_m * row)]);
+}
+
+
+dword RowEncoder::getRowLength
+(
+   const dword row
+) const
+{
+   return lengths_m[row];
+}
+
+
+void RowEncoder::doBand
+(
+   const dword begin,
+   const dword end
+)
+{
+   const bool isBgr = (orderingFlags_m & rgbe::IS_BGR) ? true : false;
+
+   // (planar rgbe, for run-length encoding)
+   std::vector<ubyte> channels( isRle_m ? static_cast<size_t>(width_m) * 4 :
+      0 );
+
+   for( dword r = begin;  r < end;  ++r )
+   {
+      // rows are written top first
+      const dword y   = height_m - 1 - (top_m + r);
+      const dword row = (orderingFlags_m & rgbe::IS_LOW_TOP) ?
+         height_m - 1 - y : y;
+      const float* pRow = pTriples_m + (static_cast<qword>(row) * width_m * 3);
+
+      ubyte* pSlot = &(slots_m[static_cast<size_t>(slotLength_m * r)]);
+
+      // plain: convert straight into slot
+      if( !isRle_m )
+      {
+         ubyte* pChannels[] = { pSlot, pSlot + 1, pSlot + 2, pSlot + 3 };
+         convertFloatsToRgbe( pRow, width_m, isBgr, pChannels, 4 );
+
+         lengths_m[r] = width_m * 4;
+      }
+      // run-length encoded: convert to channels, then encode each, after
+      // leader
+      else
+      {
+         ubyte* pChannels[] = { &(channels[0]), &(channels[width_m]),
+            &(channels[width_m * 2]), &(channels[width_m * 3]) };
+         convertFloatsToRgbe( pRow, width_m, isBgr, pChannels, 1 );
+
+         pSlot[0] = 2;
+         pSlot[1] = 2;
+         pSlot[2] = static_cast<ubyte>(width_m >> 8);
+         pSlot[3] = static_cast<ubyte>(width_m);
+         dword length = 4;
+         for( dword c = 0;  c < 4;  ++c )
+         {
+            length += encodeRuns( pChannels[c], width_m, pSlot + length );
+         }
+
+         lengths_m[r] = length;
+      }
+   }
+}
+
+
 void writePixels
 (
    const dword  i_width,
@@ -683,67 +1073,153 @@ void writePixels
    ostream&     o_out
 )
 {
-   // rows
-   for( dword y = i_height;  y-- > 0; )
+   RowEncoder encoder( i_width, i_height, i_orderingFlags, i_pTriples );
+
+   // encode a chunk of rows, then write them (in order) in one go
+   std::vector<char> bytes;
+   for( dword top = 0;  top < i_height;  top += WRITE_CHUNK_ROWS )
    {
-      // columns
-      for( dword x = 0;  x < i_width;  ++x )
+      const dword rows = (i_height - top > WRITE_CHUNK_ROWS) ?
+         WRITE_CHUNK_ROWS : i_height - top;
+
+      encoder.encode( top, rows );
+
+      bytes.clear();
+      for( dword r = 0;  r < rows;  ++r )
       {
-         // calculate pointer offset
-         const dword row = (i_orderingFlags & rgbe::IS_LOW_TOP) ?
-            i_height - 1 - y : y;
-         const dword offset = ((row * i_width) + x) * 3;
-
-         // convert to rgbe
-         ubyte rgbe[4];
-         convertFloatsToRgbe( (i_orderingFlags & rgbe::IS_BGR) ? true : false,
-            i_pTriples + offset, rgbe );
-
-         // write rgbe bytes
-         for( dword b = 0;  b < 4;  ++b )
-         {
-            o_out << static_cast<ubyte>( rgbe[b] );
-         }
+         const char* pRow = reinterpret_cast<const char*>(encoder.getRow( r ));
+         bytes.insert( bytes.end(), pRow, pRow + encoder.getRowLength( r ) );
       }
+      o_out.write( &(bytes[0]), static_cast<std::streamsize>(bytes.size()) );
    }
 }
 
 
-void convertFloatsToRgbe
+/**
+ * Run-length encode one channel of a row, Radiance style: runs of 4 or more
+ * the same (up to 127) as a count + 128 then the value, and the rest as a
+ * count then literal bytes (up to 128).
+ *
+ * (following the Radiance reference writer: <cite>rgbe.c, Walter.</cite>)
+ *
+ * @return  bytes written to pRuns
+ */
+dword encodeRuns
 (
-   const bool  i_isBgr,
-   const float i_rgb[3],
-   ubyte       o_rgbe[4]
+   const ubyte* pBytes,
+   const dword  length,
+   ubyte*       pRuns
 )
 {
-   const float rgbLargest = (i_rgb[0] >= i_rgb[1]) ? (i_rgb[0] >= i_rgb[2] ?
-      i_rgb[0] : i_rgb[2]) : (i_rgb[1] >= i_rgb[2] ? i_rgb[1] : i_rgb[2]);
+   static const dword MIN_RUN = 4;
+
+   ubyte* pOut = pRuns;
 
-   if( rgbLargest >= 1e-9f )
+   for( dword current = 0;  current < length; )
    {
-      dword exponentLargest = 0;
-      float mantissaLargest = ::frexpf( rgbLargest, &exponentLargest );
+      // find the next run long enough
+      dword runStart    = current;
+      dword runCount    = 0;
+      dword oldRunCount = 0;
+      while( (runCount < MIN_RUN) && (runStart < length) )
+      {
+         runStart   += runCount;
+         oldRunCount = runCount;
+         runCount    = 1;
+         while( (runStart + runCount < length) && (runCount < 127) &&
+            (pBytes[runStart] == pBytes[runStart + runCount]) )
+         {
+            ++runCount;
+         }
+      }
 
-      // might be needed...
-      //if( mantissaLargest == 1.0f )
-      //{
-      //   mantissaLargest = 0.5f;
-      //   exponentLargest++;
-      //}
+      // if a short run is just before it, write that as a run
+      if( (oldRunCount > 1) && (oldRunCount == runStart - current) )
+      {
+         *(pOut++) = static_cast<ubyte>(128 + oldRunCount);
+         *(pOut++) = pBytes[current];
+         current   = runStart;
+      }
 
-      const float amount = mantissaLargest * 256.0f / rgbLargest;
+      // write literals up to the run
+      while( current < runStart )
+      {
+         const dword literals = (runStart - current > 128) ? 128 :
+            runStart - current;
+         *(pOut++) = static_cast<ubyte>(literals);
+         ::memcpy( pOut, pBytes + current, literals );
+         pOut    += literals;
+         current += literals;
+      }
 
-      for( int i = 3;  i-- > 0; )
+      // write the run, if one was found
+      if( runCount >= MIN_RUN )
       {
-         const float c = (i_rgb[i] >= 0.0f) ? i_rgb[i] : 0.0f;
-         o_rgbe[!i_isBgr ? i : 2 - i] = static_cast<ubyte>(
-            ::floorf( c * amount ) );
+         *(pOut++) = static_cast<ubyte>(128 + runCount);
+         *(pOut++) = pBytes[runStart];
+         current  += runCount;
       }
-      o_rgbe[3] = static_cast<ubyte>(exponentLargest + 128);
    }
-   else
+
+   return static_cast<dword>(pOut - pRuns);
+}
+
+
+/**
+ * Convert a row of float triples to RGBE, interleaved (stride 4) or planar
+ * (stride 1).
+ *
+ * (the shared exponent is taken straight from the largest's float bits,
+ * instead of by frexp, and the rest is a plain loop, left for the compiler
+ * to vectorize)
+ */
+void convertFloatsToRgbe
+(
+   const float* pRgb,
+   const dword  width,
+   const bool   isBgr,
+   ubyte*       pChannels[4],
+   const dword  stride
+)
+{
+   ubyte* pR = pChannels[!isBgr ? 0 : 2];
+   ubyte* pG = pChannels[1];
+   ubyte* pB = pChannels[!isBgr ? 2 : 0];
+   ubyte* pE = pChannels[3];
+
+   for( dword p = 0, i = 0;  p < width;  ++p, i += stride )
    {
-      o_rgbe[0] = o_rgbe[1] = o_rgbe[2] = o_rgbe[3] = 0;
+      const float* pPixel = pRgb + (p * 3);
+      const float rgbLargest = (pPixel[0] >= pPixel[1]) ?
+         (pPixel[0] >= pPixel[2] ? pPixel[0] : pPixel[2]) :
+         (pPixel[1] >= pPixel[2] ? pPixel[1] : pPixel[2]);
+
+      if( rgbLargest >= 1e-9f )
+      {
+         // frexp exponent: mantissa is in [0.5, 1)
+         udword bits = 0;
+         ::memcpy( &bits, &rgbLargest, sizeof(bits) );
+         const dword exponent = static_cast<dword>((bits >> 23) & 0xFF) - 126;
+
+         // 256 / 2^exponent, made directly
+         const udword amountBits = static_cast<udword>(127 + 8 - exponent) <<
+            23;
+         float amount = 0.0f;
+         ::memcpy( &amount, &amountBits, sizeof(amount) );
+
+         // (truncation is floor, for non-negatives)
+         pR[i] = static_cast<ubyte>( static_cast<dword>(
+            (pPixel[0] >= 0.0f ? pPixel[0] : 0.0f) * amount ) );
+         pG[i] = static_cast<ubyte>( static_cast<dword>(
+            (pPixel[1] >= 0.0f ? pPixel[1] : 0.0f) * amount ) );
+         pB[i] = static_cast<ubyte>( static_cast<dword>(
+            (pPixel[2] >= 0.0f ? pPixel[2] : 0.0f) * amount ) );
+         pE[i] = static_cast<ubyte>(exponent + 128);
+      }
+      else
+      {
+         pR[i] = pG[i] = pB[i] = pE[i] = 0;
+      }
    }
 }
 
@@ -755,8 +1231,8 @@ void checkDimensions
    const char* pMessage
 )
 {
-   if( (width <= 0) || (height <= 0) ||
-      (height > (DWORD_MAX / 3)) || (width > (DWORD_MAX / (height * 3))) )
+   // (lengths are 64-bit, so any positive dimensions fit)
+   if( (width <= 0) || (height <= 0) )
    {
       throw pMessage;
    }
@@ -767,6 +1243,314 @@ void checkDimensions
 
 
 
+/// scanlines ------------------------------------------------------------------
+namespace
+{
+
+/**
+ * Rows decoded straight from a mapped file, top first (from whichever end of
+ * the file that is).
+ */
+class RowReader
+   : public ScanlineReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowReader();
+
+/// commands -------------------------------------------------------------------
+           bool open( const char pathName[],
+                      dword&     width,
+                      dword&     height,
+                      float*     pPrimaries8,
+                      float&     exposure );
+
+   virtual void readRows( dword rows,
+                          void* pTriples );
+
+/// fields ---------------------------------------------------------------------
+private:
+   MappedFile         file_m;
+   qword              headerSize_m;
+   dword              width_m;
+   dword              height_m;
+   bool               isRle_m;
+   std::vector<qword> rowStarts_m;
+   dword              next_m;
+};
+
+
+RowReader::RowReader()
+ : file_m      ()
+ , headerSize_m( 0 )
+ , width_m     ( 0 )
+ , height_m    ( 0 )
+ , isRle_m     ( false )
+ , rowStarts_m ()
+ , next_m      ( 0 )
+{
+}
+
+
+bool RowReader::open
+(
+   const char pathName[],
+   dword&     width,
+   dword&     height,
+   float*     pPrimaries8,
+   float&     exposure
+)
+{
+   if( !file_m.openRead( pathName ) )
+   {
+      return false;
+   }
+
+   // read header
+   float primaries[] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+   float exposure_   = 0.0f;
+   bool  isRle       = false;
+   bool  isInverted  = false;
+   headerSize_m = readHeader( file_m.getBytes(), file_m.getSize(), primaries,
+      exposure_, isRle, width, height, isInverted );
+
+   checkDimensions( width, height, IN_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   // find where each row starts, and order them top first
+   // (inverted is the usual: top row first in the file)
+   rowStarts_m.resize( height );
+   isRle_m = findRowStarts( file_m.getBytes() + headerSize_m,
+      file_m.getSize() - headerSize_m, width, height, isRle, rowStarts_m );
+   if( !isInverted )
+   {
+      std::reverse( rowStarts_m.begin(), rowStarts_m.end() );
+   }
+
+   width_m  = width;
+   height_m = height;
+   for( int i = 8;  i-- > 0;  pPrimaries8[i] = primaries[i] );
+   exposure = exposure_;
+
+   return true;
+}
+
+
+void RowReader::readRows
+(
+   const dword rows,
+   void*       pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw IN_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   if( rows > 0 )
+   {
+      RowDecoder decoder( file_m.getBytes() + headerSize_m,
+         file_m.getSize() - headerSize_m, &(rowStarts_m[next_m]), width_m,
+         rows, isRle_m, false, false, static_cast<float*>(pTriples) );
+      decoder.run( rows, READ_BAND_ROWS );
+   }
+
+   next_m += rows;
+}
+
+
+/**
+ * Rows encoded and written to a file stream, top first.
+ */
+class RowWriter
+   : public ScanlineWriter
+{
+/// standard object services ---------------------------------------------------
+public:
+   RowWriter();
+
+/// commands -------------------------------------------------------------------
+           void open( const char*  pComment,
+                      dword        width,
+                      dword        height,
+                      const float* pPrimaries8,
+                      float        exposure,
+                      const char   pathName[] );
+
+   virtual void writeRows( dword       rows,
+                           const void* pTriples );
+   virtual void finish();
+
+/// fields ---------------------------------------------------------------------
+private:
+   std::ofstream out_m;
+   dword         width_m;
+   dword         height_m;
+   dword         next_m;
+};
+
+
+RowWriter::RowWriter()
+ : out_m   ()
+ , width_m ( 0 )
+ , height_m( 0 )
+ , next_m  ( 0 )
+{
+}
+
+
+void RowWriter::open
+(
+   const char*  pComment,
+   const dword  width,
+   const dword  height,
+   const float* pPrimaries8,
+   const float  exposure,
+   const char   pathName[]
+)
+{
+   checkDimensions( width, height, OUT_DIMENSIONS_EXCEPTION_MESSAGE );
+
+   out_m.open( pathName, std::ofstream::binary );
+   if( !out_m )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   // enable stream exceptions
+   StreamExceptionSet streamExceptionSet( out_m,
+      ostream::badbit | ostream::failbit | ostream::eofbit );
+
+   try
+   {
+      // write header, and dimensions (top first)
+      writeHeader( pComment, pPrimaries8, exposure,
+         (width >= 8) & (width <= 0x7FFF), out_m );
+      out_m << "-Y " << height << " +X " << width << '\n';
+   }
+   // translate exceptions
+   catch( const std::ios_base::failure& )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   width_m  = width;
+   height_m = height;
+}
+
+
+void RowWriter::writeRows
+(
+   const dword rows,
+   const void* pTriples
+)
+{
+   if( (rows < 0) || (rows > height_m - next_m) )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+   if( !pTriples )
+   {
+      throw OUT_NULL_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   // enable stream exceptions
+   StreamExceptionSet streamExceptionSet( out_m,
+      ostream::badbit | ostream::failbit | ostream::eofbit );
+
+   try
+   {
+      // the strip is an image, top first
+      if( rows > 0 )
+      {
+         writePixels( width_m, rows, rgbe::IS_LOW_TOP,
+            static_cast<const float*>(pTriples), out_m );
+      }
+   }
+   // translate exceptions
+   catch( const std::ios_base::failure& )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+
+   next_m += rows;
+}
+
+
+void RowWriter::finish()
+{
+   if( next_m != height_m )
+   {
+      throw OUT_DIMENSIONS_EXCEPTION_MESSAGE;
+   }
+
+   out_m.close();
+   if( !out_m )
+   {
+      throw OUT_STREAM_EXCEPTION_MESSAGE;
+   }
+}
+
+}
+
+
+ScanlineReader* hxa7241_image::rgbe::openReader
+(
+   const char i_pathName[],
+   dword&     o_width,
+   dword&     o_height,
+   float*     o_pPrimaries8,
+   float&     o_exposure
+)
+{
+   RowReader* pReader = new RowReader;
+   try
+   {
+      if( !pReader->open( i_pathName, o_width, o_height, o_pPrimaries8,
+         o_exposure ) )
+      {
+         delete pReader;
+         pReader = 0;
+      }
+   }
+   catch( ... )
+   {
+      delete pReader;
+      throw;
+   }
+
+   return pReader;
+}
+
+
+ScanlineWriter* hxa7241_image::rgbe::openWriter
+(
+   const char*  i_pComment,
+   const dword  i_width,
+   const dword  i_height,
+   const float* i_pPrimaries8,
+   const float  i_exposure,
+   const char   o_pathName[]
+)
+{
+   RowWriter* pWriter = new RowWriter;
+   try
+   {
+      pWriter->open( i_pComment, i_width, i_height, i_pPrimaries8, i_exposure,
+         o_pathName );
+   }
+   catch( ... )
+   {
+      delete pWriter;
+      throw;
+   }
+
+   return pWriter;
+}
+
+
+
+
+
 
 
 
@@ -776,8 +1560,10 @@ void checkDimensions
 
 
 #include <math.h>
+#include <stdio.h>
 #include <fstream>
 #include <sstream>
+#include <iterator>
 #include <exception>
 //#include "FpToInt.hpp"
 //#include "Clamps.hpp"
@@ -813,7 +1599,7 @@ bool test_rgbe
 (
    std::ostream* pOut,
    const bool    isVerbose,
-   const dword   //seed
+   const dword   seed
 )
 {
    bool isOk = true;
@@ -934,6 +1720,255 @@ bool test_rgbe
       if( pOut ) *pOut << "compare : " <<
          (!isFail ? "--- succeeded" : "*** failed") << "\n\n";
       isOk &= !isFail;
+
+      // mapped read matches streamed read, run-length encoded and plain, and
+      // cut-short files are reported
+      {
+         std::ostringstream plain( std::ostringstream::binary );
+         if( pPixelsFp )
+         {
+            hxa7241_image::rgbe::write( "plain", width, height, primaries,
+               exposure, 0, pPixelsFp, plain );
+         }
+         const std::string files[] = { strstr.str(), plain.str() };
+         bool isMappedOk = true;
+
+         for( dword f = 0;  f < 4;  ++f )
+         {
+            static const char FILE_NAME[] = "zzztestmapped.hdr";
+            const std::string& file = files[f & 1];
+            const size_t length = (f < 2) ? file.size() : file.size() - 5;
+            {
+               std::ofstream outf( FILE_NAME, std::ofstream::binary );
+               outf.write( file.data(), static_cast<std::streamsize>(length) );
+            }
+
+            float* pReads[2] = { 0, 0 };
+            dword  sizes[4]  = { 0, 0, 0, 0 };
+            dword  throws    = 0;
+            for( dword r = 0;  r < 2;  ++r )
+            {
+               try
+               {
+                  std::istringstream in( file.substr( 0, length ),
+                     std::istringstream::binary );
+                  if( 0 == r )
+                  {
+                     readFile( FILE_NAME, 0, sizes[0], sizes[1], primaries,
+                        exposure, pReads[0] );
+                  }
+                  else
+                  {
+                     read( in, 0, sizes[2], sizes[3], primaries, exposure,
+                        pReads[1] );
+                  }
+               }
+               catch( const char[] )
+               {
+                  ++throws;
+               }
+            }
+
+            const bool isOk_ = (f < 2) ? (0 == throws) && pReads[0] &&
+               pReads[1] && (sizes[0] == sizes[2]) && (sizes[1] == sizes[3]) &&
+               (0 == ::memcmp( pReads[0], pReads[1],
+               sizes[0] * sizes[1] * 3 * sizeof(float) )) : (2 == throws);
+
+            scratch::release( pReads[0] );
+            scratch::release( pReads[1] );
+            ::remove( FILE_NAME );
+
+            if( pOut && isVerbose ) *pOut << ((f & 1) ? "plain" : "rle") <<
+               ((f < 2) ? "" : " cut short") << " : " << isOk_ << "\n";
+            isMappedOk &= isOk_;
+         }
+
+         if( pOut && isVerbose ) *pOut << "\n";
+
+         if( pOut ) *pOut << "mapped file : " <<
+            (isMappedOk ? "--- succeeded" : "*** failed") << "\n\n";
+         isOk &= isMappedOk;
+      }
+
+      scratch::release( pPixelsFp );
+   }
+
+
+   // write and read: the same across thread counts, and stable through a
+   // read back -- run-length encoded, and plain (too narrow to encode)
+   {
+      udword random = seed ? seed : 521288629u;
+
+      bool isFail = false;
+      for( dword k = 0;  k < 4;  ++k )
+      {
+         const dword width  = (k & 1) ? 5 : 300;
+         const dword height = 301;
+         const dword flags  = (k & 2) ? (IS_LOW_TOP | IS_BGR) : 0;
+
+         // (mostly runs, some noise, some out of range)
+         std::vector<float> triples( width * height * 3 );
+         for( udword i = 0;  i < triples.size();  ++i )
+         {
+            random = 18000u * (random & 0xFFFFu) + (random >> 16);
+            triples[i] = (0 == (random & 0x300)) ?
+               static_cast<float>(random & 0xFFFF) / 1000.0f - 1.0f :
+               static_cast<float>((i / 97) % 13);
+         }
+
+         std::string files[3];
+         for( dword f = 0;  f < 3;  ++f )
+         {
+            ParallelBands::setThreadCount( (1 == f) ? 4 : 1 );
+
+            std::vector<float> read_;
+            if( 2 == f )
+            {
+               dword  w  = 0;
+               dword  h  = 0;
+               float  primaries[8];
+               float  exposure = 0.0f;
+               float* pRead    = 0;
+               std::istringstream in( files[0], std::istringstream::binary );
+               read( in, flags, w, h, primaries, exposure, pRead );
+               read_.assign( pRead, pRead + (w * h * 3) );
+               scratch::release( pRead );
+            }
+
+            std::ostringstream out( std::ostringstream::binary );
+            write( 0, width, height, 0, 0.0f, flags,
+               (2 == f) ? &(read_[0]) : &(triples[0]), out );
+            files[f] = out.str();
+         }
+
+         // read: the same across thread counts
+         std::vector<float> reads[2];
+         for( dword r = 0;  r < 2;  ++r )
+         {
+            ParallelBands::setThreadCount( r ? 4 : 1 );
+
+            dword  w  = 0;
+            dword  h  = 0;
+            float  primaries[8];
+            float  exposure = 0.0f;
+            float* pRead    = 0;
+            std::istringstream in( files[0], std::istringstream::binary );
+            read( in, flags, w, h, primaries, exposure, pRead );
+            reads[r].assign( pRead, pRead + (w * h * 3) );
+            scratch::release( pRead );
+         }
+         ParallelBands::setThreadCount( 0 );
+
+         const bool isRle = (std::string::npos != files[0].find( "_rle_" ));
+         const bool isOk_ = (files[0] == files[1]) && (files[0] == files[2]) &&
+            (isRle == !(k & 1)) && (reads[0].size() == triples.size()) &&
+            (0 == ::memcmp( &(reads[0][0]), &(reads[1][0]),
+            reads[0].size() * sizeof(float) ));
+
+         if( pOut && isVerbose ) *pOut << width << " x " << height <<
+            (isRle ? " rle" : " plain") << ", " << files[0].size() <<
+            " bytes : " << isOk_ << "\n";
+         isFail |= !isOk_;
+      }
+
+      if( pOut && isVerbose ) *pOut << "\n";
+
+      if( pOut ) *pOut << "write and read : " <<
+         (!isFail ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= !isFail;
+   }
+
+   // scanlines: strips of various heights write the same file as whole, and
+   // read back the same as whole -- run-length encoded, and plain
+   {
+      static const char FILE_NAME[] = "zzzteststrip.hdr";
+      static const float PRIMARIES[] = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f,
+         0.06f, 0.3127f, 0.329f };
+
+      udword random = seed ? seed : 521288629u;
+
+      bool isFail = false;
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         const dword width  = k ? 5 : 300;
+         const dword height = 37;
+         const dword pitch  = width * 3;
+
+         std::vector<float> triples( width * height * 3 );
+         for( udword i = 0;  i < triples.size();  ++i )
+         {
+            random = 18000u * (random & 0xFFFFu) + (random >> 16);
+            triples[i] = (0 == (random & 0x300)) ?
+               static_cast<float>(random & 0xFFFF) / 1000.0f :
+               static_cast<float>((i / 97) % 13);
+         }
+
+         // whole, top first
+         std::ostringstream whole( std::ostringstream::binary );
+         write( "strips", width, height, PRIMARIES, 2.0f, IS_LOW_TOP,
+            &(triples[0]), whole );
+
+         // write in strips
+         bool isOk_ = true;
+         {
+            ScanlineWriter* pWriter = openWriter( "strips", width, height,
+               PRIMARIES, 2.0f, FILE_NAME );
+            for( dword y = 0, rows = 1;  y < height;  y += rows, ++rows )
+            {
+               rows = (height - y) < rows ? (height - y) : rows;
+               pWriter->writeRows( rows, &(triples[y * pitch]) );
+            }
+            pWriter->finish();
+            delete pWriter;
+
+            std::ifstream inf( FILE_NAME, std::ifstream::binary );
+            const std::string strip( (std::istreambuf_iterator<char>( inf )),
+               std::istreambuf_iterator<char>() );
+            isOk_ &= (strip == whole.str());
+         }
+
+         // read in strips, compared to whole read
+         {
+            dword  w = 0;
+            dword  h = 0;
+            float  primaries[8];
+            float  exposure = 0.0f;
+            float* pRead    = 0;
+            std::istringstream in( whole.str(), std::istringstream::binary );
+            read( in, IS_LOW_TOP, w, h, primaries, exposure, pRead );
+            const std::vector<float> read_( pRead, pRead + (w * h * 3) );
+            scratch::release( pRead );
+
+            ScanlineReader* pReader = openReader( FILE_NAME, w, h, primaries,
+               exposure );
+            isOk_ &= (0 != pReader) && (width == w) && (height == h) &&
+               (2.0f == exposure);
+            if( pReader )
+            {
+               std::vector<float> strips( triples.size() );
+               for( dword y = 0, rows = 3;  y < height;  y += rows )
+               {
+                  rows = (height - y) < rows ? (height - y) : rows;
+                  pReader->readRows( rows, &(strips[y * pitch]) );
+               }
+               delete pReader;
+
+               isOk_ &= (0 == ::memcmp( &(strips[0]), &(read_[0]),
+                  strips.size() * sizeof(float) ));
+            }
+         }
+         ::remove( FILE_NAME );
+
+         if( pOut && isVerbose ) *pOut << width << " x " << height << " : " <<
+            isOk_ << "\n";
+         isFail |= !isOk_;
+      }
+
+      if( pOut && isVerbose ) *pOut << "\n";
+
+      if( pOut ) *pOut << "scanlines : " <<
+         (!isFail ? "--- succeeded" : "*** failed") << "\n\n";
+      isOk &= !isFail;
    }
 
 
@@ -65,6 +65,8 @@ namespace rgbe
     * Does not condition output values -- you get what is in file, valid or not
     * (except: width and height must be in range).<br/><br/>
     *
+    * The rest of the stream is read into memory, then decoded.<br/><br/>
+    *
     * @o_pPrimaries8  chromaticities of RGB and white:
     *                 { rx, ry, gx, gy, bx, by, wx, wy }.
     *                 all 0 if not present, and should assume sRGB
@@ -85,6 +87,28 @@ namespace rgbe
    );
 
 
+   /**
+    * Read RGBE image file, memory-mapped.<br/><br/>
+    *
+    * As read, but decoded straight from the file's bytes.
+    *
+    * @return  true if read, false if the file could not be mapped (so nothing
+    *          was read -- use read with a stream instead)
+    *
+    * @exceptions throws char[] message and allocation exceptions
+    */
+   bool readFile
+   (
+      const char i_pathName[],
+      dword      i_orderingFlags,
+      dword&     o_width,
+      dword&     o_height,
+      float*     o_pPrimaries8,
+      float&     o_exposure,
+      float*&    o_pTriples
+   );
+
+
    /**
     * Write RGBE image.<br/><br/>
     *
@@ -108,6 +132,50 @@ namespace rgbe
       const float* i_pTriples,
       ostream&     o_outBytes
    );
+
+
+   /**
+    * Open RGBE image file to read a strip of rows at a time, memory-mapped.
+    * <br/><br/>
+    *
+    * Rows top first, as float triples. Where each row starts is found at
+    * open; rows are decoded as read.
+    *
+    * @o_pPrimaries8  as read
+    * @o_exposure     as read
+    * @return         reader (orphaned -- delete it), or 0 if the file could
+    *                 not be mapped
+    *
+    * @exceptions throws char[] message and allocation exceptions
+    */
+   ScanlineReader* openReader
+   (
+      const char i_pathName[],
+      dword&     o_width,
+      dword&     o_height,
+      float*     o_pPrimaries8,
+      float&     o_exposure
+   );
+
+
+   /**
+    * Open RGBE image file to write a strip of rows at a time.<br/><br/>
+    *
+    * Rows top first, as float triples. Parameters as write.
+    *
+    * @return  writer (orphaned -- delete it)
+    *
+    * @exceptions throws char[] message and allocation exceptions
+    */
+   ScanlineWriter* openWriter
+   (
+      const char*  i_pComment,
+      dword        i_width,
+      dword        i_height,
+      const float* i_pPrimaries8,
+      float        i_exposure,
+      const char   o_pathName[]
+   );
 }
 
 
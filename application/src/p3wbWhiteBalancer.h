@@ -25,14 +25,40 @@
  * library (Linux), or access purely dynamically.
  *
  *
- * There are two interface sections: meta-versioning, functions.
+ * There are six interface sections: meta-versioning, functions, asynchronous
+ * functions, sequence functions, strip functions, transfer functions.
  *
  * Versioning meta interface:
  * For checking a dynamically linked library supports the interfaces here.
  *
  * Function interface:
  * Call the function with an image and parameters, and receive a result image.
- * There are two alternatives: all parameters, and simple (uses defaults).
+ * There are four alternatives: all parameters with separate output format,
+ * all parameters with row pitch (for sub-rectangles of larger buffers), all
+ * parameters, and simple (uses defaults).
+ * And variants for a list of colors instead of an image (for palettes), for
+ * Y'CbCr planes with subsampled chroma (for video frames), and for a set of
+ * images sharing one estimated illuminant (for shots and series).
+ *
+ * Asynchronous function interface:
+ * Submit an image and parameters, receive a job handle, and later wait for the
+ * result image. Jobs run on the library's internal worker pool (one thread per
+ * processor), so the caller's thread is free meanwhile.
+ *
+ * Sequence function interface:
+ * Open a context, give it each frame of a video or animation in turn, and
+ * close it. The illuminant is smoothed over frames, and fully re-estimated
+ * only at scene cuts.
+ *
+ * Strip function interface:
+ * Open a context, give it each strip of rows of an image to estimate, then
+ * each again to balance, and close it. For images too big to hold: only one
+ * strip need be in memory at a time.
+ *
+ * Transfer function interface:
+ * Measure the color statistics of a reference image, then give them with each
+ * image or frame to take on the reference's look, instead of white balancing.
+ * The statistics are plain numbers, and can be stored as text.
  */
 
 
@@ -49,6 +75,22 @@ extern "C" {
 
 
 
+/*= types ====================================================================*/
+
+/**
+ * 64-bit signed integer, for byte offsets.
+ */
+#if defined(_MSC_VER)
+typedef __int64 p3wbInt64;
+#elif defined(__GNUC__)
+typedef int p3wbInt64 __attribute__((__mode__(__DI__)));
+#else
+typedef long long p3wbInt64;
+#endif
+
+
+
+
 /*= version meta-interface ===================================================*/
 
 /**
@@ -191,6 +233,644 @@ int p3wbWhiteBalance2
 );
 
 
+/**
+ * White balance an image, with full parameters, and row pitch.
+ *
+ * As p3wbWhiteBalance2, plus a row pitch, so a sub-rectangle of a larger
+ * buffer can be balanced in place: point the pixel pointers at its first pixel,
+ * and give the larger buffer's row pitch.
+ *
+ * @i_rowPitch       number of bytes to add to a pixel pointer to get the pixel
+ *                   in the next row, may be negative (for bottom-up storage),
+ *                   magnitude >= i_width * pixel stride
+ *                   (give 0 for default: i_width * pixel stride)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbWhiteBalance3
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_formatFlags,
+   unsigned int i_pixelStride,
+   p3wbInt64    i_rowPitch,
+   const float* i_inPixels,
+   float*       o_outPixels,
+   char*        o_message128
+);
+
+
+/**
+ * White balance an image, with full parameters, and separate input and output
+ * pixel formats.
+ *
+ * As p3wbWhiteBalance3, but the output can have a different format, and the
+ * conversion is done in the same pass: for example, float RGB linear in, and
+ * BGRA8 sRGB with constant alpha out.
+ *
+ * @i_inFormatFlags    input pixel format, from the options/constants header
+ * @i_inPixelStride    number of bytes to add to a pixel pointer to get next
+ *                     (give 0 for default: packed channels)
+ * @i_inRowPitch       number of bytes to add to a pixel pointer to get the
+ *                     pixel in the next row, may be negative
+ *                     (give 0 for default: i_width * pixel stride)
+ * @i_inPixels         array of input pixels, format as i_inFormatFlags
+ * @i_outFormatFlags   output pixel format, from the options/constants header
+ * @i_outPixelStride   as i_inPixelStride, for output
+ * @i_outRowPitch      as i_inRowPitch, for output
+ * @i_outAlpha         alpha value written, if output format has alpha,
+ *                     >= 0 and <= 1
+ * @o_outPixels        array of output pixels, format as i_outFormatFlags
+ *                     (may point to same array as input pixels, only if
+ *                     format and layout are the same)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbWhiteBalance4
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_outPixels,
+   char*        o_message128
+);
+
+
+/**
+ * White balance a list of colors, with full parameters.
+ *
+ * As p3wbWhiteBalance2, but for any set of colors instead of an image: for
+ * example, the palette of an indexed image, estimating from a histogram of
+ * index counts, so only the palette entries need mapping.
+ *
+ * @i_count            number of colors
+ * @i_inColors         array of i_count RGB float triples
+ * @i_weights          array of i_count weights, each >= 0, for estimating
+ *                     the illuminant -- for example, pixel counts
+ *                     (give 0 for all equal)
+ * @o_outColors        array of i_count RGB float triples
+ *                     (may point to same array as input colors)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbWhiteBalanceColors
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_count,
+   const float* i_inColors,
+   const float* i_weights,
+   float*       o_outColors,
+   char*        o_message128
+);
+
+
+
+/**
+ * White balance a video frame of Y'CbCr planes, with full parameters.
+ *
+ * As p3wbWhiteBalance2, but for 8-bit Y'CbCr planes with 4:2:0, 4:2:2, or
+ * 4:4:4 chroma, without converting the frame to RGB. The illuminant is
+ * estimated, and the correction computed, once per chroma sample; chroma
+ * samples are written directly, and luma samples are only scaled to restore
+ * luminance. R'G'B' is taken as sRGB-encoded (close to BT.709).
+ *
+ * @i_width          width of luma plane, in samples
+ * @i_height         height of luma plane, in samples
+ * @i_ycbcrFlags     subsampling, matrix, and range, from the options/constants
+ *                   header
+ * @i_lumaPitch      number of bytes to add to a luma sample pointer to get the
+ *                   one in the next row, may be negative
+ *                   (give 0 for default: i_width)
+ * @i_chromaPitch    as i_lumaPitch, for chroma samples
+ *                   (give 0 for default: chroma width * i_chromaStride)
+ * @i_chromaStride   number of bytes to add to a chroma sample pointer to get
+ *                   next: 1 for separate Cb and Cr planes, 2 for interleaved
+ *                   (as NV12, with i_inCr = i_inCb + 1)
+ *                   (give 0 for default: 1)
+ * @i_inLuma         input Y' plane
+ * @i_inCb           input Cb plane
+ * @i_inCr           input Cr plane
+ * @o_outLuma        output Y' plane, layout as input
+ * @o_outCb          output Cb plane, layout as input
+ * @o_outCr          output Cr plane, layout as input
+ *                   (outputs may point to same planes as inputs)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbWhiteBalanceYCbCr
+(
+   const float*         i_colorSpace6,
+   const float*         i_whitePoint2,
+   const float*         i_inIlluminant3,
+   unsigned int         i_options,
+   float                i_strength,
+   unsigned int         i_width,
+   unsigned int         i_height,
+   unsigned int         i_ycbcrFlags,
+   p3wbInt64            i_lumaPitch,
+   p3wbInt64            i_chromaPitch,
+   unsigned int         i_chromaStride,
+   const unsigned char* i_inLuma,
+   const unsigned char* i_inCb,
+   const unsigned char* i_inCr,
+   unsigned char*       o_outLuma,
+   unsigned char*       o_outCb,
+   unsigned char*       o_outCr,
+   char*                o_message128
+);
+
+
+/**
+ * One image of a set, for p3wbWhiteBalanceSet. Fields as the same-named
+ * parameters of p3wbWhiteBalance4.
+ */
+typedef struct
+{
+   unsigned int width;
+   unsigned int height;
+   unsigned int inFormatFlags;
+   unsigned int inPixelStride;
+   p3wbInt64    inRowPitch;
+   const void*  inPixels;
+   unsigned int outFormatFlags;
+   unsigned int outPixelStride;
+   p3wbInt64    outRowPitch;
+   float        outAlpha;
+   void*        outPixels;
+} p3wbImage;
+
+
+/**
+ * White balance a set of images with one shared illuminant, with full
+ * parameters.
+ *
+ * As p3wbWhiteBalance4, but for several images -- for example, the frames of a
+ * shot, or a product photo series -- so they all get the same correction. The
+ * illuminant is estimated from all the images pooled, as if they were one.
+ * Images are processed concurrently on the library's internal worker pool,
+ * which is used in both passes (estimate, then map), so the calling thread
+ * waits.
+ *
+ * @i_count            number of images
+ * @i_images           array of i_count images
+ *
+ * @return  1 means succeeded, 0 means failed (some output images may have
+ *          been written)
+ */
+int p3wbWhiteBalanceSet
+(
+   const float*     i_colorSpace6,
+   const float*     i_whitePoint2,
+   const float*     i_inIlluminant3,
+   unsigned int     i_options,
+   float            i_strength,
+   unsigned int     i_count,
+   const p3wbImage* i_images,
+   char*            o_message128
+);
+
+
+
+
+
+
+
+/*= asynchronous functions ===================================================*/
+
+/**
+ * Handle to a submitted job.
+ */
+typedef struct p3wbJobTag* p3wbJob;
+
+
+/**
+ * Return values for p3wbPoll().
+ */
+enum p3wbEJobStatus
+{
+   p3wb_JOB_QUEUED    = 0,
+   p3wb_JOB_RUNNING   = 1,
+   p3wb_JOB_SUCCEEDED = 2,
+   p3wb_JOB_FAILED    = 3,
+   p3wb_JOB_CANCELLED = 4
+};
+
+
+/**
+ * Submit an image to be white balanced, with full parameters, and return
+ * immediately.
+ *
+ * Parameters are as p3wbWhiteBalance4, except:
+ * * parameter arrays are copied, so need not outlive the call
+ * * pixel arrays must stay valid until the job has finished
+ *
+ * @i_notifyFd     file descriptor (eventfd, or write end of a pipe), to which
+ *                 an 8-byte count of 1 is written when the job finishes,
+ *                 for use in a select/poll/epoll loop
+ *                 (give -1 for none) (ignored on Windows)
+ * @o_message128   string for exception message 128 chars long (or 0),
+ *                 will be zero-terminated
+ *
+ * @return  job handle, to be released by p3wbWait(), or 0 if failed
+ */
+p3wbJob p3wbSubmit
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_outPixels,
+   int          i_notifyFd,
+   char*        o_message128
+);
+
+
+/**
+ * Get the status of a job, without blocking.
+ *
+ * @return  a p3wbEJobStatus value
+ */
+int p3wbPoll
+(
+   p3wbJob i_job
+);
+
+
+/**
+ * Block until a job has finished, then release its handle.
+ *
+ * Must be called exactly once for each handle from p3wbSubmit(), including
+ * cancelled ones.
+ *
+ * @i_job          job handle, invalid after this call
+ * @o_message128   string for exception message 128 chars long (or 0),
+ *                 will be zero-terminated
+ *
+ * @return  1 means succeeded, 0 means failed or cancelled
+ */
+int p3wbWait
+(
+   p3wbJob i_job,
+   char*   o_message128
+);
+
+
+/**
+ * Request a job be cancelled. Does not block.
+ *
+ * A queued job will not start, a running job stops soon after.
+ *
+ * @return  1 means the job will end cancelled, 0 means it had already finished
+ */
+int p3wbCancel
+(
+   p3wbJob i_job
+);
+
+
+
+
+
+
+
+
+/*= sequence functions =======================================================*/
+
+/**
+ * Handle to a sequence context.
+ */
+typedef struct p3wbSequenceTag* p3wbSequence;
+
+
+/**
+ * Open a context for white balancing a sequence of frames (video, animation).
+ *
+ * Instead of estimating each frame fully (which flickers, and costs a pass per
+ * frame), each frame is estimated from a sparse sample, and the illuminant is
+ * smoothed over frames. A full estimate, restarting the smoothing, is made
+ * only at a scene cut: when a histogram of the sample's chroma differs from
+ * the previous frame's by more than a threshold.
+ *
+ * Parameters are as p3wbWhiteBalance4 (copied, so need not outlive the call),
+ * plus:
+ *
+ * @i_smoothing      weight of the previous illuminant against each frame's
+ *                   estimate, >= 0 and < 1 (0 means no smoothing)
+ *                   (give -1 for default: 0.8)
+ * @i_cutThreshold   chroma histogram difference (total variation) counting as
+ *                   a scene cut, >= 0 and <= 1 (0 means always, 1 never)
+ *                   (give -1 for default: 0.3)
+ * @o_message128     string for exception message 128 chars long (or 0),
+ *                   will be zero-terminated
+ *
+ * @return  sequence handle, to be released by p3wbSequenceClose(), or 0 if
+ *          failed
+ */
+p3wbSequence p3wbSequenceOpen
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   float        i_strength,
+   float        i_smoothing,
+   float        i_cutThreshold,
+   char*        o_message128
+);
+
+
+/**
+ * White balance the next frame of a sequence.
+ *
+ * Parameters are as p3wbWhiteBalance4. Frames may differ in size and format.
+ * One frame at a time per sequence. A failed frame leaves the sequence as it
+ * was.
+ *
+ * @o_isCut          set to 1 if the frame was a scene cut (or the first), so
+ *                   fully estimated, else 0 (or give 0)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbSequenceFrame
+(
+   p3wbSequence i_sequence,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_outPixels,
+   int*         o_isCut,
+   char*        o_message128
+);
+
+
+/**
+ * Release a sequence handle.
+ *
+ * @i_sequence   sequence handle, invalid after this call (0 is ignored)
+ */
+void p3wbSequenceClose
+(
+   p3wbSequence i_sequence
+);
+
+
+
+
+
+
+
+
+/*= strip functions ==========================================================*/
+
+/**
+ * Handle to a strips context.
+ */
+typedef struct p3wbStripsTag* p3wbStrips;
+
+
+/**
+ * Open a context for white balancing an image in strips of rows.
+ *
+ * For images too big to hold whole: give every strip to p3wbStripsEstimate,
+ * then every strip (read again, or kept) to p3wbStripsBalance. Each is
+ * balanced with the illuminant pooled from all -- so the result is as
+ * p3wbWhiteBalance4 on the whole image (to within summing order, and, with
+ * p3wb13_ROBUST, the quantile sketches' accuracy). Strips may be any heights,
+ * in any order.
+ *
+ * Parameters are as p3wbWhiteBalance4 (copied, so need not outlive the call),
+ * plus:
+ *
+ * @o_message128     string for exception message 128 chars long (or 0),
+ *                   will be zero-terminated
+ *
+ * @return  strips handle, to be released by p3wbStripsClose(), or 0 if failed
+ */
+p3wbStrips p3wbStripsOpen
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   char*        o_message128
+);
+
+
+/**
+ * Add a strip to the estimate.
+ *
+ * Parameters are as the input parameters of p3wbWhiteBalance4. One strip at a
+ * time per context. A failed strip leaves the estimate as it was.
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbStripsEstimate
+(
+   p3wbStrips   i_strips,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   char*        o_message128
+);
+
+
+/**
+ * White balance a strip, with the estimate from all strips added (so, after
+ * they all are).
+ *
+ * Parameters are as p3wbWhiteBalance4. One strip at a time per context.
+ *
+ * @return  1 means succeeded, 0 means failed (or none estimated yet)
+ */
+int p3wbStripsBalance
+(
+   p3wbStrips   i_strips,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_outPixels,
+   char*        o_message128
+);
+
+
+/**
+ * Release a strips handle.
+ *
+ * @i_strips     strips handle, invalid after this call (0 is ignored)
+ */
+void p3wbStripsClose
+(
+   p3wbStrips i_strips
+);
+
+
+
+
+
+
+
+
+/*= transfer functions =======================================================*/
+
+/**
+ * Color statistics of an image, for color transfer: count, mean, and sum of
+ * squared deviations (M2), per axis of Ruderman (log cone) space.
+ *
+ * Plain numbers, so they can be kept and reused freely -- and stored, with
+ * p3wbStatsToText.
+ */
+typedef struct
+{
+   double count;
+   double mean[3];
+   double m2[3];
+} p3wbStats;
+
+
+/**
+ * Measure the color statistics of an image.
+ *
+ * One pass, on the library's internal worker pool. NaN and black pixels are
+ * left out. Parameters are as the input parameters of p3wbWhiteBalance4, plus:
+ *
+ * @o_stats          stats to write
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbColorStats
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_inPixels,
+   p3wbStats*   o_stats,
+   char*        o_message128
+);
+
+
+/**
+ * Transfer the look of a reference image onto an image (instead of white
+ * balancing it).
+ *
+ * Each Ruderman axis of the image is shifted and scaled so its mean and
+ * standard deviation match the reference's (Reinhard et al., 'Color Transfer
+ * between Images', 2001). Only the reference's stats are needed, so measure
+ * them once and transfer onto any number of images or frames. Runs on the
+ * library's internal worker pool. Black and NaN pixels pass through.
+ *
+ * Parameters are as p3wbWhiteBalance4 (options: only p3wb13_NO_MEMO applies),
+ * plus:
+ *
+ * @i_reference      stats of the reference image (count must be > 0)
+ * @i_target         stats of this image, if already measured, to save a pass
+ *                   (or give 0)
+ * @i_strength       fraction of the transfer, >= 0 and <= 1
+ *                   (give -1 for default: 1)
+ *
+ * @return  1 means succeeded, 0 means failed
+ */
+int p3wbColorTransfer
+(
+   const float*     i_colorSpace6,
+   const float*     i_whitePoint2,
+   const p3wbStats* i_reference,
+   const p3wbStats* i_target,
+   unsigned int     i_options,
+   float            i_strength,
+   unsigned int     i_width,
+   unsigned int     i_height,
+   unsigned int     i_inFormatFlags,
+   unsigned int     i_inPixelStride,
+   p3wbInt64        i_inRowPitch,
+   const void*      i_inPixels,
+   unsigned int     i_outFormatFlags,
+   unsigned int     i_outPixelStride,
+   p3wbInt64        i_outRowPitch,
+   float            i_outAlpha,
+   void*            o_outPixels,
+   char*            o_message128
+);
+
+
+/**
+ * Write color stats as one line of text, that reads back exactly.
+ *
+ * @o_text256        string 256 chars long, will be zero-terminated
+ */
+void p3wbStatsToText
+(
+   const p3wbStats* i_stats,
+   char*            o_text256
+);
+
+
+/**
+ * Read color stats from text made by p3wbStatsToText.
+ *
+ * @return  1 means succeeded, 0 means failed (text not valid stats)
+ */
+int p3wbStatsFromText
+(
+   const char* i_text,
+   p3wbStats*  o_stats,
+   char*       o_message128
+);
+
+
 
 
 
@@ -28,6 +28,18 @@
 */
 
 
+#ifdef _PLATFORM_WIN
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>   // kernel32.lib
+
+#elif _PLATFORM_LINUX
+
+#include <sys/time.h>
+
+#endif
+
 #include <stdlib.h>
 #include <time.h>
 
@@ -36,14 +48,22 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <exception>
 
 #include "Primitives.hpp"
+#include "ScratchMemory.hpp"
+#include "Threads.hpp"
+#include "ParallelBands.hpp"
+#include "BoundedQueue.hpp"
+#include "FileList.hpp"
 
 #include "ImageAdopter.hpp"
 #include "ImageFormatter.hpp"
+#include "IndexedImage.hpp"
+#include "ScanlineCodec.hpp"
 
-#include "p3wbWhiteBalancer-v12.h"
+#include "p3wbWhiteBalancer-v13.h"
 
 
 
@@ -53,11 +73,12 @@ using std::string;
 using std::vector;
 using hxa7241_image::ImageFormatter;
 using hxa7241_image::ImageAdopter;
+using hxa7241_image::IndexedImage;
 
 
 
 
-#define NAME "P3 WhiteBalancer v1.2"
+#define NAME "P3 WhiteBalancer v1.3"
 #define TITLE "----------------------------------------------------------------------\n"\
 "  "NAME"\n"\
 "\n"\
@@ -87,6 +108,8 @@ TITLE
 "usage:\n"
 "  p3whitebalancer {--help|-?}\n"
 "  p3whitebalancer [options] [-x:optionsFilePathName] [-z] imageFilePathName\n"
+"  p3whitebalancer [options] [-x:optionsFilePathName] [-z] {directory|\n"
+"     wildcardPattern|@manifestFilePathName}\n"
 "\n"
 "options (with defaults shown):\n"
 "  image formatting libraries:\n"
@@ -99,12 +122,66 @@ TITLE
 "   -ii:<3 floats>  original illuminant (rgb): estimated from image\n"
 "  mapping options:\n"
 "   -ms:<float>     strength (0-1): 0.8\n"
-"  output file name:\n"
+"   -mr:<int>       robust estimation, ignoring highlights (0 or 1): 0\n"
+"  color transfer (instead of balancing):\n"
+"   -tr:<string>    reference image path name: none\n"
+"   -ts:<string>    reference stats file path name: none\n"
+"  output file:\n"
 "   -on:<string>    output file path name (no ext): inputFilePathName_p3wb\n"
+"   -oe:<string>    openexr compression (none, rle, zips, zip, piz, pxr24,\n"
+"                   b44): piz\n"
+"   -ot:<int>       openexr tile size (0 for scanlines): 0\n"
+"   -op:<string>    png encoding (fast, small, or level_strategy_filter):\n"
+"                   small\n"
+"  frame sequence:\n"
+"   -sf:<int>       frame count: 1\n"
+"   -ss:<float>     illuminant smoothing (0-1): 0.8\n"
+"   -sc:<float>     scene-cut threshold (0-1): 0.3\n"
+"  out-of-core:\n"
+"   -cm:<float>     memory limit per image buffer (MB): none\n"
+"   -cd:<string>    scratch file directory: system temporary directory\n"
+"   -cs:<float>     stream in strips, within this memory (MB): none\n"
+"  batch:\n"
+"   -bj:<int>       worker count: processor count\n"
+"   -bm:<float>     memory limit for images in flight (MB): 1024\n"
 "\n"
-"image file name must be last, and must end in '.ppm', '.png',\n"
+"image file name must be last, and must end in '.ppm', '.pfm', '.png',\n"
 ".exr', '.hdr', '.pic', '.rad', or '.rgbe'.\n"
 "\n"
+"for a frame sequence, the image file name is the first frame, and the last\n"
+"number in it is counted up for the others (keeping its width). The output\n"
+"file path name, if given, gets the same number appended. Frames are read\n"
+"and written while others are balanced.\n"
+"\n"
+"color transfer gives the image (or each frame) the look of the reference:\n"
+"the mean and spread of its colors. -ms is the strength (default 1). With\n"
+"-tr and -ts, the reference's stats are written to the file; with -ts only,\n"
+"they are read from it (so the reference need not be read again).\n"
+"\n"
+"image buffers bigger than the memory limit are put in a memory-mapped\n"
+"scratch file instead, and balanced in strips -- for images bigger than\n"
+"physical memory.\n"
+"\n"
+"-oe sets how OpenEXR output is compressed: zips or none write many times\n"
+"faster than piz, but bigger; pxr24 and b44 lose some precision. -ot writes\n"
+"it in square tiles (64 is usual) instead of scanlines.\n"
+"\n"
+"-op sets how PNG output is compressed: fast (level 1, no filter) writes\n"
+"much faster than small (level 9, adaptive filter), but bigger. Or give a\n"
+"zlib level 0-9, strategy (default, filtered, huffman, rle), and filter\n"
+"(none, sub, up, average, paeth, adaptive), eg: 6_rle_up. Bigger images are\n"
+"deflated in parallel when zlib can be loaded.\n"
+"\n"
+"-cs streams the image instead: read in strips of rows (as many as fit the\n"
+"memory given) twice, to estimate and then to balance and write -- so it is\n"
+"never whole in memory. Palette and interlaced PNGs are read whole.\n"
+"\n"
+"a batch -- a directory, wildcard pattern, or manifest file listing a path\n"
+"name per line -- is balanced by a pool of workers, an image each at a time.\n"
+"An image starts only when its memory (from its size) fits under the limit\n"
+"with the others in flight. -on is the output directory. Failed images are\n"
+"reported, and the rest carry on; a summary is printed at the end.\n"
+"\n"
 "optionsFilePathName defaults to 'p3whitebalancer-opt.txt'\n"
 "\n"
 "-z switches on some feedback\n"
@@ -112,6 +189,13 @@ TITLE
 "example:\n"
 "  p3whitebalancer somerendering.exr\n"
 "  p3whitebalancer -ms:0.6 -on:resultimage somerendering.png\n"
+"  p3whitebalancer -sf:240 animation0001.exr\n"
+"  p3whitebalancer -cm:4096 -cd:/scratch aerialmosaic.ppm\n"
+"  p3whitebalancer -cs:256 aerialmosaic.hdr\n"
+"  p3whitebalancer -oe:zips -ot:64 -on:scratch someimage.exr\n"
+"  p3whitebalancer -op:fast -on:preview somerendering.png\n"
+"  p3whitebalancer -tr:graded.exr -ts:look.txt -sf:240 shot0001.exr\n"
+"  p3whitebalancer -bj:8 -bm:4096 -on:balanced \"renders/*.exr\"\n"
 "\n";
 const char BANNER_MESSAGE[] =
 "  "NAME"  :  http://www.hxa7241.org/\n";
@@ -135,6 +219,118 @@ const char BAD_GAMMA_OPTION[]      = "bad gamma option value";
 const char BAD_STRENGTH_OPTION[]   = "bad strength option value";
 const char BAD_COLORSPACE_OPTION[] = "bad colorspace option value";
 const char BAD_WHITEPOINT_OPTION[] = "bad whitepoint option value";
+const char BAD_FRAMES_OPTION[]     = "bad frame count option value";
+const char BAD_SMOOTHING_OPTION[]  = "bad smoothing option value";
+const char BAD_CUT_OPTION[]        = "bad scene-cut option value";
+const char BAD_MEMORY_OPTION[]     = "bad memory limit option value";
+const char BAD_COMPRESSION_OPTION[] = "bad compression option value";
+const char BAD_TILE_OPTION[]       = "bad tile size option value";
+const char BAD_ENCODING_OPTION[]   = "bad png encoding option value";
+const char NO_FRAME_NUMBER[]       = "no frame number in image file name";
+const char BAD_STATS_READ[]        = "could not read color stats file";
+const char BAD_STATS_WRITE[]       = "could not write color stats file";
+const char BAD_WORKERS_OPTION[]    = "bad batch workers option value";
+const char BAD_MANIFEST_READ[]     = "could not read batch manifest file";
+const char NO_BATCH_IMAGES[]       = "no images found for batch";
+const char BATCH_FAILED[]          = "some batch images failed";
+const char STREAM_REREAD_FAILED[]  = "could not read image again to stream";
+const char STREAM_WRITE_FAILED[]   = "could not write image as a stream";
+
+// (bytes per pixel an image is charged while in flight: float pixels, and
+// the file's pixels or a converted copy beside them)
+const qword BATCH_PIXEL_BYTES = 16;
+const float BATCH_MEMORY_DEFAULT = 1024.0f;
+
+// (bytes per pixel a streamed strip is charged: float pixels, the file's
+// pixels and their conversions beside them, and working space)
+const qword STREAM_PIXEL_BYTES = 32;
+
+// (frames waiting between pipeline stages: so at most five are in memory --
+// one being read, one balanced, one written, and one in each queue)
+const udword PIPELINE_QUEUE_LENGTH = 1;
+
+
+/// types ----------------------------------------------------------------------
+/**
+ * Shared state of a batch: its images, and the progress of its workers.
+ *
+ * Workers take the next image in order, but only start it when its memory
+ * charge fits under the limit with those in flight (or none are in flight);
+ * otherwise they wait for one to finish.
+ */
+struct Batch
+{
+   // constant
+   const ImageFormatter*          pFormatter;
+   const std::map<string,string>* pOptions;
+   float                          enGamma;
+   bool                           isFeedback;
+   const p3wbStats*               pReference;
+   vector<string>                 inPathnames;
+   vector<string>                 outPathnames;
+   vector<qword>                  charges;
+   qword                          memoryLimit;
+
+   // shared, under mutex
+   hxa7241_general::Mutex         mutex;
+   hxa7241_general::Semaphore     released;
+   udword                         next;
+   udword                         waiting;
+   qword                          inFlight;
+   qword                          inFlightPeak;
+   udword                         failed;
+   qword                          pixels;
+};
+
+
+/**
+ * The middle stage of a frame pipeline, run on each frame in order.
+ */
+class FrameBalancer
+{
+public:
+   virtual     ~FrameBalancer() {}
+   virtual void balance( udword        index,
+                         ImageAdopter& image ) = 0;
+};
+
+
+struct Frame
+{
+   udword       index;
+   ImageAdopter image;
+};
+
+
+/**
+ * Shared state of a frame pipeline: a reader thread, the caller balancing,
+ * and a writer thread, connected by short queues.
+ *
+ * So reading and writing overlap balancing -- while keeping frame order. A
+ * failure anywhere closes the queues, stopping all stages.
+ */
+struct FramePipeline
+{
+   explicit FramePipeline( udword queueLength )
+    : read( queueLength )
+    , balanced( queueLength )
+   {
+   }
+
+   // constant
+   const ImageFormatter*                pFormatter;
+   float                                deGamma;
+   float                                enGamma;
+   const vector<string>*                pInPathnames;
+   const vector<string>*                pOutPathnames;
+
+   // shared
+   hxa7241_general::BoundedQueue<Frame*> read;
+   hxa7241_general::BoundedQueue<Frame*> balanced;
+
+   hxa7241_general::Mutex               mutex;
+   string                               failure;
+};
 
 
 /// support declarations -------------------------------------------------------
@@ -191,6 +387,150 @@ void tokenize
    vector<string>& tokens
 );
 
+void whiteBalanceFrames
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          enGamma,
+   bool                           isFeedback,
+   const string&                  firstPathname,
+   udword                         frameCount
+);
+
+void transferFrames
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          enGamma,
+   bool                           isFeedback,
+   const string&                  firstPathname,
+   udword                         frameCount
+);
+
+void getReferenceStats
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          deGamma,
+   bool                           isFeedback,
+   p3wbStats&                     stats
+);
+
+qword balanceFile
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          enGamma,
+   bool                           isFeedback,
+   const string&                  inPathname,
+   const string&                  outPathname
+);
+
+qword balanceStream
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          enGamma,
+   bool                           isFeedback,
+   qword                          memoryBytes,
+   const string&                  inPathname,
+   const string&                  outPathname
+);
+
+qword transferFile
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const p3wbStats&               reference,
+   float                          enGamma,
+   bool                           isFeedback,
+   const string&                  inPathname,
+   const string&                  outPathname
+);
+
+void transferImage
+(
+   const std::map<string,string>& options,
+   const p3wbStats&               reference,
+   ImageAdopter&                  image
+);
+
+bool isBatch
+(
+   const string& imagePathname
+);
+
+void balanceBatch
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   float                          enGamma,
+   bool                           isFeedback,
+   const string&                  imagesPathname
+);
+
+void listBatch
+(
+   const string&   imagesPathname,
+   vector<string>& inPathnames
+);
+
+void batchWorker
+(
+   void* pBatch
+);
+
+void pipelineFrames
+(
+   const ImageFormatter& formatter,
+   float                 enGamma,
+   const vector<string>& inPathnames,
+   const vector<string>& outPathnames,
+   FrameBalancer&        balancer
+);
+
+void finishPipeline
+(
+   FramePipeline&           pipeline,
+   hxa7241_general::Thread* pReader,
+   hxa7241_general::Thread* pWriter
+);
+
+void readFrames
+(
+   void* pPipeline
+);
+
+void writeFrames
+(
+   void* pPipeline
+);
+
+void stopPipeline
+(
+   FramePipeline& pipeline,
+   const string&  failure
+);
+
+void makeFramePathnames
+(
+   const string&   firstPathname,
+   udword          frameCount,
+   const string&   outOption,
+   vector<string>& inPathnames,
+   vector<string>& outPathnames
+);
+
+string describeException();
+
+double getWallSeconds();
+
+void makeStrips
+(
+   const ImageAdopter& image,
+   vector<p3wbImage>&  strips
+);
+
 void makeOutPathname
 (
    const string& inPathname,
@@ -198,6 +538,14 @@ void makeOutPathname
    string&       outPathname
 );
 
+void makeFramePathname
+(
+   const string& firstPathname,
+   udword        index,
+   string&       framePathname,
+   string&       frameNumber
+);
+
 void checkGamma
 (
    float
@@ -214,7 +562,48 @@ void checkStrength
    float
 );
 
+unsigned int getBalancingOptions
+(
+   const std::map<string,string>& options
+);
+
+udword checkFrames
+(
+   float
+);
+
+udword checkWorkers
+(
+   float
+);
+
+udword checkTileSize
+(
+   float
+);
+
+void checkUnit
+(
+   float,
+   const char*
+);
+
+qword checkMemory
+(
+   float
+);
+
+void displayImageData
+(
+   const ImageAdopter& image
+);
+
 void displayImageData
+(
+   const IndexedImage& image
+);
+
+void displayImageMetadata
 (
    const ImageAdopter& image
 );
@@ -224,175 +613,1442 @@ void displayImageData
 
 
 
-/// entry point ////////////////////////////////////////////////////////////////
-int main
+/// entry point ////////////////////////////////////////////////////////////////
+int main
+(
+   int   argc,
+   char* argv[]
+)
+{
+   int returnValue = EXIT_FAILURE;
+
+   // catch everything
+   try
+   {
+      // check for help request
+      if( (argc <= 1) || (std::string(argv[1]) == SWITCH_HELP1) ||
+         (std::string(argv[1]) == SWITCH_HELP2) )
+      {
+         // output help
+         std::cout << HELP_MESSAGE;
+
+         returnValue = EXIT_SUCCESS;
+      }
+      // execute
+      else
+      {
+         std::cout << BANNER_MESSAGE;
+
+         whiteBalance( argc, argv );
+
+         returnValue = EXIT_SUCCESS;
+      }
+   }
+   // print exception message
+   catch( const std::exception& e )
+   {
+      std::cout << '\n' << EXCEPTION_PREFIX << e.what() << '\n';
+   }
+   catch( const char*const pExceptionString )
+   {
+      std::cout << '\n' << EXCEPTION_PREFIX << pExceptionString << '\n';
+   }
+   catch( const std::string exceptionString )
+   {
+      std::cout << '\n' << EXCEPTION_PREFIX << exceptionString << '\n';
+   }
+   catch( ... )
+   {
+      std::cout << '\n' << EXCEPTION_PREFIX << EXCEPTION_ABSTRACT << '\n';
+   }
+
+   try
+   {
+      std::cout.flush();
+   }
+   catch( ... )
+   {
+      // suppress exceptions
+   }
+
+   return returnValue;
+}
+
+
+
+
+/// other functions ------------------------------------------------------------
+namespace
+{
+
+void whiteBalance
+(
+   int   argc,
+   char* argv[]
+)
+{
+   // get input image pathname, and basic options
+   bool                    isFeedback;
+   string                  inImagePathname;
+   std::map<string,string> options;
+   getInitialOptions( argc, argv, isFeedback, inImagePathname, options );
+
+   // make formatter, with output encoding options
+   ImageFormatter formatter( getOptionS( options, "le" ).c_str(),
+      getOptionS( options, "lp" ).c_str() );
+   if( !formatter.setExrCompression( getOptionS( options, "oe" ).c_str() ) )
+   {
+      throw BAD_COMPRESSION_OPTION;
+   }
+   formatter.setExrTileSize( checkTileSize( getOptionF( options, "ot",
+      0.0f ) ) );
+   if( !formatter.setPngEncoding( getOptionS( options, "op" ).c_str() ) )
+   {
+      throw BAD_ENCODING_OPTION;
+   }
+
+   // get gamma option
+   const float enGamma = getOptionF( options, "ig", 0.0f );
+   checkGamma( enGamma );
+
+   // set where big image buffers go
+   hxa7241_general::scratch::setOutOfCore(
+      checkMemory( getOptionF( options, "cm", 0.0f ) ),
+      getOptionS( options, "cd" ).c_str() );
+
+   // batch: many images, balanced (or transferred onto) in parallel, instead
+   const udword frameCount = checkFrames( getOptionF( options, "sf", 1.0f ) );
+   if( isBatch( inImagePathname ) )
+   {
+      if( frameCount > 1 )
+      {
+         std::cout << "\n" << "(frame count option unused for batch)\n";
+      }
+      balanceBatch( formatter, options, enGamma, isFeedback,
+         inImagePathname );
+      return;
+   }
+
+   // color transfer: transfer a reference's look onto each frame, instead
+   if( !getOptionS( options, "tr" ).empty() ||
+      !getOptionS( options, "ts" ).empty() )
+   {
+      transferFrames( formatter, options, enGamma, isFeedback,
+         inImagePathname, frameCount );
+      return;
+   }
+
+   // frame sequence: balance each frame in turn, instead
+   if( frameCount > 1 )
+   {
+      whiteBalanceFrames( formatter, options, enGamma, isFeedback,
+         inImagePathname, frameCount );
+      return;
+   }
+
+   // single image
+   string outImagePathname( getOptionS( options, "on" ) );
+   makeOutPathname( inImagePathname, outImagePathname, outImagePathname );
+   balanceFile( formatter, options, enGamma, isFeedback, inImagePathname,
+      outImagePathname );
+}
+
+
+qword balanceFile
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const string&                  inPathname,
+   const string&                  outPathname
+)
+{
+   // stream: balance in strips through the files, instead (if it can be)
+   {
+      const qword streamBytes = checkMemory( getOptionF( options, "cs",
+         0.0f ) );
+      if( streamBytes > 0 )
+      {
+         const qword pixelCount = balanceStream( formatter, options, enGamma,
+            isFeedback, streamBytes, inPathname, outPathname );
+         if( pixelCount > 0 )
+         {
+            return pixelCount;
+         }
+      }
+   }
+
+   const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+
+   // read image
+   // (palette images are kept indexed, and only their palette is balanced)
+   ImageAdopter image;
+   IndexedImage indexedImage;
+   bool         isIndexed = false;
+   clock_t      timeRead  = 0;
+   {
+      const clock_t t0 = ::clock();
+      isIndexed = formatter.readIndexedImage( inPathname.c_str(), deGamma,
+         indexedImage );
+      if( !isIndexed )
+      {
+         formatter.readImage( inPathname.c_str(), deGamma, image );
+      }
+      timeRead = ::clock() - t0;
+      if( isFeedback )
+      {
+         if( isIndexed )
+         {
+            displayImageData( indexedImage );
+         }
+         else
+         {
+            displayImageData( image );
+         }
+      }
+   }
+
+   // call balancer
+   clock_t timeBalance = 0;
+   {
+      // get relevant options
+      const vector<float> colorspace( getOptionV( options, "ic", 6 ) );
+      const vector<float> whitepoint( getOptionV( options, "iw", 2 ) );
+      const vector<float> illuminant( getOptionV( options, "ii", 3 ) );
+      const float         strength = getOptionF( options, "ms", -1.0f );
+      const unsigned int  balancing = getBalancingOptions( options );
+      checkPrimaries( colorspace, whitepoint );
+      checkStrength( strength );
+
+      if( isFeedback )
+      {
+         std::cout << "\n" << "library: " << ::p3wbGetName() << " version " <<
+            ::p3wbGetVersion() << "\n" << ::p3wbGetCopyright() << "\n";
+      }
+      if( !::p3wbIsVersionSupported( p3wb13_VERSION ) )
+      {
+         throw LIB_VERSION_UNSUPPORTED;
+      }
+
+      char pMessage128[128] = "\0";
+
+      const bool isOutOfCore = !isIndexed &&
+         hxa7241_general::scratch::isMapped( image.getPixels() );
+
+      const clock_t t0 = ::clock();
+      bool isOk = false;
+      if( !isIndexed && !isOutOfCore )
+      {
+         isOk = 0 != ::p3wbWhiteBalance2(
+            (!colorspace.empty() ? &(colorspace[0]) : image.getColorspace()),
+            (!whitepoint.empty() ? &(whitepoint[0]) : image.getWhitepoint()),
+            (!illuminant.empty() ? &(illuminant[0]) : 0),
+            balancing,
+            strength,
+            image.getWidth(),
+            image.getHeight(),
+            0,
+            sizeof(*image.getPixels()) * 3,
+            image.getPixels(),
+            image.getPixels(),
+            pMessage128 );
+      }
+      // out-of-core: balance in strips, as a set with one pooled illuminant
+      // (the same as the whole image's) -- so only the strips being worked on
+      // need be paged in
+      else if( !isIndexed )
+      {
+         vector<p3wbImage> strips;
+         makeStrips( image, strips );
+         if( isFeedback )
+         {
+            std::cout << "\n" << "out-of-core: " << strips.size() <<
+               " strips\n";
+         }
+
+         isOk = 0 != ::p3wbWhiteBalanceSet(
+            (!colorspace.empty() ? &(colorspace[0]) : image.getColorspace()),
+            (!whitepoint.empty() ? &(whitepoint[0]) : image.getWhitepoint()),
+            (!illuminant.empty() ? &(illuminant[0]) : 0),
+            balancing,
+            strength,
+            static_cast<unsigned int>(strips.size()),
+            &(strips[0]),
+            pMessage128 );
+      }
+      else
+      {
+         // estimate weighted by how many pixels use each entry
+         ImageAdopter& palette = indexedImage.getPalette();
+         vector<float> weights;
+         indexedImage.getIndexWeights( weights );
+
+         isOk = 0 != ::p3wbWhiteBalanceColors(
+            (!colorspace.empty() ? &(colorspace[0]) : palette.getColorspace()),
+            (!whitepoint.empty() ? &(whitepoint[0]) : palette.getWhitepoint()),
+            (!illuminant.empty() ? &(illuminant[0]) : 0),
+            balancing,
+            strength,
+            palette.getWidth(),
+            palette.getPixels(),
+            &(weights[0]),
+            palette.getPixels(),
+            pMessage128 );
+      }
+      timeBalance = ::clock() - t0;
+      if( !isOk )
+      {
+         throw string( pMessage128 );
+      }
+   }
+
+   // write image
+   clock_t timeWrite = 0;
+   {
+      const clock_t t0 = ::clock();
+      if( !isIndexed )
+      {
+         formatter.writeImage( outPathname.c_str(), enGamma, image );
+      }
+      else
+      {
+         formatter.writeIndexedImage( outPathname.c_str(), enGamma,
+            indexedImage );
+      }
+      timeWrite = ::clock() - t0;
+   }
+
+   // display timing
+   if( isFeedback )
+   {
+      const float freqency = static_cast<float>(CLOCKS_PER_SEC);
+      std::cout << "\nread time:    " << (static_cast<float>(timeRead) /
+         freqency) << "\n";
+      std::cout << "balance time: " << (static_cast<float>(timeBalance) /
+         freqency) << "\n";
+      std::cout << "write time:   " << (static_cast<float>(timeWrite) /
+         freqency) << "\n";
+   }
+   return isIndexed ? static_cast<qword>(indexedImage.getWidth()) *
+      indexedImage.getHeight() : static_cast<qword>(image.getWidth()) *
+      image.getHeight();
+}
+
+
+/**
+ * Balance an image file in strips of rows, read and written through scanline
+ * codecs -- so it need never be whole in memory. Two passes over the input:
+ * the first estimates, the second balances and writes.
+ *
+ * @return  pixel count, or 0 if the image cannot be streamed (so balance it
+ *          whole instead)
+ */
+qword balanceStream
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const qword                    memoryBytes,
+   const string&                  inPathname,
+   const string&                  outPathname
+)
+{
+   using hxa7241_image::ScanlineReader;
+   using hxa7241_image::ScanlineWriter;
+
+   const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+
+   // (reading while writing the same file would overwrite it)
+   if( inPathname == outPathname )
+   {
+      return 0;
+   }
+
+   // open image
+   ImageAdopter header;
+   std::auto_ptr<ScanlineReader> pReader( formatter.openImageReader(
+      inPathname.c_str(), deGamma, header ) );
+   if( !pReader.get() )
+   {
+      return 0;
+   }
+   if( isFeedback )
+   {
+      displayImageData( header );
+   }
+
+   const dword width  = header.getWidth();
+   const dword height = header.getHeight();
+
+   // get relevant options
+   const vector<float> colorspace( getOptionV( options, "ic", 6 ) );
+   const vector<float> whitepoint( getOptionV( options, "iw", 2 ) );
+   const vector<float> illuminant( getOptionV( options, "ii", 3 ) );
+   const float         strength = getOptionF( options, "ms", -1.0f );
+   const unsigned int  balancing = getBalancingOptions( options );
+   checkPrimaries( colorspace, whitepoint );
+   checkStrength( strength );
+
+   if( isFeedback )
+   {
+      std::cout << "\n" << "library: " << ::p3wbGetName() << " version " <<
+         ::p3wbGetVersion() << "\n" << ::p3wbGetCopyright() << "\n";
+   }
+   if( !::p3wbIsVersionSupported( p3wb13_VERSION ) )
+   {
+      throw LIB_VERSION_UNSUPPORTED;
+   }
+
+   // size strips to the memory limit (at least one row)
+   const qword rowBytes  = static_cast<qword>(width) * STREAM_PIXEL_BYTES;
+   const qword fitRows   = (rowBytes > 0) ? memoryBytes / rowBytes : 0;
+   const dword stripRows = static_cast<dword>( (fitRows < 1) ? 1 :
+      ((fitRows < static_cast<qword>(height)) ? fitRows : height) );
+   const dword stripCount = (height + stripRows - 1) / (stripRows ? stripRows :
+      1);
+   if( isFeedback )
+   {
+      std::cout << "\n" << "streaming: " << stripCount << " strips of " <<
+         stripRows << " rows\n";
+   }
+
+   hxa7241_general::scratch::Ptr<float> pStrip( static_cast<qword>(width) *
+      stripRows * 3 );
+
+   char pMessage128[128] = "\0";
+
+   p3wbStrips strips = ::p3wbStripsOpen(
+      (!colorspace.empty() ? &(colorspace[0]) : header.getColorspace()),
+      (!whitepoint.empty() ? &(whitepoint[0]) : header.getWhitepoint()),
+      (!illuminant.empty() ? &(illuminant[0]) : 0),
+      balancing, strength, pMessage128 );
+   if( !strips )
+   {
+      throw string( pMessage128 );
+   }
+
+   const clock_t t0 = ::clock();
+   try
+   {
+      // first pass: estimate from every strip
+      for( dword y = 0;  y < height;  y += stripRows )
+      {
+         const dword rows = ((height - y) < stripRows) ? (height - y) :
+            stripRows;
+
+         pReader->readRows( rows, pStrip.get() );
+         if( !::p3wbStripsEstimate( strips, width, rows, p3wb11_RGB, 0, 0,
+            pStrip.get(), pMessage128 ) )
+         {
+            throw string( pMessage128 );
+         }
+      }
+
+      // second pass: read again (unless one strip held it all), balance, and
+      // write
+      const bool isReread = (stripCount > 1);
+      if( isReread )
+      {
+         pReader.reset( 0 );
+         ImageAdopter header2;
+         pReader.reset( formatter.openImageReader( inPathname.c_str(),
+            deGamma, header2 ) );
+         if( !pReader.get() || (header2.getWidth() != width) ||
+            (header2.getHeight() != height) )
+         {
+            throw STREAM_REREAD_FAILED;
+         }
+      }
+
+      std::auto_ptr<ScanlineWriter> pWriter( formatter.openImageWriter(
+         outPathname.c_str(), enGamma, header ) );
+      if( !pWriter.get() )
+      {
+         throw STREAM_WRITE_FAILED;
+      }
+
+      for( dword y = 0;  y < height;  y += stripRows )
+      {
+         const dword rows = ((height - y) < stripRows) ? (height - y) :
+            stripRows;
+
+         if( isReread )
+         {
+            pReader->readRows( rows, pStrip.get() );
+         }
+         if( !::p3wbStripsBalance( strips, width, rows, p3wb11_RGB, 0, 0,
+            pStrip.get(), p3wb11_RGB, 0, 0, 1.0f, pStrip.get(),
+            pMessage128 ) )
+         {
+            throw string( pMessage128 );
+         }
+         pWriter->writeRows( rows, pStrip.get() );
+      }
+
+      pWriter->finish();
+
+      ::p3wbStripsClose( strips );
+   }
+   catch( ... )
+   {
+      ::p3wbStripsClose( strips );
+      throw;
+   }
+
+   if( isFeedback )
+   {
+      std::cout << "\nstream time:  " << (static_cast<float>(::clock() - t0) /
+         static_cast<float>(CLOCKS_PER_SEC)) << "\n";
+   }
+
+   return static_cast<qword>(width) * height;
+}
+
+
+
+/**
+ * Balances frames as a sequence, with one context (made with the first frame,
+ * for its metadata).
+ */
+class SequenceBalancer
+   : public FrameBalancer
+{
+public:
+   SequenceBalancer( const vector<float>&  colorspace,
+                     const vector<float>&  whitepoint,
+                     unsigned int          balancing,
+                     float                 strength,
+                     float                 smoothing,
+                     float                 cut,
+                     bool                  isFeedback,
+                     const vector<string>& inPathnames )
+    : colorspace_m ( colorspace )
+    , whitepoint_m ( whitepoint )
+    , balancing_m  ( balancing )
+    , strength_m   ( strength )
+    , smoothing_m  ( smoothing )
+    , cut_m        ( cut )
+    , isFeedback_m ( isFeedback )
+    , inPathnames_m( inPathnames )
+    , sequence_m   ( 0 )
+    , cutCount_m   ( 0 )
+   {
+   }
+
+   virtual ~SequenceBalancer()
+   {
+      ::p3wbSequenceClose( sequence_m );
+   }
+
+private:
+   SequenceBalancer( const SequenceBalancer& );
+   SequenceBalancer& operator=( const SequenceBalancer& );
+public:
+
+   virtual void balance( const udword  index,
+                         ImageAdopter& image )
+   {
+      if( isFeedback_m && (0 == index) )
+      {
+         displayImageData( image );
+      }
+
+      char pMessage128[128] = "\0";
+
+      if( !sequence_m )
+      {
+         sequence_m = ::p3wbSequenceOpen(
+            (!colorspace_m.empty() ? &(colorspace_m[0]) :
+               image.getColorspace()),
+            (!whitepoint_m.empty() ? &(whitepoint_m[0]) :
+               image.getWhitepoint()),
+            balancing_m, strength_m, smoothing_m, cut_m, pMessage128 );
+         if( !sequence_m )
+         {
+            throw string( pMessage128 );
+         }
+      }
+
+      int isCut = 0;
+      if( !::p3wbSequenceFrame( sequence_m, image.getWidth(),
+         image.getHeight(), 0, 0, 0, image.getPixels(), 0, 0, 0, 1.0f,
+         image.getPixels(), &isCut, pMessage128 ) )
+      {
+         throw string( pMessage128 );
+      }
+      cutCount_m += isCut;
+
+      if( isFeedback_m )
+      {
+         std::cout << "frame " << inPathnames_m[index] <<
+            (isCut ? "  (cut)" : "") << "\n";
+      }
+   }
+
+   udword getCutCount() const
+   {
+      return cutCount_m;
+   }
+
+private:
+   const vector<float>   colorspace_m;
+   const vector<float>   whitepoint_m;
+   const unsigned int    balancing_m;
+   const float           strength_m;
+   const float           smoothing_m;
+   const float           cut_m;
+   const bool            isFeedback_m;
+   const vector<string>& inPathnames_m;
+
+   p3wbSequence          sequence_m;
+   udword                cutCount_m;
+};
+
+
+void whiteBalanceFrames
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const string&                  firstPathname,
+   const udword                   frameCount
+)
+{
+   // get relevant options
+   const vector<float> colorspace( getOptionV( options, "ic", 6 ) );
+   const vector<float> whitepoint( getOptionV( options, "iw", 2 ) );
+   const float         strength  = getOptionF( options, "ms", -1.0f );
+   const float         smoothing = getOptionF( options, "ss", -1.0f );
+   const float         cut       = getOptionF( options, "sc", -1.0f );
+   const unsigned int  balancing = getBalancingOptions( options );
+   checkPrimaries( colorspace, whitepoint );
+   checkStrength( strength );
+   checkUnit( smoothing, BAD_SMOOTHING_OPTION );
+   checkUnit( cut, BAD_CUT_OPTION );
+   if( !getOptionV( options, "ii", 3 ).empty() )
+   {
+      std::cout << "\n" << "(original illuminant option unused for frames)\n";
+   }
+
+   if( !::p3wbIsVersionSupported( p3wb13_VERSION ) )
+   {
+      throw LIB_VERSION_UNSUPPORTED;
+   }
+
+   vector<string> inPathnames;
+   vector<string> outPathnames;
+   makeFramePathnames( firstPathname, frameCount, getOptionS( options, "on" ),
+      inPathnames, outPathnames );
+
+   // read, balance, and write, overlapped
+   const double timeStart = getWallSeconds();
+   SequenceBalancer balancer( colorspace, whitepoint, balancing, strength,
+      smoothing, cut, isFeedback, inPathnames );
+   pipelineFrames( formatter, enGamma, inPathnames, outPathnames, balancer );
+   const double seconds = getWallSeconds() - timeStart;
+
+   // display summary
+   if( isFeedback )
+   {
+      std::cout << "\nframes:       " << frameCount << " (" <<
+         balancer.getCutCount() << " cuts)\n";
+      std::cout << "time / frame: " << (seconds /
+         static_cast<double>(frameCount)) << "\n";
+   }
+}
+
+
+/**
+ * Transfers a reference's look onto each frame.
+ */
+class TransferBalancer
+   : public FrameBalancer
+{
+public:
+   TransferBalancer( const std::map<string,string>& options,
+                     const p3wbStats&               reference,
+                     bool                           isFeedback,
+                     const vector<string>&          inPathnames )
+    : options_m    ( options )
+    , reference_m  ( reference )
+    , isFeedback_m ( isFeedback )
+    , inPathnames_m( inPathnames )
+   {
+   }
+
+private:
+   TransferBalancer( const TransferBalancer& );
+   TransferBalancer& operator=( const TransferBalancer& );
+public:
+
+   virtual void balance( const udword  index,
+                         ImageAdopter& image )
+   {
+      if( isFeedback_m && (0 == index) )
+      {
+         displayImageData( image );
+      }
+
+      transferImage( options_m, reference_m, image );
+
+      if( isFeedback_m && (inPathnames_m.size() > 1) )
+      {
+         std::cout << "frame " << inPathnames_m[index] << "\n";
+      }
+   }
+
+private:
+   const std::map<string,string>& options_m;
+   const p3wbStats&               reference_m;
+   const bool                     isFeedback_m;
+   const vector<string>&          inPathnames_m;
+};
+
+
+void transferFrames
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const string&                  firstPathname,
+   const udword                   frameCount
+)
+{
+   const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+
+   // get relevant options
+   checkPrimaries( getOptionV( options, "ic", 6 ), getOptionV( options, "iw",
+      2 ) );
+   checkStrength( getOptionF( options, "ms", -1.0f ) );
+
+   if( !::p3wbIsVersionSupported( p3wb13_VERSION ) )
+   {
+      throw LIB_VERSION_UNSUPPORTED;
+   }
+
+   // (single image keeps its name, frames are numbered)
+   vector<string> inPathnames;
+   vector<string> outPathnames;
+   makeFramePathnames( firstPathname, frameCount, getOptionS( options, "on" ),
+      inPathnames, outPathnames );
+
+   // reference stats, once for all frames
+   const double timeStart = getWallSeconds();
+   p3wbStats reference;
+   getReferenceStats( formatter, options, deGamma, isFeedback, reference );
+
+   // read, transfer, and write, overlapped
+   TransferBalancer balancer( options, reference, isFeedback, inPathnames );
+   pipelineFrames( formatter, enGamma, inPathnames, outPathnames, balancer );
+   const double seconds = getWallSeconds() - timeStart;
+
+   // display summary
+   if( isFeedback )
+   {
+      std::cout << "\nframes:        " << frameCount << "\n";
+      std::cout << "transfer time: " << seconds << "\n";
+   }
+}
+
+
+qword transferFile
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const p3wbStats&               reference,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const string&                  inPathname,
+   const string&                  outPathname
+)
+{
+   const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+
+   // read image
+   ImageAdopter image;
+   formatter.readImage( inPathname.c_str(), deGamma, image );
+   if( isFeedback )
+   {
+      displayImageData( image );
+   }
+
+   // transfer onto image
+   transferImage( options, reference, image );
+
+   // write image
+   formatter.writeImage( outPathname.c_str(), enGamma, image );
+
+   return static_cast<qword>(image.getWidth()) * image.getHeight();
+}
+
+
+void transferImage
+(
+   const std::map<string,string>& options,
+   const p3wbStats&               reference,
+   ImageAdopter&                  image
+)
+{
+   // get relevant options
+   const vector<float> colorspace( getOptionV( options, "ic", 6 ) );
+   const vector<float> whitepoint( getOptionV( options, "iw", 2 ) );
+   const float         strength  = getOptionF( options, "ms", -1.0f );
+   const unsigned int  balancing = getBalancingOptions( options );
+
+   // transfer onto image (its stats, then the mapping)
+   char pMessage128[128] = "\0";
+   if( !::p3wbColorTransfer(
+      (!colorspace.empty() ? &(colorspace[0]) : image.getColorspace()),
+      (!whitepoint.empty() ? &(whitepoint[0]) : image.getWhitepoint()),
+      &reference, 0, balancing, strength, image.getWidth(),
+      image.getHeight(), 0, 0, 0, image.getPixels(), 0, 0, 0, 1.0f,
+      image.getPixels(), pMessage128 ) )
+   {
+      throw string( pMessage128 );
+   }
+}
+
+
+void getReferenceStats
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    deGamma,
+   const bool                     isFeedback,
+   p3wbStats&                     stats
+)
+{
+   const string referencePathname( getOptionS( options, "tr" ) );
+   const string statsPathname( getOptionS( options, "ts" ) );
+
+   char pMessage128[128] = "\0";
+
+   // measure reference image (with its own metadata), and maybe keep stats
+   if( !referencePathname.empty() )
+   {
+      ImageAdopter reference;
+      formatter.readImage( referencePathname.c_str(), deGamma, reference );
+
+      if( !::p3wbColorStats( reference.getColorspace(),
+         reference.getWhitepoint(), getBalancingOptions( options ),
+         reference.getWidth(), reference.getHeight(), 0, 0, 0,
+         reference.getPixels(), &stats, pMessage128 ) )
+      {
+         throw string( pMessage128 );
+      }
+
+      if( !statsPathname.empty() )
+      {
+         char text256[256];
+         ::p3wbStatsToText( &stats, text256 );
+
+         std::ofstream statsFile( statsPathname.c_str() );
+         statsFile << text256 << "\n";
+         if( !statsFile )
+         {
+            throw BAD_STATS_WRITE;
+         }
+      }
+   }
+   // read kept stats
+   else
+   {
+      std::ifstream statsFile( statsPathname.c_str() );
+      string        text;
+      if( !std::getline( statsFile, text ) )
+      {
+         throw BAD_STATS_READ;
+      }
+
+      if( !::p3wbStatsFromText( text.c_str(), &stats, pMessage128 ) )
+      {
+         throw string( pMessage128 );
+      }
+   }
+
+   if( isFeedback )
+   {
+      char text256[256];
+      ::p3wbStatsToText( &stats, text256 );
+      std::cout << "\nreference stats: " << text256 << "\n";
+   }
+}
+
+
+bool isBatch
+(
+   const string& imagePathname
+)
+{
+   // manifest, wildcard pattern, or directory
+   return ('@' == imagePathname[0]) ||
+      (string::npos != imagePathname.find_first_of( "*?" )) ||
+      hxa7241_general::files::isDirectory( imagePathname.c_str() );
+}
+
+
+void balanceBatch
+(
+   const ImageFormatter&          formatter,
+   const std::map<string,string>& options,
+   const float                    enGamma,
+   const bool                     isFeedback,
+   const string&                  imagesPathname
+)
+{
+   // check options before starting anything
+   checkPrimaries( getOptionV( options, "ic", 6 ), getOptionV( options, "iw",
+      2 ) );
+   checkStrength( getOptionF( options, "ms", -1.0f ) );
+   getBalancingOptions( options );
+
+   if( !::p3wbIsVersionSupported( p3wb13_VERSION ) )
+   {
+      throw LIB_VERSION_UNSUPPORTED;
+   }
+
+   Batch batch;
+   batch.pFormatter   = &formatter;
+   batch.pOptions     = &options;
+   batch.enGamma      = enGamma;
+   batch.isFeedback   = isFeedback;
+   batch.pReference   = 0;
+   batch.memoryLimit  = checkMemory( getOptionF( options, "bm",
+      BATCH_MEMORY_DEFAULT ) );
+   batch.next         = 0;
+   batch.waiting      = 0;
+   batch.inFlight     = 0;
+   batch.inFlightPeak = 0;
+   batch.failed       = 0;
+   batch.pixels       = 0;
+
+   // list images
+   listBatch( imagesPathname, batch.inPathnames );
+   const udword imageCount = static_cast<udword>(batch.inPathnames.size());
+   if( 0 == imageCount )
+   {
+      throw NO_BATCH_IMAGES;
+   }
+
+   // make out path names (in out directory, if given), and memory charges
+   // (unknown sizes are charged the whole limit, so run alone)
+   const string outDirectory( getOptionS( options, "on" ) );
+   for( udword i = 0;  i < imageCount;  ++i )
+   {
+      const string& inPathname = batch.inPathnames[i];
+
+      string outPathname;
+      makeOutPathname( inPathname, "", outPathname );
+      if( !outDirectory.empty() )
+      {
+         outPathname = outDirectory + "/" + outPathname.substr(
+            outPathname.find_last_of( "/\\" ) + 1 );
+      }
+      batch.outPathnames.push_back( outPathname );
+
+      dword width  = 0;
+      dword height = 0;
+      batch.charges.push_back( formatter.readSize( inPathname.c_str(), width,
+         height ) ? static_cast<qword>(width) * height * BATCH_PIXEL_BYTES :
+         batch.memoryLimit );
+   }
+
+   // color transfer: reference stats, once for all images
+   p3wbStats reference;
+   if( !getOptionS( options, "tr" ).empty() ||
+      !getOptionS( options, "ts" ).empty() )
+   {
+      const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+      getReferenceStats( formatter, options, deGamma, isFeedback, reference );
+      batch.pReference = &reference;
+   }
+
+   // workers: no more than images
+   const udword workerCount = checkWorkers( getOptionF( options, "bj",
+      static_cast<float>(hxa7241_general::getProcessorCount()) ) );
+   const udword threadCount = (workerCount < imageCount) ? workerCount :
+      imageCount;
+
+   // image encoding and decoding share the processors among the workers
+   const udword processors = hxa7241_general::getProcessorCount();
+   hxa7241_general::ParallelBands::setThreadCount( (processors + threadCount -
+      1) / threadCount );
+
+   if( isFeedback )
+   {
+      std::cout << "\nbatch: " << imageCount << " images, " << threadCount <<
+         " workers\n\n";
+   }
+
+   // run workers, and wait for them
+   // (threads join on deletion)
+   const double timeStart = getWallSeconds();
+   {
+      vector<hxa7241_general::Thread*> threads;
+      try
+      {
+         for( udword i = 0;  i < threadCount;  ++i )
+         {
+            threads.push_back( new hxa7241_general::Thread( batchWorker,
+               &batch ) );
+         }
+      }
+      catch( ... )
+      {
+         // (stop unstarted images, then join)
+         {
+            hxa7241_general::MutexLock lock( batch.mutex );
+            batch.next = imageCount;
+         }
+         for( udword i = 0;  i < threads.size();  ++i )
+         {
+            delete threads[i];
+         }
+         throw;
+      }
+      for( udword i = 0;  i < threads.size();  ++i )
+      {
+         delete threads[i];
+      }
+   }
+   const double seconds = getWallSeconds() - timeStart;
+
+   // display summary
+   const double megapixels = static_cast<double>(batch.pixels) / 1e6;
+   std::cout << "\nimages:          " << (imageCount - batch.failed) <<
+      " of " << imageCount << " (" << batch.failed << " failed)\n";
+   std::cout << "megapixels:      " << megapixels << "\n";
+   std::cout << "time:            " << seconds << " s";
+   if( seconds > 0.0 )
+   {
+      std::cout << "  (" << (megapixels / seconds) << " megapixels/s)";
+   }
+   std::cout << "\n";
+   std::cout << "workers:         " << threadCount << "\n";
+   std::cout << "memory charged:  " << (static_cast<double>(
+      batch.inFlightPeak) / 1048576.0) << " MB peak, of " <<
+      (static_cast<double>(batch.memoryLimit) / 1048576.0) << " MB limit\n";
+
+   if( 0 != batch.failed )
+   {
+      throw BATCH_FAILED;
+   }
+}
+
+
+void listBatch
+(
+   const string&   imagesPathname,
+   vector<string>& inPathnames
+)
+{
+   // manifest: a path name per line (blank and # lines skipped)
+   if( '@' == imagesPathname[0] )
+   {
+      std::ifstream manifest( imagesPathname.c_str() + 1 );
+      if( !manifest )
+      {
+         throw BAD_MANIFEST_READ;
+      }
+
+      for( string line;  std::getline( manifest, line ); )
+      {
+         // (trim ends, including any CR)
+         const size_t first = line.find_first_not_of( " \t\r" );
+         if( (string::npos != first) && ('#' != line[first]) )
+         {
+            inPathnames.push_back( line.substr( first,
+               line.find_last_not_of( " \t\r" ) + 1 - first ) );
+         }
+      }
+   }
+   // directory or wildcard pattern: image files only, and not outputs
+   else
+   {
+      vector<string> pathnames;
+      if( string::npos != imagesPathname.find_first_of( "*?" ) )
+      {
+         hxa7241_general::files::listMatches( imagesPathname.c_str(),
+            pathnames );
+      }
+      else
+      {
+         hxa7241_general::files::listDirectory( imagesPathname.c_str(),
+            pathnames );
+      }
+
+      static const char* EXTS[] = { ".ppm", ".pfm", ".png", ".exr", ".hdr",
+         ".pic", ".rad", ".rgbe" };
+
+      for( udword i = 0;  i < pathnames.size();  ++i )
+      {
+         const string& pathname = pathnames[i];
+
+         const size_t extPos = pathname.rfind( '.' );
+         string ext( (string::npos != extPos) ? pathname.substr( extPos ) :
+            string() );
+         for( udword c = 0;  c < ext.length();  ++c )
+         {
+            ext[c] = static_cast<char>(::tolower( ext[c] ));
+         }
+
+         bool isImage = false;
+         for( udword e = 0;  e < sizeof(EXTS) / sizeof(EXTS[0]);  ++e )
+         {
+            isImage |= (ext == EXTS[e]);
+         }
+
+         if( isImage && (string::npos == pathname.find( "_p3wb.", (extPos > 5) ?
+            extPos - 5 : 0 )) )
+         {
+            inPathnames.push_back( pathname );
+         }
+      }
+   }
+}
+
+
+void batchWorker
+(
+   void* pBatchV
+)
+{
+   Batch& batch = *static_cast<Batch*>(pBatchV);
+
+   for( ;; )
+   {
+      // take next image, and wait until its memory fits
+      udword index  = 0;
+      qword  charge = 0;
+      {
+         hxa7241_general::MutexLock lock( batch.mutex );
+
+         if( batch.next >= batch.inPathnames.size() )
+         {
+            break;
+         }
+         index  = batch.next++;
+         charge = batch.charges[index];
+
+         // (oversize images run when nothing else is in flight)
+         while( (batch.inFlight > 0) &&
+            ((batch.inFlight + charge) > batch.memoryLimit) )
+         {
+            ++batch.waiting;
+            batch.mutex.unlock();
+            batch.released.wait();
+            batch.mutex.lock();
+         }
+
+         batch.inFlight += charge;
+         if( batch.inFlightPeak < batch.inFlight )
+         {
+            batch.inFlightPeak = batch.inFlight;
+         }
+      }
+
+      // balance (or transfer onto) image
+      qword  pixels = 0;
+      string failure;
+      try
+      {
+         const string& in  = batch.inPathnames[index];
+         const string& out = batch.outPathnames[index];
+         pixels = batch.pReference ?
+            transferFile( *batch.pFormatter, *batch.pOptions,
+               *batch.pReference, batch.enGamma, false, in, out ) :
+            balanceFile( *batch.pFormatter, *batch.pOptions, batch.enGamma,
+               false, in, out );
+      }
+      catch( ... )
+      {
+         failure = describeException();
+      }
+
+      // release memory, wake waiters, and report
+      {
+         hxa7241_general::MutexLock lock( batch.mutex );
+
+         batch.inFlight -= charge;
+         if( batch.waiting > 0 )
+         {
+            batch.released.post( batch.waiting );
+            batch.waiting = 0;
+         }
+
+         if( failure.empty() )
+         {
+            batch.pixels += pixels;
+            if( batch.isFeedback )
+            {
+               std::cout << "done    " << batch.inPathnames[index] << "\n";
+            }
+         }
+         else
+         {
+            ++batch.failed;
+            std::cout << "failed  " << batch.inPathnames[index] << "  :  " <<
+               failure << "\n";
+         }
+      }
+   }
+}
+
+
+void pipelineFrames
+(
+   const ImageFormatter& formatter,
+   const float           enGamma,
+   const vector<string>& inPathnames,
+   const vector<string>& outPathnames,
+   FrameBalancer&        balancer
+)
+{
+   FramePipeline pipeline( PIPELINE_QUEUE_LENGTH );
+   pipeline.pFormatter    = &formatter;
+   pipeline.deGamma       = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
+   pipeline.enGamma       = enGamma;
+   pipeline.pInPathnames  = &inPathnames;
+   pipeline.pOutPathnames = &outPathnames;
+
+   // run reader and writer threads, and balance between them, here
+   // (a 0 frame marks the end)
+   hxa7241_general::Thread* pReader = 0;
+   hxa7241_general::Thread* pWriter = 0;
+   try
+   {
+      pReader = new hxa7241_general::Thread( readFrames, &pipeline );
+      pWriter = new hxa7241_general::Thread( writeFrames, &pipeline );
+
+      for( Frame* pFrame = 0;  pipeline.read.pop( pFrame ) && pFrame; )
+      {
+         try
+         {
+            balancer.balance( pFrame->index, pFrame->image );
+         }
+         catch( ... )
+         {
+            delete pFrame;
+            throw;
+         }
+
+         if( !pipeline.balanced.push( pFrame ) )
+         {
+            delete pFrame;
+            break;
+         }
+      }
+   }
+   catch( ... )
+   {
+      // (stop reading, but let the frames before write)
+      pipeline.read.close();
+      finishPipeline( pipeline, pReader, pWriter );
+      throw;
+   }
+   finishPipeline( pipeline, pReader, pWriter );
+
+   if( !pipeline.failure.empty() )
+   {
+      throw pipeline.failure;
+   }
+}
+
+
+void finishPipeline
+(
+   FramePipeline&                 pipeline,
+   hxa7241_general::Thread* const pReader,
+   hxa7241_general::Thread* const pWriter
+)
+{
+   pipeline.balanced.push( 0 );
+
+   // wait for the threads (they join on deletion)
+   delete pWriter;
+   delete pReader;
+
+   // free any frames left
+   vector<Frame*> frames;
+   pipeline.read.removeAll( frames );
+   pipeline.balanced.removeAll( frames );
+   for( udword i = 0;  i < frames.size();  ++i )
+   {
+      delete frames[i];
+   }
+}
+
+
+void readFrames
 (
-   int   argc,
-   char* argv[]
+   void* pPipelineV
 )
 {
-   int returnValue = EXIT_FAILURE;
+   FramePipeline& pipeline = *static_cast<FramePipeline*>(pPipelineV);
 
-   // catch everything
+   Frame* pFrame = 0;
    try
    {
-      // check for help request
-      if( (argc <= 1) || (std::string(argv[1]) == SWITCH_HELP1) ||
-         (std::string(argv[1]) == SWITCH_HELP2) )
-      {
-         // output help
-         std::cout << HELP_MESSAGE;
-
-         returnValue = EXIT_SUCCESS;
-      }
-      // execute
-      else
+      for( udword i = 0;  i < pipeline.pInPathnames->size();  ++i )
       {
-         std::cout << BANNER_MESSAGE;
-
-         whiteBalance( argc, argv );
+         pFrame = new Frame;
+         pFrame->index = i;
+         pipeline.pFormatter->readImage( (*pipeline.pInPathnames)[i].c_str(),
+            pipeline.deGamma, pFrame->image );
 
-         returnValue = EXIT_SUCCESS;
+         if( !pipeline.read.push( pFrame ) )
+         {
+            break;
+         }
+         pFrame = 0;
       }
    }
-   // print exception message
-   catch( const std::exception& e )
-   {
-      std::cout << '\n' << EXCEPTION_PREFIX << e.what() << '\n';
-   }
-   catch( const char*const pExceptionString )
-   {
-      std::cout << '\n' << EXCEPTION_PREFIX << pExceptionString << '\n';
-   }
-   catch( const std::string exceptionString )
-   {
-      std::cout << '\n' << EXCEPTION_PREFIX << exceptionString << '\n';
-   }
    catch( ... )
    {
-      std::cout << '\n' << EXCEPTION_PREFIX << EXCEPTION_ABSTRACT << '\n';
+      // (keep failure, and end here -- so the frames before still write)
+      hxa7241_general::MutexLock lock( pipeline.mutex );
+      if( pipeline.failure.empty() )
+      {
+         pipeline.failure = describeException();
+      }
    }
+   delete pFrame;
 
+   pipeline.read.push( 0 );
+}
+
+
+void writeFrames
+(
+   void* pPipelineV
+)
+{
+   FramePipeline& pipeline = *static_cast<FramePipeline*>(pPipelineV);
+
+   Frame* pFrame = 0;
    try
    {
-      std::cout.flush();
+      while( pipeline.balanced.pop( pFrame ) && pFrame )
+      {
+         pipeline.pFormatter->writeImage(
+            (*pipeline.pOutPathnames)[pFrame->index].c_str(),
+            pipeline.enGamma, pFrame->image );
+
+         delete pFrame;
+         pFrame = 0;
+      }
    }
    catch( ... )
    {
-      // suppress exceptions
+      stopPipeline( pipeline, describeException() );
    }
-
-   return returnValue;
+   delete pFrame;
 }
 
 
-
-
-/// other functions ------------------------------------------------------------
-namespace
-{
-
-void whiteBalance
+void stopPipeline
 (
-   int   argc,
-   char* argv[]
+   FramePipeline& pipeline,
+   const string&  failure
 )
 {
-   // get input image pathname, and basic options
-   bool                    isFeedback;
-   string                  inImagePathname;
-   std::map<string,string> options;
-   getInitialOptions( argc, argv, isFeedback, inImagePathname, options );
-
-   // make formatter
-   const ImageFormatter formatter( getOptionS( options, "le" ).c_str(),
-      getOptionS( options, "lp" ).c_str() );
-
-   // get gamma option
-   const float enGamma = getOptionF( options, "ig", 0.0f );
-   checkGamma( enGamma );
-   const float deGamma = (0.0f != enGamma) ? (1.0f / enGamma) : 0.0f;
-
-   // read image
-   ImageAdopter image;
-   clock_t      timeRead = 0;
    {
-      const clock_t t0 = ::clock();
-      formatter.readImage( inImagePathname.c_str(), deGamma, image );
-      timeRead = ::clock() - t0;
-      if( isFeedback )
+      hxa7241_general::MutexLock lock( pipeline.mutex );
+      if( pipeline.failure.empty() )
       {
-         displayImageData( image );
+         pipeline.failure = failure;
       }
    }
 
-   // call balancer
-   clock_t timeBalance = 0;
-   {
-      // get relevant options
-      const vector<float> colorspace( getOptionV( options, "ic", 6 ) );
-      const vector<float> whitepoint( getOptionV( options, "iw", 2 ) );
-      const vector<float> illuminant( getOptionV( options, "ii", 3 ) );
-      const float         strength = getOptionF( options, "ms", -1.0f );
-      checkPrimaries( colorspace, whitepoint );
-      checkStrength( strength );
+   pipeline.read.close();
+   pipeline.balanced.close();
+}
 
-      if( isFeedback )
-      {
-         std::cout << "\n" << "library: " << ::p3wbGetName() << " version " <<
-            ::p3wbGetVersion() << "\n" << ::p3wbGetCopyright() << "\n";
-      }
-      if( !::p3wbIsVersionSupported( p3wb12_VERSION ) )
+
+void makeFramePathnames
+(
+   const string&   firstPathname,
+   const udword    frameCount,
+   const string&   outOption,
+   vector<string>& inPathnames,
+   vector<string>& outPathnames
+)
+{
+   for( udword f = 0;  f < frameCount;  ++f )
+   {
+      // (single image keeps its name, frames are numbered)
+      string framePathname( firstPathname );
+      string frameNumber;
+      if( frameCount > 1 )
       {
-         throw LIB_VERSION_UNSUPPORTED;
+         makeFramePathname( firstPathname, f, framePathname, frameNumber );
       }
 
-      char pMessage128[128] = "\0";
-
-      const clock_t t0 = ::clock();
-      const bool isOk = 0 != ::p3wbWhiteBalance2(
-         (!colorspace.empty() ? &(colorspace[0]) : image.getColorspace()),
-         (!whitepoint.empty() ? &(whitepoint[0]) : image.getWhitepoint()),
-         (!illuminant.empty() ? &(illuminant[0]) : 0),
-         p3wb11_GW,
-         strength,
-         image.getWidth(),
-         image.getHeight(),
-         0,
-         sizeof(*image.getPixels()) * 3,
-         image.getPixels(),
-         image.getPixels(),
-         pMessage128 );
-      timeBalance = ::clock() - t0;
-      if( !isOk )
+      string outPathname( outOption );
+      if( !outPathname.empty() )
       {
-         throw string( pMessage128 );
+         outPathname += frameNumber;
       }
+      makeOutPathname( framePathname, outPathname, outPathname );
+
+      inPathnames.push_back( framePathname );
+      outPathnames.push_back( outPathname );
    }
+}
 
-   // write image
-   clock_t timeWrite = 0;
-   {
-      // get relevant option
-      string outImagePathname( getOptionS( options, "on" ) );
-      makeOutPathname( inImagePathname, outImagePathname, outImagePathname );
 
-      const clock_t t0 = ::clock();
-      formatter.writeImage( outImagePathname.c_str(), enGamma, image );
-      timeWrite = ::clock() - t0;
+string describeException()
+{
+   // (rethrow the exception being handled, to see what it is)
+   string description;
+   try
+   {
+      throw;
    }
-
-   // display timing
-   if( isFeedback )
+   catch( const std::exception& e )
+   {
+      description = e.what();
+   }
+   catch( const char*const pExceptionString )
+   {
+      description = pExceptionString;
+   }
+   catch( const std::string exceptionString )
+   {
+      description = exceptionString;
+   }
+   catch( ... )
    {
-      const float freqency = static_cast<float>(CLOCKS_PER_SEC);
-      std::cout << "\nread time:    " << (static_cast<float>(timeRead) /
-         freqency) << "\n";
-      std::cout << "balance time: " << (static_cast<float>(timeBalance) /
-         freqency) << "\n";
-      std::cout << "write time:   " << (static_cast<float>(timeWrite) /
-         freqency) << "\n";
    }
+
+   return !description.empty() ? description : string( EXCEPTION_ABSTRACT );
+}
+
+
+double getWallSeconds()
+{
+   // (clock() is processor time, summed over threads, so not for this)
+#ifdef _PLATFORM_WIN
+
+   return static_cast<double>( ::GetTickCount() ) / 1000.0;
+
+#elif _PLATFORM_LINUX
+
+   struct timeval now;
+   ::gettimeofday( &now, 0 );
+
+   return static_cast<double>(now.tv_sec) +
+      (static_cast<double>(now.tv_usec) / 1e6);
+
+#else
+
+   return static_cast<double>( ::time( 0 ) );
+
+#endif
 }
 
 
@@ -623,6 +2279,41 @@ void tokenize
 //}
 
 
+void makeStrips
+(
+   const ImageAdopter& image,
+   vector<p3wbImage>&  strips
+)
+{
+   // rows per strip: about 64MB, at least one
+   const qword rowBytes  = static_cast<qword>(image.getWidth()) *
+      sizeof(*image.getPixels()) * 3;
+   const qword stripRows = (rowBytes < (1 << 26)) ? (1 << 26) / rowBytes : 1;
+
+   for( qword y = 0;  y < image.getHeight();  y += stripRows )
+   {
+      const qword rows = (image.getHeight() - y) < stripRows ?
+         (image.getHeight() - y) : stripRows;
+      float* pStrip = image.getPixels() + (y * (rowBytes / sizeof(float)));
+
+      p3wbImage strip;
+      strip.width          = image.getWidth();
+      strip.height         = static_cast<unsigned int>(rows);
+      strip.inFormatFlags  = p3wb11_RGB;
+      strip.inPixelStride  = 0;
+      strip.inRowPitch     = 0;
+      strip.inPixels       = pStrip;
+      strip.outFormatFlags = p3wb11_RGB;
+      strip.outPixelStride = 0;
+      strip.outRowPitch    = 0;
+      strip.outAlpha       = 1.0f;
+      strip.outPixels      = pStrip;
+
+      strips.push_back( strip );
+   }
+}
+
+
 void makeOutPathname
 (
    const string& inPathname,
@@ -648,6 +2339,53 @@ void makeOutPathname
 }
 
 
+void makeFramePathname
+(
+   const string& firstPathname,
+   const udword  index,
+   string&       framePathname,
+   string&       frameNumber
+)
+{
+   // find last run of digits in the name (not the directory, nor ext)
+   const size_t nameEnd   = firstPathname.rfind( '.' );
+   const size_t nameStart = firstPathname.find_last_of( "/\\" ) + 1;
+   const size_t end       = firstPathname.find_last_of( "0123456789",
+      nameEnd );
+   if( (string::npos == end) || (end < nameStart) || (end >= nameEnd) )
+   {
+      throw NO_FRAME_NUMBER;
+   }
+   size_t start = end;
+   while( (start > nameStart) && ('0' <= firstPathname[start - 1]) &&
+      ('9' >= firstPathname[start - 1]) )
+   {
+      --start;
+   }
+
+   // add index, keeping width (or widening)
+   const string first( firstPathname.substr( start, end + 1 - start ) );
+   udword number = static_cast<udword>( ::strtoul( first.c_str(), 0, 10 ) ) +
+      index;
+
+   frameNumber.clear();
+   do
+   {
+      frameNumber.insert( frameNumber.begin(), static_cast<char>( '0' +
+         (number % 10) ) );
+      number /= 10;
+   }
+   while( number > 0 );
+   if( frameNumber.length() < first.length() )
+   {
+      frameNumber.insert( 0, first.length() - frameNumber.length(), '0' );
+   }
+
+   framePathname = firstPathname.substr( 0, start ) + frameNumber +
+      firstPathname.substr( end + 1 );
+}
+
+
 void checkGamma
 (
    const float gamma
@@ -694,6 +2432,90 @@ void checkStrength
 }
 
 
+unsigned int getBalancingOptions
+(
+   const std::map<string,string>& options
+)
+{
+   // robust estimation if switched on
+   return p3wb11_GW |
+      ((0.0f != getOptionF( options, "mr", 0.0f )) ? p3wb13_ROBUST : 0);
+}
+
+
+udword checkFrames
+(
+   const float frames
+)
+{
+   if( !((frames >= 1.0f) && (frames <= 1e9f)) ||
+      (frames != static_cast<float>(static_cast<udword>(frames))) )
+   {
+      throw BAD_FRAMES_OPTION;
+   }
+
+   return static_cast<udword>(frames);
+}
+
+
+void checkUnit
+(
+   const float value,
+   const char* pMessage
+)
+{
+   if( ((0.0f > value) || (1.0f < value)) && (-1.0f != value) )
+   {
+      throw pMessage;
+   }
+}
+
+
+udword checkWorkers
+(
+   const float workers
+)
+{
+   if( !((workers >= 1.0f) && (workers <= 256.0f)) ||
+      (workers != static_cast<float>(static_cast<udword>(workers))) )
+   {
+      throw BAD_WORKERS_OPTION;
+   }
+
+   return static_cast<udword>(workers);
+}
+
+
+udword checkTileSize
+(
+   const float tileSize
+)
+{
+   if( !((tileSize >= 0.0f) && (tileSize <= 65536.0f)) ||
+      (tileSize != static_cast<float>(static_cast<udword>(tileSize))) )
+   {
+      throw BAD_TILE_OPTION;
+   }
+
+   return static_cast<udword>(tileSize);
+}
+
+
+qword checkMemory
+(
+   const float megabytes
+)
+{
+   // (negated, to catch NaN)
+   if( !((megabytes >= 0.0f) && (megabytes <= 1e12f)) )
+   {
+      throw BAD_MEMORY_OPTION;
+   }
+
+   return static_cast<qword>( static_cast<double>(megabytes) * 1048576.0 );
+}
+
+
 void displayImageData
 (
    const ImageAdopter& image
@@ -709,6 +2531,31 @@ void displayImageData
       std::cout << "  scaling:    " << image.getScaling() << "\n";
    }
 
+   displayImageMetadata( image );
+}
+
+
+void displayImageData
+(
+   const IndexedImage& image
+)
+{
+   std::cout << "\n" << "image data:" << "\n";
+
+   std::cout << "  width:      " << image.getWidth() << "\n";
+   std::cout << "  height:     " << image.getHeight() << "\n";
+   std::cout << "  palette:    " << image.getPalette().getWidth() <<
+      " entries, " << image.getBitDepth() << " bit indices\n";
+
+   displayImageMetadata( image.getPalette() );
+}
+
+
+void displayImageMetadata
+(
+   const ImageAdopter& image
+)
+{
    if( image.getColorspace() )
    {
       std::cout << "  colorspace: ";
@@ -762,7 +2609,7 @@ TITLE
 "   p3whitebalancer [-t...] [-o...] [-s...]\n"
 "\n"
 "switches:\n"
-"   -t<int>         which test: 1 to 5 for lib, -1 to -5 for app, 0 for all\n"
+"   -t<int>         which test: 1 to 11 for lib, -1 to -7 for app, 0 for all\n"
 "   -o<0 | 1 | 2>   set output level: 0 = none, 1 = summaries, 2 = verbose\n"
 "   -s<32bit int>   set random seed\n"
 "\n";
@@ -1023,6 +2870,19 @@ namespace hxa7241_image
    {
       bool test_rgbe( std::ostream* pOut, bool isVerbose, dword seed );
    }
+
+   namespace pfm
+   {
+      bool test_pfm ( std::ostream* pOut, bool isVerbose, dword seed );
+   }
+}
+
+namespace hxa7241_general
+{
+   namespace scratch
+   {
+      bool test_scratch( std::ostream* pOut, bool isVerbose, dword seed );
+   }
 }
 
 
@@ -1037,6 +2897,8 @@ bool (*TESTERS[])(std::ostream*, bool, dword) =
 ,  &hxa7241_image::png::test_png                 // 3
 ,  &hxa7241_image::ppm::test_ppm                 // 4
 ,  &hxa7241_image::rgbe::test_rgbe               // 5
+,  &hxa7241_general::scratch::test_scratch       // 6
+,  &hxa7241_image::pfm::test_pfm                 // 7
 };
 
 
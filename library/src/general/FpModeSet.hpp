@@ -0,0 +1,96 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef FpModeSet_h
+#define FpModeSet_h
+
+
+#ifdef _PLATFORM_LINUX
+#include <fenv.h>
+#endif
+#include <float.h>
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+
+/**
+ * Scoped setting of the floating-point environment, for the current thread:
+ * rounding mode near, no exceptions.<br/><br/>
+ *
+ * Restores the previous setting on destruction.
+ */
+class FpModeSet
+{
+public:
+   FpModeSet()
+#if defined(_PLATFORM_WIN) && !defined(__STRICT_ANSI__)
+    : fpControlWord_m( ::_controlfp( _MCW_EM | _RC_NEAR, _MCW_EM | _MCW_RC ) )
+#endif
+#ifdef _PLATFORM_LINUX
+    : fpExceptions_m( -1 )
+    , fpRounding_m  ( -1 )
+#endif
+   {
+#ifdef _PLATFORM_LINUX
+#ifdef FE_ALL_EXCEPT
+      fpExceptions_m = ::fedisableexcept( FE_ALL_EXCEPT );
+#endif
+#ifdef FE_TONEAREST
+      fpRounding_m = ::fegetround();
+      if( fpRounding_m >= 0 )
+      {
+         ::fesetround( FE_TONEAREST );
+      }
+#endif
+#endif //_PLATFORM_LINUX
+   }
+
+   ~FpModeSet()
+   {
+#if defined(_PLATFORM_WIN) && !defined(__STRICT_ANSI__)
+      ::_controlfp( fpControlWord_m, 0xFFFFFFFFu );
+#endif
+#ifdef _PLATFORM_LINUX
+      if( fpRounding_m >= 0 )
+      {
+         ::fesetround( fpRounding_m );
+      }
+      if( -1 != fpExceptions_m )
+      {
+         ::feenableexcept( fpExceptions_m );
+      }
+#endif //_PLATFORM_LINUX
+   }
+
+private:
+   FpModeSet( const FpModeSet& );
+   FpModeSet& operator=( const FpModeSet& );
+
+#if defined(_PLATFORM_WIN) && !defined(__STRICT_ANSI__)
+   unsigned int fpControlWord_m;
+#endif
+#ifdef _PLATFORM_LINUX
+   int          fpExceptions_m;
+   int          fpRounding_m;
+#endif
+};
+
+
+}//namespace
+
+
+
+
+#endif//FpModeSet_h
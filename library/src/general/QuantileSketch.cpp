@@ -0,0 +1,486 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <string.h>
+#include <algorithm>
+
+#include "QuantileSketch.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+/// standard object services ---------------------------------------------------
+QuantileSketch::QuantileSketch()
+ : levels_m  ( 1 )
+ , capacity_m( K )
+ , parities_m( 0 )
+ , weight_m  ( 0 )
+{
+   ::memset( items_m, 0, sizeof(items_m) );
+
+   for( udword h = LEVELS_MAX + 1;  h-- > 0; )
+   {
+      starts_m[h] = ITEMS_MAX;
+   }
+   for( udword h = LEVELS_MAX;  h-- > 0; )
+   {
+      capacities_m[h] = K;
+   }
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void QuantileSketch::add
+(
+   const float value,
+   uqword      weight
+)
+{
+   weight_m += weight;
+
+   // one value per bit of weight, at that bit's level
+   for( udword h = 0;  0 != weight;  ++h, weight >>= 1 )
+   {
+      if( weight & 1u )
+      {
+         insert( h, value );
+      }
+   }
+}
+
+
+void QuantileSketch::merge
+(
+   const QuantileSketch& other
+)
+{
+   if( &other != this )
+   {
+      // add other's values, at their levels, lowest first
+      for( udword h = 0;  h < other.levels_m;  ++h )
+      {
+         for( udword i = other.starts_m[h];  i < other.starts_m[h + 1];  ++i )
+         {
+            insert( h, other.items_m[i] );
+         }
+      }
+
+      weight_m += other.weight_m;
+   }
+   else
+   {
+      const QuantileSketch copy( other );
+      merge( copy );
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+uqword QuantileSketch::getWeight() const
+{
+   return weight_m;
+}
+
+
+float QuantileSketch::getQuantile
+(
+   const float q01
+) const
+{
+   std::vector<Item> items;
+   getItems( items );
+
+   // first value whose cumulative weight reaches the rank
+   const double rank = static_cast<double>(q01) *
+      static_cast<double>(weight_m);
+
+   double cumulative = 0.0;
+   for( udword i = 0;  i < items.size();  ++i )
+   {
+      cumulative += static_cast<double>(items[i].weight);
+      if( cumulative >= rank )
+      {
+         return items[i].value;
+      }
+   }
+
+   return items.empty() ? 0.0f : items.back().value;
+}
+
+
+float QuantileSketch::getTrimmedMean
+(
+   const float trim01
+) const
+{
+   std::vector<Item> items;
+   getItems( items );
+
+   const double weight = static_cast<double>(weight_m);
+   const double lower  = static_cast<double>(trim01) * weight;
+   const double upper  = weight - lower;
+
+   if( !(upper > lower) )
+   {
+      return getQuantile( 0.5f );
+   }
+
+   // sum each value's weight inside the rank range
+   double sum        = 0.0;
+   double cumulative = 0.0;
+   for( udword i = 0;  i < items.size();  ++i )
+   {
+      const double begin = cumulative;
+      cumulative += static_cast<double>(items[i].weight);
+
+      const double inside = (cumulative < upper ? cumulative : upper) -
+         (begin > lower ? begin : lower);
+      if( inside > 0.0 )
+      {
+         sum += static_cast<double>(items[i].value) * inside;
+      }
+   }
+
+   return static_cast<float>( sum / (upper - lower) );
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void QuantileSketch::insert
+(
+   const udword level,
+   const float  value
+)
+{
+   while( level >= levels_m )
+   {
+      addLevel();
+   }
+
+   if( (ITEMS_MAX - starts_m[0]) >= capacity_m )
+   {
+      compress();
+   }
+
+   // open a slot at the bottom of the level, moving lower levels down one
+   // (none for level 0, the usual case)
+   if( 0 != level )
+   {
+      const udword bottom = starts_m[0];
+      ::memmove( items_m + bottom - 1, items_m + bottom,
+         (starts_m[level] - bottom) * sizeof(float) );
+      for( udword h = 1;  h <= level;  ++h )
+      {
+         --starts_m[h];
+      }
+   }
+   --starts_m[0];
+
+   items_m[ starts_m[level] ] = value;
+}
+
+
+void QuantileSketch::compress()
+{
+   // lowest level at or over its capacity (as the total is, one must be)
+   udword h = 0;
+   while( ((h + 1) < levels_m) &&
+      ((starts_m[h + 1] - starts_m[h]) < capacities_m[h]) )
+   {
+      ++h;
+   }
+   if( (h + 1) == levels_m )
+   {
+      addLevel();
+   }
+
+   // leave any odd one, sort the rest
+   const udword odd   = (starts_m[h + 1] - starts_m[h]) & 1u;
+   const udword begin = starts_m[h] + odd;
+   const udword half  = (starts_m[h + 1] - begin) >> 1;
+   std::sort( items_m + begin, items_m + starts_m[h + 1] );
+
+   // promote every other one (alternately odd or even) into the top half,
+   // which becomes part of the level above
+   // (backwards, so none are overwritten before being read)
+   const udword offset = static_cast<udword>(parities_m >> h) & 1u;
+   parities_m ^= static_cast<uqword>(1) << h;
+   for( udword i = half;  i-- > 0; )
+   {
+      items_m[ begin + half + i ] = items_m[ begin + offset + (i * 2) ];
+   }
+   starts_m[h + 1] -= half;
+
+   // close the gap left: move the odd one and lower levels up
+   ::memmove( items_m + starts_m[0] + half, items_m + starts_m[0],
+      (begin - starts_m[0]) * sizeof(float) );
+   for( udword l = 0;  l <= h;  ++l )
+   {
+      starts_m[l] += half;
+   }
+}
+
+
+void QuantileSketch::addLevel()
+{
+   // (new top level is empty, at the end)
+   ++levels_m;
+   starts_m[levels_m] = ITEMS_MAX;
+
+   // (capacities of all levels shrink, but the total grows)
+   capacity_m = 0;
+   for( udword h = levels_m;  h-- > 0; )
+   {
+      capacities_m[h] = getCapacity( h );
+      capacity_m     += capacities_m[h];
+   }
+}
+
+
+udword QuantileSketch::getCapacity
+(
+   const udword level
+) const
+{
+   float capacity = static_cast<float>(K);
+   for( udword d = levels_m - 1 - level;
+      (d-- > 0) && (capacity >= static_cast<float>(MIN_CAPACITY)); )
+   {
+      capacity *= (2.0f / 3.0f);
+   }
+
+   return capacity >= static_cast<float>(MIN_CAPACITY) ?
+      static_cast<udword>(capacity) : static_cast<udword>(MIN_CAPACITY);
+}
+
+
+void QuantileSketch::getItems
+(
+   std::vector<Item>& items
+) const
+{
+   items.clear();
+   items.reserve( ITEMS_MAX - starts_m[0] );
+
+   for( udword h = 0;  h < levels_m;  ++h )
+   {
+      for( udword i = starts_m[h];  i < starts_m[h + 1];  ++i )
+      {
+         const Item item = { items_m[i], static_cast<uqword>(1) << h };
+         items.push_back( item );
+      }
+   }
+
+   std::sort( items.begin(), items.end() );
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <math.h>
+#include <ostream>
+
+
+namespace hxa7241_general
+{
+
+namespace
+{
+
+/**
+ * Exact fraction of values below a value, for rank error.
+ */
+float getRank
+(
+   const std::vector<float>& sorted,
+   const float               value
+)
+{
+   return static_cast<float>( std::lower_bound( sorted.begin(), sorted.end(),
+      value ) - sorted.begin() ) / static_cast<float>(sorted.size());
+}
+
+}
+
+
+bool test_QuantileSketch
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_QuantileSketch ]\n\n";
+
+
+   // skewed values: a dull mass, with a bright tail (like highlights)
+   const udword COUNT = 1000000;
+   std::vector<float> values( COUNT );
+   {
+      udword r = seed ? static_cast<udword>(seed) : 362436069u;
+      for( udword i = 0;  i < COUNT;  ++i )
+      {
+         r = 36969u * (r & 0xFFFFu) + (r >> 16);
+         const float f = static_cast<float>(r & 0xFFFFu) / 65536.0f;
+         values[i] = (i % 20) ? f : (f * f * 1000.0f) + 1.0f;
+      }
+   }
+   std::vector<float> sorted( values );
+   std::sort( sorted.begin(), sorted.end() );
+
+   static const float QUANTILES[] = { 0.0f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f,
+      0.99f };
+
+   // quantiles within rank tolerance, in fixed size
+   QuantileSketch whole;
+   {
+      for( udword i = 0;  i < COUNT;  ++i )
+      {
+         whole.add( values[i] );
+      }
+
+      bool isOk_ = (COUNT == whole.getWeight()) &
+         (sizeof(QuantileSketch) < 5000);
+
+      for( udword q = 0;  q < sizeof(QUANTILES)/sizeof(QUANTILES[0]);  ++q )
+      {
+         const float rank = getRank( sorted, whole.getQuantile(
+            QUANTILES[q] ) );
+         isOk_ &= ::fabsf( rank - QUANTILES[q] ) < 0.01f;
+
+         if( pOut && isVerbose ) *pOut << QUANTILES[q] << ": " << rank <<
+            "  ";
+      }
+      if( pOut && isVerbose ) *pOut << " size " << sizeof(QuantileSketch) <<
+         "\n";
+
+      // trimmed mean
+      double sum = 0.0;
+      for( udword i = COUNT / 4;  i < (COUNT - (COUNT / 4));  ++i )
+      {
+         sum += sorted[i];
+      }
+      const float mean    = static_cast<float>( sum / (COUNT / 2) );
+      const float trimmed = whole.getTrimmedMean( 0.25f );
+      isOk_ &= ::fabsf( trimmed - mean ) < (0.01f * mean);
+
+      if( pOut && isVerbose ) *pOut << "trimmed mean: " << trimmed << "  " <<
+         mean << "\n\n";
+
+      if( pOut ) *pOut << "quantiles : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // merged parts: same every time, and close to whole
+   {
+      QuantileSketch merged[2];
+      for( udword k = 0;  k < 2;  ++k )
+      {
+         // (parts filled in a different order each time, as by threads)
+         QuantileSketch parts[4];
+         for( udword n = 0;  n < 4;  ++n )
+         {
+            const udword p = k ? (3 - n) : n;
+            for( udword i = (p * COUNT) / 4;  i < ((p + 1) * COUNT) / 4;  ++i )
+            {
+               parts[p].add( values[i] );
+            }
+         }
+         for( udword p = 0;  p < 4;  ++p )
+         {
+            merged[k].merge( parts[p] );
+         }
+      }
+
+      bool isOk_ = (COUNT == merged[0].getWeight());
+      for( udword q = 0;  q < sizeof(QUANTILES)/sizeof(QUANTILES[0]);  ++q )
+      {
+         isOk_ &= (merged[0].getQuantile( QUANTILES[q] ) ==
+            merged[1].getQuantile( QUANTILES[q] ));
+         isOk_ &= ::fabsf( getRank( sorted, merged[0].getQuantile(
+            QUANTILES[q] ) ) - QUANTILES[q] ) < 0.015f;
+      }
+
+      if( pOut ) *pOut << "merge : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // weights: as if added repeatedly
+   {
+      QuantileSketch     weighted;
+      std::vector<float> repeated;
+      for( udword i = 0;  i < 1000;  ++i )
+      {
+         const uqword weight = (i % 7) * 13;
+         weighted.add( values[i], weight );
+         repeated.insert( repeated.end(), static_cast<udword>(weight),
+            values[i] );
+      }
+      std::sort( repeated.begin(), repeated.end() );
+
+      bool isOk_ = (weighted.getWeight() == repeated.size());
+      for( udword q = 1;  q < sizeof(QUANTILES)/sizeof(QUANTILES[0]);  ++q )
+      {
+         isOk_ &= ::fabsf( getRank( repeated, weighted.getQuantile(
+            QUANTILES[q] ) ) - QUANTILES[q] ) < 0.02f;
+      }
+
+      // empty, and single
+      QuantileSketch empty;
+      QuantileSketch single;
+      single.add( 2.5f, 3 );
+      isOk_ &= (0.0f == empty.getQuantile( 0.5f )) &
+         (0.0f == empty.getTrimmedMean( 0.25f )) &
+         (2.5f == single.getQuantile( 0.0f )) &
+         (2.5f == single.getTrimmedMean( 0.25f ));
+
+      if( pOut ) *pOut << "weights : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+}//namespace
+
+
+#endif//TESTING
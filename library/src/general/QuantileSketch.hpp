@@ -0,0 +1,136 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef QuantileSketch_h
+#define QuantileSketch_h
+
+
+#include <vector>
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Streaming quantile estimator, in fixed memory (a KLL sketch).<br/><br/>
+ *
+ * Values are kept in levels: a value at level h stands for 2^h added values.
+ * When full, the lowest full level is sorted, and every other value promoted
+ * to the level above. Lower levels get geometrically smaller capacities, so
+ * size stays under about 4.5KB however many values are added, with rank error
+ * around a percent.<br/><br/>
+ *
+ * Promotion alternates between odd and even values per level, instead of
+ * choosing randomly, so results depend only on the values and the order they
+ * are added (and merged) in. Sketches of separate parts (for example, one per
+ * thread) can be merged, in a fixed order, for the same result every time.
+ *
+ * @invariants
+ * * levels_m >= 1 and <= LEVELS_MAX
+ * * starts_m[levels_m] == ITEMS_MAX
+ * * starts_m[h] <= starts_m[h + 1]
+ * * capacity_m == sum of capacities_m, up to levels_m
+ * * sum over items of 2^level == weight_m
+ */
+class QuantileSketch
+{
+/// standard object services ---------------------------------------------------
+public:
+            QuantileSketch();
+
+// use defaults
+//         ~QuantileSketch();
+//          QuantileSketch( const QuantileSketch& );
+//   QuantileSketch& operator=( const QuantileSketch& );
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * @weight  how many times value counts (0 adds nothing)
+    */
+           void   add  ( float value,
+                         uqword weight = 1 );
+           void   merge( const QuantileSketch& other );
+
+
+/// queries --------------------------------------------------------------------
+           uqword getWeight()                                             const;
+
+   /**
+    * @q01     rank, as a fraction of weight, >= 0 and <= 1
+    *
+    * @return  value at that rank (0 if empty)
+    */
+           float  getQuantile( float q01 )                                const;
+
+   /**
+    * Mean of the values between two ranks: trim01 and (1 - trim01).
+    *
+    * @trim01  fraction of weight left out at each end, >= 0 and < 0.5
+    *
+    * @return  mean (0 if empty)
+    */
+           float  getTrimmedMean( float trim01 )                          const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   struct Item
+   {
+      float  value;
+      uqword weight;
+
+      bool operator<( const Item& other ) const { return value < other.value; }
+   };
+
+           void   insert( udword level,
+                          float  value );
+           void   compress();
+           void   addLevel();
+
+           udword getCapacity( udword level )                             const;
+           void   getItems( std::vector<Item>& items )                    const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   // (capacities: K at the top level, shrinking by 2/3 per level down, but no
+   // less than MIN_CAPACITY -- so all levels fit in 3K + MIN * LEVELS_MAX)
+   enum
+   {
+      K            = 200,
+      MIN_CAPACITY = 8,
+      LEVELS_MAX   = 64,
+      ITEMS_MAX    = (3 * K) + (MIN_CAPACITY * LEVELS_MAX)
+   };
+
+   // levels are packed at the end of items_m, lowest first
+   float  items_m[ ITEMS_MAX ];
+   udword starts_m[ LEVELS_MAX + 1 ];
+   udword levels_m;
+
+   // (capacities, recomputed when a level is added)
+   udword capacities_m[ LEVELS_MAX ];
+   udword capacity_m;
+
+   // (a bit per level, flipped at each compaction)
+   uqword parities_m;
+   uqword weight_m;
+};
+
+}//namespace
+
+
+
+
+#endif//QuantileSketch_h
@@ -0,0 +1,361 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifdef _PLATFORM_WIN
+
+#include <windows.h>   // kernel32.lib
+#include <process.h>
+
+#elif _PLATFORM_LINUX
+
+#include <pthread.h>   // libpthread
+#include <unistd.h>
+
+#endif
+
+#include "Threads.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+const char MUTEX_CREATE_FAIL_MESSAGE[]     = "mutex creation failed";
+const char SEMAPHORE_CREATE_FAIL_MESSAGE[] = "semaphore creation failed";
+const char THREAD_CREATE_FAIL_MESSAGE[]    = "thread creation failed";
+
+
+/// types ----------------------------------------------------------------------
+#ifdef _PLATFORM_WIN
+
+struct ThreadHandle
+{
+   HANDLE           thread;
+   Thread::Function pFunction;
+   void*            pArgument;
+};
+
+
+unsigned __stdcall threadStart
+(
+   void* pHandle
+)
+{
+   const ThreadHandle& handle = *static_cast<ThreadHandle*>( pHandle );
+   (handle.pFunction)( handle.pArgument );
+
+   return 0;
+}
+
+#elif _PLATFORM_LINUX
+
+struct SemaphoreHandle
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t  condition;
+   udword          count;
+};
+
+
+struct ThreadHandle
+{
+   pthread_t        thread;
+   Thread::Function pFunction;
+   void*            pArgument;
+};
+
+
+void* threadStart
+(
+   void* pHandle
+)
+{
+   const ThreadHandle& handle = *static_cast<ThreadHandle*>( pHandle );
+   (handle.pFunction)( handle.pArgument );
+
+   return 0;
+}
+
+#endif
+
+}
+
+
+
+
+/// mutex ======================================================================
+
+/// standard object services ---------------------------------------------------
+Mutex::Mutex()
+ : pHandle_m( 0 )
+{
+#ifdef _PLATFORM_WIN
+
+   CRITICAL_SECTION* pSection = new CRITICAL_SECTION;
+   ::InitializeCriticalSection( pSection );
+   pHandle_m = pSection;
+
+#elif _PLATFORM_LINUX
+
+   pthread_mutex_t* pMutex = new pthread_mutex_t;
+   if( 0 != ::pthread_mutex_init( pMutex, 0 ) )
+   {
+      delete pMutex;
+      throw MUTEX_CREATE_FAIL_MESSAGE;
+   }
+   pHandle_m = pMutex;
+
+#else
+
+   throw MUTEX_CREATE_FAIL_MESSAGE;
+
+#endif
+}
+
+
+Mutex::~Mutex()
+{
+#ifdef _PLATFORM_WIN
+
+   CRITICAL_SECTION* pSection = static_cast<CRITICAL_SECTION*>( pHandle_m );
+   ::DeleteCriticalSection( pSection );
+   delete pSection;
+
+#elif _PLATFORM_LINUX
+
+   pthread_mutex_t* pMutex = static_cast<pthread_mutex_t*>( pHandle_m );
+   ::pthread_mutex_destroy( pMutex );
+   delete pMutex;
+
+#endif
+}
+
+
+/// commands -------------------------------------------------------------------
+void Mutex::lock()
+{
+#ifdef _PLATFORM_WIN
+   ::EnterCriticalSection( static_cast<CRITICAL_SECTION*>( pHandle_m ) );
+#elif _PLATFORM_LINUX
+   ::pthread_mutex_lock( static_cast<pthread_mutex_t*>( pHandle_m ) );
+#endif
+}
+
+
+void Mutex::unlock()
+{
+#ifdef _PLATFORM_WIN
+   ::LeaveCriticalSection( static_cast<CRITICAL_SECTION*>( pHandle_m ) );
+#elif _PLATFORM_LINUX
+   ::pthread_mutex_unlock( static_cast<pthread_mutex_t*>( pHandle_m ) );
+#endif
+}
+
+
+
+
+/// semaphore ==================================================================
+
+/// standard object services ---------------------------------------------------
+Semaphore::Semaphore
+(
+   const udword initialCount
+)
+ : pHandle_m( 0 )
+{
+#ifdef _PLATFORM_WIN
+
+   pHandle_m = ::CreateSemaphore( 0, static_cast<LONG>(initialCount),
+      0x7FFFFFFF, 0 );
+   if( 0 == pHandle_m )
+   {
+      throw SEMAPHORE_CREATE_FAIL_MESSAGE;
+   }
+
+#elif _PLATFORM_LINUX
+
+   SemaphoreHandle* pSemaphore = new SemaphoreHandle;
+   pSemaphore->count = initialCount;
+   if( 0 != ::pthread_mutex_init( &pSemaphore->mutex, 0 ) )
+   {
+      delete pSemaphore;
+      throw SEMAPHORE_CREATE_FAIL_MESSAGE;
+   }
+   if( 0 != ::pthread_cond_init( &pSemaphore->condition, 0 ) )
+   {
+      ::pthread_mutex_destroy( &pSemaphore->mutex );
+      delete pSemaphore;
+      throw SEMAPHORE_CREATE_FAIL_MESSAGE;
+   }
+   pHandle_m = pSemaphore;
+
+#else
+
+   throw SEMAPHORE_CREATE_FAIL_MESSAGE;
+
+#endif
+}
+
+
+Semaphore::~Semaphore()
+{
+#ifdef _PLATFORM_WIN
+
+   ::CloseHandle( static_cast<HANDLE>( pHandle_m ) );
+
+#elif _PLATFORM_LINUX
+
+   SemaphoreHandle* pSemaphore = static_cast<SemaphoreHandle*>( pHandle_m );
+   ::pthread_cond_destroy( &pSemaphore->condition );
+   ::pthread_mutex_destroy( &pSemaphore->mutex );
+   delete pSemaphore;
+
+#endif
+}
+
+
+/// commands -------------------------------------------------------------------
+void Semaphore::wait()
+{
+#ifdef _PLATFORM_WIN
+
+   ::WaitForSingleObject( static_cast<HANDLE>( pHandle_m ), INFINITE );
+
+#elif _PLATFORM_LINUX
+
+   SemaphoreHandle& semaphore = *static_cast<SemaphoreHandle*>( pHandle_m );
+
+   ::pthread_mutex_lock( &semaphore.mutex );
+   while( 0 == semaphore.count )
+   {
+      ::pthread_cond_wait( &semaphore.condition, &semaphore.mutex );
+   }
+   --semaphore.count;
+   ::pthread_mutex_unlock( &semaphore.mutex );
+
+#endif
+}
+
+
+void Semaphore::post
+(
+   const udword count
+)
+{
+#ifdef _PLATFORM_WIN
+
+   ::ReleaseSemaphore( static_cast<HANDLE>( pHandle_m ),
+      static_cast<LONG>(count), 0 );
+
+#elif _PLATFORM_LINUX
+
+   SemaphoreHandle& semaphore = *static_cast<SemaphoreHandle*>( pHandle_m );
+
+   ::pthread_mutex_lock( &semaphore.mutex );
+   semaphore.count += count;
+   if( 1 == count )
+   {
+      ::pthread_cond_signal( &semaphore.condition );
+   }
+   else
+   {
+      ::pthread_cond_broadcast( &semaphore.condition );
+   }
+   ::pthread_mutex_unlock( &semaphore.mutex );
+
+#endif
+}
+
+
+
+
+/// thread =====================================================================
+
+/// standard object services ---------------------------------------------------
+Thread::Thread
+(
+   const Function pFunction,
+   void* const    pArgument
+)
+ : pHandle_m( 0 )
+{
+#if defined(_PLATFORM_WIN) || defined(_PLATFORM_LINUX)
+
+   ThreadHandle* pThread = new ThreadHandle;
+   pThread->pFunction = pFunction;
+   pThread->pArgument = pArgument;
+
+#ifdef _PLATFORM_WIN
+   pThread->thread = reinterpret_cast<HANDLE>( ::_beginthreadex( 0, 0,
+      &threadStart, pThread, 0, 0 ) );
+   if( 0 == pThread->thread )
+#else
+   if( 0 != ::pthread_create( &pThread->thread, 0, &threadStart, pThread ) )
+#endif
+   {
+      delete pThread;
+      throw THREAD_CREATE_FAIL_MESSAGE;
+   }
+
+   pHandle_m = pThread;
+
+#else
+
+   throw THREAD_CREATE_FAIL_MESSAGE;
+
+#endif
+}
+
+
+Thread::~Thread()
+{
+#if defined(_PLATFORM_WIN) || defined(_PLATFORM_LINUX)
+
+   ThreadHandle* pThread = static_cast<ThreadHandle*>( pHandle_m );
+
+#ifdef _PLATFORM_WIN
+   ::WaitForSingleObject( pThread->thread, INFINITE );
+   ::CloseHandle( pThread->thread );
+#else
+   ::pthread_join( pThread->thread, 0 );
+#endif
+
+   delete pThread;
+
+#endif
+}
+
+
+
+
+/// functions ==================================================================
+udword hxa7241_general::getProcessorCount()
+{
+   dword count = 1;
+
+#ifdef _PLATFORM_WIN
+
+   SYSTEM_INFO info;
+   ::GetSystemInfo( &info );
+   count = static_cast<dword>( info.dwNumberOfProcessors );
+
+#elif _PLATFORM_LINUX
+
+   count = static_cast<dword>( ::sysconf( _SC_NPROCESSORS_ONLN ) );
+
+#endif
+
+   return count >= 1 ? static_cast<udword>(count) : 1;
+}
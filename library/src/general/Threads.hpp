@@ -0,0 +1,159 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef Threads_h
+#define Threads_h
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/// mutex ----------------------------------------------------------------------
+   /**
+    * Mutual exclusion lock, non-recursive.<br/><br/>
+    *
+    * (Platform handle is kept opaque, so no system headers are needed here.)
+    *
+    * @throws  construction
+    */
+   class Mutex
+   {
+   /// standard object services ------------------------------------------------
+   public:
+               Mutex();
+
+              ~Mutex();
+   private:
+               Mutex( const Mutex& );
+      Mutex&   operator=( const Mutex& );
+   public:
+
+   /// commands ----------------------------------------------------------------
+      void     lock();
+      void     unlock();
+
+   /// fields ------------------------------------------------------------------
+   private:
+      void* pHandle_m;
+   };
+
+
+   /**
+    * Scoped lock of a Mutex.<br/><br/>
+    *
+    * Locks on construction, unlocks on destruction.
+    */
+   class MutexLock
+   {
+   public:
+      explicit MutexLock( Mutex& mutex )
+       : mutex_m( mutex )
+      {
+         mutex_m.lock();
+      }
+
+      ~MutexLock()
+      {
+         mutex_m.unlock();
+      }
+
+   private:
+      MutexLock( const MutexLock& );
+      MutexLock& operator=( const MutexLock& );
+
+      Mutex& mutex_m;
+   };
+
+
+
+
+/// semaphore ------------------------------------------------------------------
+   /**
+    * Counting semaphore.<br/><br/>
+    *
+    * @throws  construction
+    */
+   class Semaphore
+   {
+   /// standard object services ------------------------------------------------
+   public:
+      explicit   Semaphore( udword initialCount = 0 );
+
+                ~Semaphore();
+   private:
+                 Semaphore( const Semaphore& );
+      Semaphore& operator=( const Semaphore& );
+   public:
+
+   /// commands ----------------------------------------------------------------
+      /**
+       * Block until count is > 0, then decrement it.
+       */
+      void       wait();
+
+      /**
+       * Increment count, releasing waiters.
+       */
+      void       post( udword count = 1 );
+
+   /// fields ------------------------------------------------------------------
+   private:
+      void* pHandle_m;
+   };
+
+
+
+
+/// thread ---------------------------------------------------------------------
+   /**
+    * Thread of execution.<br/><br/>
+    *
+    * Starts running the function on construction, joins on destruction.
+    *
+    * @throws  construction
+    */
+   class Thread
+   {
+   /// standard object services ------------------------------------------------
+   public:
+      typedef void (*Function)( void* pArgument );
+
+               Thread( Function pFunction,
+                       void*    pArgument );
+
+              ~Thread();
+   private:
+               Thread( const Thread& );
+      Thread&  operator=( const Thread& );
+   public:
+
+   /// fields ------------------------------------------------------------------
+   private:
+      void* pHandle_m;
+   };
+
+
+
+
+/// functions ------------------------------------------------------------------
+   /**
+    * Number of processors available to this process (>= 1).
+    */
+   udword getProcessorCount();
+
+}//namespace
+
+
+
+
+#endif//Threads_h
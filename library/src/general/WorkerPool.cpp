@@ -0,0 +1,142 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include "WorkerPool.hpp"
+
+
+using namespace hxa7241_general;
+
+
+
+
+/// standard object services ---------------------------------------------------
+WorkerPool::WorkerPool
+(
+   const udword threadCount
+)
+ : isStopping_m( false )
+{
+   try
+   {
+      for( udword i = (threadCount >= 1 ? threadCount : 1);  i-- > 0; )
+      {
+         threads_m.push_back( 0 );
+         threads_m.back() = new Thread( &WorkerPool::threadMain, this );
+      }
+   }
+   catch( ... )
+   {
+      stop();
+      throw;
+   }
+}
+
+
+WorkerPool::~WorkerPool()
+{
+   stop();
+}
+
+
+/// commands -------------------------------------------------------------------
+void WorkerPool::submit
+(
+   Task* const pTask
+)
+{
+   {
+      MutexLock lock( mutex_m );
+      queue_m.push_back( pTask );
+   }
+   queued_m.post();
+}
+
+
+bool WorkerPool::withdraw
+(
+   Task* const pTask
+)
+{
+   MutexLock lock( mutex_m );
+
+   for( std::deque<Task*>::iterator i = queue_m.begin();  i != queue_m.end();
+      ++i )
+   {
+      if( *i == pTask )
+      {
+         // (its semaphore count remains, and makes a harmless empty wake)
+         queue_m.erase( i );
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/// queries --------------------------------------------------------------------
+udword WorkerPool::getThreadCount() const
+{
+   return static_cast<udword>(threads_m.size());
+}
+
+
+/// implementation -------------------------------------------------------------
+void WorkerPool::stop()
+{
+   // tell threads to finish, when queue is empty
+   {
+      MutexLock lock( mutex_m );
+      isStopping_m = true;
+   }
+   queued_m.post( static_cast<udword>(threads_m.size()) );
+
+   // join threads (null entry only if construction failed)
+   for( udword i = 0;  i < threads_m.size();  ++i )
+   {
+      delete threads_m[i];
+   }
+   threads_m.clear();
+}
+
+
+void WorkerPool::threadMain
+(
+   void* const pPool
+)
+{
+   WorkerPool& pool = *static_cast<WorkerPool*>( pPool );
+
+   for( ;; )
+   {
+      pool.queued_m.wait();
+
+      // take next task, or finish if stopping and none left
+      Task* pTask = 0;
+      {
+         MutexLock lock( pool.mutex_m );
+
+         if( !pool.queue_m.empty() )
+         {
+            pTask = pool.queue_m.front();
+            pool.queue_m.pop_front();
+         }
+         else if( pool.isStopping_m )
+         {
+            break;
+         }
+      }
+
+      if( pTask )
+      {
+         pTask->run();
+      }
+   }
+}
@@ -0,0 +1,93 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 General library.
+   Copyright (c) 2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef WorkerPool_h
+#define WorkerPool_h
+
+
+#include <deque>
+#include <vector>
+
+#include "Threads.hpp"
+
+
+
+
+#include "hxa7241_general.hpp"
+namespace hxa7241_general
+{
+
+/**
+ * Fixed set of threads running queued tasks, first-in first-out.<br/><br/>
+ *
+ * Tasks are not owned: the submitter keeps them alive until they have run or
+ * been withdrawn. Destruction runs all still-queued tasks, then joins.
+ *
+ * @invariants
+ * * threads_m.size() >= 1
+ */
+class WorkerPool
+{
+public:
+   /**
+    * Unit of work. run() must not throw.
+    */
+   class Task
+   {
+   public:
+      virtual     ~Task() {}
+      virtual void run() = 0;
+   };
+
+
+/// standard object services ---------------------------------------------------
+public:
+   explicit    WorkerPool( udword threadCount );
+
+              ~WorkerPool();
+private:
+               WorkerPool( const WorkerPool& );
+   WorkerPool& operator=( const WorkerPool& );
+public:
+
+/// commands -------------------------------------------------------------------
+           void   submit  ( Task* pTask );
+
+   /**
+    * Remove task from queue, if it has not started.
+    *
+    * @return  true if removed (so will not run), false if started or unknown
+    */
+           bool   withdraw( Task* pTask );
+
+/// queries --------------------------------------------------------------------
+           udword getThreadCount()                                        const;
+
+/// implementation -------------------------------------------------------------
+protected:
+           void   stop();
+   static  void   threadMain( void* pPool );
+
+/// fields ---------------------------------------------------------------------
+private:
+   Mutex               mutex_m;
+   Semaphore           queued_m;
+   std::deque<Task*>   queue_m;
+   bool                isStopping_m;
+
+   std::vector<Thread*> threads_m;
+};
+
+}//namespace
+
+
+
+
+#endif//WorkerPool_h
@@ -25,6 +25,16 @@ namespace hxa7241_general
    //PowFast functions
    class LogFast;
    class PowFast;
+
+   //QuantileSketch functions
+   class QuantileSketch;
+
+   //Threads functions
+   class Mutex;
+   class MutexLock;
+   class Semaphore;
+   class Thread;
+   class WorkerPool;
 }
 
 
@@ -26,9 +26,31 @@ ImageWrapper::ImageWrapper
    const dword         height,
    const EChannelOrder channelOrder,
    const udword        pixelStride,
+   const qword         rowPitch,
    float*const         pPixels
 )
- : ImageWrapperConst( width, height, channelOrder, pixelStride, pPixels )
+ : ImageWrapperConst( width, height, channelOrder, pixelStride, rowPitch,
+      pPixels )
+ , alpha_m( 1.0f )
+{
+}
+
+
+ImageWrapper::ImageWrapper
+(
+   const dword         width,
+   const dword         height,
+   const EChannelOrder channelOrder,
+   const EChannelType  channelType,
+   const bool          hasAlpha,
+   const float         alpha,
+   const udword        pixelStride,
+   const qword         rowPitch,
+   void*const          pPixels
+)
+ : ImageWrapperConst( width, height, channelOrder, channelType, hasAlpha,
+      pixelStride, rowPitch, pPixels )
+ , alpha_m( alpha )
 {
 }
 
@@ -56,6 +78,7 @@ ImageWrapper::ImageWrapper
    const ImageWrapper& that
 )
  : ImageWrapperConst( that )
+ , alpha_m( that.alpha_m )
 {
 }
 
@@ -66,6 +89,7 @@ ImageWrapper& ImageWrapper::operator=
 )
 {
    ImageWrapperConst::operator=( that );
+   alpha_m = that.alpha_m;
 
    return *this;
 }
@@ -81,13 +105,26 @@ void ImageWrapper::set
    const Vector3f& element
 )
 {
-   set( (y * width_m) + x, element );
+   setAt( getOffset( x, y ), element );
 }
 
 
 void ImageWrapper::set
 (
-   const dword     i,
+   const qword     i,
+   const Vector3f& element
+)
+{
+   setAt( getOffset( i ), element );
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void ImageWrapper::setAt
+(
+   const qword     offset,
    const Vector3f& element
 )
 {
@@ -99,7 +136,7 @@ void ImageWrapper::set
    }
 
    void* pPixelBytes = static_cast<ubyte*>(const_cast<void*>(pPixels_m)) +
-      (i * pixelStride_m);
+      offset;
 
    switch( channelType_m )
    {
@@ -117,6 +154,29 @@ void ImageWrapper::set
          pt[0] = pixel[0];
          pt[1] = pixel[1];
          pt[2] = pixel[2];
+         if( hasAlpha_m )
+         {
+            pt[3] = alpha_m;
+         }
+         break;
+      }
+      case UBYTE_e :
+      {
+         // clamp to 0-1, scale, round
+         // (NaNs fail both comparisons, so come out as 0)
+         #define QUANTIZE(f) static_cast<ubyte>( (((f) > 0.0f) ? \
+            (((f) < 1.0f) ? (f) : 1.0f) : 0.0f) * 255.0f + 0.5f )
+
+         ubyte* pt = static_cast<ubyte*>( pPixelBytes );
+         pt[0] = QUANTIZE( pixel[0] );
+         pt[1] = QUANTIZE( pixel[1] );
+         pt[2] = QUANTIZE( pixel[2] );
+         if( hasAlpha_m )
+         {
+            pt[3] = QUANTIZE( alpha_m );
+         }
+
+         #undef QUANTIZE
          break;
       }
    }
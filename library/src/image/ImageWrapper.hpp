@@ -38,7 +38,17 @@ public:
                           dword         height,
                           EChannelOrder channelOrder,
                           udword        pixelStride,
+                          qword         rowPitch,
                           float*        pPixels );
+            ImageWrapper( dword         width,
+                          dword         height,
+                          EChannelOrder channelOrder,
+                          EChannelType  channelType,
+                          bool          hasAlpha,
+                          float         alpha,
+                          udword        pixelStride,
+                          qword         rowPitch,
+                          void*         pPixels );
 //            ImageWrapper( dword         width,
 //                          dword         height,
 //                          EChannelOrder channelOrder,
@@ -54,8 +64,17 @@ public:
            void  set( dword x,
                       dword y,
                       const Vector3f& );
-           void  set( dword i,
+           void  set( qword i,
                       const Vector3f& );
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  setAt( qword offset,
+                        const Vector3f& );
+
+/// fields ---------------------------------------------------------------------
+private:
+   float alpha_m;
 };
 
 
@@ -27,6 +27,8 @@ const char SIZE_EXCEPTION_MESSAGE[] =
    "size out of range, in ImageWrapper construction";
 const char PIXEL_STRIDE_EXCEPTION_MESSAGE[] =
    "pixel stride too small, in ImageWrapper construction";
+const char ROW_PITCH_EXCEPTION_MESSAGE[] =
+   "row pitch too small, in ImageWrapper construction";
 const char NULL_PIXELS_POINTER_EXCEPTION_MESSAGE[] =
    "pixels pointer null, in ImageWrapper construction";
 
@@ -42,11 +44,29 @@ ImageWrapperConst::ImageWrapperConst
    const dword         height,
    const EChannelOrder channelOrder,
    const udword        pixelStride,
+   const qword         rowPitch,
    const float*const   pPixels
 )
 {
    ImageWrapperConst::construct( width, height, channelOrder, FLOAT_e,
-      pixelStride, pPixels );
+      false, pixelStride, rowPitch, pPixels );
+}
+
+
+ImageWrapperConst::ImageWrapperConst
+(
+   const dword         width,
+   const dword         height,
+   const EChannelOrder channelOrder,
+   const EChannelType  channelType,
+   const bool          hasAlpha,
+   const udword        pixelStride,
+   const qword         rowPitch,
+   const void*const    pPixels
+)
+{
+   ImageWrapperConst::construct( width, height, channelOrder, channelType,
+      hasAlpha, pixelStride, rowPitch, pPixels );
 }
 
 
@@ -89,7 +109,9 @@ ImageWrapperConst& ImageWrapperConst::operator=
       height_m       = that.height_m;
       channelOrder_m = that.channelOrder_m;
       channelType_m  = that.channelType_m;
+      hasAlpha_m     = that.hasAlpha_m;
       pixelStride_m  = that.pixelStride_m;
+      rowPitch_m     = that.rowPitch_m;
       pPixels_m      = that.pPixels_m;
    }
 
@@ -112,9 +134,15 @@ dword ImageWrapperConst::getHeight() const
 }
 
 
-dword ImageWrapperConst::getLength() const
+qword ImageWrapperConst::getLength() const
 {
-   return width_m * height_m;
+   return static_cast<qword>(width_m) * height_m;
+}
+
+
+bool ImageWrapperConst::isPacked() const
+{
+   return rowPitch_m == (static_cast<qword>(width_m) * pixelStride_m);
 }
 
 
@@ -124,19 +152,30 @@ Vector3f ImageWrapperConst::get
    const dword y
 ) const
 {
-   return get( (y * width_m) + x );
+   return getAt( getOffset( x, y ) );
 }
 
 
 Vector3f ImageWrapperConst::get
 (
-   const dword i
+   const qword i
+) const
+{
+   return getAt( getOffset( i ) );
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+Vector3f ImageWrapperConst::getAt
+(
+   const qword offset
 ) const
 {
    float pixel[3];
    {
-      const void* pPixelBytes = static_cast<const ubyte*>(pPixels_m) +
-         (i * pixelStride_m);
+      const void* pPixelBytes = static_cast<const ubyte*>(pPixels_m) + offset;
       switch( channelType_m )
       {
          case HALF_e :
@@ -155,6 +194,14 @@ Vector3f ImageWrapperConst::get
             pixel[2] = pt[2];
             break;
          }
+         case UBYTE_e :
+         {
+            const ubyte* pt = static_cast<const ubyte*>( pPixelBytes );
+            pixel[0] = static_cast<float>(pt[0]) * (1.0f / 255.0f);
+            pixel[1] = static_cast<float>(pt[1]) * (1.0f / 255.0f);
+            pixel[2] = static_cast<float>(pt[2]) * (1.0f / 255.0f);
+            break;
+         }
       }
    }
 
@@ -163,37 +210,47 @@ Vector3f ImageWrapperConst::get
 }
 
 
-
-
-/// implementation -------------------------------------------------------------
 void ImageWrapperConst::construct
 (
    const dword         width,
    const dword         height,
    const EChannelOrder channelOrder,
    const EChannelType  channelType,
+   const bool          hasAlpha,
          udword        pixelStride,
+         qword         rowPitch,
    const void* const   pPixels
 )
 {
-   // dimensions positive, and length <= DWORD_MAX
-   if( (width < 0) || (height < 0) || (height > (DWORD_MAX / 3)) ||
-      ((0 != height) && (width > (DWORD_MAX / height * 3))) )
+   // dimensions positive
+   // (length and offsets are 64-bit, so cannot overflow)
+   if( (width < 0) || (height < 0) )
    {
       throw SIZE_EXCEPTION_MESSAGE;
    }
 
-   // maybe default pixel stride
-   pixelStride = (0 != pixelStride) ? pixelStride :
-      ( (FLOAT_e == channelType) ? (sizeof(float) * 3) : (sizeof(uword) * 3) );
+   // maybe default pixel stride: packed channels
+   const udword channelSize = (FLOAT_e == channelType) ? sizeof(float) :
+      ((HALF_e == channelType) ? sizeof(uword) : sizeof(ubyte));
+   const udword pixelSize   = channelSize * (hasAlpha ? 4 : 3);
+   pixelStride = (0 != pixelStride) ? pixelStride : pixelSize;
 
-   // pixel stride not smaller than RGB size
-   if( ((FLOAT_e == channelType) && (pixelStride < (sizeof(float) * 3))) ||
-      ((HALF_e == channelType) && (pixelStride < (sizeof(uword) * 3))) )
+   // pixel stride not smaller than pixel size
+   if( pixelStride < pixelSize )
    {
       throw PIXEL_STRIDE_EXCEPTION_MESSAGE;
    }
 
+   // maybe default row pitch: packed rows
+   const qword rowLength = static_cast<qword>(width) * pixelStride;
+   rowPitch = (0 != rowPitch) ? rowPitch : rowLength;
+
+   // rows not overlapping
+   if( (height > 1) && (((rowPitch >= 0) ? rowPitch : -rowPitch) < rowLength) )
+   {
+      throw ROW_PITCH_EXCEPTION_MESSAGE;
+   }
+
    // pixels not null
    if( !pPixels )
    {
@@ -204,6 +261,31 @@ void ImageWrapperConst::construct
    height_m       = height;
    channelOrder_m = channelOrder;
    channelType_m  = channelType;
+   hasAlpha_m     = hasAlpha;
    pixelStride_m  = pixelStride;
+   rowPitch_m     = rowPitch;
    pPixels_m      = pPixels;
 }
+
+
+qword ImageWrapperConst::getOffset
+(
+   const dword x,
+   const dword y
+) const
+{
+   return (static_cast<qword>(y) * rowPitch_m) +
+      (static_cast<qword>(x) * pixelStride_m);
+}
+
+
+qword ImageWrapperConst::getOffset
+(
+   const qword i
+) const
+{
+   // packed: index is simply linear, else split into row and column
+   return isPacked() ? (static_cast<qword>(i) * pixelStride_m) :
+      getOffset( static_cast<dword>(i % width_m),
+         static_cast<dword>(i / width_m) );
+}
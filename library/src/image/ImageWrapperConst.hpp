@@ -24,7 +24,13 @@ namespace hxa7241_image
 
 
 /**
- * Wrapper of constant image of float triplet pixels.<br/><br/>
+ * Wrapper of constant image of triplet pixels, of float or ubyte channels,
+ * optionally followed by an alpha channel (ignored).<br/><br/>
+ *
+ * Pixels are pixelStride bytes apart, rows are rowPitch bytes apart (which may
+ * be negative, or larger than a row, to view a sub-rectangle of a bigger
+ * buffer). Lengths, indices, and byte offsets are 64-bit, so there is no limit
+ * on pixel count beyond the dimensions themselves.<br/><br/>
  *
  * Constant.
  *
@@ -43,7 +49,8 @@ public:
    enum EChannelType
    {
       HALF_e,
-      FLOAT_e
+      FLOAT_e,
+      UBYTE_e
    };
 
 
@@ -52,7 +59,16 @@ public:
                                dword         height,
                                EChannelOrder channelOrder,
                                udword        pixelStride,
+                               qword         rowPitch,
                                const float*  pPixels );
+            ImageWrapperConst( dword         width,
+                               dword         height,
+                               EChannelOrder channelOrder,
+                               EChannelType  channelType,
+                               bool          hasAlpha,
+                               udword        pixelStride,
+                               qword         rowPitch,
+                               const void*   pPixels );
 //            ImageWrapperConst( dword         width,
 //                               dword         height,
 //                               EChannelOrder channelOrder,
@@ -67,11 +83,12 @@ public:
 /// queries --------------------------------------------------------------------
            dword    getWidth()                                            const;
            dword    getHeight()                                           const;
-           dword    getLength()                                           const;
+           qword    getLength()                                           const;
+           bool     isPacked()                                            const;
 
            Vector3f get( dword x,
                          dword y )                                        const;
-           Vector3f get( dword i )                                        const;
+           Vector3f get( qword i )                                        const;
 
 
 /// implementation -------------------------------------------------------------
@@ -80,9 +97,16 @@ protected:
                                dword         height,
                                EChannelOrder channelOrder,
                                EChannelType  channelType,
+                               bool          hasAlpha,
                                udword        pixelStride,
+                               qword         rowPitch,
                                const void*   pPixels );
 
+           qword    getOffset( dword x,
+                               dword y )                                  const;
+           qword    getOffset( qword i )                                  const;
+           Vector3f getAt( qword offset )                                 const;
+
 
 /// fields ---------------------------------------------------------------------
 protected:
@@ -91,7 +115,9 @@ protected:
 
    EChannelOrder channelOrder_m;
    EChannelType  channelType_m;
+   bool          hasAlpha_m;
    udword        pixelStride_m;
+   qword         rowPitch_m;
 
    const void*   pPixels_m;
 };
@@ -0,0 +1,109 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include "Vector3f.hpp"
+
+#include "YCbCrWrapper.hpp"
+
+
+using namespace hxa7241_image;
+
+
+
+
+/// standard object services ---------------------------------------------------
+YCbCrWrapper::YCbCrWrapper
+(
+   const YCbCrWrapperConst& lumaIn,
+   const ESubsampling       subsampling,
+   const EMatrix            matrix,
+   const bool               isFullRange,
+   const qword              lumaPitch,
+   const qword              chromaPitch,
+   const udword             chromaStride,
+   ubyte*const              pLuma,
+   ubyte*const              pCb,
+   ubyte*const              pCr
+)
+ : YCbCrWrapperConst( lumaIn.getLumaWidth(), lumaIn.getLumaHeight(),
+      subsampling, matrix, isFullRange, lumaPitch, chromaPitch, chromaStride,
+      pLuma, pCb, pCr )
+ , lumaIn_m( lumaIn )
+{
+}
+
+
+YCbCrWrapper::~YCbCrWrapper()
+{
+}
+
+
+YCbCrWrapper::YCbCrWrapper
+(
+   const YCbCrWrapper& that
+)
+ : YCbCrWrapperConst( that )
+ , lumaIn_m( that.lumaIn_m )
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void YCbCrWrapper::set
+(
+   const dword     x,
+   const dword     y,
+   const Vector3f& element
+)
+{
+   // clamp to 0-255, round
+   #define QUANTIZE(f) static_cast<ubyte>( (((f) > 0.0f) ? \
+      (((f) < 255.0f) ? (f) : 255.0f) : 0.0f) + 0.5f )
+
+   // R'G'B' to Y'CbCr
+   const float luma = (kr_m * element[0]) + ((1.0f - kr_m - kb_m) *
+      element[1]) + (kb_m * element[2]);
+   const float cb   = (element[2] - luma) / (2.0f * (1.0f - kb_m));
+   const float cr   = (element[0] - luma) / (2.0f * (1.0f - kr_m));
+
+   // write chroma sample
+   {
+      const qword offset = getChromaOffset( x, y );
+      const_cast<ubyte*>(pCb_m)[offset] = QUANTIZE( 128.0f +
+         (cb * chromaScale_m) );
+      const_cast<ubyte*>(pCr_m)[offset] = QUANTIZE( 128.0f +
+         (cr * chromaScale_m) );
+   }
+
+   // write luma block, scaled from input by ratio of block luma
+   // (black input stays black)
+   {
+      const float lumaIn = lumaIn_m.getLuma( x, y );
+      const float ratio  = (lumaIn > 0.0f) ? (luma / lumaIn) : 1.0f;
+
+      dword x0, y0, x1, y1;
+      getBlock( x, y, x0, y0, x1, y1 );
+      for( dword ly = y0;  ly < y1;  ++ly )
+      {
+         for( dword lx = x0;  lx < x1;  ++lx )
+         {
+            const float sample = static_cast<float>(
+               lumaIn_m.getLumaSample( lx, ly )) - lumaOffset_m;
+            const_cast<ubyte*>(pLuma_m)[ getLumaOffset( lx, ly ) ] =
+               QUANTIZE( lumaOffset_m + ((lumaIn > 0.0f) ? (sample * ratio) :
+               (luma * lumaScale_m)) );
+         }
+      }
+   }
+
+   #undef QUANTIZE
+}
@@ -0,0 +1,78 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef YCbCrWrapper_h
+#define YCbCrWrapper_h
+
+
+#include "YCbCrWrapperConst.hpp"
+
+
+
+
+#include "hxa7241_image.hpp"
+namespace hxa7241_image
+{
+   using namespace hxa7241;
+
+
+/**
+ * Wrapper of Y'CbCr planes, of ubyte samples, with chroma optionally
+ * subsampled.<br/><br/>
+ *
+ * Setting a pixel writes its chroma sample from the R'G'B', and scales each
+ * luma sample of its block from an input image, by the ratio of new block luma
+ * to input block mean luma -- so luma detail within the block is kept. The
+ * input may be the same planes.<br/><br/>
+ *
+ * @exceptions
+ * Constructor can throw.
+ */
+class YCbCrWrapper
+   : public YCbCrWrapperConst
+{
+/// standard object services ---------------------------------------------------
+public:
+            YCbCrWrapper( const YCbCrWrapperConst& lumaIn,
+                          ESubsampling             subsampling,
+                          EMatrix                  matrix,
+                          bool                     isFullRange,
+                          qword                    lumaPitch,
+                          qword                    chromaPitch,
+                          udword                   chromaStride,
+                          ubyte*                   pLuma,
+                          ubyte*                   pCb,
+                          ubyte*                   pCr );
+
+           ~YCbCrWrapper();
+            YCbCrWrapper( const YCbCrWrapper& );
+private:
+   YCbCrWrapper& operator=( const YCbCrWrapper& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  set( dword x,
+                      dword y,
+                      const Vector3f& );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const YCbCrWrapperConst& lumaIn_m;
+};
+
+
+}//namespace
+
+
+
+
+#endif//YCbCrWrapper_h
@@ -0,0 +1,276 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include "Vector3f.hpp"
+
+#include "YCbCrWrapperConst.hpp"
+
+
+using namespace hxa7241_image;
+
+
+
+
+namespace
+{
+
+/// constants ------------------------------------------------------------------
+const char SIZE_EXCEPTION_MESSAGE[] =
+   "size out of range, in YCbCrWrapper construction";
+const char PITCH_EXCEPTION_MESSAGE[] =
+   "row pitch too small, in YCbCrWrapper construction";
+const char NULL_PLANES_POINTER_EXCEPTION_MESSAGE[] =
+   "planes pointer null, in YCbCrWrapper construction";
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+YCbCrWrapperConst::YCbCrWrapperConst
+(
+   const dword        width,
+   const dword        height,
+   const ESubsampling subsampling,
+   const EMatrix      matrix,
+   const bool         isFullRange,
+   qword              lumaPitch,
+   qword              chromaPitch,
+   udword             chromaStride,
+   const ubyte*const  pLuma,
+   const ubyte*const  pCb,
+   const ubyte*const  pCr
+)
+{
+   // dimensions positive
+   if( (width < 0) || (height < 0) )
+   {
+      throw SIZE_EXCEPTION_MESSAGE;
+   }
+
+   blockWidth_m  = (S444_e != subsampling) ? 2 : 1;
+   blockHeight_m = (S420_e == subsampling) ? 2 : 1;
+
+   const dword chromaWidth  = (width  + blockWidth_m  - 1) / blockWidth_m;
+   const dword chromaHeight = (height + blockHeight_m - 1) / blockHeight_m;
+
+   // maybe default pitches and stride: packed
+   chromaStride = (0 != chromaStride) ? chromaStride : 1;
+   lumaPitch    = (0 != lumaPitch) ? lumaPitch : width;
+   chromaPitch  = (0 != chromaPitch) ? chromaPitch :
+      static_cast<qword>(chromaWidth) * chromaStride;
+
+   // rows not overlapping
+   if( ((height > 1) && (((lumaPitch >= 0) ? lumaPitch : -lumaPitch) <
+      width)) || ((chromaHeight > 1) && (((chromaPitch >= 0) ?
+      chromaPitch : -chromaPitch) < (static_cast<qword>(chromaWidth - 1) *
+      chromaStride) + 1)) )
+   {
+      throw PITCH_EXCEPTION_MESSAGE;
+   }
+
+   // planes not null
+   if( !pLuma | !pCb | !pCr )
+   {
+      throw NULL_PLANES_POINTER_EXCEPTION_MESSAGE;
+   }
+
+   lumaWidth_m  = width;
+   lumaHeight_m = height;
+
+   // ITU-R BT.709 or BT.601 luma weights
+   kr_m = (BT709_e == matrix) ? 0.2126f : 0.299f;
+   kb_m = (BT709_e == matrix) ? 0.0722f : 0.114f;
+
+   // full range, or 'video' range: luma 16-235, chroma 16-240
+   lumaOffset_m  = isFullRange ?   0.0f :  16.0f;
+   lumaScale_m   = isFullRange ? 255.0f : 219.0f;
+   chromaScale_m = isFullRange ? 255.0f : 224.0f;
+
+   lumaPitch_m    = lumaPitch;
+   chromaPitch_m  = chromaPitch;
+   chromaStride_m = chromaStride;
+
+   pLuma_m = pLuma;
+   pCb_m   = pCb;
+   pCr_m   = pCr;
+}
+
+
+YCbCrWrapperConst::~YCbCrWrapperConst()
+{
+}
+
+
+YCbCrWrapperConst::YCbCrWrapperConst
+(
+   const YCbCrWrapperConst& that
+)
+{
+   YCbCrWrapperConst::operator=( that );
+}
+
+
+YCbCrWrapperConst& YCbCrWrapperConst::operator=
+(
+   const YCbCrWrapperConst& that
+)
+{
+   if( &that != this )
+   {
+      lumaWidth_m    = that.lumaWidth_m;
+      lumaHeight_m   = that.lumaHeight_m;
+      blockWidth_m   = that.blockWidth_m;
+      blockHeight_m  = that.blockHeight_m;
+      kr_m           = that.kr_m;
+      kb_m           = that.kb_m;
+      lumaOffset_m   = that.lumaOffset_m;
+      lumaScale_m    = that.lumaScale_m;
+      chromaScale_m  = that.chromaScale_m;
+      lumaPitch_m    = that.lumaPitch_m;
+      chromaPitch_m  = that.chromaPitch_m;
+      chromaStride_m = that.chromaStride_m;
+      pLuma_m        = that.pLuma_m;
+      pCb_m          = that.pCb_m;
+      pCr_m          = that.pCr_m;
+   }
+
+   return *this;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword YCbCrWrapperConst::getWidth() const
+{
+   return (lumaWidth_m + blockWidth_m - 1) / blockWidth_m;
+}
+
+
+dword YCbCrWrapperConst::getHeight() const
+{
+   return (lumaHeight_m + blockHeight_m - 1) / blockHeight_m;
+}
+
+
+dword YCbCrWrapperConst::getLumaWidth() const
+{
+   return lumaWidth_m;
+}
+
+
+dword YCbCrWrapperConst::getLumaHeight() const
+{
+   return lumaHeight_m;
+}
+
+
+Vector3f YCbCrWrapperConst::get
+(
+   const dword x,
+   const dword y
+) const
+{
+   const float luma = getLuma( x, y );
+
+   const qword offset = getChromaOffset( x, y );
+   const float cb = (static_cast<float>(pCb_m[offset]) - 128.0f) /
+      chromaScale_m;
+   const float cr = (static_cast<float>(pCr_m[offset]) - 128.0f) /
+      chromaScale_m;
+
+   // Y'CbCr to R'G'B'
+   const float r = luma + (2.0f * (1.0f - kr_m) * cr);
+   const float b = luma + (2.0f * (1.0f - kb_m) * cb);
+   const float g = (luma - (kr_m * r) - (kb_m * b)) / (1.0f - kr_m - kb_m);
+
+   return Vector3f( r, g, b );
+}
+
+
+float YCbCrWrapperConst::getLuma
+(
+   const dword x,
+   const dword y
+) const
+{
+   dword x0, y0, x1, y1;
+   getBlock( x, y, x0, y0, x1, y1 );
+
+   // mean of block
+   dword sum = 0;
+   for( dword ly = y0;  ly < y1;  ++ly )
+   {
+      const ubyte* pRow = pLuma_m + getLumaOffset( x0, ly );
+      for( dword i = x1 - x0;  i-- > 0; )
+      {
+         sum += pRow[i];
+      }
+   }
+   const float mean = static_cast<float>(sum) /
+      static_cast<float>((x1 - x0) * (y1 - y0));
+
+   return (mean - lumaOffset_m) / lumaScale_m;
+}
+
+
+ubyte YCbCrWrapperConst::getLumaSample
+(
+   const dword lumaX,
+   const dword lumaY
+) const
+{
+   return pLuma_m[ getLumaOffset( lumaX, lumaY ) ];
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void YCbCrWrapperConst::getBlock
+(
+   const dword x,
+   const dword y,
+   dword&      x0,
+   dword&      y0,
+   dword&      x1,
+   dword&      y1
+) const
+{
+   // (clipped at right and bottom edges, for odd dimensions)
+   x0 = x * blockWidth_m;
+   y0 = y * blockHeight_m;
+   x1 = (x0 + blockWidth_m  <= lumaWidth_m)  ? x0 + blockWidth_m  : lumaWidth_m;
+   y1 = (y0 + blockHeight_m <= lumaHeight_m) ? y0 + blockHeight_m :
+      lumaHeight_m;
+}
+
+
+qword YCbCrWrapperConst::getLumaOffset
+(
+   const dword x,
+   const dword y
+) const
+{
+   return (static_cast<qword>(y) * lumaPitch_m) + static_cast<qword>(x);
+}
+
+
+qword YCbCrWrapperConst::getChromaOffset
+(
+   const dword x,
+   const dword y
+) const
+{
+   return (static_cast<qword>(y) * chromaPitch_m) +
+      (static_cast<qword>(x) * chromaStride_m);
+}
@@ -0,0 +1,144 @@
+/*------------------------------------------------------------------------------
+
+   HXA7241 Image library.
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef YCbCrWrapperConst_h
+#define YCbCrWrapperConst_h
+
+
+#include "hxa7241_graphics.hpp"
+
+
+
+
+#include "hxa7241_image.hpp"
+namespace hxa7241_image
+{
+   using hxa7241_graphics::Vector3f;
+
+
+/**
+ * Wrapper of constant Y'CbCr planes, of ubyte samples, with chroma optionally
+ * subsampled.<br/><br/>
+ *
+ * Pixels are addressed on the chroma grid: each is one chroma sample and the
+ * block of luma samples it covers (2x2 for 4:2:0, 2x1 for 4:2:2, 1x1 for
+ * 4:4:4). Its value is the R'G'B' (nonlinear, 0 to 1) made from the block's
+ * mean luma and the chroma sample.<br/><br/>
+ *
+ * Luma rows are lumaPitch bytes apart, chroma rows chromaPitch (either may be
+ * negative). Chroma samples are chromaStride bytes apart, so Cb and Cr can be
+ * separate planes, or interleaved (as NV12: Cr pointer = Cb pointer + 1, stride
+ * 2).<br/><br/>
+ *
+ * Constant.
+ *
+ * @exceptions
+ * Constructor can throw.
+ */
+class YCbCrWrapperConst
+{
+public:
+   enum ESubsampling
+   {
+      S420_e,
+      S422_e,
+      S444_e
+   };
+
+   enum EMatrix
+   {
+      BT709_e,
+      BT601_e
+   };
+
+
+/// standard object services ---------------------------------------------------
+            YCbCrWrapperConst( dword        width,
+                               dword        height,
+                               ESubsampling subsampling,
+                               EMatrix      matrix,
+                               bool         isFullRange,
+                               qword        lumaPitch,
+                               qword        chromaPitch,
+                               udword       chromaStride,
+                               const ubyte* pLuma,
+                               const ubyte* pCb,
+                               const ubyte* pCr );
+
+           ~YCbCrWrapperConst();
+            YCbCrWrapperConst( const YCbCrWrapperConst& );
+   YCbCrWrapperConst& operator=( const YCbCrWrapperConst& );
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Chroma grid dimensions.
+    */
+           dword    getWidth()                                            const;
+           dword    getHeight()                                           const;
+           dword    getLumaWidth()                                        const;
+           dword    getLumaHeight()                                       const;
+
+           Vector3f get( dword x,
+                         dword y )                                        const;
+
+   /**
+    * Mean luma of pixel's block, 0 to 1.
+    */
+           float    getLuma( dword x,
+                             dword y )                                    const;
+           ubyte    getLumaSample( dword lumaX,
+                                   dword lumaY )                          const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void     getBlock( dword  x,
+                              dword  y,
+                              dword& x0,
+                              dword& y0,
+                              dword& x1,
+                              dword& y1 )                                 const;
+           qword    getLumaOffset( dword x,
+                                   dword y )                              const;
+           qword    getChromaOffset( dword x,
+                                     dword y )                            const;
+
+
+/// fields ---------------------------------------------------------------------
+protected:
+   dword        lumaWidth_m;
+   dword        lumaHeight_m;
+   dword        blockWidth_m;
+   dword        blockHeight_m;
+
+   // matrix and range coefficients
+   float        kr_m;
+   float        kb_m;
+   float        lumaOffset_m;
+   float        lumaScale_m;
+   float        chromaScale_m;
+
+   qword        lumaPitch_m;
+   qword        chromaPitch_m;
+   udword       chromaStride_m;
+
+   const ubyte* pLuma_m;
+   const ubyte* pCb_m;
+   const ubyte* pCr_m;
+};
+
+
+}//namespace
+
+
+
+
+#endif//YCbCrWrapperConst_h
@@ -23,6 +23,8 @@ namespace hxa7241_image
 
    class ImageWrapper;
    class ImageWrapperConst;
+   class YCbCrWrapper;
+   class YCbCrWrapperConst;
 }
 
 
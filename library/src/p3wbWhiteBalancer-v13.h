@@ -0,0 +1,167 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+/**
+ * Options/constants for p3wbWhiteBalancer interface. These will change with
+ * implementation versions.
+ *
+ * Include this file, and link with the library or access purely dynamically.
+ */
+
+
+
+
+#ifndef p3wbWhiteBalancer_v13_h
+#define p3wbWhiteBalancer_v13_h
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "p3wbWhiteBalancer.h"
+
+
+
+
+/* version ------------------------------------------------------------------ */
+/**
+ * Version, for use with p3wbIsVersionSupported().
+ */
+enum p3wb13EVersion
+{
+   /* current */
+   p3wb13_VERSION = 0x00010300,
+
+   /* previous */
+   p3wb12_VERSION = 0x00010200,
+   p3wb11_VERSION = 0x00010001,
+
+   /* old and defunct */
+   p3wb10_VERSION = 0x00010000
+};
+
+
+
+
+/* balancing option flags --------------------------------------------------- */
+/**
+ * Options for use with p3wbWhiteBalance_() in i_options parameter.
+ */
+enum p3wb11EBalancingOptions
+{
+   p3wb11_GW  = 0
+};
+
+
+/**
+ * More options for use with p3wbWhiteBalance_() in i_options parameter.
+ * Combine with p3wb11EBalancingOptions by bitwise or.
+ *
+ * @p3wb13_NO_MEMO  do not memoise mapped colors (by default, repeated colors
+ *                  are mapped once, and memoising switches itself off when
+ *                  colors rarely repeat -- results are the same either way)
+ * @p3wb13_ROBUST   estimate the illuminant from the middle half of the image
+ *                  colors (the interquartile mean of each axis), instead of
+ *                  all of them -- so bright highlights, light sources, and
+ *                  saturated areas do not skew it (uses a few KB more memory
+ *                  per image, however large)
+ */
+enum p3wb13EBalancingOptions
+{
+   p3wb13_NO_MEMO = 0x100,
+   p3wb13_ROBUST  = 0x200
+};
+
+
+
+
+/* pixel option flags ------------------------------------------------------- */
+/**
+ * Options for use with p3wbWhiteBalance_() in i_formatFlags parameter.
+ *
+ * @p3wb11_RGB  pixel parts/channels in storage order R, G, B
+ * @p3wb11_BGR  pixel parts/channels in storage order B, G, R
+ */
+enum p3wb11EPixelOptions
+{
+   p3wb11_RGB = 0,
+   p3wb11_BGR = 1
+};
+
+
+/**
+ * More options for use with p3wbWhiteBalance_() in i_formatFlags parameters.
+ * Combine with p3wb11EPixelOptions by bitwise or.
+ *
+ * (Only for functions taking void* pixels, others assume 3 floats.)
+ *
+ * @p3wb13_ALPHA  an alpha channel follows the color channels: ignored on
+ *                input, set to i_outAlpha on output
+ * @p3wb13_UBYTE  channels are unsigned bytes, 0 to 255 meaning 0 to 1,
+ *                (output is clamped and rounded) (instead of floats)
+ * @p3wb13_SRGB   channels are encoded with the sRGB curve (instead of
+ *                linear)
+ *
+ * For example: p3wb11_BGR | p3wb13_ALPHA | p3wb13_UBYTE | p3wb13_SRGB
+ * is BGRA8 sRGB, as for many display textures.
+ */
+enum p3wb13EPixelOptions
+{
+   p3wb13_ALPHA = 2,
+   p3wb13_UBYTE = 4,
+   p3wb13_SRGB  = 8
+};
+
+
+
+
+/* Y'CbCr option flags ------------------------------------------------------ */
+/**
+ * Options for use with p3wbWhiteBalanceYCbCr() in i_ycbcrFlags parameter.
+ * Combine one of each group by bitwise or (the first of each is default).
+ *
+ * Chroma subsampling (masked by p3wb13_YCC_SUBSAMPLING):
+ * @p3wb13_YCC_420         chroma halved horizontally and vertically
+ * @p3wb13_YCC_422         chroma halved horizontally
+ * @p3wb13_YCC_444         chroma not subsampled
+ *
+ * Matrix coefficients:
+ * @p3wb13_YCC_BT709       ITU-R BT.709 (HD)
+ * @p3wb13_YCC_BT601       ITU-R BT.601 (SD)
+ *
+ * Range:
+ * @p3wb13_YCC_VIDEO_RANGE luma 16 to 235, chroma 16 to 240
+ * @p3wb13_YCC_FULL_RANGE  luma and chroma 0 to 255
+ */
+enum p3wb13EYCbCrOptions
+{
+   p3wb13_YCC_420         = 0,
+   p3wb13_YCC_422         = 1,
+   p3wb13_YCC_444         = 2,
+   p3wb13_YCC_SUBSAMPLING = 3,
+
+   p3wb13_YCC_BT709       = 0,
+   p3wb13_YCC_BT601       = 4,
+
+   p3wb13_YCC_VIDEO_RANGE = 0,
+   p3wb13_YCC_FULL_RANGE  = 8
+};
+
+
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif/*p3wbWhiteBalancer_v13_h*/
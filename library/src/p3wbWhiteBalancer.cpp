@@ -8,16 +8,19 @@
 ------------------------------------------------------------------------------*/
 
 
-#ifdef _PLATFORM_LINUX
-#include <fenv.h>
-#endif
-#include <float.h>
 #include <string.h>
 #include <exception>
+#include <vector>
 
+#include "FpModeSet.hpp"
 #include "WhiteBalancer.hpp"
+#include "BalanceJob.hpp"
+#include "BalanceSet.hpp"
+#include "BalanceSequence.hpp"
+#include "BalanceStrips.hpp"
+#include "ColorTransfer.hpp"
 
-#include "p3wbWhiteBalancer-v12.h"
+#include "p3wbWhiteBalancer-v13.h"
 
 
 
@@ -31,6 +34,24 @@ const char LIBRARY_NAME[]      = "P3WhiteBalancer";
 const char LIBRARY_COPYRIGHT[] =
    "Copyright (c) 2007, Harrison Ainsworth / HXA7241.";
 
+const char NULL_JOB_MESSAGE[]      = "null job";
+const char NULL_SEQUENCE_MESSAGE[] = "null sequence";
+const char NULL_STRIPS_MESSAGE[]   = "null strips";
+
+
+void copyMessage
+(
+   const char* pFrom,
+   char*       o_pMessage128
+)
+{
+   if( o_pMessage128 )
+   {
+      ::strncpy( o_pMessage128, pFrom, 127 );
+      o_pMessage128[ 127 ] = 0;
+   }
+}
+
 }
 
 
@@ -43,7 +64,8 @@ int p3wbIsVersionSupported
    const int version
 )
 {
-   return (p3wb12_VERSION == version) | (p3wb11_VERSION == version) ?
+   return (p3wb13_VERSION == version) | (p3wb12_VERSION == version) |
+      (p3wb11_VERSION == version) ?
       p3wb_SUPPORTED_FULLY : p3wb_SUPPORTED_NOT;
 }
 
@@ -62,7 +84,7 @@ const char* p3wbGetCopyright()
 
 int p3wbGetVersion()
 {
-   return p3wb12_VERSION;
+   return p3wb13_VERSION;
 }
 
 
@@ -104,92 +126,883 @@ int p3wbWhiteBalance2
    char*        o_pMessage128
 )
 {
-   bool isOk = false;
-   if( o_pMessage128 )
+   // delegate with packed rows
+   return p3wbWhiteBalance3( i_colorSpace6, i_whitePoint2, i_inIlluminant3,
+      i_options, i_strength, i_width, i_height, i_formatFlags, i_pixelStride,
+      0, i_pInPixels, o_pOutPixels,
+      o_pMessage128 );
+}
+
+
+int p3wbWhiteBalance3
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_formatFlags,
+   unsigned int i_pixelStride,
+   p3wbInt64    i_rowPitch,
+   const float* i_pInPixels,
+   float*       o_pOutPixels,
+   char*        o_pMessage128
+)
+{
+   // (these functions take only 3-float pixels)
+   const unsigned int formatFlags = i_formatFlags & p3wb11_BGR;
+
+   // delegate with same output format
+   return p3wbWhiteBalance4( i_colorSpace6, i_whitePoint2, i_inIlluminant3,
+      i_options, i_strength, i_width, i_height,
+      formatFlags, i_pixelStride, i_rowPitch, i_pInPixels,
+      formatFlags, i_pixelStride, i_rowPitch, 1.0f, o_pOutPixels,
+      o_pMessage128 );
+}
+
+
+int p3wbWhiteBalance4
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_pOutPixels,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // run directly in this thread
+   try
    {
-      o_pMessage128[ 0 ] = 0;
+      p3whitebalancer::BalanceJob job( i_colorSpace6, i_whitePoint2,
+         i_inIlluminant3, i_options, i_strength, i_width, i_height,
+         i_inFormatFlags, i_inPixelStride, i_inRowPitch, i_pInPixels,
+         i_outFormatFlags, i_outPixelStride, i_outRowPitch, i_outAlpha,
+         o_pOutPixels );
+
+      job.run();
+
+      copyMessage( job.getMessage(), o_pMessage128 );
+
+      return p3whitebalancer::BalanceJob::SUCCEEDED_e == job.getStatus() ?
+         1 : 0;
    }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
 
-#if defined(_PLATFORM_WIN) && !defined(__STRICT_ANSI__)
-   // set fp control word: rounding mode near, no exceptions
-   const unsigned int fpControlWord =
-      ::_controlfp( _MCW_EM | _RC_NEAR, _MCW_EM | _MCW_RC );
-#endif
 
-#ifdef _PLATFORM_LINUX
-#ifdef FE_ALL_EXCEPT
-   const int fpExceptions = ::fedisableexcept( FE_ALL_EXCEPT );
-#endif
-#ifdef FE_TONEAREST
-   const int fpRounding = ::fegetround();
-   if( fpRounding >= 0 )
+int p3wbWhiteBalanceColors
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_count,
+   const float* i_pInColors,
+   const float* i_pWeights,
+   float*       o_pOutColors,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      p3whitebalancer::whiteBalanceColors( i_colorSpace6, i_whitePoint2,
+         i_inIlluminant3, i_options, i_strength, i_count, i_pInColors,
+         i_pWeights, o_pOutColors );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
    {
-      ::fesetround( FE_TONEAREST );
+      copyMessage( "unannotated exception", o_pMessage128 );
    }
-#endif
-#endif //_PLATFORM_LINUX
+
+   return 0;
+}
+
+
+int p3wbWhiteBalanceYCbCr
+(
+   const float*         i_colorSpace6,
+   const float*         i_whitePoint2,
+   const float*         i_inIlluminant3,
+   unsigned int         i_options,
+   float                i_strength,
+   unsigned int         i_width,
+   unsigned int         i_height,
+   unsigned int         i_ycbcrFlags,
+   p3wbInt64            i_lumaPitch,
+   p3wbInt64            i_chromaPitch,
+   unsigned int         i_chromaStride,
+   const unsigned char* i_inLuma,
+   const unsigned char* i_inCb,
+   const unsigned char* i_inCr,
+   unsigned char*       o_outLuma,
+   unsigned char*       o_outCb,
+   unsigned char*       o_outCr,
+   char*                o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
 
    // handle exceptions
    try
    {
-      // delegate the actual activity
-      p3whitebalancer::whiteBalance(
-         i_colorSpace6,
-         i_whitePoint2,
-         i_inIlluminant3,
-         i_options,
-         i_strength,
-         i_width,
-         i_height,
-         i_formatFlags,
-         i_pixelStride,
-         i_pInPixels,
-         o_pOutPixels );
+      p3whitebalancer::whiteBalanceYCbCr( i_colorSpace6, i_whitePoint2,
+         i_inIlluminant3, i_options, i_strength, i_width, i_height,
+         i_ycbcrFlags, i_lumaPitch, i_chromaPitch, i_chromaStride, i_inLuma,
+         i_inCb, i_inCr, o_outLuma, o_outCb, o_outCr );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+int p3wbWhiteBalanceSet
+(
+   const float*     i_colorSpace6,
+   const float*     i_whitePoint2,
+   const float*     i_inIlluminant3,
+   unsigned int     i_options,
+   float            i_strength,
+   unsigned int     i_count,
+   const p3wbImage* i_images,
+   char*            o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      if( (0 != i_count) & !i_images )
+      {
+         throw "null image array";
+      }
+
+      // translate images
+      std::vector<p3whitebalancer::SetImage> images( i_count );
+      for( unsigned int i = i_count;  i-- > 0; )
+      {
+         const p3wbImage&           from = i_images[i];
+         p3whitebalancer::SetImage& to   = images[i];
+
+         to.width          = from.width;
+         to.height         = from.height;
+         to.inFormatFlags  = from.inFormatFlags;
+         to.inPixelStride  = from.inPixelStride;
+         to.inRowPitch     = from.inRowPitch;
+         to.pInPixels      = from.inPixels;
+         to.outFormatFlags = from.outFormatFlags;
+         to.outPixelStride = from.outPixelStride;
+         to.outRowPitch    = from.outRowPitch;
+         to.outAlpha       = from.outAlpha;
+         to.pOutPixels     = from.outPixels;
+      }
+
+      p3whitebalancer::whiteBalanceSet( i_colorSpace6, i_whitePoint2,
+         i_inIlluminant3, i_options, i_strength, i_count,
+         i_count ? &images[0] : 0 );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+
+
+/// asynchronous functions =====================================================
+
+p3wbJob p3wbSubmit
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_pOutPixels,
+   int          i_notifyFd,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   p3whitebalancer::BalanceJob* pJob = 0;
+   try
+   {
+      pJob = new p3whitebalancer::BalanceJob( i_colorSpace6, i_whitePoint2,
+         i_inIlluminant3, i_options, i_strength, i_width, i_height,
+         i_inFormatFlags, i_inPixelStride, i_inRowPitch, i_pInPixels,
+         i_outFormatFlags, i_outPixelStride, i_outRowPitch, i_outAlpha,
+         o_pOutPixels, i_notifyFd );
+
+      pJob->submit();
+
+      return reinterpret_cast<p3wbJob>( pJob );
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   delete pJob;
+
+   return 0;
+}
+
+
+int p3wbPoll
+(
+   p3wbJob i_job
+)
+{
+   return i_job ? static_cast<int>(
+      reinterpret_cast<p3whitebalancer::BalanceJob*>( i_job )->getStatus() ) :
+      p3wb_JOB_FAILED;
+}
+
+
+int p3wbWait
+(
+   p3wbJob i_job,
+   char*   o_pMessage128
+)
+{
+   if( !i_job )
+   {
+      copyMessage( NULL_JOB_MESSAGE, o_pMessage128 );
+      return 0;
+   }
+
+   p3whitebalancer::BalanceJob* pJob =
+      reinterpret_cast<p3whitebalancer::BalanceJob*>( i_job );
+
+   const bool isOk = p3whitebalancer::BalanceJob::SUCCEEDED_e == pJob->wait();
+   copyMessage( pJob->getMessage(), o_pMessage128 );
+
+   // release handle
+   delete pJob;
+
+   return isOk ? 1 : 0;
+}
+
+
+int p3wbCancel
+(
+   p3wbJob i_job
+)
+{
+   return i_job &&
+      reinterpret_cast<p3whitebalancer::BalanceJob*>( i_job )->cancel() ?
+      1 : 0;
+}
+
+
+
+
+
+
+
+
+
+/// sequence functions =========================================================
+
+p3wbSequence p3wbSequenceOpen
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   float        i_strength,
+   float        i_smoothing,
+   float        i_cutThreshold,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   try
+   {
+      return reinterpret_cast<p3wbSequence>(
+         new p3whitebalancer::BalanceSequence( i_colorSpace6, i_whitePoint2,
+            i_options, i_strength, i_smoothing, i_cutThreshold ) );
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+int p3wbSequenceFrame
+(
+   p3wbSequence i_sequence,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_pOutPixels,
+   int*         o_pIsCut,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+   if( o_pIsCut )
+   {
+      *o_pIsCut = 0;
+   }
+
+   if( !i_sequence )
+   {
+      copyMessage( NULL_SEQUENCE_MESSAGE, o_pMessage128 );
+      return 0;
+   }
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      const bool isCut = reinterpret_cast<p3whitebalancer::BalanceSequence*>(
+         i_sequence )->balanceFrame( i_width, i_height, i_inFormatFlags,
+         i_inPixelStride, i_inRowPitch, i_pInPixels, i_outFormatFlags,
+         i_outPixelStride, i_outRowPitch, i_outAlpha, o_pOutPixels );
+
+      if( o_pIsCut )
+      {
+         *o_pIsCut = isCut ? 1 : 0;
+      }
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+void p3wbSequenceClose
+(
+   p3wbSequence i_sequence
+)
+{
+   delete reinterpret_cast<p3whitebalancer::BalanceSequence*>( i_sequence );
+}
+
+
 
-      isOk = true;
+
+
+
+
+
+
+/// strip functions ============================================================
+
+p3wbStrips p3wbStripsOpen
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_inIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   try
+   {
+      return reinterpret_cast<p3wbStrips>(
+         new p3whitebalancer::BalanceStrips( i_colorSpace6, i_whitePoint2,
+            i_inIlluminant3, i_options, i_strength ) );
    }
    catch( const std::exception& exception )
    {
-      if( o_pMessage128 )
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+int p3wbStripsEstimate
+(
+   p3wbStrips   i_strips,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   if( !i_strips )
+   {
+      copyMessage( NULL_STRIPS_MESSAGE, o_pMessage128 );
+      return 0;
+   }
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      reinterpret_cast<p3whitebalancer::BalanceStrips*>( i_strips )->
+         estimateStrip( i_width, i_height, i_inFormatFlags, i_inPixelStride,
+         i_inRowPitch, i_pInPixels );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+int p3wbStripsBalance
+(
+   p3wbStrips   i_strips,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   unsigned int i_outFormatFlags,
+   unsigned int i_outPixelStride,
+   p3wbInt64    i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_pOutPixels,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   if( !i_strips )
+   {
+      copyMessage( NULL_STRIPS_MESSAGE, o_pMessage128 );
+      return 0;
+   }
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      reinterpret_cast<p3whitebalancer::BalanceStrips*>( i_strips )->
+         balanceStrip( i_width, i_height, i_inFormatFlags, i_inPixelStride,
+         i_inRowPitch, i_pInPixels, i_outFormatFlags, i_outPixelStride,
+         i_outRowPitch, i_outAlpha, o_pOutPixels );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+void p3wbStripsClose
+(
+   p3wbStrips i_strips
+)
+{
+   delete reinterpret_cast<p3whitebalancer::BalanceStrips*>( i_strips );
+}
+
+
+
+
+
+
+
+
+
+
+/// transfer functions =========================================================
+
+namespace
+{
+
+p3whitebalancer::ColorStats toColorStats
+(
+   const p3wbStats& i_stats
+)
+{
+   p3whitebalancer::ColorStats stats;
+   stats.count = i_stats.count;
+   for( unsigned int i = 3;  i-- > 0; )
+   {
+      stats.mean[i] = i_stats.mean[i];
+      stats.m2[i]   = i_stats.m2[i];
+   }
+
+   return stats;
+}
+
+
+void fromColorStats
+(
+   const p3whitebalancer::ColorStats& i_stats,
+   p3wbStats&                         o_stats
+)
+{
+   o_stats.count = i_stats.count;
+   for( unsigned int i = 3;  i-- > 0; )
+   {
+      o_stats.mean[i] = i_stats.mean[i];
+      o_stats.m2[i]   = i_stats.m2[i];
+   }
+}
+
+}
+
+
+int p3wbColorStats
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   unsigned int i_width,
+   unsigned int i_height,
+   unsigned int i_inFormatFlags,
+   unsigned int i_inPixelStride,
+   p3wbInt64    i_inRowPitch,
+   const void*  i_pInPixels,
+   p3wbStats*   o_pStats,
+   char*        o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      if( !o_pStats )
       {
-         ::strncpy( o_pMessage128, exception.what(), 127 );
-         o_pMessage128[ 127 ] = 0;
+         throw "null stats";
       }
+
+      p3whitebalancer::ColorStats stats;
+      p3whitebalancer::colorStats( i_colorSpace6, i_whitePoint2, i_options,
+         i_width, i_height, i_inFormatFlags, i_inPixelStride, i_inRowPitch,
+         i_pInPixels, stats );
+
+      fromColorStats( stats, *o_pStats );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
    }
    catch( const char*const exceptionString )
    {
-      if( o_pMessage128 )
+      copyMessage( exceptionString, o_pMessage128 );
+   }
+   catch( ... )
+   {
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+int p3wbColorTransfer
+(
+   const float*     i_colorSpace6,
+   const float*     i_whitePoint2,
+   const p3wbStats* i_pReference,
+   const p3wbStats* i_pTarget,
+   unsigned int     i_options,
+   float            i_strength,
+   unsigned int     i_width,
+   unsigned int     i_height,
+   unsigned int     i_inFormatFlags,
+   unsigned int     i_inPixelStride,
+   p3wbInt64        i_inRowPitch,
+   const void*      i_pInPixels,
+   unsigned int     i_outFormatFlags,
+   unsigned int     i_outPixelStride,
+   p3wbInt64        i_outRowPitch,
+   float            i_outAlpha,
+   void*            o_pOutPixels,
+   char*            o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // (fp environment is per-thread)
+   const hxa7241_general::FpModeSet fpModeSet;
+
+   // handle exceptions
+   try
+   {
+      if( !i_pReference )
+      {
+         throw "null reference stats";
+      }
+
+      const p3whitebalancer::ColorStats reference( toColorStats(
+         *i_pReference ) );
+      p3whitebalancer::ColorStats target;
+      if( i_pTarget )
       {
-         ::strncpy( o_pMessage128, exceptionString, 127 );
-         o_pMessage128[ 127 ] = 0;
+         target = toColorStats( *i_pTarget );
       }
+
+      p3whitebalancer::colorTransfer( i_colorSpace6, i_whitePoint2, i_options,
+         i_strength, reference, (i_pTarget ? &target : 0), i_width, i_height,
+         i_inFormatFlags, i_inPixelStride, i_inRowPitch, i_pInPixels,
+         i_outFormatFlags, i_outPixelStride, i_outRowPitch, i_outAlpha,
+         o_pOutPixels );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
    }
    catch( ... )
    {
-      if( o_pMessage128 )
+      copyMessage( "unannotated exception", o_pMessage128 );
+   }
+
+   return 0;
+}
+
+
+void p3wbStatsToText
+(
+   const p3wbStats* i_pStats,
+   char*            o_pText256
+)
+{
+   if( o_pText256 )
+   {
+      o_pText256[0] = 0;
+
+      // (only allocation can throw)
+      try
       {
-         ::strncpy( o_pMessage128, "unannotated exception", 127 );
-         o_pMessage128[ 127 ] = 0;
+         if( i_pStats )
+         {
+            p3whitebalancer::writeStats( toColorStats( *i_pStats ),
+               o_pText256 );
+         }
+      }
+      catch( ... )
+      {
+         o_pText256[0] = 0;
       }
    }
+}
 
-#if defined(_PLATFORM_WIN) && !defined(__STRICT_ANSI__)
-   // restore fp control word
-   ::_controlfp( fpControlWord, 0xFFFFFFFFu );
-#endif
 
-#ifdef _PLATFORM_LINUX
-   if( fpRounding >= 0 )
+int p3wbStatsFromText
+(
+   const char* i_pText,
+   p3wbStats*  o_pStats,
+   char*       o_pMessage128
+)
+{
+   copyMessage( "", o_pMessage128 );
+
+   // handle exceptions
+   try
    {
-      ::fesetround( fpRounding );
+      if( !o_pStats )
+      {
+         throw "null stats";
+      }
+
+      p3whitebalancer::ColorStats stats;
+      p3whitebalancer::readStats( i_pText, stats );
+
+      fromColorStats( stats, *o_pStats );
+
+      return 1;
+   }
+   catch( const std::exception& exception )
+   {
+      copyMessage( exception.what(), o_pMessage128 );
+   }
+   catch( const char*const exceptionString )
+   {
+      copyMessage( exceptionString, o_pMessage128 );
    }
-   if( -1 != fpExceptions )
+   catch( ... )
    {
-      ::feenableexcept( fpExceptions );
+      copyMessage( "unannotated exception", o_pMessage128 );
    }
-#endif //_PLATFORM_LINUX
 
-   return isOk ? 1 : 0;
+   return 0;
 }
 
 
@@ -199,6 +1012,8 @@ int p3wbWhiteBalance2
 
 
 
+
+
 /// test =======================================================================
 
 #ifndef TESTING
@@ -230,6 +1045,8 @@ namespace hxa7241_general
 {
    bool test_LogFast( std::ostream* pOut, bool isVerbose, dword seed );
    bool test_PowFast( std::ostream* pOut, bool isVerbose, dword seed );
+   bool test_QuantileSketch( std::ostream* pOut, bool isVerbose,
+      dword seed );
 }
 
 namespace hxa7241_graphics
@@ -241,6 +1058,12 @@ namespace hxa7241_graphics
 namespace p3whitebalancer
 {
    bool test_WhiteBalancer( std::ostream* pOut, bool isVerbose, dword seed );
+   bool test_BalanceJob   ( std::ostream* pOut, bool isVerbose, dword seed );
+   bool test_BalanceSet   ( std::ostream* pOut, bool isVerbose, dword seed );
+   bool test_BalanceSequence( std::ostream* pOut, bool isVerbose,
+      dword seed );
+   bool test_ColorTransfer( std::ostream* pOut, bool isVerbose, dword seed );
+   bool test_BalanceStrips( std::ostream* pOut, bool isVerbose, dword seed );
 }
 
 
@@ -255,6 +1078,13 @@ static bool (*TESTERS[])(std::ostream*, bool, dword) =
 ,  &hxa7241_graphics::test_Matrix3f          //  4
 
 ,  &p3whitebalancer::test_WhiteBalancer      //  5
+,  &p3whitebalancer::test_BalanceJob         //  6
+,  &p3whitebalancer::test_BalanceSet         //  7
+,  &p3whitebalancer::test_BalanceSequence    //  8
+
+,  &hxa7241_general::test_QuantileSketch     //  9
+,  &p3whitebalancer::test_ColorTransfer      // 10
+,  &p3whitebalancer::test_BalanceStrips      // 11
 };
 
 
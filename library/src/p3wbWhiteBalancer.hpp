@@ -0,0 +1,763 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+/**
+ * Header-only C++ interface for the P3 WhiteBalancer component: the per-pixel
+ * parts as inlinable function objects, for fusing into a host's own pixel
+ * loops (for example, a renderer's film-buffer resolve), instead of a separate
+ * whole-image pass through the library.
+ *
+ * No linking needed: include this file only. (It does not include or need the
+ * C interface.)
+ *
+ * Usage, in two passes over the host's pixels (or one, if the illuminant is
+ * known, or taken from a previous frame):
+ *
+ *    typedef p3wb::Pixel<p3wb::ChannelFloat, p3wb::RGB_e, 4> Rgba;
+ *
+ *    const p3wb::ColorSpace colorSpace;           // sRGB
+ *    p3wb::Estimator        estimator( colorSpace );
+ *    for( each row )
+ *       estimator.addRow<Rgba>( pRow, width );
+ *
+ *    float illuminant[3];
+ *    estimator.getIlluminant( illuminant );
+ *    const p3wb::PixelMap map( colorSpace, illuminant, 0.8f );
+ *    for( each row )
+ *       map.mapRow<Rgba, Rgba>( pRow, pRow, width );
+ *
+ * Estimators are cheap to copy: give each thread one, and add() them together.
+ *
+ * Results match the library's to within its fast log/pow approximations (this
+ * uses the standard maths functions instead): about 0.1% of each pixel's
+ * largest channel, and 3 LSB for 8-bit sRGB output (a dark channel of a bright
+ * pixel is on the curve's steep foot).
+ *
+ * Errors throw a const char* message (as the library does internally).
+ */
+
+
+
+
+#ifndef p3wbWhiteBalancer_hpp
+#define p3wbWhiteBalancer_hpp
+
+
+#include <math.h>
+#include <string.h>
+
+
+
+
+namespace p3wb
+{
+
+
+/// pixel traits ===============================================================
+
+/**
+ * Channel types: storage, and conversion to and from linear float.
+ *
+ * @ChannelFloat      float, linear
+ * @ChannelUbyte      unsigned char, 0 to 255 meaning 0 to 1, linear
+ * @ChannelUword      unsigned short, 0 to 65535 meaning 0 to 1, linear
+ * @ChannelUbyteSrgb  unsigned char, 0 to 255 meaning 0 to 1, sRGB-encoded
+ *
+ * (Integer channels are clamped and rounded on output.)
+ */
+struct ChannelFloat
+{
+   typedef float Type;
+
+   static float toLinear  ( const Type  c ) { return c; }
+   static Type  fromLinear( const float l ) { return l; }
+};
+
+
+struct ChannelUbyte
+{
+   typedef unsigned char Type;
+
+   static float toLinear( const Type c )
+   {
+      return static_cast<float>(c) * (1.0f / 255.0f);
+   }
+
+   static Type fromLinear( const float l )
+   {
+      const float c = (l * 255.0f) + 0.5f;
+      return static_cast<Type>( c > 0.0f ? (c < 255.0f ? c : 255.0f) : 0.0f );
+   }
+};
+
+
+struct ChannelUword
+{
+   typedef unsigned short Type;
+
+   static float toLinear( const Type c )
+   {
+      return static_cast<float>(c) * (1.0f / 65535.0f);
+   }
+
+   static Type fromLinear( const float l )
+   {
+      const float c = (l * 65535.0f) + 0.5f;
+      return static_cast<Type>( c > 0.0f ? (c < 65535.0f ? c : 65535.0f) :
+         0.0f );
+   }
+};
+
+
+struct ChannelUbyteSrgb
+{
+   typedef unsigned char Type;
+
+   static float toLinear( const Type c )
+   {
+      // IEC 61966-2-1 curve
+      const float e = static_cast<float>(c) * (1.0f / 255.0f);
+      return (e > 0.04045f) ? ::powf( (e + 0.055f) * (1.0f / 1.055f), 2.4f ) :
+         e * (1.0f / 12.92f);
+   }
+
+   static Type fromLinear( const float l )
+   {
+      const float e = (l > 0.0031308f) ? (1.055f * ::powf( l,
+         (1.0f / 2.4f) )) - 0.055f : l * 12.92f;
+      return ChannelUbyte::fromLinear( e );
+   }
+};
+
+
+/**
+ * Channel storage orders.
+ */
+enum EChannelOrder
+{
+   RGB_e = 0,
+   BGR_e = 1
+};
+
+
+/**
+ * Pixel traits: channel type, channel order, and stride (number of channels
+ * from one pixel to the next -- 4 for RGBA, for example). Channels after the
+ * third (alpha) are not read or written.
+ */
+template<class CHANNEL, EChannelOrder ORDER = RGB_e, int STRIDE = 3>
+struct Pixel
+{
+   typedef typename CHANNEL::Type Type;
+
+   enum { STRIDE_ = STRIDE };
+
+   static void read( const Type* pPixel, float rgb[3] )
+   {
+      rgb[0] = CHANNEL::toLinear( pPixel[ (BGR_e == ORDER) ? 2 : 0 ] );
+      rgb[1] = CHANNEL::toLinear( pPixel[ 1 ] );
+      rgb[2] = CHANNEL::toLinear( pPixel[ (BGR_e == ORDER) ? 0 : 2 ] );
+   }
+
+   static void write( Type* pPixel, const float rgb[3] )
+   {
+      pPixel[ (BGR_e == ORDER) ? 2 : 0 ] = CHANNEL::fromLinear( rgb[0] );
+      pPixel[ 1 ]                        = CHANNEL::fromLinear( rgb[1] );
+      pPixel[ (BGR_e == ORDER) ? 0 : 2 ] = CHANNEL::fromLinear( rgb[2] );
+   }
+};
+
+
+
+
+/// support ====================================================================
+
+namespace inner
+{
+
+const float SMALL_48 = 1.0f / (65536.0f * 65536.0f * 65536.0f);
+const float LARGE_48 = 65536.0f * 65536.0f * 65536.0f;
+
+const char INVALID_COLORSPACE_MESSAGE[] = "invalid colorspace";
+
+
+/**
+ * Row-major 3x3 matrix, just enough for color conversions.
+ */
+struct Matrix3
+{
+   float m[9];
+
+   void multiply( const float v[3], float o[3] ) const
+   {
+      o[0] = (m[0] * v[0]) + (m[1] * v[1]) + (m[2] * v[2]);
+      o[1] = (m[3] * v[0]) + (m[4] * v[1]) + (m[5] * v[2]);
+      o[2] = (m[6] * v[0]) + (m[7] * v[1]) + (m[8] * v[2]);
+   }
+
+   Matrix3 operator*( const Matrix3& b ) const
+   {
+      Matrix3 p;
+      for( int r = 0;  r < 3;  ++r )
+      {
+         for( int c = 0;  c < 3;  ++c )
+         {
+            p.m[r * 3 + c] = (m[r * 3 + 0] * b.m[0 + c]) +
+               (m[r * 3 + 1] * b.m[3 + c]) + (m[r * 3 + 2] * b.m[6 + c]);
+         }
+      }
+      return p;
+   }
+
+   Matrix3 inverted() const
+   {
+      const float c0 = (m[4] * m[8]) - (m[5] * m[7]);
+      const float c1 = (m[5] * m[6]) - (m[3] * m[8]);
+      const float c2 = (m[3] * m[7]) - (m[4] * m[6]);
+      const float determinant = (m[0] * c0) + (m[1] * c1) + (m[2] * c2);
+
+      // (catches NaNs too)
+      if( !(::fabsf( determinant ) > 1e-20f) )
+      {
+         throw INVALID_COLORSPACE_MESSAGE;
+      }
+      const float d = 1.0f / determinant;
+
+      const Matrix3 i = { {
+         c0 * d, ((m[2] * m[7]) - (m[1] * m[8])) * d,
+            ((m[1] * m[5]) - (m[2] * m[4])) * d,
+         c1 * d, ((m[0] * m[8]) - (m[2] * m[6])) * d,
+            ((m[2] * m[3]) - (m[0] * m[5])) * d,
+         c2 * d, ((m[1] * m[6]) - (m[0] * m[7])) * d,
+            ((m[0] * m[4]) - (m[1] * m[3])) * d } };
+      return i;
+   }
+};
+
+
+// Hunter-Point-Estevez cone responses (Wyszecki and Stiles)
+inline
+const Matrix3& xyzToCone()
+{
+   static const Matrix3 M = { {
+       0.38971f, 0.68898f, -0.07868f,
+      -0.22981f, 1.18340f,  0.04641f,
+       0.00000f, 0.00000f,  1.00000f } };
+   return M;
+}
+
+
+// 'Statistics of Cone Responses to Natural Images'
+// Ruderman, Cronin, Chiao; J. Optical Soc. of America, vol. 15, no. 8; 1998
+// (orthonormal, so inverse is transpose)
+inline
+const Matrix3& coneToRuderman()
+{
+   static const Matrix3 M = { {
+      0.57735026918963f,  0.57735026918963f,  0.57735026918963f,
+      0.40824829046386f,  0.40824829046386f, -0.81649658092773f,
+      0.70710678118655f, -0.70710678118655f,  0.00000000000000f } };
+   return M;
+}
+
+
+inline
+bool isNan( const float f )
+{
+   // is NaN if (IEEE-754): exponent is all ones and mantissa is not all zeros
+   // (by bits, so fast-math cannot remove it)
+   unsigned int bits;
+   ::memcpy( &bits, &f, sizeof(bits) );
+   return (bits & 0x7FFFFFFFu) > 0x7F800000u;
+}
+
+
+inline
+bool isNan( const float v[3] )
+{
+   return isNan(v[0]) | isNan(v[1]) | isNan(v[2]);
+}
+
+
+/**
+ * Clamp between zero and LARGE_48.
+ */
+inline
+void precondition( const float in[3], float out[3] )
+{
+   for( int i = 0;  i < 3;  ++i )
+   {
+      out[i] = (in[i] > 0.0f) ? ((in[i] < LARGE_48) ? in[i] : LARGE_48) :
+         0.0f;
+   }
+}
+
+
+/**
+ * Cone response to cone-log, (clamping to tiny above zero).
+ */
+inline
+void coneLog( const float lms[3], float lmsLog[3] )
+{
+   for( int i = 0;  i < 3;  ++i )
+   {
+      lmsLog[i] = ::log10f( lms[i] >= SMALL_48 ? lms[i] : SMALL_48 );
+   }
+}
+
+}//namespace
+
+
+
+
+/// color space ================================================================
+
+/**
+ * RGB <-> XYZ conversions, from chromaticities and whitepoint.
+ */
+class ColorSpace
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * @colorSpace6  { rx, ry, gx, gy, bx, by }, each > 0 and < 1
+    *               (give 0 for default: ITU-R BT.709 / sRGB)
+    * @whitePoint2  { x, y }, each > 0 and < 1
+    *               (give 0 for default: flat 1/3, 1/3)
+    */
+   explicit ColorSpace( const float* colorSpace6 = 0,
+                        const float* whitePoint2 = 0 );
+
+/// queries --------------------------------------------------------------------
+   const inner::Matrix3& getRgbToXyz()                                    const;
+   const inner::Matrix3& getXyzToRgb()                                    const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   inner::Matrix3 rgbToXyz_m;
+   inner::Matrix3 xyzToRgb_m;
+};
+
+
+inline
+ColorSpace::ColorSpace
+(
+   const float* colorSpace6,
+   const float* whitePoint2
+)
+{
+   static const float SRGB[]  = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f, 0.06f };
+   static const float FLAT[]  = { (1.0f / 3.0f), (1.0f / 3.0f) };
+   const float* c = colorSpace6 ? colorSpace6 : SRGB;
+   const float* w = whitePoint2 ? whitePoint2 : FLAT;
+
+   // chromaticities as columns
+   inner::Matrix3 chrm;
+   for( int i = 0;  i < 3;  ++i )
+   {
+      const float x = c[i * 2 + 0];
+      const float y = c[i * 2 + 1];
+      if( !((x >= 0.0f) & (x <= 1.0f) & (y >= 0.0f) & (y <= 1.0f)) )
+      {
+         throw inner::INVALID_COLORSPACE_MESSAGE;
+      }
+
+      chrm.m[0 + i] = x;
+      chrm.m[3 + i] = y;
+      chrm.m[6 + i] = 1.0f - (x + y);
+   }
+
+   // white color, of luminance one (flat white exactly one)
+   float white[3] = { 1.0f, 1.0f, 1.0f };
+   {
+      const float x = w[0];
+      const float y = w[1];
+      if( !((x >= 1e-7f) & (x < 1.0f) & (y >= 1e-7f) & (y < 1.0f)) )
+      {
+         throw inner::INVALID_COLORSPACE_MESSAGE;
+      }
+
+      if( (::fabsf(x - (1.0f / 3.0f)) >= 1e-3f) ||
+         (::fabsf(y - (1.0f / 3.0f)) >= 1e-3f) )
+      {
+         white[0] = x / y;
+         white[2] = (1.0f - (x + y)) / y;
+      }
+   }
+
+   // scale chromaticity columns to make white
+   float scale[3];
+   chrm.inverted().multiply( white, scale );
+
+   rgbToXyz_m = chrm;
+   for( int i = 0;  i < 9;  ++i )
+   {
+      rgbToXyz_m.m[i] *= scale[i % 3];
+   }
+   xyzToRgb_m = rgbToXyz_m.inverted();
+}
+
+
+inline
+const inner::Matrix3& ColorSpace::getRgbToXyz() const
+{
+   return rgbToXyz_m;
+}
+
+
+inline
+const inner::Matrix3& ColorSpace::getXyzToRgb() const
+{
+   return xyzToRgb_m;
+}
+
+
+
+
+/// Ruderman ===================================================================
+
+/**
+ * Linear RGB <-> Ruderman l-alpha-beta (log cone opponent space), where the
+ * illuminant estimate lives.
+ */
+class Ruderman
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit Ruderman( const ColorSpace& );
+
+/// queries --------------------------------------------------------------------
+   void fromRgb( const float rgb[3],
+                 float       lab[3] )                                     const;
+   void toRgb  ( const float lab[3],
+                 float       rgb[3] )                                     const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   inner::Matrix3 rgbToCone_m;
+   inner::Matrix3 coneToRgb_m;
+};
+
+
+inline
+Ruderman::Ruderman
+(
+   const ColorSpace& colorSpace
+)
+ : rgbToCone_m( inner::xyzToCone() * colorSpace.getRgbToXyz() )
+ , coneToRgb_m( colorSpace.getXyzToRgb() * inner::xyzToCone().inverted() )
+{
+}
+
+
+inline
+void Ruderman::fromRgb
+(
+   const float rgb[3],
+   float       lab[3]
+) const
+{
+   float lms[3];
+   rgbToCone_m.multiply( rgb, lms );
+
+   float lmsLog[3];
+   inner::coneLog( lms, lmsLog );
+
+   inner::coneToRuderman().multiply( lmsLog, lab );
+}
+
+
+inline
+void Ruderman::toRgb
+(
+   const float lab[3],
+   float       rgb[3]
+) const
+{
+   // (transpose multiply)
+   const float* r = inner::coneToRuderman().m;
+   float lms[3];
+   for( int i = 0;  i < 3;  ++i )
+   {
+      lms[i] = ::powf( 10.0f, (r[0 + i] * lab[0]) + (r[3 + i] * lab[1]) +
+         (r[6 + i] * lab[2]) );
+   }
+
+   coneToRgb_m.multiply( lms, rgb );
+}
+
+
+
+
+/// estimator ==================================================================
+
+/**
+ * 'Gray-world' illuminant estimation: the mean pixel, in Ruderman space.
+ * Pixels containing NaNs are left out.
+ */
+class Estimator
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit Estimator( const ColorSpace& );
+
+/// commands -------------------------------------------------------------------
+   void add( const float rgb[3],
+             float       weight = 1.0f );
+
+   /**
+    * Add another estimator's pixels (for example, from another thread).
+    */
+   void add( const Estimator& );
+
+   template<class PIXEL>
+   void addRow( const typename PIXEL::Type* pRow,
+                unsigned int                width );
+
+/// queries --------------------------------------------------------------------
+   /**
+    * @illuminant3  mean Ruderman pixel (zero if none added)
+    */
+   void getIlluminant( float illuminant3[3] )                             const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   Ruderman ruderman_m;
+   double   sum_m[3];
+   double   weight_m;
+};
+
+
+inline
+Estimator::Estimator
+(
+   const ColorSpace& colorSpace
+)
+ : ruderman_m( colorSpace )
+ , weight_m  ( 0.0 )
+{
+   sum_m[0] = sum_m[1] = sum_m[2] = 0.0;
+}
+
+
+inline
+void Estimator::add
+(
+   const float rgb[3],
+   const float weight
+)
+{
+   if( !inner::isNan( rgb ) )
+   {
+      float p[3];
+      inner::precondition( rgb, p );
+
+      float lab[3];
+      ruderman_m.fromRgb( p, lab );
+
+      sum_m[0] += lab[0] * weight;
+      sum_m[1] += lab[1] * weight;
+      sum_m[2] += lab[2] * weight;
+      weight_m += weight;
+   }
+}
+
+
+inline
+void Estimator::add
+(
+   const Estimator& other
+)
+{
+   sum_m[0] += other.sum_m[0];
+   sum_m[1] += other.sum_m[1];
+   sum_m[2] += other.sum_m[2];
+   weight_m += other.weight_m;
+}
+
+
+template<class PIXEL>
+inline
+void Estimator::addRow
+(
+   const typename PIXEL::Type* pRow,
+   const unsigned int          width
+)
+{
+   for( unsigned int x = 0;  x < width;  ++x, pRow += PIXEL::STRIDE_ )
+   {
+      float rgb[3];
+      PIXEL::read( pRow, rgb );
+      add( rgb );
+   }
+}
+
+
+inline
+void Estimator::getIlluminant
+(
+   float illuminant3[3]
+) const
+{
+   const double w = (weight_m > 0.0) ? weight_m : 1.0;
+
+   illuminant3[0] = static_cast<float>( sum_m[0] / w );
+   illuminant3[1] = static_cast<float>( sum_m[1] / w );
+   illuminant3[2] = static_cast<float>( sum_m[2] / w );
+}
+
+
+
+
+/// pixel map ==================================================================
+
+/**
+ * The per-pixel correction: shift chroma away from the illuminant, in
+ * Ruderman space, keeping luminance.<br/><br/>
+ *
+ * Input pixels are linear RGB. Negatives and very large values are clamped
+ * first, outputs are positive, black stays black, and pixels containing NaNs
+ * pass through unchanged.
+ */
+class PixelMap
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * @illuminant3  Ruderman illuminant, from an Estimator (or from
+    *               Ruderman::fromRgb of a known RGB illuminant)
+    * @strength     strength of color-shift, >= 0 and <= 1
+    */
+            PixelMap( const ColorSpace& colorSpace,
+                      const float       illuminant3[3],
+                      float             strength = 0.8f );
+
+/// queries --------------------------------------------------------------------
+   void operator()( const float in[3],
+                    float       out[3] )                                  const;
+
+   /**
+    * Map a row of pixels, from one pixel format to another. (in and out may
+    * be the same, if the formats are.)
+    */
+   template<class PIXEL_IN, class PIXEL_OUT>
+   void mapRow( const typename PIXEL_IN::Type* pIn,
+                typename PIXEL_OUT::Type*      pOut,
+                unsigned int                   width )                    const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   float          toY_m[3];
+   inner::Matrix3 rgbToCone_m;
+   inner::Matrix3 coneToRgb_m;
+   float          coneLogShift_m[3];
+};
+
+
+inline
+PixelMap::PixelMap
+(
+   const ColorSpace& colorSpace,
+   const float       illuminant3[3],
+   const float       strength
+)
+ : rgbToCone_m( inner::xyzToCone() * colorSpace.getRgbToXyz() )
+ , coneToRgb_m( colorSpace.getXyzToRgb() * inner::xyzToCone().inverted() )
+{
+   toY_m[0] = colorSpace.getRgbToXyz().m[3];
+   toY_m[1] = colorSpace.getRgbToXyz().m[4];
+   toY_m[2] = colorSpace.getRgbToXyz().m[5];
+
+   // chroma translation (alpha and beta only), moved into cone-log space
+   const float s = (strength >= 0.0f) ? ((strength <= 1.0f) ? strength :
+      1.0f) : 0.0f;
+   const float t[] = { 0.0f, illuminant3[1] * s, illuminant3[2] * s };
+   const float* r = inner::coneToRuderman().m;
+   for( int i = 0;  i < 3;  ++i )
+   {
+      coneLogShift_m[i] = -((r[0 + i] * t[0]) + (r[3 + i] * t[1]) +
+         (r[6 + i] * t[2]));
+   }
+}
+
+
+inline
+void PixelMap::operator()
+(
+   const float in[3],
+   float       out[3]
+) const
+{
+   // pass NaNs through
+   if( inner::isNan( in ) )
+   {
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+      return;
+   }
+
+   float p[3];
+   inner::precondition( in, p );
+
+   // to cone-log, translate, and back
+   float lms[3];
+   rgbToCone_m.multiply( p, lms );
+   float lmsLog[3];
+   inner::coneLog( lms, lmsLog );
+   for( int i = 0;  i < 3;  ++i )
+   {
+      lms[i] = ::powf( 10.0f, lmsLog[i] + coneLogShift_m[i] );
+   }
+   float rgb[3];
+   coneToRgb_m.multiply( lms, rgb );
+
+   // restore original luminance
+   const float outY = (rgb[0] * toY_m[0]) + (rgb[1] * toY_m[1]) +
+      (rgb[2] * toY_m[2]);
+   const float inY  = (p[0] * toY_m[0]) + (p[1] * toY_m[1]) +
+      (p[2] * toY_m[2]);
+   const float scaling = (0.0f != outY) ? (inY / outY) : 0.0f;
+
+   // clamp to positive
+   for( int i = 0;  i < 3;  ++i )
+   {
+      const float c = rgb[i] * scaling;
+      out[i] = (c > 0.0f) ? c : 0.0f;
+   }
+}
+
+
+template<class PIXEL_IN, class PIXEL_OUT>
+inline
+void PixelMap::mapRow
+(
+   const typename PIXEL_IN::Type* pIn,
+   typename PIXEL_OUT::Type*      pOut,
+   const unsigned int             width
+) const
+{
+   for( unsigned int x = 0;  x < width;
+      ++x, pIn += PIXEL_IN::STRIDE_, pOut += PIXEL_OUT::STRIDE_ )
+   {
+      float rgb[3];
+      PIXEL_IN::read( pIn, rgb );
+      (*this)( rgb, rgb );
+      PIXEL_OUT::write( pOut, rgb );
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//p3wbWhiteBalancer_hpp
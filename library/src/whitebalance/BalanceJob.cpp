@@ -0,0 +1,517 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifdef _PLATFORM_LINUX
+#include <unistd.h>
+#endif
+#include <string.h>
+#include <exception>
+
+#include "FpModeSet.hpp"
+#include "WhiteBalancer.hpp"
+
+#include "BalanceJob.hpp"
+
+
+using namespace p3whitebalancer;
+using namespace hxa7241_general;
+
+
+
+
+// implementation --------------------------------------------------------------
+namespace
+{
+
+// globals ---------------------------------------------------------------------
+// shared pool, made on first submit, joined on unload
+Mutex poolMutex_g;
+
+struct PoolHolder
+{
+   WorkerPool* pPool;
+
+   ~PoolHolder()
+   {
+      delete pPool;
+   }
+} poolHolder_g = { 0 };
+
+
+// functions -------------------------------------------------------------------
+const float* copyParameter
+(
+   const float* pFrom,
+   const udword length,
+   float*       pTo
+)
+{
+   if( pFrom )
+   {
+      for( udword i = length;  i-- > 0; )
+      {
+         pTo[i] = pFrom[i];
+      }
+   }
+
+   return pFrom ? pTo : 0;
+}
+
+
+void copyMessage
+(
+   const char* pFrom,
+   char*       pTo128
+)
+{
+   ::strncpy( pTo128, pFrom, 127 );
+   pTo128[ 127 ] = 0;
+}
+
+}
+
+
+
+
+// exported function -----------------------------------------------------------
+WorkerPool& p3whitebalancer::getSharedPool()
+{
+   MutexLock lock( poolMutex_g );
+
+   if( !poolHolder_g.pPool )
+   {
+      poolHolder_g.pPool = new WorkerPool( getProcessorCount() );
+   }
+
+   return *poolHolder_g.pPool;
+}
+
+
+
+/// standard object services ---------------------------------------------------
+BalanceJob::BalanceJob
+(
+   const float* pColorSpace6,
+   const float* pWhitePoint2,
+   const float* pInIlluminant3,
+   const udword options,
+   const float  strength,
+   const udword width,
+   const udword height,
+   const udword inFormatFlags,
+   const udword inPixelStride,
+   const qword  inRowPitch,
+   const void*  pInPixels,
+   const udword outFormatFlags,
+   const udword outPixelStride,
+   const qword  outRowPitch,
+   const float  outAlpha,
+   void*        pOutPixels,
+   const dword  notifyFd
+)
+ : pColorSpace6_m  ( copyParameter( pColorSpace6,   6, colorSpace6_m ) )
+ , pWhitePoint2_m  ( copyParameter( pWhitePoint2,   2, whitePoint2_m ) )
+ , pInIlluminant3_m( copyParameter( pInIlluminant3, 3, inIlluminant3_m ) )
+ , options_m       ( options )
+ , strength_m      ( strength )
+ , width_m         ( width )
+ , height_m        ( height )
+ , inFormatFlags_m ( inFormatFlags )
+ , inPixelStride_m ( inPixelStride )
+ , inRowPitch_m    ( inRowPitch )
+ , pInPixels_m     ( pInPixels )
+ , outFormatFlags_m( outFormatFlags )
+ , outPixelStride_m( outPixelStride )
+ , outRowPitch_m   ( outRowPitch )
+ , outAlpha_m      ( outAlpha )
+ , pOutPixels_m    ( pOutPixels )
+ , notifyFd_m      ( notifyFd )
+ , mutex_m         ()
+ , finished_m      ( 0 )
+ , status_m        ( QUEUED_e )
+ , isCancelled_m   ( false )
+{
+   message_m[0] = 0;
+}
+
+
+BalanceJob::~BalanceJob()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+void BalanceJob::submit()
+{
+   getSharedPool().submit( this );
+}
+
+
+void BalanceJob::run()
+{
+   EStatus status = FAILED_e;
+
+   // start, unless cancelled while queued
+   bool isStarting = false;
+   {
+      MutexLock lock( mutex_m );
+      status_m   = RUNNING_e;
+      isStarting = !isCancelled_m;
+   }
+
+   if( isStarting )
+   {
+      // (fp environment is per-thread)
+      const FpModeSet fpModeSet;
+
+      // handle exceptions
+      try
+      {
+         // delegate the actual activity
+         whiteBalance(
+            pColorSpace6_m,
+            pWhitePoint2_m,
+            pInIlluminant3_m,
+            options_m,
+            strength_m,
+            width_m,
+            height_m,
+            inFormatFlags_m,
+            inPixelStride_m,
+            inRowPitch_m,
+            pInPixels_m,
+            outFormatFlags_m,
+            outPixelStride_m,
+            outRowPitch_m,
+            outAlpha_m,
+            pOutPixels_m,
+            &isCancelled_m );
+
+         status = SUCCEEDED_e;
+      }
+      catch( const std::exception& exception )
+      {
+         copyMessage( exception.what(), message_m );
+      }
+      catch( const char*const exceptionString )
+      {
+         copyMessage( exceptionString, message_m );
+      }
+      catch( ... )
+      {
+         copyMessage( "unannotated exception", message_m );
+      }
+   }
+
+   finish( status );
+}
+
+
+bool BalanceJob::cancel()
+{
+   bool isWithdrawn = false;
+   {
+      MutexLock lock( mutex_m );
+
+      if( status_m >= SUCCEEDED_e )
+      {
+         return false;
+      }
+
+      // flag is seen by run, whether about to start or running
+      isCancelled_m = true;
+
+      isWithdrawn = (QUEUED_e == status_m) && poolHolder_g.pPool &&
+         poolHolder_g.pPool->withdraw( this );
+   }
+
+   // will never run, so finish here
+   if( isWithdrawn )
+   {
+      finish( CANCELLED_e );
+   }
+
+   return true;
+}
+
+
+BalanceJob::EStatus BalanceJob::wait()
+{
+   finished_m.wait();
+
+   // leave it open for any other waiters
+   finished_m.post();
+
+   return getStatus();
+}
+
+
+/// queries --------------------------------------------------------------------
+BalanceJob::EStatus BalanceJob::getStatus() const
+{
+   MutexLock lock( mutex_m );
+
+   return status_m;
+}
+
+
+const char* BalanceJob::getMessage() const
+{
+   return message_m;
+}
+
+
+/// implementation -------------------------------------------------------------
+void BalanceJob::finish
+(
+   EStatus status
+)
+{
+   {
+      MutexLock lock( mutex_m );
+
+      // a cancel request always wins, even if the work completed
+      if( isCancelled_m )
+      {
+         status = CANCELLED_e;
+         copyMessage( CANCELLED_MESSAGE, message_m );
+      }
+      else if( SUCCEEDED_e == status )
+      {
+         message_m[0] = 0;
+      }
+
+      status_m = status;
+   }
+
+   // eventfd-style notification: add 1 to an 8-byte counter
+   // (must precede finished_m post, after which a waiter may delete this)
+#ifdef _PLATFORM_LINUX
+   if( notifyFd_m >= 0 )
+   {
+      const uqword one = 1;
+      const ssize_t written = ::write( notifyFd_m, &one, sizeof(one) );
+      static_cast<void>( written );
+   }
+#endif
+
+   finished_m.post();
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <ostream>
+#include <vector>
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+bool test_BalanceJob
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_BalanceJob ]\n\n";
+
+
+   // make a noisy, tinted image
+   const udword WIDTH  = 97;
+   const udword HEIGHT = 61;
+   std::vector<float> image( WIDTH * HEIGHT * 3 );
+   {
+      udword r = seed ? static_cast<udword>(seed) : 362436069u;
+      for( udword i = 0;  i < image.size();  ++i )
+      {
+         r = 30903u * (r & 0xFFFFu) + (r >> 16);
+         image[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+            (0 == (i % 3) ? 1.5f : 1.0f);
+      }
+   }
+
+   // direct run, for reference
+   std::vector<float> direct( image.size() );
+   {
+      BalanceJob job( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+         0, 0, 0, 1.0f, &direct[0] );
+      job.run();
+
+      const bool isOk_ = (BalanceJob::SUCCEEDED_e == job.getStatus()) &&
+         (0 == job.getMessage()[0]);
+
+      if( pOut ) *pOut << "direct : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // pooled runs, all in flight together, must match direct
+   {
+      const udword JOB_COUNT = 8;
+      std::vector< std::vector<float> > outs( JOB_COUNT,
+         std::vector<float>( image.size() ) );
+      std::vector<BalanceJob*> jobs( JOB_COUNT );
+
+      for( udword j = 0;  j < JOB_COUNT;  ++j )
+      {
+         jobs[j] = new BalanceJob( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+            &image[0], 0, 0, 0, 1.0f, &outs[j][0] );
+         jobs[j]->submit();
+      }
+
+      bool isOk_ = true;
+      for( udword j = 0;  j < JOB_COUNT;  ++j )
+      {
+         isOk_ &= (BalanceJob::SUCCEEDED_e == jobs[j]->wait());
+         isOk_ &= (0 == ::memcmp( &outs[j][0], &direct[0],
+            direct.size() * sizeof(float) ));
+         delete jobs[j];
+      }
+
+      if( pOut && isVerbose ) *pOut << "pool threads: " <<
+         getSharedPool().getThreadCount() << "\n";
+
+      if( pOut ) *pOut << "pooled : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // cancellation
+   {
+      bool isOk_ = true;
+
+      // before running
+      {
+         std::vector<float> out( image.size() );
+         BalanceJob job( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+            0, 0, 0, 1.0f, &out[0] );
+         isOk_ &= job.cancel();
+         job.run();
+         isOk_ &= (BalanceJob::CANCELLED_e == job.getStatus()) &&
+            (0 == ::strcmp( CANCELLED_MESSAGE, job.getMessage() ));
+      }
+
+      // queued or running: wherever it is, it must end cancelled
+      {
+         const udword JOB_COUNT = 16;
+         std::vector< std::vector<float> > outs( JOB_COUNT,
+            std::vector<float>( image.size() ) );
+         std::vector<BalanceJob*> jobs( JOB_COUNT );
+
+         for( udword j = 0;  j < JOB_COUNT;  ++j )
+         {
+            jobs[j] = new BalanceJob( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+               &image[0], 0, 0, 0, 1.0f, &outs[j][0] );
+            jobs[j]->submit();
+         }
+         for( udword j = JOB_COUNT;  j-- > 0; )
+         {
+            const bool isCancelling = jobs[j]->cancel();
+            const BalanceJob::EStatus status = jobs[j]->wait();
+            isOk_ &= isCancelling ? (BalanceJob::CANCELLED_e == status) :
+               (BalanceJob::SUCCEEDED_e == status);
+            isOk_ &= !jobs[j]->cancel();
+            delete jobs[j];
+         }
+      }
+
+      if( pOut ) *pOut << "cancel : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // failure is reported, not thrown
+   {
+      // primaries with a NaN
+      float primaries[] = { 0.64f, 0.33f, 0.30f, 0.60f, 0.15f, 0.06f };
+      {
+         const udword nanBits = 0x7FC00000u;
+         ::memcpy( &primaries[2], &nanBits, sizeof(nanBits) );
+      }
+
+      std::vector<float> out( image.size() );
+      BalanceJob job( primaries, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+         &image[0], 0, 0, 0, 1.0f, &out[0] );
+      job.submit();
+
+      const bool isOk_ = (BalanceJob::FAILED_e == job.wait()) &&
+         (0 != job.getMessage()[0]);
+
+      if( pOut && isVerbose ) *pOut << "message: " << job.getMessage() <<
+         "\n";
+
+      if( pOut ) *pOut << "failure : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // completion notification
+#ifdef _PLATFORM_LINUX
+   {
+      bool isOk_ = false;
+
+      int fds[2];
+      if( 0 == ::pipe( fds ) )
+      {
+         std::vector<float> out( image.size() );
+         BalanceJob job( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+            0, 0, 0, 1.0f, &out[0], fds[1] );
+         job.submit();
+
+         // block on the fd, not the job
+         uqword count = 0;
+         const ssize_t length = ::read( fds[0], &count, sizeof(count) );
+         isOk_ = (static_cast<ssize_t>(sizeof(count)) == length) &&
+            (1 == count) && (BalanceJob::SUCCEEDED_e == job.wait());
+
+         ::close( fds[0] );
+         ::close( fds[1] );
+      }
+
+      if( pOut ) *pOut << "notify : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+#endif
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+}//namespace
+
+
+#endif//TESTING
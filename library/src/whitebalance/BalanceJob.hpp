@@ -0,0 +1,163 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef BalanceJob_h
+#define BalanceJob_h
+
+
+#include "Primitives.hpp"
+#include "Threads.hpp"
+#include "WorkerPool.hpp"
+
+
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+/**
+ * The library's shared worker pool, one thread per processor, made on first
+ * use.
+ */
+hxa7241_general::WorkerPool& getSharedPool();
+
+
+/**
+ * One white balance call, run directly or queued on the library's shared
+ * worker pool.<br/><br/>
+ *
+ * Parameter arrays are copied, pixel arrays are not (the caller keeps them
+ * until finished).<br/><br/>
+ *
+ * Status moves: queued -> running -> succeeded|failed|cancelled, (or queued ->
+ * cancelled). A cancel request before finishing always ends cancelled.
+ *
+ * @invariants
+ * * message_m is zero-terminated
+ */
+class BalanceJob
+   : public hxa7241_general::WorkerPool::Task
+{
+public:
+   /// (values match p3wbEJobStatus)
+   enum EStatus
+   {
+      QUEUED_e    = 0,
+      RUNNING_e   = 1,
+      SUCCEEDED_e = 2,
+      FAILED_e    = 3,
+      CANCELLED_e = 4
+   };
+
+
+/// standard object services ---------------------------------------------------
+public:
+            BalanceJob( const float* pColorSpace6,
+                        const float* pWhitePoint2,
+                        const float* pInIlluminant3,
+                        udword       options,
+                        float        strength,
+                        udword       width,
+                        udword       height,
+                        udword       inFormatFlags,
+                        udword       inPixelStride,
+                        qword        inRowPitch,
+                        const void*  pInPixels,
+                        udword       outFormatFlags,
+                        udword       outPixelStride,
+                        qword        outRowPitch,
+                        float        outAlpha,
+                        void*        pOutPixels,
+                        dword        notifyFd = -1 );
+
+   virtual ~BalanceJob();
+private:
+             BalanceJob( const BalanceJob& );
+   BalanceJob& operator=( const BalanceJob& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Queue on the shared worker pool.
+    */
+           void        submit();
+
+   /**
+    * Execute in the calling thread (also what a pool thread calls).
+    *
+    * Does not throw: failure is recorded in status and message.
+    */
+   virtual void        run();
+
+   /**
+    * Request cancellation.
+    *
+    * @return  true if the job will end cancelled, false if already finished
+    */
+           bool        cancel();
+
+   /**
+    * Block until finished.
+    */
+           EStatus     wait();
+
+/// queries --------------------------------------------------------------------
+           EStatus     getStatus()                                        const;
+
+   /**
+    * Failure message, valid when finished (empty if succeeded).
+    */
+           const char* getMessage()                                       const;
+
+/// implementation -------------------------------------------------------------
+protected:
+           void        finish( EStatus );
+
+/// fields ---------------------------------------------------------------------
+private:
+   // parameters
+   float        colorSpace6_m[6];
+   float        whitePoint2_m[2];
+   float        inIlluminant3_m[3];
+   const float* pColorSpace6_m;
+   const float* pWhitePoint2_m;
+   const float* pInIlluminant3_m;
+   udword       options_m;
+   float        strength_m;
+   udword       width_m;
+   udword       height_m;
+   udword       inFormatFlags_m;
+   udword       inPixelStride_m;
+   qword        inRowPitch_m;
+   const void*  pInPixels_m;
+   udword       outFormatFlags_m;
+   udword       outPixelStride_m;
+   qword        outRowPitch_m;
+   float        outAlpha_m;
+   void*        pOutPixels_m;
+   dword        notifyFd_m;
+
+   // state
+   mutable hxa7241_general::Mutex mutex_m;
+   hxa7241_general::Semaphore     finished_m;
+   EStatus                        status_m;
+   volatile bool                  isCancelled_m;
+   char                           message_m[128];
+};
+
+
+}
+
+
+
+
+#endif/*BalanceJob_h*/
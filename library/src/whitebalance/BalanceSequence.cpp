@@ -0,0 +1,496 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <algorithm>
+
+#include "BalanceSequence.hpp"
+
+
+using namespace p3whitebalancer;
+
+
+
+
+// implementation --------------------------------------------------------------
+namespace
+{
+
+// constants -------------------------------------------------------------------
+const char SMOOTHING_EXCEPTION_MESSAGE[] = "smoothing out of range";
+const char THRESHOLD_EXCEPTION_MESSAGE[] = "cut threshold out of range";
+
+const float SMOOTHING_DEFAULT     = 0.8f;
+const float CUT_THRESHOLD_DEFAULT = 0.3f;
+
+// samples per frame for estimation (about): enough for a stable mean and
+// histogram, few enough to cost little beside mapping
+const float SAMPLE_COUNT = 128.0f * 128.0f;
+
+
+// functions -------------------------------------------------------------------
+const float* copyParameter
+(
+   const float* pFrom,
+   const udword length,
+   float*       pTo
+)
+{
+   if( pFrom )
+   {
+      for( udword i = length;  i-- > 0; )
+      {
+         pTo[i] = pFrom[i];
+      }
+   }
+
+   return pFrom ? pTo : 0;
+}
+
+
+/**
+ * Normalise histogram to sum to one.
+ */
+void normaliseHistogram
+(
+   std::vector<float>& histogram
+)
+{
+   float sum = 0.0f;
+   for( udword i = histogram.size();  i-- > 0; )
+   {
+      sum += histogram[i];
+   }
+
+   const float scale = sum > 0.0f ? 1.0f / sum : 0.0f;
+   for( udword i = histogram.size();  i-- > 0; )
+   {
+      histogram[i] *= scale;
+   }
+}
+
+
+/**
+ * Difference of normalised histograms: total variation, 0 to 1.
+ */
+float getHistogramDifference
+(
+   const std::vector<float>& a,
+   const std::vector<float>& b
+)
+{
+   float difference = 0.0f;
+   for( udword i = a.size();  i-- > 0; )
+   {
+      difference += ::fabsf( a[i] - b[i] );
+   }
+
+   return difference * 0.5f;
+}
+
+
+/**
+ * Illuminant sum reduced to its mean (robust, if it has sketches), as a sum
+ * of one.
+ */
+IlluminantSum makeUnitSum
+(
+   const IlluminantSum& sum
+)
+{
+   double mean[3];
+   getIlluminantMean( sum, false, mean );
+
+   const IlluminantSum unit = { { mean[0], mean[1], mean[2] }, 1.0f, 1 };
+
+   return unit;
+}
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+BalanceSequence::BalanceSequence
+(
+   const float* pColorSpace6,
+   const float* pWhitePoint2,
+   const udword options,
+   const float  strength,
+   const float  smoothing,
+   const float  cutThreshold
+)
+ : pColorSpace6_m( copyParameter( pColorSpace6, 6, colorSpace6_m ) )
+ , pWhitePoint2_m( copyParameter( pWhitePoint2, 2, whitePoint2_m ) )
+ , options_m     ( options )
+ , strength_m    ( strength )
+ , smoothing_m   ( (-1.0f != smoothing) ? smoothing : SMOOTHING_DEFAULT )
+ , cutThreshold_m( (-1.0f != cutThreshold) ? cutThreshold :
+      CUT_THRESHOLD_DEFAULT )
+ , frameCount_m  ( 0 )
+{
+   // (NaNs fail too)
+   if( !((smoothing_m >= 0.0f) & (smoothing_m < 1.0f)) )
+   {
+      throw SMOOTHING_EXCEPTION_MESSAGE;
+   }
+   if( !((cutThreshold_m >= 0.0f) & (cutThreshold_m <= 1.0f)) )
+   {
+      throw THRESHOLD_EXCEPTION_MESSAGE;
+   }
+
+   const IlluminantSum ZERO = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   illuminant_m = ZERO;
+}
+
+
+BalanceSequence::~BalanceSequence()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+bool BalanceSequence::balanceFrame
+(
+   const udword width,
+   const udword height,
+   const udword inFormatFlags,
+   const udword inPixelStride,
+   const qword  inRowPitch,
+   const void*  pInPixels,
+   const udword outFormatFlags,
+   const udword outPixelStride,
+   const qword  outRowPitch,
+   const float  outAlpha,
+   void*        pOutPixels
+)
+{
+   // sample sparsely, about SAMPLE_COUNT pixels
+   const udword step = static_cast<udword>( ::sqrtf( (static_cast<float>(
+      width) * static_cast<float>(height)) / SAMPLE_COUNT ) );
+
+   IlluminantSum      sample = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   std::vector<float> histogram( CHROMA_BINS * CHROMA_BINS, 0.0f );
+   sampleIlluminant( pColorSpace6_m, pWhitePoint2_m, options_m, width, height,
+      inFormatFlags, inPixelStride, inRowPitch, pInPixels, step, sample,
+      &histogram[0] );
+   normaliseHistogram( histogram );
+
+   // scene cut if chroma distribution jumps (or first frame)
+   const bool isCut = histogram_m.empty() ||
+      (getHistogramDifference( histogram, histogram_m ) > cutThreshold_m);
+
+   // cut: estimate fully, and restart smoothing
+   IlluminantSum illuminant( illuminant_m );
+   if( isCut )
+   {
+      if( step > 1 )
+      {
+         const IlluminantSum ZERO = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+         sample = ZERO;
+         sumIlluminant( pColorSpace6_m, pWhitePoint2_m, 0, options_m, width,
+            height, inFormatFlags, inPixelStride, inRowPitch, pInPixels,
+            sample );
+      }
+
+      illuminant = makeUnitSum( sample );
+   }
+   // continuing: move toward sample's estimate (in Ruderman space)
+   else
+   {
+      const IlluminantSum unit = makeUnitSum( sample );
+      for( udword i = 3;  i-- > 0; )
+      {
+         illuminant.sum[i] = (illuminant.sum[i] * smoothing_m) +
+            (unit.sum[i] * (1.0f - smoothing_m));
+      }
+   }
+
+   // map, with smoothed illuminant
+   whiteBalance( pColorSpace6_m, pWhitePoint2_m, 0, options_m, strength_m,
+      width, height, inFormatFlags, inPixelStride, inRowPitch, pInPixels,
+      outFormatFlags, outPixelStride, outRowPitch, outAlpha, pOutPixels, 0,
+      &illuminant );
+
+   // update state (only if frame succeeded)
+   illuminant_m = illuminant;
+   histogram_m.swap( histogram );
+   ++frameCount_m;
+
+   return isCut;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+udword BalanceSequence::getFrameCount() const
+{
+   return frameCount_m;
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <ostream>
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+namespace
+{
+
+/**
+ * Tinted noise: random gray, jittered per channel.
+ */
+void makeFrame
+(
+   const float*        tint3,
+   udword&             random,
+   std::vector<float>& frame
+)
+{
+   for( udword i = 0;  i < frame.size();  i += 3 )
+   {
+      random = 30903u * (random & 0xFFFFu) + (random >> 16);
+      const float gray = 0.1f + static_cast<float>(random & 0xFFFFu) /
+         65536.0f;
+
+      for( udword c = 0;  c < 3;  ++c )
+      {
+         random = 30903u * (random & 0xFFFFu) + (random >> 16);
+         const float jitter = 0.9f + static_cast<float>(random & 0xFFFFu) /
+            (65536.0f * 5.0f);
+         frame[i + c] = gray * jitter * tint3[c];
+      }
+   }
+}
+
+
+/**
+ * Ratio of mean red to mean blue: a measure of remaining cast.
+ */
+float getCast
+(
+   const std::vector<float>& frame
+)
+{
+   float sum[] = { 0.0f, 0.0f };
+   for( udword i = 0;  i < frame.size();  i += 3 )
+   {
+      sum[0] += frame[i + 0];
+      sum[1] += frame[i + 2];
+   }
+
+   return sum[0] / sum[1];
+}
+
+}
+
+
+bool test_BalanceSequence
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_BalanceSequence ]\n\n";
+
+   udword random = seed ? static_cast<udword>(seed) : 362436069u;
+
+   const float BLUISH[]  = { 0.8f, 1.0f, 1.4f };
+   const float REDDISH[] = { 1.5f, 1.0f, 0.7f };
+
+
+   // scene cuts: detected where the tint changes, (sampled, large frames)
+   {
+      const udword WIDTH  = 300;
+      const udword HEIGHT = 240;
+      std::vector<float> frame( WIDTH * HEIGHT * 3 );
+      std::vector<float> out( frame.size() );
+
+      BalanceSequence sequence( 0, 0, 0, -1.0f, -1.0f, -1.0f );
+
+      bool isOk_ = true;
+      for( udword f = 0;  f < 8;  ++f )
+      {
+         makeFrame( (f < 5) ? BLUISH : REDDISH, random, frame );
+         const bool isCut = sequence.balanceFrame( WIDTH, HEIGHT, 0, 0, 0,
+            &frame[0], 0, 0, 0, 1.0f, &out[0] );
+
+         isOk_ &= ((0 == f) | (5 == f)) == isCut;
+
+         if( pOut && isVerbose ) *pOut << f << (isCut ? " cut" : "    ") <<
+            "  cast " << getCast( out ) << "\n";
+      }
+      isOk_ &= 8 == sequence.getFrameCount();
+
+      if( pOut ) *pOut << "cuts : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // steady frames: as balancing each alone, (unsampled, small frames)
+   {
+      const udword WIDTH  = 61;
+      const udword HEIGHT = 37;
+      std::vector<float> frame( WIDTH * HEIGHT * 3 );
+      std::vector<float> out( frame.size() );
+      std::vector<float> alone( frame.size() );
+      makeFrame( BLUISH, random, frame );
+
+      whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &frame[0], 0, 0,
+         0, 1.0f, &alone[0] );
+
+      BalanceSequence sequence( 0, 0, 0, -1.0f, -1.0f, -1.0f );
+
+      // (rounding of the mean can step the fast approximations, so compare to
+      // each pixel's largest channel)
+      float maxDif = 0.0f;
+      for( udword f = 0;  f < 4;  ++f )
+      {
+         sequence.balanceFrame( WIDTH, HEIGHT, 0, 0, 0, &frame[0], 0, 0, 0,
+            1.0f, &out[0] );
+
+         for( udword i = 0;  i < frame.size();  ++i )
+         {
+            const float* pPixel = &alone[i - (i % 3)];
+            const float  max    = pPixel[0] > pPixel[1] ?
+               (pPixel[0] > pPixel[2] ? pPixel[0] : pPixel[2]) :
+               (pPixel[1] > pPixel[2] ? pPixel[1] : pPixel[2]);
+
+            const float dif = ::fabsf( out[i] - alone[i] ) / (max + 1e-3f);
+            maxDif = dif > maxDif ? dif : maxDif;
+         }
+      }
+      const bool isOk_ = maxDif < 2e-3f;
+
+      if( pOut && isVerbose ) *pOut << "max relative dif: " << maxDif << "\n";
+
+      if( pOut ) *pOut << "steady : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // flickering content (under cut threshold): smoothing steadies the
+   // background
+   {
+      const udword WIDTH  = 61;
+      const udword HEIGHT = 37;
+      const udword PATCH  = WIDTH * (HEIGHT / 4) * 3;
+      std::vector<float> frame( WIDTH * HEIGHT * 3 );
+      std::vector<float> out( frame.size() );
+      std::vector<float> patch( PATCH );
+
+      const float RED[] = { 1.0f, 0.3f, 0.3f };
+
+      float flickers[2];
+      for( udword s = 0;  s < 2;  ++s )
+      {
+         // no smoothing, then default
+         BalanceSequence sequence( 0, 0, 0, -1.0f, s ? -1.0f : 0.0f, 1.0f );
+
+         float minCast = 1e9f;
+         float maxCast = 0.0f;
+         for( udword f = 0;  f < 12;  ++f )
+         {
+            // red object in the top quarter, every other frame
+            makeFrame( BLUISH, random, frame );
+            if( f & 1 )
+            {
+               makeFrame( RED, random, patch );
+               std::copy( patch.begin(), patch.end(), frame.begin() );
+            }
+
+            sequence.balanceFrame( WIDTH, HEIGHT, 0, 0, 0, &frame[0], 0, 0, 0,
+               1.0f, &out[0] );
+
+            // background only, after settling
+            if( f >= 6 )
+            {
+               const float cast = getCast( std::vector<float>( out.begin() +
+                  PATCH, out.end() ) );
+               minCast = cast < minCast ? cast : minCast;
+               maxCast = cast > maxCast ? cast : maxCast;
+            }
+         }
+         flickers[s] = maxCast - minCast;
+      }
+      const bool isOk_ = flickers[1] < (flickers[0] * 0.5f);
+
+      if( pOut && isVerbose ) *pOut << "flicker unsmoothed: " << flickers[0] <<
+         "  smoothed: " << flickers[1] << "\n";
+
+      if( pOut ) *pOut << "smoothing : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // bad parameters rejected
+   {
+      const float BADS[][2] = { { 1.0f, -1.0f }, { -0.5f, -1.0f },
+         { -1.0f, 1.5f } };
+
+      bool isOk_ = true;
+      for( udword b = 0;  b < 3;  ++b )
+      {
+         bool isThrown = false;
+         try
+         {
+            BalanceSequence sequence( 0, 0, 0, -1.0f, BADS[b][0], BADS[b][1] );
+         }
+         catch( const char* )
+         {
+            isThrown = true;
+         }
+         isOk_ &= isThrown;
+      }
+
+      if( pOut ) *pOut << "parameters : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+}//namespace
+
+
+#endif//TESTING
@@ -0,0 +1,107 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef BalanceSequence_h
+#define BalanceSequence_h
+
+
+#include <vector>
+
+#include "Primitives.hpp"
+#include "WhiteBalancer.hpp"
+
+
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+/**
+ * White balancing for a sequence of frames, with a smoothed illuminant.<br/>
+ * <br/>
+ *
+ * Each frame is estimated from a sparse sample only, and the illuminant moves
+ * toward that by an exponential moving average -- so it does not flicker, and
+ * there is no full estimation pass. A full estimate (and reset) is made only
+ * at a scene cut: when the sample's chroma histogram differs from the previous
+ * frame's by more than a threshold.<br/><br/>
+ *
+ * Parameter arrays are copied. One frame at a time (not thread-safe).
+ *
+ * @invariants
+ * * smoothing_m >= 0 and < 1
+ * * cutThreshold_m >= 0 and <= 1
+ * * histogram_m.size() == CHROMA_BINS * CHROMA_BINS, or 0 before first frame
+ */
+class BalanceSequence
+{
+/// standard object services ---------------------------------------------------
+public:
+            BalanceSequence( const float* pColorSpace6,
+                             const float* pWhitePoint2,
+                             udword       options,
+                             float        strength,
+                             float        smoothing,
+                             float        cutThreshold );
+
+           ~BalanceSequence();
+private:
+            BalanceSequence( const BalanceSequence& );
+   BalanceSequence& operator=( const BalanceSequence& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Balance the next frame. Parameters as whiteBalance.
+    *
+    * @return  true if a scene cut (or first frame), so fully estimated
+    */
+           bool balanceFrame( udword      width,
+                              udword      height,
+                              udword      inFormatFlags,
+                              udword      inPixelStride,
+                              qword       inRowPitch,
+                              const void* pInPixels,
+                              udword      outFormatFlags,
+                              udword      outPixelStride,
+                              qword       outRowPitch,
+                              float       outAlpha,
+                              void*       pOutPixels );
+
+/// queries --------------------------------------------------------------------
+           udword getFrameCount()                                         const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   // parameters
+   float        colorSpace6_m[6];
+   float        whitePoint2_m[2];
+   const float* pColorSpace6_m;
+   const float* pWhitePoint2_m;
+   udword       options_m;
+   float        strength_m;
+   float        smoothing_m;
+   float        cutThreshold_m;
+
+   // state
+   udword             frameCount_m;
+   IlluminantSum      illuminant_m;
+   std::vector<float> histogram_m;
+};
+
+
+}
+
+
+
+
+#endif/*BalanceSequence_h*/
@@ -0,0 +1,432 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <new>
+#include <vector>
+
+#include "FpModeSet.hpp"
+#include "Threads.hpp"
+#include "WorkerPool.hpp"
+#include "WhiteBalancer.hpp"
+#include "BalanceJob.hpp"
+
+#include "BalanceSet.hpp"
+
+
+using namespace p3whitebalancer;
+using namespace hxa7241_general;
+
+
+
+
+// implementation --------------------------------------------------------------
+namespace
+{
+
+// constants -------------------------------------------------------------------
+const char ALLOCATION_EXCEPTION_MESSAGE[]  = "allocation failure";
+const char UNANNOTATED_EXCEPTION_MESSAGE[] = "unannotated exception";
+
+
+// classes ---------------------------------------------------------------------
+/**
+ * State shared by the tasks of one set.
+ *
+ * @invariants
+ * * pMessage is a static string, or 0
+ */
+struct SetState
+{
+   const float*   pColorSpace6;
+   const float*   pWhitePoint2;
+   const float*   pInIlluminant3;
+   udword         options;
+   float          strength;
+
+   // pooled sum, once made
+   IlluminantSum  pooledSum;
+
+   Mutex          mutex;
+   Semaphore      finished;
+   volatile bool  isFailed;
+   const char*    pMessage;
+};
+
+
+/**
+ * One image's sum or mapping, on the pool.<br/><br/>
+ *
+ * Records failure in the set state (and so stops the others), instead of
+ * throwing.
+ */
+class ImageTask
+   : public WorkerPool::Task
+{
+/// standard object services ---------------------------------------------------
+public:
+            ImageTask();
+// use defaults
+//   virtual ~ImageTask();
+//            ImageTask( const ImageTask& );
+//   ImageTask& operator=( const ImageTask& );
+
+/// commands -------------------------------------------------------------------
+           void set( SetState&       state,
+                     const SetImage& image,
+                     bool            isMapping );
+
+   virtual void run();
+
+/// queries --------------------------------------------------------------------
+           const IlluminantSum& getSum()                                  const;
+
+/// implementation -------------------------------------------------------------
+protected:
+           void fail( const char* pMessage );
+
+/// fields ---------------------------------------------------------------------
+private:
+   SetState*       pState_m;
+   const SetImage* pImage_m;
+   bool            isMapping_m;
+
+   IlluminantSum   sum_m;
+};
+
+
+ImageTask::ImageTask()
+ : pState_m   ( 0 )
+ , pImage_m   ( 0 )
+ , isMapping_m( false )
+{
+   const IlluminantSum ZERO = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   sum_m = ZERO;
+}
+
+
+void ImageTask::set
+(
+   SetState&       state,
+   const SetImage& image,
+   const bool      isMapping
+)
+{
+   pState_m    = &state;
+   pImage_m    = &image;
+   isMapping_m = isMapping;
+}
+
+
+void ImageTask::run()
+{
+   // (fp environment is per-thread)
+   const FpModeSet fpModeSet;
+
+   SetState&       s = *pState_m;
+   const SetImage& i = *pImage_m;
+
+   // handle exceptions
+   try
+   {
+      // (set failure is seen as cancelling)
+      if( !isMapping_m )
+      {
+         sumIlluminant( s.pColorSpace6, s.pWhitePoint2, s.pInIlluminant3,
+            s.options, i.width, i.height, i.inFormatFlags, i.inPixelStride,
+            i.inRowPitch, i.pInPixels, sum_m, &s.isFailed );
+      }
+      else
+      {
+         whiteBalance( s.pColorSpace6, s.pWhitePoint2, s.pInIlluminant3,
+            s.options, s.strength, i.width, i.height, i.inFormatFlags,
+            i.inPixelStride, i.inRowPitch, i.pInPixels, i.outFormatFlags,
+            i.outPixelStride, i.outRowPitch, i.outAlpha, i.pOutPixels,
+            &s.isFailed, &s.pooledSum );
+      }
+   }
+   catch( const std::bad_alloc& )
+   {
+      fail( ALLOCATION_EXCEPTION_MESSAGE );
+   }
+   catch( const char*const exceptionString )
+   {
+      fail( exceptionString );
+   }
+   catch( ... )
+   {
+      fail( UNANNOTATED_EXCEPTION_MESSAGE );
+   }
+
+   s.finished.post();
+}
+
+
+const IlluminantSum& ImageTask::getSum() const
+{
+   return sum_m;
+}
+
+
+void ImageTask::fail
+(
+   const char* pMessage
+)
+{
+   MutexLock lock( pState_m->mutex );
+
+   // keep the first, not the cancellations it causes
+   if( !pState_m->pMessage )
+   {
+      pState_m->pMessage = pMessage;
+   }
+   pState_m->isFailed = true;
+}
+
+
+/**
+ * Run all tasks on the pool, and wait for them all.
+ */
+void runTasks
+(
+   SetState&               state,
+   std::vector<ImageTask>& tasks
+)
+{
+   WorkerPool& pool = getSharedPool();
+
+   for( udword t = 0;  t < tasks.size();  ++t )
+   {
+      pool.submit( &tasks[t] );
+   }
+   for( udword t = tasks.size();  t-- > 0; )
+   {
+      state.finished.wait();
+   }
+
+   if( state.isFailed )
+   {
+      throw state.pMessage;
+   }
+}
+
+}
+
+
+
+
+// exported function -----------------------------------------------------------
+void p3whitebalancer::whiteBalanceSet
+(
+   const float*    i_pColorSpace6,
+   const float*    i_pWhitePoint2,
+   const float*    i_pInIlluminant3,
+   const udword    i_options,
+   const float     i_strength01,
+   const udword    i_count,
+   const SetImage* i_pImages
+)
+{
+   SetState state;
+   {
+      const IlluminantSum ZERO = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+
+      state.pColorSpace6   = i_pColorSpace6;
+      state.pWhitePoint2   = i_pWhitePoint2;
+      state.pInIlluminant3 = i_pInIlluminant3;
+      state.options        = i_options;
+      state.strength       = i_strength01;
+      state.pooledSum      = ZERO;
+      state.isFailed       = false;
+      state.pMessage       = 0;
+   }
+
+   std::vector<ImageTask> tasks( i_count );
+
+   // sum each image
+   for( udword t = 0;  t < i_count;  ++t )
+   {
+      tasks[t].set( state, i_pImages[t], false );
+   }
+   runTasks( state, tasks );
+
+   // pool sums, in image order (so result does not depend on timing)
+   for( udword t = 0;  t < i_count;  ++t )
+   {
+      poolIlluminant( tasks[t].getSum(), state.pooledSum );
+   }
+
+   // map each image
+   for( udword t = 0;  t < i_count;  ++t )
+   {
+      tasks[t].set( state, i_pImages[t], true );
+   }
+   runTasks( state, tasks );
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <math.h>
+#include <ostream>
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+bool test_BalanceSet
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_BalanceSet ]\n\n";
+
+
+   // make a noisy, tinted montage: three images, stacked
+   const udword WIDTH      = 53;
+   const udword HEIGHTS[]  = { 31, 7, 44 };
+   const udword COUNT      = sizeof(HEIGHTS) / sizeof(HEIGHTS[0]);
+   const udword HEIGHT     = HEIGHTS[0] + HEIGHTS[1] + HEIGHTS[2];
+   std::vector<float> montage( WIDTH * HEIGHT * 3 );
+   {
+      udword r = seed ? static_cast<udword>(seed) : 362436069u;
+      for( udword i = 0;  i < montage.size();  ++i )
+      {
+         r = 30903u * (r & 0xFFFFu) + (r >> 16);
+         montage[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+            (2 == (i % 3) ? 1.5f : 1.0f);
+      }
+   }
+
+   // set of images, into the montage
+   std::vector<float> out( montage.size() );
+   SetImage images[COUNT];
+   {
+      udword offset = 0;
+      for( udword i = 0;  i < COUNT;  ++i )
+      {
+         const SetImage image = { WIDTH, HEIGHTS[i], 0, 0, 0,
+            &montage[offset], 0, 0, 0, 1.0f, &out[offset] };
+         images[i] = image;
+         offset   += WIDTH * HEIGHTS[i] * 3;
+      }
+   }
+
+   // set must match the montage balanced whole, estimated and supplied
+   for( udword k = 0;  k < 2;  ++k )
+   {
+      const float  illuminant[] = { 0.9f, 1.0f, 1.3f };
+      const float* pIlluminant  = k ? illuminant : 0;
+
+      std::vector<float> whole( montage.size() );
+      whiteBalance( 0, 0, pIlluminant, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+         &montage[0], 0, 0, 0, 1.0f, &whole[0] );
+
+      whiteBalanceSet( 0, 0, pIlluminant, 0, -1.0f, COUNT, images );
+
+      // (only summing order differs, but the fast approximations can step on
+      // that, so compare to each pixel's largest channel)
+      float maxDif = 0.0f;
+      for( udword i = 0;  i < montage.size();  ++i )
+      {
+         const float* pPixel = &whole[i - (i % 3)];
+         const float  max    = pPixel[0] > pPixel[1] ?
+            (pPixel[0] > pPixel[2] ? pPixel[0] : pPixel[2]) :
+            (pPixel[1] > pPixel[2] ? pPixel[1] : pPixel[2]);
+
+         const float dif = ::fabsf( out[i] - whole[i] ) / (max + 1e-3f);
+         maxDif = dif > maxDif ? dif : maxDif;
+      }
+      const bool isOk_ = maxDif < 2e-3f;
+
+      if( pOut && isVerbose ) *pOut << "max relative dif: " << maxDif << "\n";
+
+      if( pOut ) *pOut << (k ? "supplied " : "estimated ") <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // an empty set does nothing
+   {
+      bool isOk_ = true;
+      try
+      {
+         whiteBalanceSet( 0, 0, 0, 0, -1.0f, 0, 0 );
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+
+      if( pOut ) *pOut << "empty : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // one bad image fails the set
+   {
+      SetImage bad[COUNT];
+      for( udword i = 0;  i < COUNT;  ++i )
+      {
+         bad[i] = images[i];
+      }
+      bad[1].inRowPitch = 4;
+
+      const char* pMessage = 0;
+      try
+      {
+         whiteBalanceSet( 0, 0, 0, 0, -1.0f, COUNT, bad );
+      }
+      catch( const char*const exceptionString )
+      {
+         pMessage = exceptionString;
+      }
+
+      const bool isOk_ = (0 != pMessage) && (0 != pMessage[0]);
+
+      if( pOut && isVerbose && pMessage ) *pOut << "message: " << pMessage <<
+         "\n";
+
+      if( pOut ) *pOut << "failure : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+}//namespace
+
+
+#endif//TESTING
@@ -0,0 +1,76 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef BalanceSet_h
+#define BalanceSet_h
+
+
+#include "Primitives.hpp"
+
+
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+/**
+ * One image of a set: parameters as whiteBalance.
+ */
+struct SetImage
+{
+   udword      width;
+   udword      height;
+   udword      inFormatFlags;
+   udword      inPixelStride;
+   qword       inRowPitch;
+   const void* pInPixels;
+   udword      outFormatFlags;
+   udword      outPixelStride;
+   qword       outRowPitch;
+   float       outAlpha;
+   void*       pOutPixels;
+};
+
+
+/**
+ * White balance a set of images with one illuminant, pooled from all of them
+ * (as if they were one image).<br/><br/>
+ *
+ * Two passes on the library's shared worker pool: each image's illuminant sum,
+ * concurrently, then each image's mapping, concurrently. Each image is one
+ * task, so a pool thread holds only one image's working storage at a time.
+ * The first failure stops the other tasks early.
+ *
+ * Parameters as whiteBalance, plus:
+ * @i_count    number of images
+ * @i_pImages  array of i_count images
+ *
+ * @throws exceptions
+ */
+void whiteBalanceSet
+(
+   const float*    i_colorSpace6,
+   const float*    i_whitePoint2,
+   const float*    i_pInIlluminant3,
+   unsigned int    i_options,
+   float           i_strength,
+   udword          i_count,
+   const SetImage* i_pImages
+);
+
+
+}
+
+
+
+
+#endif/*BalanceSet_h*/
@@ -0,0 +1,280 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include "BalanceStrips.hpp"
+
+
+using namespace p3whitebalancer;
+
+
+
+
+// implementation --------------------------------------------------------------
+namespace
+{
+
+// constants -------------------------------------------------------------------
+const char NOT_ESTIMATED_EXCEPTION_MESSAGE[] =
+   "strip balanced before any estimated";
+
+
+// functions -------------------------------------------------------------------
+const float* copyParameter
+(
+   const float* pFrom,
+   const udword length,
+   float*       pTo
+)
+{
+   if( pFrom )
+   {
+      for( udword i = length;  i-- > 0; )
+      {
+         pTo[i] = pFrom[i];
+      }
+   }
+
+   return pFrom ? pTo : 0;
+}
+
+}
+
+
+
+
+/// standard object services ---------------------------------------------------
+BalanceStrips::BalanceStrips
+(
+   const float* pColorSpace6,
+   const float* pWhitePoint2,
+   const float* pInIlluminant3,
+   const udword options,
+   const float  strength
+)
+ : pColorSpace6_m  ( copyParameter( pColorSpace6, 6, colorSpace6_m ) )
+ , pWhitePoint2_m  ( copyParameter( pWhitePoint2, 2, whitePoint2_m ) )
+ , pInIlluminant3_m( copyParameter( pInIlluminant3, 3, inIlluminant3_m ) )
+ , options_m       ( options )
+ , strength_m      ( strength )
+ , estimatedCount_m( 0 )
+{
+   const IlluminantSum ZERO = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   sum_m = ZERO;
+}
+
+
+BalanceStrips::~BalanceStrips()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void BalanceStrips::estimateStrip
+(
+   const udword width,
+   const udword height,
+   const udword inFormatFlags,
+   const udword inPixelStride,
+   const qword  inRowPitch,
+   const void*  pInPixels
+)
+{
+   // (summed separately, so a failed strip leaves the sum as it was)
+   IlluminantSum strip = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   sumIlluminant( pColorSpace6_m, pWhitePoint2_m, pInIlluminant3_m, options_m,
+      width, height, inFormatFlags, inPixelStride, inRowPitch, pInPixels,
+      strip );
+
+   poolIlluminant( strip, sum_m );
+   ++estimatedCount_m;
+}
+
+
+void BalanceStrips::balanceStrip
+(
+   const udword width,
+   const udword height,
+   const udword inFormatFlags,
+   const udword inPixelStride,
+   const qword  inRowPitch,
+   const void*  pInPixels,
+   const udword outFormatFlags,
+   const udword outPixelStride,
+   const qword  outRowPitch,
+   const float  outAlpha,
+   void*        pOutPixels
+)
+{
+   if( 0 == estimatedCount_m )
+   {
+      throw NOT_ESTIMATED_EXCEPTION_MESSAGE;
+   }
+
+   whiteBalance( pColorSpace6_m, pWhitePoint2_m, pInIlluminant3_m, options_m,
+      strength_m, width, height, inFormatFlags, inPixelStride, inRowPitch,
+      pInPixels, outFormatFlags, outPixelStride, outRowPitch, outAlpha,
+      pOutPixels, 0, &sum_m );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+udword BalanceStrips::getEstimatedCount() const
+{
+   return estimatedCount_m;
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <math.h>
+#include <vector>
+#include <ostream>
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+bool test_BalanceStrips
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_BalanceStrips ]\n\n";
+
+
+   // make a noisy, tinted image
+   const udword WIDTH  = 47;
+   const udword HEIGHT = 83;
+   std::vector<float> image( WIDTH * HEIGHT * 3 );
+   {
+      udword r = seed ? static_cast<udword>(seed) : 362436069u;
+      for( udword i = 0;  i < image.size();  ++i )
+      {
+         r = 30903u * (r & 0xFFFFu) + (r >> 16);
+         image[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+            (0 == (i % 3) ? 1.4f : 1.0f);
+      }
+   }
+
+   // strips must match the image balanced whole, estimated and supplied, for
+   // various strip heights
+   static const udword STRIP_ROWS[] = { 1, 10, 83 };
+   for( udword k = 0;  k < 2;  ++k )
+   {
+      const float  illuminant[] = { 1.2f, 1.0f, 0.8f };
+      const float* pIlluminant  = k ? illuminant : 0;
+
+      std::vector<float> whole( image.size() );
+      whiteBalance( 0, 0, pIlluminant, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+         &image[0], 0, 0, 0, 1.0f, &whole[0] );
+
+      for( udword s = 0;  s < sizeof(STRIP_ROWS)/sizeof(STRIP_ROWS[0]);  ++s )
+      {
+         const udword rows  = STRIP_ROWS[s];
+         const udword pitch = WIDTH * 3;
+
+         // two passes over the strips (output strips, so input is kept)
+         std::vector<float> out( image.size() );
+         BalanceStrips strips( 0, 0, pIlluminant, 0, -1.0f );
+         for( udword y = 0;  y < HEIGHT;  y += rows )
+         {
+            const udword height = (HEIGHT - y) < rows ? (HEIGHT - y) : rows;
+            strips.estimateStrip( WIDTH, height, 0, 0, 0, &image[y * pitch] );
+         }
+         for( udword y = 0;  y < HEIGHT;  y += rows )
+         {
+            const udword height = (HEIGHT - y) < rows ? (HEIGHT - y) : rows;
+            strips.balanceStrip( WIDTH, height, 0, 0, 0, &image[y * pitch], 0,
+               0, 0, 1.0f, &out[y * pitch] );
+         }
+
+         // (only summing order differs, but the fast approximations can step
+         // on that, so compare to each pixel's largest channel)
+         float maxDif = 0.0f;
+         for( udword i = 0;  i < image.size();  ++i )
+         {
+            const float* pPixel = &whole[i - (i % 3)];
+            const float  max    = pPixel[0] > pPixel[1] ?
+               (pPixel[0] > pPixel[2] ? pPixel[0] : pPixel[2]) :
+               (pPixel[1] > pPixel[2] ? pPixel[1] : pPixel[2]);
+
+            const float dif = ::fabsf( out[i] - whole[i] ) / (max + 1e-3f);
+            maxDif = dif > maxDif ? dif : maxDif;
+         }
+         const bool isOk_ = (maxDif < 2e-3f) &&
+            (((HEIGHT + rows - 1) / rows) == strips.getEstimatedCount());
+
+         if( pOut && isVerbose ) *pOut << rows << " rows, max relative dif: "
+            << maxDif << "\n";
+
+         if( pOut ) *pOut << (k ? "supplied " : "estimated ") << rows <<
+            " : " << (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+         isOk &= isOk_;
+      }
+   }
+
+   // balancing before estimating fails
+   {
+      std::vector<float> out( image.size() );
+      BalanceStrips strips( 0, 0, 0, 0, -1.0f );
+
+      const char* pMessage = 0;
+      try
+      {
+         strips.balanceStrip( WIDTH, HEIGHT, 0, 0, 0, &image[0], 0, 0, 0,
+            1.0f, &out[0] );
+      }
+      catch( const char* pException )
+      {
+         pMessage = pException;
+      }
+      const bool isOk_ = (0 != pMessage);
+
+      if( pOut && isVerbose && pMessage ) *pOut << pMessage << "\n";
+
+      if( pOut ) *pOut << "not estimated : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+   return isOk;
+}
+
+
+}//namespace
+
+
+#endif//TESTING
@@ -0,0 +1,107 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef BalanceStrips_h
+#define BalanceStrips_h
+
+
+#include "Primitives.hpp"
+#include "WhiteBalancer.hpp"
+
+
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+/**
+ * White balancing an image in strips of rows, for images too big to hold.
+ * <br/><br/>
+ *
+ * Two passes: every strip is added to the estimate, then every strip is
+ * balanced with the illuminant pooled from all of them -- so the result is as
+ * balancing the image whole (to within summing order). Only one strip need
+ * be in memory at a time: the caller can read each, and drop it, in both
+ * passes.<br/><br/>
+ *
+ * Parameter arrays are copied. One strip at a time (not thread-safe).
+ */
+class BalanceStrips
+{
+/// standard object services ---------------------------------------------------
+public:
+            BalanceStrips( const float* pColorSpace6,
+                           const float* pWhitePoint2,
+                           const float* pInIlluminant3,
+                           udword       options,
+                           float        strength );
+
+           ~BalanceStrips();
+private:
+            BalanceStrips( const BalanceStrips& );
+   BalanceStrips& operator=( const BalanceStrips& );
+public:
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Add a strip to the estimate. Parameters as sumIlluminant.
+    */
+           void   estimateStrip( udword      width,
+                                 udword      height,
+                                 udword      inFormatFlags,
+                                 udword      inPixelStride,
+                                 qword       inRowPitch,
+                                 const void* pInPixels );
+
+   /**
+    * Balance a strip, with the estimate so far (so, after all are added).
+    * Parameters as whiteBalance.
+    */
+           void   balanceStrip( udword      width,
+                                udword      height,
+                                udword      inFormatFlags,
+                                udword      inPixelStride,
+                                qword       inRowPitch,
+                                const void* pInPixels,
+                                udword      outFormatFlags,
+                                udword      outPixelStride,
+                                qword       outRowPitch,
+                                float       outAlpha,
+                                void*       pOutPixels );
+
+/// queries --------------------------------------------------------------------
+           udword getEstimatedCount()                                     const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   // parameters
+   float        colorSpace6_m[6];
+   float        whitePoint2_m[2];
+   float        inIlluminant3_m[3];
+   const float* pColorSpace6_m;
+   const float* pWhitePoint2_m;
+   const float* pInIlluminant3_m;
+   udword       options_m;
+   float        strength_m;
+
+   // state
+   udword        estimatedCount_m;
+   IlluminantSum sum_m;
+};
+
+
+}
+
+
+
+
+#endif/*BalanceStrips_h*/
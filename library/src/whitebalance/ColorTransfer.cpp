@@ -0,0 +1,663 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#include <new>
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "FpModeSet.hpp"
+#include "Threads.hpp"
+#include "WorkerPool.hpp"
+#include "BalanceJob.hpp"
+
+#include "ColorTransfer.hpp"
+
+
+using namespace p3whitebalancer;
+using namespace hxa7241_general;
+
+
+
+
+// implementation --------------------------------------------------------------
+namespace
+{
+
+// constants -------------------------------------------------------------------
+const char ALLOCATION_EXCEPTION_MESSAGE[]  = "allocation failure";
+const char UNANNOTATED_EXCEPTION_MESSAGE[] = "unannotated exception";
+const char TEXT_EXCEPTION_MESSAGE[]        = "invalid color stats text";
+
+const char STATS_TAG[] = "p3wb-stats-1";
+
+// rows per task (fixed, so pooling order, and so result, is the same on any
+// machine)
+const udword BAND_ROWS = 64;
+
+
+// classes ---------------------------------------------------------------------
+/**
+ * State shared by the tasks of one image.
+ *
+ * @invariants
+ * * pMessage is a static string, or 0
+ */
+struct ImageState
+{
+   const float*      pColorSpace6;
+   const float*      pWhitePoint2;
+   udword            options;
+   float             strength;
+   const ColorStats* pReference;
+
+   udword            width;
+   udword            height;
+   udword            inFormatFlags;
+   udword            inPixelStride;
+   qword             inRowPitch;
+   const void*       pInPixels;
+   udword            outFormatFlags;
+   udword            outPixelStride;
+   qword             outRowPitch;
+   float             outAlpha;
+   void*             pOutPixels;
+
+   // target stats, once made
+   ColorStats        target;
+
+   Mutex             mutex;
+   Semaphore         finished;
+   volatile bool     isFailed;
+   const char*       pMessage;
+};
+
+
+/**
+ * One band's stats or mapping, on the pool.<br/><br/>
+ *
+ * Records failure in the image state (and so stops the others), instead of
+ * throwing.
+ */
+class BandTask
+   : public WorkerPool::Task
+{
+/// standard object services ---------------------------------------------------
+public:
+            BandTask();
+// use defaults
+//   virtual ~BandTask();
+//            BandTask( const BandTask& );
+//   BandTask& operator=( const BandTask& );
+
+/// commands -------------------------------------------------------------------
+           void set( ImageState& state,
+                     udword      top,
+                     bool        isMapping );
+
+   virtual void run();
+
+/// queries --------------------------------------------------------------------
+           const ColorStats& getStats()                                   const;
+
+/// implementation -------------------------------------------------------------
+protected:
+           void fail( const char* pMessage );
+
+/// fields ---------------------------------------------------------------------
+private:
+   ImageState* pState_m;
+   udword      top_m;
+   bool        isMapping_m;
+
+   ColorStats  stats_m;
+};
+
+
+BandTask::BandTask()
+ : pState_m   ( 0 )
+ , top_m      ( 0 )
+ , isMapping_m( false )
+{
+   const ColorStats ZERO = { 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+   stats_m = ZERO;
+}
+
+
+void BandTask::set
+(
+   ImageState&  state,
+   const udword top,
+   const bool   isMapping
+)
+{
+   pState_m    = &state;
+   top_m       = top;
+   isMapping_m = isMapping;
+}
+
+
+void BandTask::run()
+{
+   // (fp environment is per-thread)
+   const FpModeSet fpModeSet;
+
+   ImageState& s = *pState_m;
+
+   // handle exceptions
+   try
+   {
+      // (image failure is seen as cancelling)
+      if( !isMapping_m )
+      {
+         sumStats( s.pColorSpace6, s.pWhitePoint2, s.options, s.width,
+            s.height, s.inFormatFlags, s.inPixelStride, s.inRowPitch,
+            s.pInPixels, top_m, BAND_ROWS, stats_m, &s.isFailed );
+      }
+      else
+      {
+         transferColors( s.pColorSpace6, s.pWhitePoint2, s.options,
+            s.strength, s.target, *s.pReference, s.width, s.height,
+            s.inFormatFlags, s.inPixelStride, s.inRowPitch, s.pInPixels,
+            s.outFormatFlags, s.outPixelStride, s.outRowPitch, s.outAlpha,
+            s.pOutPixels, top_m, BAND_ROWS, &s.isFailed );
+      }
+   }
+   catch( const std::bad_alloc& )
+   {
+      fail( ALLOCATION_EXCEPTION_MESSAGE );
+   }
+   catch( const char*const exceptionString )
+   {
+      fail( exceptionString );
+   }
+   catch( ... )
+   {
+      fail( UNANNOTATED_EXCEPTION_MESSAGE );
+   }
+
+   s.finished.post();
+}
+
+
+const ColorStats& BandTask::getStats() const
+{
+   return stats_m;
+}
+
+
+void BandTask::fail
+(
+   const char* pMessage
+)
+{
+   MutexLock lock( pState_m->mutex );
+
+   // keep the first, not the cancellations it causes
+   if( !pState_m->pMessage )
+   {
+      pState_m->pMessage = pMessage;
+   }
+   pState_m->isFailed = true;
+}
+
+
+/**
+ * Run a task per band on the pool, and wait for them all.
+ */
+void runBands
+(
+   ImageState&            state,
+   std::vector<BandTask>& tasks,
+   const bool             isMapping
+)
+{
+   WorkerPool& pool = getSharedPool();
+
+   for( udword t = 0;  t < tasks.size();  ++t )
+   {
+      tasks[t].set( state, t * BAND_ROWS, isMapping );
+      pool.submit( &tasks[t] );
+   }
+   for( udword t = tasks.size();  t-- > 0; )
+   {
+      state.finished.wait();
+   }
+
+   if( state.isFailed )
+   {
+      throw state.pMessage;
+   }
+}
+
+
+void makeState
+(
+   const float*      i_pColorSpace6,
+   const float*      i_pWhitePoint2,
+   const udword      i_options,
+   const float       i_strength01,
+   const ColorStats* i_pReference,
+   const udword      i_width,
+   const udword      i_height,
+   const udword      i_inFormatFlags,
+   const udword      i_inPixelStride,
+   const qword       i_inRowPitch,
+   const void*       i_pInPixels,
+   ImageState&       o_state
+)
+{
+   const ColorStats ZERO = { 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+
+   o_state.pColorSpace6   = i_pColorSpace6;
+   o_state.pWhitePoint2   = i_pWhitePoint2;
+   o_state.options        = i_options;
+   o_state.strength       = i_strength01;
+   o_state.pReference     = i_pReference;
+   o_state.width          = i_width;
+   o_state.height         = i_height;
+   o_state.inFormatFlags  = i_inFormatFlags;
+   o_state.inPixelStride  = i_inPixelStride;
+   o_state.inRowPitch     = i_inRowPitch;
+   o_state.pInPixels      = i_pInPixels;
+   o_state.outFormatFlags = 0;
+   o_state.outPixelStride = 0;
+   o_state.outRowPitch    = 0;
+   o_state.outAlpha       = 1.0f;
+   o_state.pOutPixels     = 0;
+   o_state.target         = ZERO;
+   o_state.isFailed       = false;
+   o_state.pMessage       = 0;
+}
+
+
+void sumBands
+(
+   ImageState&            state,
+   std::vector<BandTask>& tasks
+)
+{
+   runBands( state, tasks, false );
+
+   // pool stats, in band order (so result does not depend on timing)
+   for( udword t = 0;  t < tasks.size();  ++t )
+   {
+      poolStats( tasks[t].getStats(), state.target );
+   }
+}
+
+}
+
+
+
+
+// exported functions ----------------------------------------------------------
+void p3whitebalancer::colorStats
+(
+   const float* i_pColorSpace6,
+   const float* i_pWhitePoint2,
+   const udword i_options,
+   const udword i_width,
+   const udword i_height,
+   const udword i_inFormatFlags,
+   const udword i_inPixelStride,
+   const qword  i_inRowPitch,
+   const void*  i_pInPixels,
+   ColorStats&  o_stats
+)
+{
+   ImageState state;
+   makeState( i_pColorSpace6, i_pWhitePoint2, i_options, 1.0f, 0, i_width,
+      i_height, i_inFormatFlags, i_inPixelStride, i_inRowPitch, i_pInPixels,
+      state );
+
+   std::vector<BandTask> tasks( (i_height + BAND_ROWS - 1) / BAND_ROWS );
+   sumBands( state, tasks );
+
+   o_stats = state.target;
+}
+
+
+void p3whitebalancer::colorTransfer
+(
+   const float*      i_pColorSpace6,
+   const float*      i_pWhitePoint2,
+   const udword      i_options,
+   const float       i_strength01,
+   const ColorStats& i_reference,
+   const ColorStats* i_pTarget,
+   const udword      i_width,
+   const udword      i_height,
+   const udword      i_inFormatFlags,
+   const udword      i_inPixelStride,
+   const qword       i_inRowPitch,
+   const void*       i_pInPixels,
+   const udword      i_outFormatFlags,
+   const udword      i_outPixelStride,
+   const qword       i_outRowPitch,
+   const float       i_outAlpha,
+   void*             o_pOutPixels
+)
+{
+   ImageState state;
+   makeState( i_pColorSpace6, i_pWhitePoint2, i_options, i_strength01,
+      &i_reference, i_width, i_height, i_inFormatFlags, i_inPixelStride,
+      i_inRowPitch, i_pInPixels, state );
+   state.outFormatFlags = i_outFormatFlags;
+   state.outPixelStride = i_outPixelStride;
+   state.outRowPitch    = i_outRowPitch;
+   state.outAlpha       = i_outAlpha;
+   state.pOutPixels     = o_pOutPixels;
+
+   std::vector<BandTask> tasks( (i_height + BAND_ROWS - 1) / BAND_ROWS );
+
+   // stats of image, given or summed
+   if( i_pTarget )
+   {
+      state.target = *i_pTarget;
+   }
+   else
+   {
+      sumBands( state, tasks );
+   }
+
+   // map image
+   runBands( state, tasks, true );
+}
+
+
+void p3whitebalancer::writeStats
+(
+   const ColorStats& i_stats,
+   char*const        o_text
+)
+{
+   // (17 significant digits round-trip a double exactly)
+   std::ostringstream out;
+   out.precision( 17 );
+   out << STATS_TAG << ' ' << i_stats.count;
+   for( udword i = 0;  i < 3;  ++i )
+   {
+      out << ' ' << i_stats.mean[i];
+   }
+   for( udword i = 0;  i < 3;  ++i )
+   {
+      out << ' ' << i_stats.m2[i];
+   }
+
+   const std::string text( out.str() );
+   const std::string::size_type length = text.copy( o_text,
+      STATS_TEXT_LENGTH - 1 );
+   o_text[length] = 0;
+}
+
+
+void p3whitebalancer::readStats
+(
+   const char*const i_text,
+   ColorStats&      o_stats
+)
+{
+   std::istringstream in( i_text ? i_text : "" );
+
+   std::string tag;
+   ColorStats  stats;
+   in >> tag >> stats.count >> stats.mean[0] >> stats.mean[1] >>
+      stats.mean[2] >> stats.m2[0] >> stats.m2[1] >> stats.m2[2];
+
+   // must be tagged, complete, and followed by nothing but space
+   std::string rest;
+   if( (tag != STATS_TAG) || in.fail() || (in >> rest) ||
+      (stats.count < 0.0) || (stats.m2[0] < 0.0) || (stats.m2[1] < 0.0) ||
+      (stats.m2[2] < 0.0) )
+   {
+      throw TEXT_EXCEPTION_MESSAGE;
+   }
+
+   o_stats = stats;
+}
+
+
+
+
+
+
+
+
+/// test -----------------------------------------------------------------------
+#ifdef TESTING
+
+
+#include <math.h>
+#include <string.h>
+#include <ostream>
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+bool test_ColorTransfer
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   bool isOk = true;
+
+   if( pOut ) *pOut << "[ test_ColorTransfer ]\n\n";
+
+
+   // make two noisy images: a dull bluish target, a contrasty orange reference
+   // (target tall enough for several bands, and not a whole number of them)
+   const udword WIDTH   = 61;
+   const udword HEIGHTS[] = { 203, 37 };
+   std::vector<float> images[2];
+   {
+      udword r = seed ? static_cast<udword>(seed) : 521288629u;
+      for( udword k = 0;  k < 2;  ++k )
+      {
+         const float tint[2][3] = { { 0.7f, 0.8f, 1.1f },
+            { 1.4f, 1.0f, 0.5f } };
+         const float contrast = k ? 0.9f : 0.3f;
+
+         images[k].resize( WIDTH * HEIGHTS[k] * 3 );
+         for( udword i = 0;  i < images[k].size();  i += 3 )
+         {
+            r = 36969u * (r & 0xFFFFu) + (r >> 16);
+            const float level = 0.5f + (contrast * ((static_cast<float>(
+               r & 0xFFFFu) / 65536.0f) - 0.5f));
+            for( udword c = 0;  c < 3;  ++c )
+            {
+               r = 36969u * (r & 0xFFFFu) + (r >> 16);
+               images[k][i + c] = level * tint[k][c] * (0.9f +
+                  (0.2f * static_cast<float>(r & 0xFFFFu) / 65536.0f));
+            }
+         }
+         // (and a NaN and a black pixel, left out)
+         const udword NAN_BITS = 0x7FC00000u;
+         ::memcpy( &images[k][3 * 5], &NAN_BITS, sizeof(NAN_BITS) );
+         images[k][3 * 7 + 0] = images[k][3 * 7 + 1] = images[k][3 * 7 + 2] =
+            0.0f;
+      }
+   }
+
+   ColorStats stats[2];
+   for( udword k = 0;  k < 2;  ++k )
+   {
+      colorStats( 0, 0, 0, WIDTH, HEIGHTS[k], 0, 0, 0, &images[k][0],
+         stats[k] );
+   }
+
+   // banded stats match one pass over the whole, and repeat exactly
+   {
+      const ColorStats ZERO = { 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+      ColorStats whole = ZERO;
+      sumStats( 0, 0, 0, WIDTH, HEIGHTS[0], 0, 0, 0, &images[0][0], 0,
+         HEIGHTS[0], whole );
+      ColorStats again;
+      colorStats( 0, 0, 0, WIDTH, HEIGHTS[0], 0, 0, 0, &images[0][0],
+         again );
+
+      bool isOk_ = (whole.count == stats[0].count) &&
+         (static_cast<double>(WIDTH * HEIGHTS[0] - 2) == whole.count) &&
+         (0 == ::memcmp( &again, &stats[0], sizeof(ColorStats) ));
+      for( udword i = 0;  i < 3;  ++i )
+      {
+         isOk_ &= (::fabs( whole.mean[i] - stats[0].mean[i] ) < 1e-9) &&
+            (::fabs( whole.m2[i] - stats[0].m2[i] ) < (1e-9 * whole.m2[i]));
+      }
+
+      if( pOut && isVerbose ) *pOut << "count " << whole.count << "  mean " <<
+         whole.mean[0] << " " << whole.mean[1] << " " << whole.mean[2] <<
+         "\n\n";
+
+      if( pOut ) *pOut << "bands : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // transfer gives the target the reference's stats, and given target stats
+   // give the same result
+   {
+      std::vector<float> out( images[0].size() );
+      colorTransfer( 0, 0, 0, -1.0f, stats[1], 0, WIDTH, HEIGHTS[0], 0, 0, 0,
+         &images[0][0], 0, 0, 0, 1.0f, &out[0] );
+      std::vector<float> outGiven( images[0].size() );
+      colorTransfer( 0, 0, 0, -1.0f, stats[1], &stats[0], WIDTH, HEIGHTS[0],
+         0, 0, 0, &images[0][0], 0, 0, 0, 1.0f, &outGiven[0] );
+
+      ColorStats outStats;
+      colorStats( 0, 0, 0, WIDTH, HEIGHTS[0], 0, 0, 0, &out[0], outStats );
+
+      // (fast log and pow approximations limit the match)
+      bool isOk_ = (outStats.count == stats[0].count) &&
+         (0 == ::memcmp( &out[0], &outGiven[0], out.size() * sizeof(float) ))
+         && (0.0f == out[3 * 7]) &&
+         (0 == ::memcmp( &out[3 * 5], &images[0][3 * 5], sizeof(float) ));
+      for( udword i = 0;  i < 3;  ++i )
+      {
+         const double deviation[] = { ::sqrt( outStats.m2[i] /
+            outStats.count ), ::sqrt( stats[1].m2[i] / stats[1].count ) };
+         isOk_ &= (::fabs( outStats.mean[i] - stats[1].mean[i] ) < 2e-3) &&
+            (::fabs( (deviation[0] / deviation[1]) - 1.0 ) < 0.02);
+
+         if( pOut && isVerbose ) *pOut << "axis " << i << "  mean " <<
+            outStats.mean[i] << " / " << stats[1].mean[i] << "  deviation " <<
+            deviation[0] << " / " << deviation[1] << "\n";
+      }
+
+      if( pOut && isVerbose ) *pOut << "\n";
+
+      if( pOut ) *pOut << "transfer : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // zero strength leaves the image (nearly) as it was
+   {
+      std::vector<float> out( images[0].size() );
+      colorTransfer( 0, 0, 0, 0.0f, stats[1], &stats[0], WIDTH, HEIGHTS[0], 0,
+         0, 0, &images[0][0], 0, 0, 0, 1.0f, &out[0] );
+
+      float maxDif = 0.0f;
+      for( udword i = 0;  i < out.size();  ++i )
+      {
+         if( i / 3 != 5 )
+         {
+            const float dif = ::fabsf( out[i] - images[0][i] );
+            maxDif = dif > maxDif ? dif : maxDif;
+         }
+      }
+      const bool isOk_ = maxDif < 2e-3f;
+
+      if( pOut && isVerbose ) *pOut << "max dif: " << maxDif << "\n";
+
+      if( pOut ) *pOut << "zero strength : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // text round-trips exactly, and bad text is rejected
+   {
+      char text[ STATS_TEXT_LENGTH ];
+      writeStats( stats[1], text );
+      ColorStats read;
+      readStats( text, read );
+
+      bool isOk_ = (0 == ::memcmp( &read, &stats[1], sizeof(ColorStats) ));
+
+      if( pOut && isVerbose ) *pOut << text << "\n";
+
+      const char* BAD[] = { "", "p3wb-stats-1 1 2 3",
+         "p3wb-stats-2 1 0 0 0 0 0 0", "p3wb-stats-1 1 0 0 0 0 -1 0",
+         "p3wb-stats-1 1 0 0 0 0 0 0 x", 0 };
+      for( udword b = 0;  BAD[b];  ++b )
+      {
+         bool isThrown = false;
+         try
+         {
+            readStats( BAD[b], read );
+         }
+         catch( const char[] )
+         {
+            isThrown = true;
+         }
+         isOk_ &= isThrown;
+      }
+
+      if( pOut ) *pOut << "text : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // empty reference is rejected
+   {
+      const ColorStats ZERO = { 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+      std::vector<float> out( images[0].size() );
+
+      bool isOk_ = false;
+      try
+      {
+         colorTransfer( 0, 0, 0, -1.0f, ZERO, 0, WIDTH, HEIGHTS[0], 0, 0, 0,
+            &images[0][0], 0, 0, 0, 1.0f, &out[0] );
+      }
+      catch( const char[] )
+      {
+         isOk_ = true;
+      }
+
+      if( pOut ) *pOut << "empty reference : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+
+   if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
+      " completed " << "\n\n\n";
+
+   if( pOut ) pOut->flush();
+
+
+   return isOk;
+}
+
+
+}//namespace
+
+
+#endif//TESTING
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+
+   Perceptuum3 rendering components
+   Copyright (c) 2005-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef ColorTransfer_h
+#define ColorTransfer_h
+
+
+#include "Primitives.hpp"
+#include "WhiteBalancer.hpp"
+
+
+
+
+namespace p3whitebalancer
+{
+   using namespace hxa7241;
+
+
+/**
+ * Color stats of a whole image.<br/><br/>
+ *
+ * Bands of fixed height are summed concurrently, on the library's shared
+ * worker pool, then pooled in order -- so the result is the same however many
+ * threads there are.
+ *
+ * Parameters as sumStats, for the whole image, except:
+ * @o_stats  stats to write
+ *
+ * @throws exceptions
+ */
+void colorStats
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   udword       i_width,
+   udword       i_height,
+   udword       i_inFormatFlags,
+   udword       i_inPixelStride,
+   qword        i_inRowPitch,
+   const void*  i_pInPixels,
+   ColorStats&  o_stats
+);
+
+
+/**
+ * Transfer colors onto a whole image, from reference stats.<br/><br/>
+ *
+ * Two passes, each in bands on the shared pool: the image's stats, then the
+ * mapping. Or one pass, if the image's stats are given (kept from an earlier
+ * colorStats, say). Reference stats are only read, so one can serve any
+ * number of images.
+ *
+ * Parameters as transferColors, for the whole image, except:
+ * @i_pTarget  stats of the image being mapped (give 0 to compute them)
+ *
+ * @throws exceptions
+ */
+void colorTransfer
+(
+   const float*      i_colorSpace6,
+   const float*      i_whitePoint2,
+   unsigned int      i_options,
+   float             i_strength,
+   const ColorStats& i_reference,
+   const ColorStats* i_pTarget,
+   udword            i_width,
+   udword            i_height,
+   udword            i_inFormatFlags,
+   udword            i_inPixelStride,
+   qword             i_inRowPitch,
+   const void*       i_pInPixels,
+   udword            i_outFormatFlags,
+   udword            i_outPixelStride,
+   qword             i_outRowPitch,
+   float             i_outAlpha,
+   void*             o_pOutPixels
+);
+
+
+/**
+ * Length of color stats as text, including terminator, at most.
+ */
+const udword STATS_TEXT_LENGTH = 256;
+
+
+/**
+ * Write color stats as one line of text: a version tag, then the seven
+ * numbers, each with enough digits to read back exactly.
+ *
+ * @o_text  array of STATS_TEXT_LENGTH chars to write to
+ */
+void writeStats
+(
+   const ColorStats& i_stats,
+   char*             o_text
+);
+
+
+/**
+ * Read color stats from text made by writeStats.
+ *
+ * @throws exceptions, if the text is not valid stats
+ */
+void readStats
+(
+   const char* i_text,
+   ColorStats& o_stats
+);
+
+
+}
+
+
+
+
+#endif/*ColorTransfer_h*/
@@ -9,6 +9,8 @@
 
 
 #include <math.h>
+#include <string.h>
+#include <vector>
 
 #include "LogFast.hpp"
 #include "PowFast.hpp"
@@ -18,8 +20,10 @@
 #include "ColorConversion.hpp"
 #include "ImageWrapperConst.hpp"
 #include "ImageWrapper.hpp"
+#include "YCbCrWrapperConst.hpp"
+#include "YCbCrWrapper.hpp"
 
-#include "p3wbWhiteBalancer-v12.h"
+#include "p3wbWhiteBalancer-v13.h"
 
 #include "WhiteBalancer.hpp"
 
@@ -29,6 +33,12 @@ using namespace p3whitebalancer;
 
 
 
+// exported constants ----------------------------------------------------------
+const char p3whitebalancer::CANCELLED_MESSAGE[] = "cancelled";
+
+
+
+
 // implementation --------------------------------------------------------------
 namespace
 {
@@ -40,9 +50,25 @@ using namespace hxa7241_image;
 // constants -------------------------------------------------------------------
 const char EXCEPTION_MESSAGE[]           = "numerical failure";
 const char NAN_INPUT_EXCEPTION_MESSAGE[] = "NaN in input parameter";
+const char FORMAT_EXCEPTION_MESSAGE[]    = "unknown pixel format flags";
+const char WEIGHT_EXCEPTION_MESSAGE[]    = "negative weight";
+const char STATS_EXCEPTION_MESSAGE[]     = "invalid color stats";
+const char EMPTY_EXCEPTION_MESSAGE[]     = "empty reference color stats";
 
 const float FLAT_WHITE[] = { (1.0f / 3.0f), (1.0f / 3.0f) };
 
+// half-width of chroma histogram, in Ruderman (log10) units
+const float CHROMA_RANGE = 0.5f;
+
+// fraction left out at each end, for robust estimation (interquartile mean)
+const float ROBUST_TRIM = 0.25f;
+
+// robust estimation: weights become whole counts, about this on average
+const double ROBUST_WEIGHT_UNIT = 256.0;
+
+// color transfer: axes deviating less than this are shifted, not scaled
+const double DEVIATION_MIN = 1e-6;
+
 const Matrix3f CONE_TO_RUDERMAN(
    // 'Statistics of Cone Responses to Natural Images'
    // Ruderman, Cronin, Chiao;
@@ -393,6 +419,310 @@ Vector3f PixelMap::operator()
 }*/
 
 
+/**
+ * Color transfer of a pixel: an affine map of each Ruderman axis, made in
+ * cone-log space (no luminance restore, since luminance is mapped too).
+ */
+class PixelTransfer
+{
+/// standard object services ---------------------------------------------------
+public:
+            PixelTransfer( const Matrix3f& rgbToXyz,
+                           const Matrix3f& xyzToRgb,
+                           const Vector3f& scaleLab,
+                           const Vector3f& translationLab );
+// use defaults
+//           ~PixelTransfer();
+//            PixelTransfer( const PixelTransfer& );
+//   PixelTransfer& operator=( const PixelTransfer& );
+
+/// queries --------------------------------------------------------------------
+           Vector3f operator()( const Vector3f& rgb )                     const;
+
+/// fields ---------------------------------------------------------------------
+private:
+   Matrix3f rgbToCone_m;
+   Matrix3f coneToRgb_m;
+   Matrix3f rudermanAffine_m;
+};
+
+
+PixelTransfer::PixelTransfer
+(
+   const Matrix3f& rgbToXyz,
+   const Matrix3f& xyzToRgb,
+   const Vector3f& scaleLab,
+   const Vector3f& translationLab
+)
+ : rgbToCone_m( XYZ_TO_CONE * rgbToXyz )
+ , coneToRgb_m( xyzToRgb * CONE_TO_XYZ )
+ , rudermanAffine_m( RUDERMAN_TO_CONE *
+      Matrix3f( Matrix3f::TRANSLATE, translationLab ) *
+      Matrix3f( Matrix3f::SCALE, scaleLab ) * CONE_TO_RUDERMAN )
+{
+}
+
+
+Vector3f PixelTransfer::operator()
+(
+   const Vector3f& i_inPixelRgb
+) const
+{
+   // manually inlined implementation
+
+   // (retro-style inlining)
+   #define DOT(a,b) ((a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]))
+   #define MUL(m,v) { DOT(m.getRow0(), v), DOT(m.getRow1(), v),\
+      DOT(m.getRow2(), v) }
+
+   // convert to cone-log space
+   float lmsIn[] = MUL(rgbToCone_m, i_inPixelRgb);
+   lmsIn[0] = lmsIn[0] >= FLOAT_SMALL_48 ? lmsIn[0] : FLOAT_SMALL_48;
+   lmsIn[1] = lmsIn[1] >= FLOAT_SMALL_48 ? lmsIn[1] : FLOAT_SMALL_48;
+   lmsIn[2] = lmsIn[2] >= FLOAT_SMALL_48 ? lmsIn[2] : FLOAT_SMALL_48;
+   const float lmsLogIn[] = { LOGFAST.ten(lmsIn[0]), LOGFAST.ten(lmsIn[1]),
+      LOGFAST.ten(lmsIn[2]) };
+
+   // do scale and translation, in Ruderman space
+   float lmsLogOut[] = MUL(rudermanAffine_m, lmsLogIn);
+   lmsLogOut[0] += rudermanAffine_m.getCol3()[0];
+   lmsLogOut[1] += rudermanAffine_m.getCol3()[1];
+   lmsLogOut[2] += rudermanAffine_m.getCol3()[2];
+
+   // convert back from cone-log space
+   const float lmsOut[] = {POWFAST.ten(lmsLogOut[0]), POWFAST.ten(lmsLogOut[1]),
+      POWFAST.ten(lmsLogOut[2]) };
+   const float outRgb[] = MUL(coneToRgb_m, lmsOut);
+
+   return Vector3f( outRgb );
+
+   #undef MUL
+   #undef DOT
+}
+
+
+/**
+ * Adaptor of Ruderman::fromRgb, as a function object.
+ */
+class RudermanFromRgb
+{
+public:
+   explicit RudermanFromRgb( const Ruderman& ruderman )
+    : ruderman_m( ruderman )
+   {
+   }
+
+   Vector3f operator()( const Vector3f& rgb ) const
+   {
+      return ruderman_m.fromRgb( rgb );
+   }
+
+private:
+   RudermanFromRgb& operator=( const RudermanFromRgb& );
+
+   const Ruderman& ruderman_m;
+};
+
+
+/**
+ * Memoiser of a pixel function object (PixelMap, PixelTransfer, or
+ * RudermanFromRgb).<br/><br/>
+ *
+ * Images with flat areas or few distinct colors (UI screenshots, cartoon
+ * renders, 8-bit decodes) map the same pixels over and over. This keeps recent
+ * results in a small direct-mapped table, keyed by the exact input bits, so
+ * results are identical to unmemoised.<br/><br/>
+ *
+ * Hit rate is measured per window of lookups: if it falls too low to pay, the
+ * table is bypassed for a while, then probed again.
+ *
+ * @invariants
+ * * entries_m.size() == MEMO_SIZE
+ * * empty entries have NaN keys (which are never looked up)
+ */
+template<class MAPPING>
+class PixelMemo
+{
+/// standard object services ---------------------------------------------------
+public:
+            PixelMemo( const MAPPING& mapping,
+                       bool           isEnabled );
+// use defaults
+//           ~PixelMemo();
+private:
+            PixelMemo( const PixelMemo& );
+   PixelMemo& operator=( const PixelMemo& );
+public:
+
+/// commands -------------------------------------------------------------------
+           Vector3f operator()( const Vector3f& rgb );
+
+/// queries --------------------------------------------------------------------
+           udword   getLookupCount()                                      const;
+           udword   getHitCount()                                         const;
+           udword   getBypassCount()                                      const;
+
+/// implementation -------------------------------------------------------------
+protected:
+   static  udword   bitsOf( float );
+
+/// constants ------------------------------------------------------------------
+   // (4096 * 24 bytes = 96KB: stays in level-2 cache)
+   static const udword MEMO_SIZE_LOG2 = 12;
+   static const udword MEMO_SIZE      = 1u << MEMO_SIZE_LOG2;
+   static const udword WINDOW_SIZE    = 4096;
+   static const udword WINDOW_HITS    = WINDOW_SIZE / 4;
+   static const udword BYPASS_SIZE    = WINDOW_SIZE * 16;
+
+/// fields ---------------------------------------------------------------------
+private:
+   struct Entry
+   {
+      udword key[3];
+      float  value[3];
+   };
+
+   const MAPPING&     mapping_m;
+   std::vector<Entry> entries_m;
+   Entry*             pLast_m;
+
+   udword             windowLookups_m;
+   udword             windowHits_m;
+   udword             bypassRemaining_m;
+
+   // stats
+   udword             lookups_m;
+   udword             hits_m;
+   udword             bypasses_m;
+};
+
+
+template<class MAPPING>
+PixelMemo<MAPPING>::PixelMemo
+(
+   const MAPPING& mapping,
+   const bool     isEnabled
+)
+ : mapping_m        ( mapping )
+ , entries_m        ()
+ , pLast_m          ( 0 )
+ , windowLookups_m  ( 0 )
+ , windowHits_m     ( 0 )
+ , bypassRemaining_m( 0 )
+ , lookups_m        ( 0 )
+ , hits_m           ( 0 )
+ , bypasses_m       ( 0 )
+{
+   if( isEnabled )
+   {
+      const Entry EMPTY = { { udword(-1), udword(-1), udword(-1) },
+         { 0.0f, 0.0f, 0.0f } };
+      entries_m.assign( MEMO_SIZE, EMPTY );
+      pLast_m = &entries_m[0];
+   }
+}
+
+
+template<class MAPPING>
+Vector3f PixelMemo<MAPPING>::operator()
+(
+   const Vector3f& i_inPixelRgb
+)
+{
+   // disabled, or bypassing until next probe: map directly
+   if( entries_m.empty() | (0 != bypassRemaining_m) )
+   {
+      bypassRemaining_m -= (0 != bypassRemaining_m);
+      ++bypasses_m;
+      return mapping_m( i_inPixelRgb );
+   }
+
+   const udword key[] = { bitsOf( i_inPixelRgb[0] ), bitsOf( i_inPixelRgb[1] ),
+      bitsOf( i_inPixelRgb[2] ) };
+
+   // same as last pixel (common in flat areas), else hash exact bits
+   Entry* pEntry = pLast_m;
+   if( (pEntry->key[0] != key[0]) | (pEntry->key[1] != key[1]) |
+      (pEntry->key[2] != key[2]) )
+   {
+      udword hash = (key[0] * 0x9E3779B1u) ^ (key[1] * 0x85EBCA77u) ^
+         (key[2] * 0xC2B2AE3Du);
+      hash ^= hash >> 15;
+      pEntry = &entries_m[ (hash * 0x27D4EB2Fu) >> (32 - MEMO_SIZE_LOG2) ];
+      pLast_m = pEntry;
+   }
+   Entry& entry = *pEntry;
+
+   ++lookups_m;
+   ++windowLookups_m;
+
+   Vector3f outPixelRgb;
+   if( (entry.key[0] == key[0]) & (entry.key[1] == key[1]) &
+      (entry.key[2] == key[2]) )
+   {
+      ++hits_m;
+      ++windowHits_m;
+      outPixelRgb = Vector3f( entry.value );
+   }
+   else
+   {
+      outPixelRgb = mapping_m( i_inPixelRgb );
+
+      entry.key[0]   = key[0];
+      entry.key[1]   = key[1];
+      entry.key[2]   = key[2];
+      entry.value[0] = outPixelRgb[0];
+      entry.value[1] = outPixelRgb[1];
+      entry.value[2] = outPixelRgb[2];
+   }
+
+   // end of window: bypass if not paying
+   if( WINDOW_SIZE == windowLookups_m )
+   {
+      bypassRemaining_m = (windowHits_m < WINDOW_HITS) ? BYPASS_SIZE : 0;
+      windowLookups_m   = 0;
+      windowHits_m      = 0;
+   }
+
+   return outPixelRgb;
+}
+
+
+template<class MAPPING>
+udword PixelMemo<MAPPING>::getLookupCount() const
+{
+   return lookups_m;
+}
+
+
+template<class MAPPING>
+udword PixelMemo<MAPPING>::getHitCount() const
+{
+   return hits_m;
+}
+
+
+template<class MAPPING>
+udword PixelMemo<MAPPING>::getBypassCount() const
+{
+   return bypasses_m;
+}
+
+
+template<class MAPPING>
+udword PixelMemo<MAPPING>::bitsOf
+(
+   const float f
+)
+{
+   // (copied, not cast: the key must not be mis-optimised by aliasing)
+   udword bits;
+   ::memcpy( &bits, &f, sizeof(bits) );
+
+   return bits;
+}
+
+
 inline
 bool isNan
 (
@@ -463,200 +793,1147 @@ const float* checkForNans
 }
 
 
-void preconditionInputs
+inline
+float srgbEncode
 (
-   const float*& i_pColorSpace6,
-   const float*& i_pWhitePoint2,
-   const float*  i_pInIlluminant3,
-         float&  i_strength01
+   const float linear
 )
 {
-   // check for NaNs, or default to sRGB
-   i_pColorSpace6 = i_pColorSpace6 ?
-      checkForNans( i_pColorSpace6, 6 ) : color::getSrgbChromaticities();
-
-   // check for NaNs, or default to flat white
-   i_pWhitePoint2 = i_pWhitePoint2 ?
-      checkForNans( i_pWhitePoint2, 2 ) : FLAT_WHITE;
-
-   // check for NaNs
-   if( i_pInIlluminant3 )
-   {
-      checkForNans( i_pInIlluminant3, 3 );
-   }
-
-   // check for NaNs, or default to quite-strong
-   i_strength01 = (-1.0f != i_strength01) ?
-      *checkForNans( &i_strength01, 1 ) : 0.8f;
+   // IEC 61966-2-1 curve, (pow by fast approximation)
+   return (linear > 0.0031308f) ? (1.055f * POWFAST.two( LOGFAST.two(
+      linear ) * (1.0f / 2.4f) )) - 0.055f : linear * 12.92f;
 }
 
 
-Vector3f makeIlluminant
+inline
+float srgbDecode
 (
-   const float*             i_pInIlluminant3,
-   const ImageWrapperConst& i_image,
-   const Matrix3f&          i_rgbToXyz,
-   const Matrix3f&          i_xyzToRgb
+   const float encoded
 )
 {
-   Vector3f inIlluminant;
+   return (encoded > 0.04045f) ? POWFAST.two( LOGFAST.two( (encoded +
+      0.055f) * (1.0f / 1.055f) ) * 2.4f ) : encoded * (1.0f / 12.92f);
+}
 
-   const Ruderman ruderman( i_rgbToXyz, i_xyzToRgb );
 
-   // use supplied
-   if( i_pInIlluminant3 )
-   {
-      // get image mean energy
-      float mean = 0.0f;
-      {
-         // sum energy
-         float  sum   = 0.0f;
-         udword count = 0;
-         for( dword i = 0, end = i_image.getLength();  i < end;  ++i )
-         {
-            const Vector3f p( i_image.get( i ) );
+/**
+ * Sparse view of an image: every step-th pixel, across and down, starting at
+ * the first. For cheap estimation.
+ */
+template<class IMAGE>
+class ImageSampler
+{
+/// standard object services ---------------------------------------------------
+public:
+            ImageSampler( const IMAGE& image,
+                          udword       step );
+// use defaults
+//           ~ImageSampler();
+//            ImageSampler( const ImageSampler& );
+private:
+   ImageSampler& operator=( const ImageSampler& );
+public:
 
-            // disclude NaNs
-            if( !isNan( p ) )
-            {
-               sum += preconditionPixel( p ).average();
-               ++count;
-            }
-         }
+/// queries --------------------------------------------------------------------
+           dword    getWidth()                                            const;
+           dword    getHeight()                                           const;
+           Vector3f get( dword x,
+                         dword y )                                        const;
 
-         // mean energy
-         mean = sum / (count > 0 ? static_cast<float>(count) : 1.0f);
-      }
+/// fields ---------------------------------------------------------------------
+private:
+   const IMAGE& image_m;
+   dword        step_m;
+};
 
-      // normalise illuminant energy to image mean
-      const Vector3f a( Vector3f(i_pInIlluminant3).clampMin(Vector3f::ZERO()) );
-      const Vector3f b( a * (mean / (a.average() > 0.0f ? a.average() : 1.0f)));
 
-      // convert to Ruderman space
-      inIlluminant = ruderman.fromRgb( b );
-   }
-   // estimate
-   else
-   {
-      // use 'gray-world' method in Ruderman space
+template<class IMAGE>
+inline
+ImageSampler<IMAGE>::ImageSampler
+(
+   const IMAGE& image,
+   const udword step
+)
+ : image_m( image )
+ , step_m ( step > 1 ? static_cast<dword>(step) : 1 )
+{
+}
 
-      // sum pixels
-      Vector3f sum;
-      udword   count = 0;
-      for( dword i = 0, end = i_image.getLength();  i < end;  ++i )
-      {
-         const Vector3f p( i_image.get( i ) );
 
-         // disclude NaNs
-         if( !isNan( p ) )
-         {
-            sum += ruderman.fromRgb( preconditionPixel( p ) );
-            ++count;
-         }
-      }
+template<class IMAGE>
+inline
+dword ImageSampler<IMAGE>::getWidth() const
+{
+   return (image_m.getWidth() + step_m - 1) / step_m;
+}
 
-      // mean pixel
-      inIlluminant = sum / (count > 0 ? static_cast<float>(count) : 1.0f);
-   }
 
-   return inIlluminant;
+template<class IMAGE>
+inline
+dword ImageSampler<IMAGE>::getHeight() const
+{
+   return (image_m.getHeight() + step_m - 1) / step_m;
 }
 
 
-/*float getMaxMagnitude
+template<class IMAGE>
+inline
+Vector3f ImageSampler<IMAGE>::get
 (
-   const ImageWrapperConst& i_image
-)
+   const dword x,
+   const dword y
+) const
 {
-   float max = FLOAT_MIN_NEG;
-
-   // step through all pixels
-   for( dword i = i_image.getLength();  i-- > 0; )
-   {
-      const Vector3f p( i_image.get( i ) );
+   return image_m.get( x * step_m, y * step_m );
+}
 
-      // disclude NaNs
-      if( !isNan( p ) )
-      {
-         const float magnitude = preconditionPixel( p ).average();
-         max = (max >= magnitude) ? max : magnitude;
-      }
-   }
 
-   return max;
-}*/
+/**
+ * View of a band of rows of an image. For splitting an image into parts.
+ *
+ * (IMAGE is ImageWrapperConst, const or not, or ImageWrapper.)
+ */
+template<class IMAGE>
+class ImageBand
+{
+/// standard object services ---------------------------------------------------
+public:
+            ImageBand( IMAGE& image,
+                       udword top,
+                       udword rows );
+// use defaults
+//           ~ImageBand();
+//            ImageBand( const ImageBand& );
+private:
+   ImageBand& operator=( const ImageBand& );
+public:
 
-}
+/// commands -------------------------------------------------------------------
+           void     set( dword x,
+                         dword y,
+                         const Vector3f& );
 
+/// queries --------------------------------------------------------------------
+           dword    getWidth()                                            const;
+           dword    getHeight()                                           const;
+           Vector3f get( dword x,
+                         dword y )                                        const;
 
+/// fields ---------------------------------------------------------------------
+private:
+   IMAGE& image_m;
+   dword  top_m;
+   dword  rows_m;
+};
 
 
-// exported function -----------------------------------------------------------
-void p3whitebalancer::whiteBalance
+template<class IMAGE>
+inline
+ImageBand<IMAGE>::ImageBand
+(
+   IMAGE&       image,
+   const udword top,
+   const udword rows
+)
+ : image_m( image )
+ , top_m  ( 0 )
+ , rows_m ( 0 )
+{
+   // clamp to image
+   const udword height = static_cast<udword>(image.getHeight());
+   top_m  = static_cast<dword>( top < height ? top : height );
+   rows_m = static_cast<dword>( rows < (height - top_m) ? rows :
+      (height - top_m) );
+}
+
+
+template<class IMAGE>
+inline
+void ImageBand<IMAGE>::set
+(
+   const dword     x,
+   const dword     y,
+   const Vector3f& pixel
+)
+{
+   image_m.set( x, y + top_m, pixel );
+}
+
+
+template<class IMAGE>
+inline
+dword ImageBand<IMAGE>::getWidth() const
+{
+   return image_m.getWidth();
+}
+
+
+template<class IMAGE>
+inline
+dword ImageBand<IMAGE>::getHeight() const
+{
+   return rows_m;
+}
+
+
+template<class IMAGE>
+inline
+Vector3f ImageBand<IMAGE>::get
+(
+   const dword x,
+   const dword y
+) const
+{
+   return image_m.get( x, y + top_m );
+}
+
+
+
+
+/**
+ * (IMAGE is ImageWrapperConst or YCbCrWrapperConst.)
+ */
+template<class IMAGE>
+inline
+Vector3f readPixel
+(
+   const IMAGE& i_image,
+   const bool   i_isSrgb,
+   const dword  x,
+   const dword  y
+)
+{
+   const Vector3f p( i_image.get( x, y ) );
+
+   return !i_isSrgb ? p :
+      Vector3f( srgbDecode( p[0] ), srgbDecode( p[1] ), srgbDecode( p[2] ) );
+}
+
+
+/**
+ * (IMAGE is ImageWrapper or YCbCrWrapper.)
+ */
+template<class IMAGE>
+inline
+void writePixel
+(
+   IMAGE&          o_image,
+   const bool      i_isSrgb,
+   const dword     x,
+   const dword     y,
+   const Vector3f& i_pixel
+)
+{
+   o_image.set( x, y, !i_isSrgb ? i_pixel : Vector3f( srgbEncode( i_pixel[0] ),
+      srgbEncode( i_pixel[1] ), srgbEncode( i_pixel[2] ) ) );
+}
+
+
+/**
+ * Interpret p3wb11EPixelOptions and p3wb13EPixelOptions flags.
+ */
+void readFormatFlags
+(
+   const udword                      i_flags,
+   ImageWrapperConst::EChannelOrder& o_channelOrder,
+   ImageWrapperConst::EChannelType&  o_channelType,
+   bool&                             o_hasAlpha,
+   bool&                             o_isSrgb
+)
+{
+   if( 0 != (i_flags & ~static_cast<udword>(p3wb11_BGR | p3wb13_ALPHA |
+      p3wb13_UBYTE | p3wb13_SRGB)) )
+   {
+      throw FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   o_channelOrder = (i_flags & p3wb11_BGR) ?
+      ImageWrapperConst::BGR_e : ImageWrapperConst::RGB_e;
+   o_channelType  = (i_flags & p3wb13_UBYTE) ?
+      ImageWrapperConst::UBYTE_e : ImageWrapperConst::FLOAT_e;
+   o_hasAlpha     = 0 != (i_flags & p3wb13_ALPHA);
+   o_isSrgb       = 0 != (i_flags & p3wb13_SRGB);
+}
+
+
+/**
+ * Interpret p3wb13EYCbCrOptions flags.
+ */
+void readYCbCrFlags
+(
+   const udword                     i_flags,
+   YCbCrWrapperConst::ESubsampling& o_subsampling,
+   YCbCrWrapperConst::EMatrix&      o_matrix,
+   bool&                            o_isFullRange
+)
+{
+   const udword subsampling = i_flags & p3wb13_YCC_SUBSAMPLING;
+   if( (0 != (i_flags & ~static_cast<udword>(p3wb13_YCC_SUBSAMPLING |
+      p3wb13_YCC_BT601 | p3wb13_YCC_FULL_RANGE))) ||
+      (subsampling > p3wb13_YCC_444) )
+   {
+      throw FORMAT_EXCEPTION_MESSAGE;
+   }
+
+   o_subsampling = (p3wb13_YCC_420 == subsampling) ?
+      YCbCrWrapperConst::S420_e : ((p3wb13_YCC_422 == subsampling) ?
+      YCbCrWrapperConst::S422_e : YCbCrWrapperConst::S444_e);
+   o_matrix      = (i_flags & p3wb13_YCC_BT601) ?
+      YCbCrWrapperConst::BT601_e : YCbCrWrapperConst::BT709_e;
+   o_isFullRange = 0 != (i_flags & p3wb13_YCC_FULL_RANGE);
+}
+
+
+inline
+void pollCancel
+(
+   const volatile bool* i_pIsCancelled
+)
+{
+   if( i_pIsCancelled && *i_pIsCancelled )
+   {
+      throw p3whitebalancer::CANCELLED_MESSAGE;
+   }
+}
+
+
+template<class IMAGE>
+inline
+float getWeight
+(
+   const float* i_pWeights,
+   const IMAGE& i_image,
+   const dword  x,
+   const dword  y
+)
+{
+   return i_pWeights ? i_pWeights[ (static_cast<qword>(y) *
+      i_image.getWidth()) + x ] : 1.0f;
+}
+
+
+inline
+double getWeightSum
+(
+   const bool   i_isWeighted,
+   const qword  i_count,
+   const double i_weight
+)
+{
+   // (unweighted count is exact, beyond float integer range)
+   const double sum = i_isWeighted ? i_weight : static_cast<double>(i_count);
+
+   return sum > 0.0 ? sum : 1.0;
+}
+
+
+void preconditionInputs
+(
+   const float*& i_pColorSpace6,
+   const float*& i_pWhitePoint2,
+   const float*  i_pInIlluminant3,
+         float&  i_strength01
+)
+{
+   // check for NaNs, or default to sRGB
+   i_pColorSpace6 = i_pColorSpace6 ?
+      checkForNans( i_pColorSpace6, 6 ) : color::getSrgbChromaticities();
+
+   // check for NaNs, or default to flat white
+   i_pWhitePoint2 = i_pWhitePoint2 ?
+      checkForNans( i_pWhitePoint2, 2 ) : FLAT_WHITE;
+
+   // check for NaNs
+   if( i_pInIlluminant3 )
+   {
+      checkForNans( i_pInIlluminant3, 3 );
+   }
+
+   // check for NaNs, or default to quite-strong
+   i_strength01 = (-1.0f != i_strength01) ?
+      *checkForNans( &i_strength01, 1 ) : 0.8f;
+}
+
+
+/**
+ * Precondition inputs, and make the color conversion, for summing.
+ */
+Ruderman makeRuderman
 (
    const float* i_pColorSpace6,
    const float* i_pWhitePoint2,
-   const float* i_pInIlluminant3,
-   const udword ,//i_options,
-         float  i_strength01,
-   const udword i_width,
-   const udword i_height,
-   const udword i_formatFlags,
-   const udword i_pixelStride,
-   const float* i_pInPixels,
-   float*       o_pOutPixels
+   const float* i_pInIlluminant3
+)
+{
+   // precondition (strength unused)
+   const float* pColorSpace6 = i_pColorSpace6;
+   const float* pWhitePoint2 = i_pWhitePoint2;
+   float        strength01   = -1.0f;
+   preconditionInputs( pColorSpace6, pWhitePoint2, i_pInIlluminant3,
+      strength01 );
+
+   // make rgb <-> xyz color conversion (and check primaries)
+   Matrix3f rgbToXyz;
+   Matrix3f xyzToRgb;
+   color::makeColorSpaceConversions( pColorSpace6, pWhitePoint2, &xyzToRgb,
+      &rgbToXyz );
+
+   return Ruderman( rgbToXyz, xyzToRgb );
+}
+
+
+/**
+ * Add image to an illuminant sum: energy if illuminant supplied, else Ruderman
+ * pixels, for 'gray-world' estimation (and, if robust, into the sketches too).
+ */
+template<class IMAGE>
+void addIlluminant
+(
+   const float*         i_pInIlluminant3,
+   const IMAGE&         i_image,
+   const bool           i_isSrgb,
+   const Ruderman&      i_ruderman,
+   const float*         i_pWeights,
+   const bool           i_isMemo,
+   const bool           i_isRobust,
+   const volatile bool* i_pIsCancelled,
+   IlluminantSum&       io_sum
+)
+{
+   // (each row is summed in float, then rows are summed in double -- so
+   // gigapixel images lose no precision, and the inner loop stays float)
+   double sum[3] = { 0.0, 0.0, 0.0 };
+   double weight = 0.0;
+   qword  count  = 0;
+
+   // use supplied
+   if( i_pInIlluminant3 )
+   {
+      // sum energy
+      for( dword y = 0, height = i_image.getHeight();  y < height;  ++y )
+      {
+         pollCancel( i_pIsCancelled );
+
+         float rowEnergy = 0.0f;
+         float rowWeight = 0.0f;
+         for( dword x = 0, width = i_image.getWidth();  x < width;  ++x )
+         {
+            const Vector3f p( readPixel( i_image, i_isSrgb, x, y ) );
+
+            // disclude NaNs
+            if( !isNan( p ) )
+            {
+               const float w = getWeight( i_pWeights, i_image, x, y );
+               rowEnergy += preconditionPixel( p ).average() * w;
+               rowWeight += w;
+               ++count;
+            }
+         }
+         sum[0] += rowEnergy;
+         weight += rowWeight;
+      }
+   }
+   // estimate
+   else
+   {
+      // use 'gray-world' method in Ruderman space
+      const RudermanFromRgb fromRgb( i_ruderman );
+      PixelMemo<RudermanFromRgb> fromRgbMemo( fromRgb, i_isMemo );
+
+      // robust: scale weights to whole counts (sketches count in integers)
+      double weightScale = 1.0;
+      if( i_isRobust && i_pWeights )
+      {
+         const qword length = static_cast<qword>(i_image.getWidth()) *
+            i_image.getHeight();
+         double total = 0.0;
+         for( qword i = length;  i-- > 0; )
+         {
+            total += i_pWeights[i];
+         }
+         weightScale = (total > 0.0) ? (ROBUST_WEIGHT_UNIT *
+            static_cast<double>(length) / total) : 1.0;
+      }
+
+      // sum pixels
+      for( dword y = 0, height = i_image.getHeight();  y < height;  ++y )
+      {
+         pollCancel( i_pIsCancelled );
+
+         Vector3f rowSum;
+         float    rowWeight = 0.0f;
+         for( dword x = 0, width = i_image.getWidth();  x < width;  ++x )
+         {
+            const Vector3f p( readPixel( i_image, i_isSrgb, x, y ) );
+
+            // disclude NaNs
+            if( !isNan( p ) )
+            {
+               const float    w = getWeight( i_pWeights, i_image, x, y );
+               const Vector3f r( fromRgbMemo( preconditionPixel( p ) ) );
+               rowSum    += r * w;
+               rowWeight += w;
+               ++count;
+
+               if( i_isRobust )
+               {
+                  const uqword units = i_pWeights ? static_cast<uqword>(
+                     (static_cast<double>(w) * weightScale) + 0.5 ) : 1u;
+                  io_sum.axes[0].add( r[0], units );
+                  io_sum.axes[1].add( r[1], units );
+                  io_sum.axes[2].add( r[2], units );
+               }
+            }
+         }
+         sum[0] += rowSum[0];
+         sum[1] += rowSum[1];
+         sum[2] += rowSum[2];
+         weight += rowWeight;
+      }
+   }
+
+   io_sum.sum[0] += sum[0];
+   io_sum.sum[1] += sum[1];
+   io_sum.sum[2] += sum[2];
+   io_sum.weight += weight;
+   io_sum.count  += count;
+}
+
+
+/**
+ * Add image to a histogram of chroma: Ruderman alpha and beta, each clamped to
+ * +-CHROMA_RANGE, in CHROMA_BINS bins.
+ */
+template<class IMAGE>
+void addChromas
+(
+   const IMAGE&    i_image,
+   const bool      i_isSrgb,
+   const Ruderman& i_ruderman,
+   float*          io_pHistogram
+)
+{
+   const float scale = static_cast<float>(CHROMA_BINS) / (2.0f * CHROMA_RANGE);
+   const dword top   = static_cast<dword>(CHROMA_BINS) - 1;
+
+   for( dword y = 0, height = i_image.getHeight();  y < height;  ++y )
+   {
+      for( dword x = 0, width = i_image.getWidth();  x < width;  ++x )
+      {
+         const Vector3f p( readPixel( i_image, i_isSrgb, x, y ) );
+
+         // disclude NaNs
+         if( !isNan( p ) )
+         {
+            const Vector3f r( i_ruderman.fromRgb( preconditionPixel( p ) ) );
+
+            dword a = static_cast<dword>( (r[1] + CHROMA_RANGE) * scale );
+            dword b = static_cast<dword>( (r[2] + CHROMA_RANGE) * scale );
+            a = a < 0 ? 0 : (a > top ? top : a);
+            b = b < 0 ? 0 : (b > top ? top : b);
+
+            io_pHistogram[ (b * CHROMA_BINS) + a ] += 1.0f;
+         }
+      }
+   }
+}
+
+
+/**
+ * Add image to color stats: Ruderman pixels, by Welford's method (a running
+ * mean, and sum of squared deviations from it -- so no cancellation, as with
+ * plain sums of squares).
+ */
+template<class IMAGE>
+void addStats
+(
+   const IMAGE&         i_image,
+   const bool           i_isSrgb,
+   const Ruderman&      i_ruderman,
+   const bool           i_isMemo,
+   const volatile bool* i_pIsCancelled,
+   ColorStats&          io_stats
+)
+{
+   const RudermanFromRgb fromRgb( i_ruderman );
+   PixelMemo<RudermanFromRgb> fromRgbMemo( fromRgb, i_isMemo );
+
+   ColorStats stats = { 0.0, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+
+   for( dword y = 0, height = i_image.getHeight();  y < height;  ++y )
+   {
+      pollCancel( i_pIsCancelled );
+
+      for( dword x = 0, width = i_image.getWidth();  x < width;  ++x )
+      {
+         const Vector3f p( readPixel( i_image, i_isSrgb, x, y ) );
+
+         // disclude NaNs, and black
+         if( !isNan( p ) )
+         {
+            const Vector3f c( preconditionPixel( p ) );
+            if( c.sum() > 0.0f )
+            {
+               const Vector3f r( fromRgbMemo( c ) );
+
+               stats.count += 1.0;
+               const double countReciprocal = 1.0 / stats.count;
+               for( udword i = 0;  i < 3;  ++i )
+               {
+                  const double v = static_cast<double>( r[i] );
+                  const double d = v - stats.mean[i];
+                  stats.mean[i] += d * countReciprocal;
+                  stats.m2[i]   += d * (v - stats.mean[i]);
+               }
+            }
+         }
+      }
+   }
+
+   poolStats( stats, io_stats );
+}
+
+
+/**
+ * Check color stats: no NaNs, nothing negative.
+ */
+void checkStats
+(
+   const ColorStats& i_stats
+)
+{
+   bool isBad = isNan( static_cast<float>(i_stats.count) ) |
+      (i_stats.count < 0.0);
+   for( udword i = 3;  i-- > 0; )
+   {
+      isBad |= isNan( static_cast<float>(i_stats.mean[i]) ) |
+         isNan( static_cast<float>(i_stats.m2[i]) ) | (i_stats.m2[i] < 0.0);
+   }
+
+   if( isBad )
+   {
+      throw STATS_EXCEPTION_MESSAGE;
+   }
+}
+
+
+double getDeviation
+(
+   const ColorStats& i_stats,
+   const udword      i_axis
+)
+{
+   return (i_stats.count > 0.0) ? ::sqrt( i_stats.m2[i_axis] /
+      i_stats.count ) : 0.0;
+}
+
+
+Vector3f makeIlluminant
+(
+   const float*         i_pInIlluminant3,
+   const Ruderman&      i_ruderman,
+   const IlluminantSum& i_sum,
+   const bool           i_isWeighted
+)
+{
+   const double weightSum = getWeightSum( i_isWeighted, i_sum.count,
+      i_sum.weight );
+
+   Vector3f inIlluminant;
+
+   // use supplied
+   if( i_pInIlluminant3 )
+   {
+      // mean energy
+      const float mean = static_cast<float>( i_sum.sum[0] / weightSum );
+
+      // normalise illuminant energy to image mean
+      const Vector3f a( Vector3f(i_pInIlluminant3).clampMin(Vector3f::ZERO()) );
+      const Vector3f b( a * (mean / (a.average() > 0.0f ? a.average() : 1.0f)));
+
+      // convert to Ruderman space
+      inIlluminant = i_ruderman.fromRgb( b );
+   }
+   // estimate
+   else
+   {
+      // mean pixel (or robust mean)
+      double mean[3];
+      getIlluminantMean( i_sum, i_isWeighted, mean );
+      inIlluminant.set( static_cast<float>( mean[0] ),
+         static_cast<float>( mean[1] ), static_cast<float>( mean[2] ) );
+   }
+
+   return inIlluminant;
+}
+
+
+/*float getMaxMagnitude
+(
+   const ImageWrapperConst& i_image
+)
+{
+   float max = FLOAT_MIN_NEG;
+
+   // step through all pixels
+   for( qword i = i_image.getLength();  i-- > 0; )
+   {
+      const Vector3f p( i_image.get( i ) );
+
+      // disclude NaNs
+      if( !isNan( p ) )
+      {
+         const float magnitude = preconditionPixel( p ).average();
+         max = (max >= magnitude) ? max : magnitude;
+      }
+   }
+
+   return max;
+}*/
+
+/**
+ * Balance wrapped images, optionally with per-pixel weights for estimation.
+ *
+ * (IMAGE_IN/IMAGE_OUT are ImageWrapperConst/ImageWrapper, or
+ * YCbCrWrapperConst/YCbCrWrapper.)
+ */
+template<class IMAGE_IN, class IMAGE_OUT>
+void balanceImage
+(
+   const float*         i_pColorSpace6,
+   const float*         i_pWhitePoint2,
+   const float*         i_pInIlluminant3,
+   const udword         i_options,
+   float                i_strength01,
+   const IMAGE_IN&      i_inImage,
+   const bool           i_inIsSrgb,
+   const float*         i_pWeights,
+   IMAGE_OUT&           o_outImage,
+   const bool           i_outIsSrgb,
+   const volatile bool* i_pIsCancelled,
+   const IlluminantSum* i_pPooledSum
 )
 {
    // precondition
    preconditionInputs( i_pColorSpace6, i_pWhitePoint2, i_pInIlluminant3,
       i_strength01 );
 
-   // wrap (and check) images
-   const ImageWrapperConst::EChannelOrder channelOrder =
-      (p3wb11_BGR == i_formatFlags) ?
-      ImageWrapperConst::BGR_e : ImageWrapperConst::RGB_e;
-   const ImageWrapperConst inImage( i_width, i_height, channelOrder,
-      i_pixelStride, i_pInPixels );
-   ImageWrapper outImage( i_width, i_height, channelOrder, i_pixelStride,
-      o_pOutPixels );
-
    // make rgb <-> xyz color conversion (and check primaries)
    Matrix3f rgbToXyz;
    Matrix3f xyzToRgb;
    color::makeColorSpaceConversions( i_pColorSpace6, i_pWhitePoint2,
       &xyzToRgb, &rgbToXyz );
 
-   // make illuminant (and check in-illuminant)
-   const Vector3f inIlluminantLab( makeIlluminant( i_pInIlluminant3, inImage,
-      rgbToXyz, xyzToRgb ) );
+   // memoise repeated colors, unless switched off
+   const bool isMemo = !(i_options & p3wb13_NO_MEMO);
+   const bool isRobust = 0 != (i_options & p3wb13_ROBUST);
+
+   // make illuminant (and check in-illuminant), from this image or pooled
+   const Ruderman ruderman( rgbToXyz, xyzToRgb );
+   IlluminantSum  sum = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+   if( !i_pPooledSum )
+   {
+      addIlluminant( i_pInIlluminant3, i_inImage, i_inIsSrgb, ruderman,
+         i_pWeights, isMemo, isRobust, i_pIsCancelled, sum );
+   }
+   const Vector3f inIlluminantLab( makeIlluminant( i_pInIlluminant3, ruderman,
+      (i_pPooledSum ? *i_pPooledSum : sum), (0 != i_pWeights) ) );
+
+   //const float maxMagnitude = getMaxMagnitude( i_inImage );
+
+   // map image
+   {
+      // make mapping
+      const PixelMap pixelMap( rgbToXyz, xyzToRgb, inIlluminantLab,
+         i_strength01 );
+      PixelMemo<PixelMap> pixelMemo( pixelMap, isMemo );
+
+      // step through pixels
+      for( dword y = 0, height = o_outImage.getHeight();  y < height;  ++y )
+      {
+         pollCancel( i_pIsCancelled );
+
+         for( dword x = 0, width = o_outImage.getWidth();  x < width;  ++x )
+         {
+            const Vector3f p( readPixel( i_inImage, i_inIsSrgb, x, y ) );
+
+            // disclude NaNs
+            if( !isNan( p ) )
+            {
+               // map pixel, (and encode, in the same pass)
+               writePixel( o_outImage, i_outIsSrgb, x, y, postconditionPixel(
+                  pixelMemo( preconditionPixel( p ) ) ) );
+            }
+            else
+            {
+               // pass through unchanged
+               writePixel( o_outImage, i_outIsSrgb, x, y, p );
+            }
+         }
+      }
+   }
+}
+
+}
+
+
+
+
+// exported function -----------------------------------------------------------
+void p3whitebalancer::whiteBalance
+(
+   const float* i_pColorSpace6,
+   const float* i_pWhitePoint2,
+   const float* i_pInIlluminant3,
+   const udword i_options,
+   const float  i_strength01,
+   const udword i_width,
+   const udword i_height,
+   const udword i_inFormatFlags,
+   const udword i_inPixelStride,
+   const qword  i_inRowPitch,
+   const void*  i_pInPixels,
+   const udword i_outFormatFlags,
+   const udword i_outPixelStride,
+   const qword  i_outRowPitch,
+   const float  i_outAlpha,
+   void*        o_pOutPixels,
+   const volatile bool* i_pIsCancelled,
+   const IlluminantSum* i_pPooledSum
+)
+{
+   // wrap (and check) images
+   ImageWrapperConst::EChannelOrder inOrder,  outOrder;
+   ImageWrapperConst::EChannelType  inType,   outType;
+   bool                             inAlpha,  outAlpha;
+   bool                             inIsSrgb, outIsSrgb;
+   readFormatFlags( i_inFormatFlags,  inOrder,  inType,  inAlpha,  inIsSrgb );
+   readFormatFlags( i_outFormatFlags, outOrder, outType, outAlpha, outIsSrgb );
+
+   const ImageWrapperConst inImage( i_width, i_height, inOrder, inType,
+      inAlpha, i_inPixelStride, i_inRowPitch, i_pInPixels );
+   ImageWrapper outImage( i_width, i_height, outOrder, outType, outAlpha,
+      i_outAlpha, i_outPixelStride, i_outRowPitch, o_pOutPixels );
+
+   balanceImage( i_pColorSpace6, i_pWhitePoint2, i_pInIlluminant3, i_options,
+      i_strength01, inImage, inIsSrgb, 0, outImage, outIsSrgb,
+      i_pIsCancelled, i_pPooledSum );
+}
+
+
+void p3whitebalancer::sumIlluminant
+(
+   const float*   i_pColorSpace6,
+   const float*   i_pWhitePoint2,
+   const float*   i_pInIlluminant3,
+   const udword   i_options,
+   const udword   i_width,
+   const udword   i_height,
+   const udword   i_inFormatFlags,
+   const udword   i_inPixelStride,
+   const qword    i_inRowPitch,
+   const void*    i_pInPixels,
+   IlluminantSum& io_sum,
+   const volatile bool* i_pIsCancelled
+)
+{
+   // wrap (and check) image
+   ImageWrapperConst::EChannelOrder inOrder;
+   ImageWrapperConst::EChannelType  inType;
+   bool                             inAlpha;
+   bool                             inIsSrgb;
+   readFormatFlags( i_inFormatFlags, inOrder, inType, inAlpha, inIsSrgb );
+
+   const ImageWrapperConst inImage( i_width, i_height, inOrder, inType,
+      inAlpha, i_inPixelStride, i_inRowPitch, i_pInPixels );
+
+   addIlluminant( i_pInIlluminant3, inImage, inIsSrgb, makeRuderman(
+      i_pColorSpace6, i_pWhitePoint2, i_pInIlluminant3 ), 0,
+      !(i_options & p3wb13_NO_MEMO), 0 != (i_options & p3wb13_ROBUST),
+      i_pIsCancelled, io_sum );
+}
+
+
+void p3whitebalancer::sampleIlluminant
+(
+   const float*   i_pColorSpace6,
+   const float*   i_pWhitePoint2,
+   const udword   i_options,
+   const udword   i_width,
+   const udword   i_height,
+   const udword   i_inFormatFlags,
+   const udword   i_inPixelStride,
+   const qword    i_inRowPitch,
+   const void*    i_pInPixels,
+   const udword   i_step,
+   IlluminantSum& io_sum,
+   float*         io_pChromaHistogram
+)
+{
+   // wrap (and check) image
+   ImageWrapperConst::EChannelOrder inOrder;
+   ImageWrapperConst::EChannelType  inType;
+   bool                             inAlpha;
+   bool                             inIsSrgb;
+   readFormatFlags( i_inFormatFlags, inOrder, inType, inAlpha, inIsSrgb );
+
+   const ImageWrapperConst inImage( i_width, i_height, inOrder, inType,
+      inAlpha, i_inPixelStride, i_inRowPitch, i_pInPixels );
+   const ImageSampler<ImageWrapperConst> samples( inImage, i_step );
+
+   const Ruderman ruderman( makeRuderman( i_pColorSpace6, i_pWhitePoint2,
+      0 ) );
+
+   addIlluminant( 0, samples, inIsSrgb, ruderman, 0,
+      !(i_options & p3wb13_NO_MEMO), 0 != (i_options & p3wb13_ROBUST), 0,
+      io_sum );
+
+   if( io_pChromaHistogram )
+   {
+      addChromas( samples, inIsSrgb, ruderman, io_pChromaHistogram );
+   }
+}
+
+
+void p3whitebalancer::poolIlluminant
+(
+   const IlluminantSum& i_sum,
+   IlluminantSum&       io_sum
+)
+{
+   for( udword i = 3;  i-- > 0; )
+   {
+      io_sum.sum[i] += i_sum.sum[i];
+
+      if( 0 != i_sum.axes[i].getWeight() )
+      {
+         io_sum.axes[i].merge( i_sum.axes[i] );
+      }
+   }
+   io_sum.weight += i_sum.weight;
+   io_sum.count  += i_sum.count;
+}
+
+
+void p3whitebalancer::getIlluminantMean
+(
+   const IlluminantSum& i_sum,
+   const bool           i_isWeighted,
+   double*const         o_mean3
+)
+{
+   const double weightSum = getWeightSum( i_isWeighted, i_sum.count,
+      i_sum.weight );
+
+   for( udword i = 3;  i-- > 0; )
+   {
+      // robust: middle half only, so the tails (highlights) do not pull it
+      o_mean3[i] = (0 != i_sum.axes[i].getWeight()) ?
+         static_cast<double>( i_sum.axes[i].getTrimmedMean( ROBUST_TRIM ) ) :
+         (i_sum.sum[i] / weightSum);
+   }
+}
+
+
+void p3whitebalancer::sumStats
+(
+   const float* i_pColorSpace6,
+   const float* i_pWhitePoint2,
+   const udword i_options,
+   const udword i_width,
+   const udword i_height,
+   const udword i_inFormatFlags,
+   const udword i_inPixelStride,
+   const qword  i_inRowPitch,
+   const void*  i_pInPixels,
+   const udword i_top,
+   const udword i_rows,
+   ColorStats&  io_stats,
+   const volatile bool* i_pIsCancelled
+)
+{
+   // wrap (and check) image
+   ImageWrapperConst::EChannelOrder inOrder;
+   ImageWrapperConst::EChannelType  inType;
+   bool                             inAlpha;
+   bool                             inIsSrgb;
+   readFormatFlags( i_inFormatFlags, inOrder, inType, inAlpha, inIsSrgb );
+
+   const ImageWrapperConst inImage( i_width, i_height, inOrder, inType,
+      inAlpha, i_inPixelStride, i_inRowPitch, i_pInPixels );
+   const ImageBand<const ImageWrapperConst> inBand( inImage, i_top, i_rows );
+
+   addStats( inBand, inIsSrgb, makeRuderman( i_pColorSpace6, i_pWhitePoint2,
+      0 ), !(i_options & p3wb13_NO_MEMO), i_pIsCancelled, io_stats );
+}
+
+
+void p3whitebalancer::poolStats
+(
+   const ColorStats& i_stats,
+   ColorStats&       io_stats
+)
+{
+   if( i_stats.count > 0.0 )
+   {
+      // (Chan et al.: shift mean by weighted difference, and add the
+      // between-parts deviation to M2)
+      const double count = io_stats.count + i_stats.count;
+      const double part  = i_stats.count / count;
+      for( udword i = 3;  i-- > 0; )
+      {
+         const double d = i_stats.mean[i] - io_stats.mean[i];
+         io_stats.mean[i] += d * part;
+         io_stats.m2[i]   += i_stats.m2[i] + (d * d * io_stats.count * part);
+      }
+      io_stats.count = count;
+   }
+}
+
+
+void p3whitebalancer::transferColors
+(
+   const float*      i_pColorSpace6,
+   const float*      i_pWhitePoint2,
+   const udword      i_options,
+   const float       i_strength01,
+   const ColorStats& i_target,
+   const ColorStats& i_reference,
+   const udword      i_width,
+   const udword      i_height,
+   const udword      i_inFormatFlags,
+   const udword      i_inPixelStride,
+   const qword       i_inRowPitch,
+   const void*       i_pInPixels,
+   const udword      i_outFormatFlags,
+   const udword      i_outPixelStride,
+   const qword       i_outRowPitch,
+   const float       i_outAlpha,
+   void*             o_pOutPixels,
+   const udword      i_top,
+   const udword      i_rows,
+   const volatile bool* i_pIsCancelled
+)
+{
+   // wrap (and check) images
+   ImageWrapperConst::EChannelOrder inOrder,  outOrder;
+   ImageWrapperConst::EChannelType  inType,   outType;
+   bool                             inAlpha,  outAlpha;
+   bool                             inIsSrgb, outIsSrgb;
+   readFormatFlags( i_inFormatFlags,  inOrder,  inType,  inAlpha,  inIsSrgb );
+   readFormatFlags( i_outFormatFlags, outOrder, outType, outAlpha, outIsSrgb );
+
+   const ImageWrapperConst inImage( i_width, i_height, inOrder, inType,
+      inAlpha, i_inPixelStride, i_inRowPitch, i_pInPixels );
+   ImageWrapper outImage( i_width, i_height, outOrder, outType, outAlpha,
+      i_outAlpha, i_outPixelStride, i_outRowPitch, o_pOutPixels );
+   const ImageBand<const ImageWrapperConst> inBand( inImage, i_top, i_rows );
+   ImageBand<ImageWrapper> outBand( outImage, i_top, i_rows );
+
+   // precondition (default to full strength), and check stats
+   const float* pColorSpace6 = i_pColorSpace6;
+   const float* pWhitePoint2 = i_pWhitePoint2;
+   float        strength01   = (-1.0f != i_strength01) ? i_strength01 : 1.0f;
+   preconditionInputs( pColorSpace6, pWhitePoint2, 0, strength01 );
+   strength01 = strength01 >= 0.0f ? (strength01 <= 1.0f ? strength01 : 1.0f) :
+      0.0f;
+
+   checkStats( i_target );
+   checkStats( i_reference );
+   if( 0.0 == i_reference.count )
+   {
+      throw EMPTY_EXCEPTION_MESSAGE;
+   }
+
+   // make rgb <-> xyz color conversion (and check primaries)
+   Matrix3f rgbToXyz;
+   Matrix3f xyzToRgb;
+   color::makeColorSpaceConversions( pColorSpace6, pWhitePoint2, &xyzToRgb,
+      &rgbToXyz );
+
+   // make per-axis affine: (x - mean) * (deviation ratio) + reference mean,
+   // interpolated from identity by strength
+   float scale[3];
+   float translation[3];
+   for( udword i = 3;  i-- > 0; )
+   {
+      const double deviation = getDeviation( i_target, i );
+      const double ratio     = (deviation > DEVIATION_MIN) ?
+         (getDeviation( i_reference, i ) / deviation) : 1.0;
+
+      scale[i]       = static_cast<float>( 1.0 + (strength01 * (ratio -
+         1.0)) );
+      translation[i] = static_cast<float>( strength01 *
+         (i_reference.mean[i] - (ratio * i_target.mean[i])) );
+   }
 
-   //const float maxMagnitude = getMaxMagnitude( inImage );
+   // map band
+   const PixelTransfer pixelTransfer( rgbToXyz, xyzToRgb, Vector3f( scale ),
+      Vector3f( translation ) );
+   PixelMemo<PixelTransfer> pixelMemo( pixelTransfer,
+      !(i_options & p3wb13_NO_MEMO) );
 
-   // map image
+   for( dword y = 0, height = outBand.getHeight();  y < height;  ++y )
    {
-      // make mapping
-      const PixelMap pixelMap( rgbToXyz, xyzToRgb, inIlluminantLab,
-         i_strength01 );
+      pollCancel( i_pIsCancelled );
 
-      // step through pixels
-      for( dword i = 0, end = outImage.getLength();  i < end;  ++i )
+      for( dword x = 0, width = outBand.getWidth();  x < width;  ++x )
       {
-         const Vector3f p( inImage.get( i ) );
+         const Vector3f p( readPixel( inBand, inIsSrgb, x, y ) );
 
-         // disclude NaNs
+         // disclude NaNs, and black
          if( !isNan( p ) )
          {
-            // map pixel
-            outImage.set( i, postconditionPixel( pixelMap(
-               preconditionPixel( p ) ) ) );
+            const Vector3f c( preconditionPixel( p ) );
+
+            // map pixel, (and encode, in the same pass)
+            writePixel( outBand, outIsSrgb, x, y, (c.sum() > 0.0f) ?
+               postconditionPixel( pixelMemo( c ) ) : c );
          }
          else
          {
             // pass through unchanged
-            outImage.set( i, p );
+            writePixel( outBand, outIsSrgb, x, y, p );
+         }
+      }
+   }
+}
+
+
+void p3whitebalancer::whiteBalanceColors
+(
+   const float* i_pColorSpace6,
+   const float* i_pWhitePoint2,
+   const float* i_pInIlluminant3,
+   const udword i_options,
+   const float  i_strength01,
+   const udword i_count,
+   const float* i_pInColors,
+   const float* i_pWeights,
+   float*       o_pOutColors
+)
+{
+   // check weights: not NaN, not negative
+   if( i_pWeights )
+   {
+      checkForNans( i_pWeights, i_count );
+      for( udword i = i_count;  i-- > 0; )
+      {
+         if( i_pWeights[i] < 0.0f )
+         {
+            throw WEIGHT_EXCEPTION_MESSAGE;
          }
       }
    }
+
+   // wrap (and check) colors, as a one-row image
+   const ImageWrapperConst inImage( i_count, 1, ImageWrapperConst::RGB_e, 0, 0,
+      i_pInColors );
+   ImageWrapper outImage( i_count, 1, ImageWrapperConst::RGB_e, 0, 0,
+      o_pOutColors );
+
+   balanceImage( i_pColorSpace6, i_pWhitePoint2, i_pInIlluminant3, i_options,
+      i_strength01, inImage, false, i_pWeights, outImage, false, 0, 0 );
 }
 
 
@@ -664,13 +1941,59 @@ void p3whitebalancer::whiteBalance
 
 
 
+void p3whitebalancer::whiteBalanceYCbCr
+(
+   const float* i_pColorSpace6,
+   const float* i_pWhitePoint2,
+   const float* i_pInIlluminant3,
+   const udword i_options,
+   const float  i_strength01,
+   const udword i_width,
+   const udword i_height,
+   const udword i_ycbcrFlags,
+   const qword  i_lumaPitch,
+   const qword  i_chromaPitch,
+   const udword i_chromaStride,
+   const ubyte* i_pInLuma,
+   const ubyte* i_pInCb,
+   const ubyte* i_pInCr,
+   ubyte*       o_pOutLuma,
+   ubyte*       o_pOutCb,
+   ubyte*       o_pOutCr,
+   const volatile bool* i_pIsCancelled
+)
+{
+   // wrap (and check) planes
+   YCbCrWrapperConst::ESubsampling subsampling;
+   YCbCrWrapperConst::EMatrix      matrix;
+   bool                            isFullRange;
+   readYCbCrFlags( i_ycbcrFlags, subsampling, matrix, isFullRange );
+
+   const YCbCrWrapperConst inPlanes( i_width, i_height, subsampling, matrix,
+      isFullRange, i_lumaPitch, i_chromaPitch, i_chromaStride, i_pInLuma,
+      i_pInCb, i_pInCr );
+   YCbCrWrapper outPlanes( inPlanes, subsampling, matrix, isFullRange,
+      i_lumaPitch, i_chromaPitch, i_chromaStride, o_pOutLuma, o_pOutCb,
+      o_pOutCr );
+
+   // estimate and map per chroma sample, on nonlinear R'G'B' as sRGB-encoded
+   balanceImage( i_pColorSpace6, i_pWhitePoint2, i_pInIlluminant3, i_options,
+      i_strength01, inPlanes, true, 0, outPlanes, true, i_pIsCancelled, 0 );
+}
+
+
 
 
 /// test -----------------------------------------------------------------------
 #ifdef TESTING
 
 
+#include <math.h>
+#include <string.h>
 #include <ostream>
+#include <vector>
+
+#include "p3wbWhiteBalancer.hpp"
 
 
 namespace p3whitebalancer
@@ -681,8 +2004,8 @@ namespace p3whitebalancer
 bool test_WhiteBalancer
 (
    std::ostream* pOut,
-   const bool    ,//verbose,
-   const dword   //seed
+   const bool    isVerbose,
+   const dword   seed
 )
 {
    bool isOk = true;
@@ -690,8 +2013,701 @@ bool test_WhiteBalancer
    if( pOut ) *pOut << "[ test_WhiteBalancer ]\n\n";
 
 
-   if( pOut ) *pOut << "!!! not implemented yet\n\n";
-   //isOk = false;
+   // row pitch: a sub-rectangle of a larger buffer, in place
+   {
+      // buffer of padded pixels (4 floats), tinted noise
+      const dword BUFFER_WIDTH  = 41;
+      const dword BUFFER_HEIGHT = 29;
+      const dword STRIDE        = 4;
+      std::vector<float> buffer( BUFFER_WIDTH * BUFFER_HEIGHT * STRIDE );
+      {
+         udword r = seed ? static_cast<udword>(seed) : 362436069u;
+         for( udword i = 0;  i < buffer.size();  ++i )
+         {
+            r = 30903u * (r & 0xFFFFu) + (r >> 16);
+            buffer[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+               (1 == (i % STRIDE) ? 1.5f : 1.0f);
+         }
+      }
+      const std::vector<float> original( buffer );
+
+      // sub-rectangle
+      const dword X = 5;
+      const dword Y = 7;
+      const dword WIDTH  = 17;
+      const dword HEIGHT = 11;
+      const qword PITCH  = BUFFER_WIDTH * STRIDE * sizeof(float);
+      float*const pSub = &buffer[ ((Y * BUFFER_WIDTH) + X) * STRIDE ];
+
+      // packed copy, for reference
+      std::vector<float> packed( WIDTH * HEIGHT * 3 );
+      for( dword y = 0;  y < HEIGHT;  ++y )
+      {
+         for( dword x = 0;  x < WIDTH;  ++x )
+         {
+            for( dword c = 0;  c < 3;  ++c )
+            {
+               packed[ (((y * WIDTH) + x) * 3) + c ] =
+                  pSub[ (((y * BUFFER_WIDTH) + x) * STRIDE) + c ];
+            }
+         }
+      }
+      std::vector<float> bottomUp( packed.size() );
+
+      bool isOk_ = true;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &packed[0],
+            0, 0, 0, 1.0f, &packed[0] );
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+            0, STRIDE * sizeof(float), PITCH, pSub,
+            0, STRIDE * sizeof(float), PITCH, 1.0f, pSub );
+
+         // negative pitch: same packed rows, read last first
+         const qword ROW = WIDTH * 3 * sizeof(float);
+         std::vector<float> reversed( packed.size() );
+         for( dword y = 0;  y < HEIGHT;  ++y )
+         {
+            for( dword i = 0;  i < (WIDTH * 3);  ++i )
+            {
+               reversed[ (y * WIDTH * 3) + i ] = original[ ((((Y + HEIGHT -
+                  1 - y) * BUFFER_WIDTH) + X) * STRIDE) + ((i / 3) * STRIDE) +
+                  (i % 3) ];
+            }
+         }
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+            0, 0, -ROW, &reversed[(HEIGHT - 1) * WIDTH * 3],
+            0, 0, -ROW, 1.0f, &bottomUp[(HEIGHT - 1) * WIDTH * 3] );
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+
+      // inside matches packed, outside and padding untouched
+      float maxDif = 0.0f;
+      for( dword y = 0;  y < BUFFER_HEIGHT;  ++y )
+      {
+         for( dword x = 0;  x < BUFFER_WIDTH;  ++x )
+         {
+            const bool isInside = (x >= X) & (x < X + WIDTH) & (y >= Y) &
+               (y < Y + HEIGHT);
+            for( dword c = 0;  c < STRIDE;  ++c )
+            {
+               const dword i = (((y * BUFFER_WIDTH) + x) * STRIDE) + c;
+               if( isInside & (c < 3) )
+               {
+                  const dword p = ((((y - Y) * WIDTH) + (x - X)) * 3) + c;
+                  const dword b = ((((Y + HEIGHT - 1 - y) * WIDTH) +
+                     (x - X)) * 3) + c;
+                  isOk_ &= (packed[p] == buffer[i]);
+
+                  const float dif = ::fabsf( bottomUp[b] - packed[p] );
+                  maxDif = (maxDif >= dif) ? maxDif : dif;
+               }
+               else
+               {
+                  isOk_ &= (original[i] == buffer[i]);
+               }
+            }
+         }
+      }
+
+      // (negative pitch sums in a different order, so not bit-exact)
+      isOk_ &= (maxDif < 1e-4f);
+
+      if( pOut && isVerbose ) *pOut << "negative pitch max dif: " << maxDif <<
+         "\n";
+
+      if( pOut ) *pOut << "row pitch : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // row pitch too small is rejected
+   {
+      float pixels[ 4 * 3 ];
+      bool isOk_ = false;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, 2, 2, 0, 0, 12, pixels,
+            0, 0, 12, 1.0f, pixels );
+      }
+      catch( ... )
+      {
+         isOk_ = true;
+      }
+
+      if( pOut ) *pOut << "pitch check : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // output format: float RGB linear in, BGRA8 sRGB out, constant alpha
+   {
+      const dword WIDTH  = 23;
+      const dword HEIGHT = 13;
+      std::vector<float> image( WIDTH * HEIGHT * 3 );
+      {
+         udword r = seed ? static_cast<udword>(seed) : 521288629u;
+         for( udword i = 0;  i < image.size();  ++i )
+         {
+            r = 18000u * (r & 0xFFFFu) + (r >> 16);
+            image[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+               (2 == (i % 3) ? 0.6f : 1.0f);
+         }
+      }
+
+      std::vector<float> linear( image.size() );
+      std::vector<ubyte> bgra( WIDTH * HEIGHT * 4 );
+
+      bool isOk_ = true;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+            0, 0, 0, 1.0f, &linear[0] );
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+            p3wb11_BGR | p3wb13_ALPHA | p3wb13_UBYTE | p3wb13_SRGB, 0, 0,
+            0.5f, &bgra[0] );
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+
+      // compare with exact encode of float output: within 1 LSB
+      dword maxDif = 0;
+      for( dword i = 0;  i < (WIDTH * HEIGHT);  ++i )
+      {
+         for( dword c = 0;  c < 3;  ++c )
+         {
+            float v = linear[ (i * 3) + c ];
+            v = (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f;
+            v = (v <= 0.0031308f) ? (v * 12.92f) :
+               ((1.055f * ::powf( v, 1.0f / 2.4f )) - 0.055f);
+            const dword expected = static_cast<dword>( (v * 255.0f) + 0.5f );
+            const dword actual   = bgra[ (i * 4) + (2 - c) ];
+
+            const dword dif = (expected >= actual) ? expected - actual :
+               actual - expected;
+            maxDif = (maxDif >= dif) ? maxDif : dif;
+         }
+
+         isOk_ &= (128 == bgra[ (i * 4) + 3 ]);
+      }
+      isOk_ &= (maxDif <= 1);
+
+      if( pOut && isVerbose ) *pOut << "sRGB encode max dif: " << maxDif <<
+         "\n";
+
+      if( pOut ) *pOut << "output format : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // memo: results same as unmemoised, hits on few colors, bypasses on noise
+   {
+      // top half few colors (flat bands), bottom half noise
+      const dword WIDTH  = 256;
+      const dword HEIGHT = 64;
+      std::vector<float> image( WIDTH * HEIGHT * 3 );
+      udword r = seed ? static_cast<udword>(seed) : 88675123u;
+      for( udword i = 0;  i < image.size();  ++i )
+      {
+         r = 36969u * (r & 0xFFFFu) + (r >> 16);
+         image[i] = (i < (image.size() / 2)) ?
+            static_cast<float>(((i / (WIDTH * 3 * 4)) + (i % 3)) % 5) * 0.2f :
+            static_cast<float>(r & 0xFFFFu) / 65536.0f;
+      }
+
+      std::vector<float> memoised( image.size() );
+      std::vector<float> direct( image.size() );
+
+      bool isOk_ = true;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT, 0, 0, 0, &image[0],
+            0, 0, 0, 1.0f, &memoised[0] );
+         whiteBalance( 0, 0, 0, p3wb13_NO_MEMO, -1.0f, WIDTH, HEIGHT, 0, 0, 0,
+            &image[0], 0, 0, 0, 1.0f, &direct[0] );
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+      isOk_ &= (0 == ::memcmp( &memoised[0], &direct[0], memoised.size() *
+         sizeof(float) ));
+
+      // stats
+      const PixelMap pixelMap( Matrix3f::IDENTITY(), Matrix3f::IDENTITY(),
+         Vector3f( 0.0f, 0.1f, -0.1f ), 0.8f );
+
+      PixelMemo<PixelMap> flat( pixelMap, true );
+      for( udword i = 0;  i < 10000;  ++i )
+      {
+         flat( Vector3f( 0.1f * static_cast<float>(i % 7), 0.5f, 0.25f ) );
+      }
+      isOk_ &= (10000 == flat.getLookupCount()) &
+         ((10000 - 7) == flat.getHitCount()) & (0 == flat.getBypassCount());
+
+      PixelMemo<PixelMap> noisy( pixelMap, true );
+      for( udword i = 0;  i < (4096 * 3);  ++i )
+      {
+         noisy( Vector3f( &image[ (image.size() / 2) +
+            ((i % (WIDTH * HEIGHT / 2)) * 3) ] ) );
+      }
+      isOk_ &= (4096 == noisy.getLookupCount()) &
+         ((4096 * 2) == noisy.getBypassCount());
+
+      PixelMemo<PixelMap> off( pixelMap, false );
+      off( Vector3f( 0.5f, 0.5f, 0.5f ) );
+      isOk_ &= (0 == off.getLookupCount()) & (1 == off.getBypassCount());
+
+      if( pOut && isVerbose ) *pOut << "flat hits: " << flat.getHitCount() <<
+         "/" << flat.getLookupCount() << "  noisy hits: " <<
+         noisy.getHitCount() << "/" << noisy.getLookupCount() << "\n";
+
+      if( pOut ) *pOut << "memo : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // color list: weighted palette same as expanded image
+   {
+      static const float PALETTE[] = {
+         0.9f, 0.8f, 0.3f,   0.1f, 0.2f, 0.6f,   0.5f, 0.5f, 0.4f,
+         0.0f, 0.0f, 0.0f,   0.7f, 0.3f, 0.2f };
+      static const dword COUNT = sizeof(PALETTE) / (sizeof(PALETTE[0]) * 3);
+      static const float WEIGHTS[COUNT] = { 37.0f, 5.0f, 12.0f, 9.0f, 1.0f };
+
+      // expand to image, by weights
+      std::vector<float> image;
+      for( dword i = 0;  i < COUNT;  ++i )
+      {
+         for( dword w = static_cast<dword>(WEIGHTS[i]);  w-- > 0; )
+         {
+            image.insert( image.end(), PALETTE + (i * 3),
+               PALETTE + ((i + 1) * 3) );
+         }
+      }
+      const dword WIDTH = static_cast<dword>(image.size() / 3);
+
+      std::vector<float> mappedImage( image.size() );
+      float mappedPalette[ COUNT * 3 ];
+
+      bool isOk_ = true;
+      float maxDif = 0.0f;
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         // estimated, and supplied illuminant
+         static const float ILLUMINANT[] = { 1.0f, 0.8f, 0.6f };
+         const float* pIlluminant = (0 == k) ? 0 : ILLUMINANT;
+
+         try
+         {
+            whiteBalance( 0, 0, pIlluminant, 0, -1.0f, WIDTH, 1, 0, 0, 0,
+               &image[0], 0, 0, 0, 1.0f, &mappedImage[0] );
+            whiteBalanceColors( 0, 0, pIlluminant, 0, -1.0f, COUNT, PALETTE,
+               WEIGHTS, mappedPalette );
+         }
+         catch( ... )
+         {
+            isOk_ = false;
+         }
+
+         for( dword i = 0, j = 0;  i < COUNT;  j += static_cast<dword>(
+            WEIGHTS[i++]) * 3 )
+         {
+            for( dword c = 0;  c < 3;  ++c )
+            {
+               const float dif = ::fabsf( mappedPalette[ (i * 3) + c ] -
+                  mappedImage[ j + c ] );
+               maxDif = (maxDif >= dif) ? maxDif : dif;
+            }
+         }
+      }
+      isOk_ &= (maxDif < 1e-5f);
+
+      // negative weight is rejected
+      {
+         const float WEIGHTS_BAD[COUNT] = { 1.0f, 1.0f, -1.0f, 1.0f, 1.0f };
+         bool isThrown = false;
+         try
+         {
+            whiteBalanceColors( 0, 0, 0, 0, -1.0f, COUNT, PALETTE,
+               WEIGHTS_BAD, mappedPalette );
+         }
+         catch( ... )
+         {
+            isThrown = true;
+         }
+         isOk_ &= isThrown;
+      }
+
+      if( pOut && isVerbose ) *pOut << "color list max dif: " << maxDif <<
+         "\n";
+
+      if( pOut ) *pOut << "color list : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // Y'CbCr: 4:4:4 same as RGB, 4:2:0 interleaved in place same as 4:4:4
+   {
+      // sRGB bytes, constant in 2x2 blocks, moderate tinted colors
+      const dword WIDTH  = 16;
+      const dword HEIGHT = 12;
+      std::vector<ubyte> rgb( WIDTH * HEIGHT * 3 );
+      {
+         udword r = seed ? static_cast<udword>(seed) : 123456789u;
+         for( dword y = 0;  y < HEIGHT;  y += 2 )
+         {
+            for( dword x = 0;  x < WIDTH;  x += 2 )
+            {
+               for( dword c = 0;  c < 3;  ++c )
+               {
+                  r = 18000u * (r & 0xFFFFu) + (r >> 16);
+                  const ubyte v = static_cast<ubyte>( 60 + (r % 120) +
+                     (0 == c ? 30 : 0) );
+                  for( dword i = 0;  i < 4;  ++i )
+                  {
+                     rgb[ ((((y + (i / 2)) * WIDTH) + x + (i % 2)) * 3) + c ] =
+                        v;
+                  }
+               }
+            }
+         }
+      }
+
+      // to full range BT.709 Y'CbCr 4:4:4, and interleaved 4:2:0
+      static const float KR = 0.2126f;
+      static const float KB = 0.0722f;
+      std::vector<ubyte> luma( WIDTH * HEIGHT );
+      std::vector<ubyte> cb( WIDTH * HEIGHT );
+      std::vector<ubyte> cr( WIDTH * HEIGHT );
+      std::vector<ubyte> cbcr( (WIDTH / 2) * (HEIGHT / 2) * 2 );
+      for( dword i = 0;  i < (WIDTH * HEIGHT);  ++i )
+      {
+         const float r = static_cast<float>(rgb[ (i * 3) + 0 ]) / 255.0f;
+         const float g = static_cast<float>(rgb[ (i * 3) + 1 ]) / 255.0f;
+         const float b = static_cast<float>(rgb[ (i * 3) + 2 ]) / 255.0f;
+         const float l = (KR * r) + ((1.0f - KR - KB) * g) + (KB * b);
+         luma[i] = static_cast<ubyte>( (l * 255.0f) + 0.5f );
+         cb[i]   = static_cast<ubyte>( 128.5f + ((b - l) /
+            (2.0f * (1.0f - KB)) * 255.0f) );
+         cr[i]   = static_cast<ubyte>( 128.5f + ((r - l) /
+            (2.0f * (1.0f - KR)) * 255.0f) );
+
+         const dword x = i % WIDTH;
+         const dword y = i / WIDTH;
+         const dword j = (((y / 2) * (WIDTH / 2)) + (x / 2)) * 2;
+         cbcr[ j + 0 ] = cb[i];
+         cbcr[ j + 1 ] = cr[i];
+      }
+      std::vector<ubyte> luma420( luma );
+
+      std::vector<ubyte> rgbOut( rgb.size() );
+      std::vector<ubyte> lumaOut( luma.size() );
+      std::vector<ubyte> cbOut( cb.size() );
+      std::vector<ubyte> crOut( cr.size() );
+
+      bool isOk_ = true;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+            p3wb13_UBYTE | p3wb13_SRGB, 0, 0, &rgb[0],
+            p3wb13_UBYTE | p3wb13_SRGB, 0, 0, 1.0f, &rgbOut[0] );
+         whiteBalanceYCbCr( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+            p3wb13_YCC_444 | p3wb13_YCC_FULL_RANGE, 0, 0, 0,
+            &luma[0], &cb[0], &cr[0], &lumaOut[0], &cbOut[0], &crOut[0] );
+         whiteBalanceYCbCr( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+            p3wb13_YCC_420 | p3wb13_YCC_FULL_RANGE, 0, 0, 2,
+            &luma420[0], &cbcr[0], &cbcr[1],
+            &luma420[0], &cbcr[0], &cbcr[1] );
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+
+      // 4:4:4 back to R'G'B', compare with RGB result
+      dword maxDifRgb = 0;
+      dword sumDifRgb = 0;
+      dword maxDif420 = 0;
+      for( dword i = 0;  i < (WIDTH * HEIGHT);  ++i )
+      {
+         const float l = static_cast<float>(lumaOut[i]) / 255.0f;
+         const float b = l + ((static_cast<float>(cbOut[i]) - 128.0f) /
+            255.0f * (2.0f * (1.0f - KB)));
+         const float r = l + ((static_cast<float>(crOut[i]) - 128.0f) /
+            255.0f * (2.0f * (1.0f - KR)));
+         const float g = (l - (KR * r) - (KB * b)) / (1.0f - KR - KB);
+         const float channels[] = { r, g, b };
+         for( dword c = 0;  c < 3;  ++c )
+         {
+            const dword expected = rgbOut[ (i * 3) + c ];
+            const dword actual   = static_cast<dword>( (channels[c] * 255.0f) +
+               0.5f );
+            const dword dif = (expected >= actual) ? expected - actual :
+               actual - expected;
+            sumDifRgb += dif;
+
+            // (max only off the sRGB curve's steep foot: see below)
+            if( expected >= 32 )
+            {
+               maxDifRgb = (maxDifRgb >= dif) ? maxDifRgb : dif;
+            }
+         }
+
+         const dword x = i % WIDTH;
+         const dword y = i / WIDTH;
+         const dword j = (((y / 2) * (WIDTH / 2)) + (x / 2)) * 2;
+         const dword difs[] = {
+            static_cast<dword>(luma420[i]) - static_cast<dword>(lumaOut[i]),
+            static_cast<dword>(cbcr[j + 0]) - static_cast<dword>(cbOut[i]),
+            static_cast<dword>(cbcr[j + 1]) - static_cast<dword>(crOut[i]) };
+         for( dword k = 0;  k < 3;  ++k )
+         {
+            const dword dif = (difs[k] >= 0) ? difs[k] : -difs[k];
+            maxDif420 = (maxDif420 >= dif) ? maxDif420 : dif;
+         }
+      }
+      // (Y'CbCr quantization loses a little each way, and more in green, which
+      // is made from all three. The input's quantization error -- about 1.5
+      // LSB of R' -- is carried through the map: where that takes a channel
+      // near black, the sRGB curve's steep foot stretches it -- its slope is
+      // 12.92 at black, still over 5 at 32 (1/8), and falling. So the max
+      // covers only outputs of 32 and up, where it was at most 5 over 5000
+      // seeds (and 3 from 56 up); the mean covers all)
+      const float meanDifRgb = static_cast<float>(sumDifRgb) /
+         static_cast<float>(WIDTH * HEIGHT * 3);
+      isOk_ &= (meanDifRgb <= 1.0f) & (maxDifRgb <= 6) & (maxDif420 <= 1);
+
+      // unknown Y'CbCr flags are rejected
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         bool isThrown = false;
+         try
+         {
+            whiteBalanceYCbCr( 0, 0, 0, 0, -1.0f, WIDTH, HEIGHT,
+               (0 == k) ? p3wb13_YCC_SUBSAMPLING : 0x10, 0, 0, 0,
+               &luma[0], &cb[0], &cr[0], &lumaOut[0], &cbOut[0], &crOut[0] );
+         }
+         catch( ... )
+         {
+            isThrown = true;
+         }
+         isOk_ &= isThrown;
+      }
+
+      if( pOut && isVerbose ) *pOut << "Y'CbCr max dif: " << maxDifRgb <<
+         " (RGB)  " << maxDif420 << " (4:2:0)\n";
+
+      if( pOut ) *pOut << "Y'CbCr : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // header-only interface: same as library, within its fast approximations
+   {
+      const dword WIDTH  = 37;
+      const dword HEIGHT = 19;
+      std::vector<float> image( WIDTH * HEIGHT * 4 );
+      {
+         udword r = seed ? static_cast<udword>(seed) : 123456789u;
+         for( udword i = 0;  i < image.size();  ++i )
+         {
+            r = 18000u * (r & 0xFFFFu) + (r >> 16);
+            image[i] = static_cast<float>(r & 0xFFFFu) / 65536.0f *
+               (0 == (i % 4) ? 1.4f : 1.0f);
+         }
+      }
+      const float colorSpace[] = { 0.68f, 0.32f, 0.265f, 0.69f, 0.15f, 0.06f };
+      const float whitePoint[] = { 0.3127f, 0.329f };
+
+      // library: float RGBA in, float RGB and BGRA8 sRGB out
+      std::vector<float> libFloat( WIDTH * HEIGHT * 3 );
+      std::vector<ubyte> libBgra( WIDTH * HEIGHT * 4 );
+      whiteBalance( colorSpace, whitePoint, 0, 0, -1.0f, WIDTH, HEIGHT,
+         p3wb13_ALPHA, 0, 0, &image[0], 0, 0, 0, 1.0f, &libFloat[0] );
+      whiteBalance( colorSpace, whitePoint, 0, 0, -1.0f, WIDTH, HEIGHT,
+         p3wb13_ALPHA, 0, 0, &image[0],
+         p3wb11_BGR | p3wb13_ALPHA | p3wb13_UBYTE | p3wb13_SRGB, 0, 0, 1.0f,
+         &libBgra[0] );
+
+      // inline: estimate, then map rows into both formats
+      typedef p3wb::Pixel<p3wb::ChannelFloat, p3wb::RGB_e, 4>     InPixel;
+      typedef p3wb::Pixel<p3wb::ChannelFloat>                     FloatPixel;
+      typedef p3wb::Pixel<p3wb::ChannelUbyteSrgb, p3wb::BGR_e, 4> BgraPixel;
+
+      std::vector<float> hppFloat( libFloat.size() );
+      std::vector<ubyte> hppBgra( libBgra.size(), 255 );
+      {
+         const p3wb::ColorSpace space( colorSpace, whitePoint );
+
+         p3wb::Estimator estimator( space );
+         for( dword y = 0;  y < HEIGHT;  ++y )
+         {
+            estimator.addRow<InPixel>( &image[y * WIDTH * 4], WIDTH );
+         }
+         float illuminant[3];
+         estimator.getIlluminant( illuminant );
+
+         const p3wb::PixelMap map( space, illuminant );
+         for( dword y = 0;  y < HEIGHT;  ++y )
+         {
+            map.mapRow<InPixel, FloatPixel>( &image[y * WIDTH * 4],
+               &hppFloat[y * WIDTH * 3], WIDTH );
+            map.mapRow<InPixel, BgraPixel>( &image[y * WIDTH * 4],
+               &hppBgra[y * WIDTH * 4], WIDTH );
+         }
+      }
+
+      // compare float to each pixel's largest channel, bytes to 3 LSB (the
+      // encode rounds the same, but a dark channel of a bright pixel carries
+      // the float difference onto the sRGB curve's steep foot: 12.92 * 255
+      // times 7.5e-4 is 2.5 LSB)
+      float maxDif     = 0.0f;
+      dword maxByteDif = 0;
+      for( udword i = 0;  i < libFloat.size();  ++i )
+      {
+         const float* pPixel = &libFloat[i - (i % 3)];
+         const float  max    = pPixel[0] > pPixel[1] ?
+            (pPixel[0] > pPixel[2] ? pPixel[0] : pPixel[2]) :
+            (pPixel[1] > pPixel[2] ? pPixel[1] : pPixel[2]);
+         const float dif = ::fabsf( hppFloat[i] - libFloat[i] ) / (max + 1e-3f);
+         maxDif = dif > maxDif ? dif : maxDif;
+      }
+      for( udword i = 0;  i < libBgra.size();  ++i )
+      {
+         const dword dif = static_cast<dword>(libBgra[i]) -
+            static_cast<dword>(hppBgra[i]);
+         maxByteDif = (dif >= 0 ? dif : -dif) > maxByteDif ?
+            (dif >= 0 ? dif : -dif) : maxByteDif;
+      }
+      const bool isOk_ = (maxDif < 2e-3f) & (maxByteDif <= 3);
+
+      if( pOut && isVerbose ) *pOut << "inline max dif: " << maxDif <<
+         "  bytes: " << maxByteDif << "\n";
+
+      if( pOut ) *pOut << "header-only : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // unknown format flags are rejected
+   {
+      float pixels[ 4 * 3 ];
+      bool isOk_ = false;
+      try
+      {
+         whiteBalance( 0, 0, 0, 0, -1.0f, 2, 2, 0x100, 0, 0, pixels,
+            0, 0, 0, 1.0f, pixels );
+      }
+      catch( ... )
+      {
+         isOk_ = true;
+      }
+
+      if( pOut ) *pOut << "format check : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // robust: bright off-color highlights skew the mean, not the robust one
+   {
+      // a cast gray mass, with a tenth bright blue lights
+      const dword WIDTH  = 100;
+      const dword HEIGHT = 60;
+      std::vector<float> image( WIDTH * HEIGHT * 3 );
+      udword r = seed ? static_cast<udword>(seed) : 362436069u;
+      for( udword i = 0;  i < (WIDTH * HEIGHT);  ++i )
+      {
+         r = 36969u * (r & 0xFFFFu) + (r >> 16);
+         const float shade = 0.3f + (static_cast<float>(r & 0xFFFFu) /
+            65536.0f);
+         static const float CAST[]  = { 0.6f, 0.5f, 0.3f };
+         static const float LIGHT[] = { 20.0f, 40.0f, 90.0f };
+         for( udword c = 0;  c < 3;  ++c )
+         {
+            image[(i * 3) + c] = (i % 10) ? CAST[c] * shade : LIGHT[c] * shade;
+         }
+      }
+
+      // how far the mass is from neutral, after balancing
+      float spread[2];
+      bool  isOk_ = true;
+      for( udword k = 0;  k < 2;  ++k )
+      {
+         std::vector<float> out( image.size() );
+         try
+         {
+            whiteBalance( 0, 0, 0, (k ? p3wb13_ROBUST : 0), 1.0f, WIDTH,
+               HEIGHT, 0, 0, 0, &image[0], 0, 0, 0, 1.0f, &out[0] );
+         }
+         catch( ... )
+         {
+            isOk_ = false;
+         }
+
+         float mean[3] = { 0.0f, 0.0f, 0.0f };
+         for( udword i = 0;  i < (WIDTH * HEIGHT);  ++i )
+         {
+            for( udword c = 0;  (i % 10) && (c < 3);  ++c )
+            {
+               mean[c] += out[(i * 3) + c];
+            }
+         }
+         const float max = mean[0] > mean[1] ? (mean[0] > mean[2] ? mean[0] :
+            mean[2]) : (mean[1] > mean[2] ? mean[1] : mean[2]);
+         const float min = mean[0] < mean[1] ? (mean[0] < mean[2] ? mean[0] :
+            mean[2]) : (mean[1] < mean[2] ? mean[1] : mean[2]);
+         spread[k] = max / min;
+
+         if( pOut && isVerbose ) *pOut << (k ? "robust " : "mean ") <<
+            mean[0] << " " << mean[1] << " " << mean[2] << "\n";
+      }
+      isOk_ &= (spread[1] < 1.02f) & (spread[0] > 1.15f);
+
+      // sketches are fixed size, however many pixels
+      isOk_ &= sizeof(IlluminantSum) < 16000;
+
+      if( pOut ) *pOut << "robust : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
+
+   // sizes beyond 32 bits are accepted (only the first pixel is touched)
+   {
+      const float pixel[3] = { 0.25f, 0.5f, 0.75f };
+      bool isOk_ = true;
+      try
+      {
+         const hxa7241_image::ImageWrapperConst image( 100000, 30000,
+            hxa7241_image::ImageWrapperConst::RGB_e, 0, 0, pixel );
+
+         isOk_ &= (image.getLength() == static_cast<qword>(3000000000.0));
+         isOk_ &= (image.get( 0 ) == Vector3f( pixel ));
+      }
+      catch( ... )
+      {
+         isOk_ = false;
+      }
+
+      if( pOut ) *pOut << "64-bit size : " <<
+         (isOk_ ? "--- succeeded" : "*** failed") << "\n\n";
+
+      isOk &= isOk_;
+   }
 
 
    if( pOut ) *pOut << (isOk ? "--- successfully" : "*** failurefully") <<
@@ -13,6 +13,7 @@
 
 
 #include "Primitives.hpp"
+#include "QuantileSketch.hpp"
 
 
 
@@ -22,6 +23,27 @@ namespace p3whitebalancer
    using namespace hxa7241;
 
 
+/**
+ * Sum for estimating an illuminant, poolable over a set of images.<br/><br/>
+ *
+ * Start zeroed, add images with sumIlluminant, then give to whiteBalance for
+ * each image. Sums of separate images can be added together, with
+ * poolIlluminant.<br/><br/>
+ *
+ * Double precision, so billions of pixels can be summed without loss.
+ * With the robust option, each Ruderman axis also goes into a quantile
+ * sketch (fixed size, however many pixels).
+ */
+struct IlluminantSum
+{
+   double sum[3];
+   double weight;
+   qword  count;
+
+   hxa7241_general::QuantileSketch axes[3];
+};
+
+
 /**
  * White balance an image.<br/><br/>
  *
@@ -37,32 +59,43 @@ namespace p3whitebalancer
  * * Input pixels that are black result in black output pixels
  * * Input pixels containing NaNs pass through unused and unchanged.
  *
- * @i_colorSpace6    chromaticities of image,
- *                   array of six { rx, ry, gx, gy, bx, by },
- *                   each value is > 0 and < 1
- *                   (give 0 for default: ITU-R BT.709 / sRGB)
- * @i_whitePoint2    whitepoint of image,
- *                   array of two { x, y },
- *                   each value is > 0 and < 1
- *                   (give 0 for default: flat 1/3, 1/3)
- * @i_inIlluminant3  illuminant color of image's original context,
- *                   array of three { r, g, b },
- *                   only relative proportions are needed, not absolute
- *                   (give 0 for automatic estimation)
- * @i_options        balancing options, from the options/constants header
- * @i_strength       strength of color-shift, >= 0 and <= 1
- *                   (give -1 for default: 0.8)
- * @i_width          width of input and output images, in pixels
- * @i_height         height of input and output images, in pixels
- * @i_formatFlags    pixel channel order, from the options/constants header
- * @i_pixelStride    number of bytes to add to a pixel pointer to get next,
- *                   will be >= 3 * sizeof(*i_inPixels)
- *                   (give 0 for default: 3 * sizeof(*i_inPixels))
- * @i_inPixels       array of input RGB pixels, channel order as i_formatFlags,
- *                   padding as i_pixelStride,
- * @o_outPixels      array of output RGB pixels, channel order as i_formatFlags,
- *                   padding as i_pixelStride
- *                   (may point to same array as input pixels)
+ * @i_colorSpace6      chromaticities of image,
+ *                     array of six { rx, ry, gx, gy, bx, by },
+ *                     each value is > 0 and < 1
+ *                     (give 0 for default: ITU-R BT.709 / sRGB)
+ * @i_whitePoint2      whitepoint of image,
+ *                     array of two { x, y },
+ *                     each value is > 0 and < 1
+ *                     (give 0 for default: flat 1/3, 1/3)
+ * @i_inIlluminant3    illuminant color of image's original context,
+ *                     array of three { r, g, b },
+ *                     only relative proportions are needed, not absolute
+ *                     (give 0 for automatic estimation)
+ * @i_options          balancing options, from the options/constants header
+ * @i_strength         strength of color-shift, >= 0 and <= 1
+ *                     (give -1 for default: 0.8)
+ * @i_width            width of input and output images, in pixels
+ * @i_height           height of input and output images, in pixels
+ * @i_inFormatFlags    input pixel format, from the options/constants header
+ * @i_inPixelStride    number of bytes to add to a pixel pointer to get next
+ *                     (give 0 for default: packed channels)
+ * @i_inRowPitch       number of bytes to add to a pixel pointer to get the one
+ *                     below, may be negative, magnitude >= i_width * stride
+ *                     (give 0 for default: i_width * stride)
+ * @i_pInPixels        array of input RGB pixels, format as i_inFormatFlags,
+ *                     layout as i_inPixelStride and i_inRowPitch
+ * @i_outFormatFlags   output pixel format, from the options/constants header
+ * @i_outPixelStride   as i_inPixelStride, for output
+ * @i_outRowPitch      as i_inRowPitch, for output
+ * @i_outAlpha         alpha value written, if output format has alpha
+ * @o_pOutPixels       array of output RGB pixels, format as i_outFormatFlags,
+ *                     layout as i_outPixelStride and i_outRowPitch
+ *                     (may point to same array as input pixels, if format and
+ *                     layout are the same)
+ * @i_pIsCancelled     flag polled while running, to abandon by throwing
+ *                     CANCELLED_MESSAGE (give 0 for none)
+ * @i_pPooledSum       illuminant sum of a set of images, to use instead of
+ *                     estimating from this image (give 0 for none)
  *
  * @throws exceptions
  */
@@ -75,13 +108,297 @@ void whiteBalance
    float        i_strength,
    udword       i_width,
    udword       i_height,
-   udword       i_formatFlags,
-   udword       i_pixelStride,
-   const float* i_pInPixels,
-   float*       o_pOutPixels
+   udword       i_inFormatFlags,
+   udword       i_inPixelStride,
+   qword        i_inRowPitch,
+   const void*  i_pInPixels,
+   udword       i_outFormatFlags,
+   udword       i_outPixelStride,
+   qword        i_outRowPitch,
+   float        i_outAlpha,
+   void*        o_pOutPixels,
+   const volatile bool* i_pIsCancelled = 0,
+   const IlluminantSum* i_pPooledSum   = 0
+);
+
+
+/**
+ * Add an image to an illuminant sum, for pooled estimation over a set.
+ *
+ * Parameters as whiteBalance. (Images can be summed concurrently, into
+ * separate sums, then added.)
+ *
+ * @io_sum  sum to add to
+ *
+ * @throws exceptions
+ */
+void sumIlluminant
+(
+   const float*   i_colorSpace6,
+   const float*   i_whitePoint2,
+   const float*   i_pInIlluminant3,
+   unsigned int   i_options,
+   udword         i_width,
+   udword         i_height,
+   udword         i_inFormatFlags,
+   udword         i_inPixelStride,
+   qword          i_inRowPitch,
+   const void*    i_pInPixels,
+   IlluminantSum& io_sum,
+   const volatile bool* i_pIsCancelled = 0
+);
+
+
+/**
+ * Add one illuminant sum to another.
+ *
+ * (Sketches merged in the same order give the same result, so pool in a
+ * fixed order, not as threads finish.)
+ */
+void poolIlluminant
+(
+   const IlluminantSum& i_sum,
+   IlluminantSum&       io_sum
+);
+
+
+/**
+ * Mean of an estimating illuminant sum, in Ruderman space: the interquartile
+ * mean of each axis if it has sketches (robust option), else the plain mean.
+ *
+ * @i_isWeighted  mean over summed weights, else over pixel count
+ * @o_mean3       array of three to write to
+ */
+void getIlluminantMean
+(
+   const IlluminantSum& i_sum,
+   bool                 i_isWeighted,
+   double*              o_mean3
+);
+
+
+/**
+ * Number of bins along each axis of a chroma histogram.
+ */
+const udword CHROMA_BINS = 16;
+
+
+/**
+ * Add a sparse sample of an image to an illuminant sum, and a histogram of its
+ * chroma (Ruderman alpha and beta). For cheap estimation and scene-change
+ * detection, per frame of a sequence.
+ *
+ * Parameters as sumIlluminant, estimating only, plus:
+ * @i_step                 sample every i_step-th pixel, across and down
+ * @io_pChromaHistogram    array of CHROMA_BINS * CHROMA_BINS counts, to add
+ *                         to (give 0 for none)
+ *
+ * @throws exceptions
+ */
+void sampleIlluminant
+(
+   const float*   i_colorSpace6,
+   const float*   i_whitePoint2,
+   unsigned int   i_options,
+   udword         i_width,
+   udword         i_height,
+   udword         i_inFormatFlags,
+   udword         i_inPixelStride,
+   qword          i_inRowPitch,
+   const void*    i_pInPixels,
+   udword         i_step,
+   IlluminantSum& io_sum,
+   float*         io_pChromaHistogram
+);
+
+
+/**
+ * White balance a list of colors.<br/><br/>
+ *
+ * As whiteBalance, but for any set of colors instead of an image -- a palette
+ * for example. Estimation can be weighted, by how many pixels use each color.
+ *
+ * @i_count            number of colors
+ * @i_pInColors        array of i_count RGB float triples
+ * @i_pWeights         array of i_count weights, each >= 0, for estimating the
+ *                     illuminant (give 0 for all equal)
+ * @o_pOutColors       array of i_count RGB float triples
+ *                     (may point to same array as input colors)
+ *
+ * @throws exceptions
+ */
+void whiteBalanceColors
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_pInIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   udword       i_count,
+   const float* i_pInColors,
+   const float* i_pWeights,
+   float*       o_pOutColors
 );
 
 
+/**
+ * White balance Y'CbCr planes, with chroma optionally subsampled.<br/><br/>
+ *
+ * As whiteBalance, but estimating and mapping once per chroma sample (the
+ * R'G'B' of the sample with the mean luma of its block, taken as sRGB-encoded).
+ * Chroma samples are written directly, and luma samples only scaled, to restore
+ * the block's luma.
+ *
+ * @i_width            width of luma plane, in samples
+ * @i_height           height of luma plane, in samples
+ * @i_ycbcrFlags       subsampling, matrix, and range, from the
+ *                     options/constants header
+ * @i_lumaPitch        number of bytes to add to a luma sample pointer to get
+ *                     the one below, may be negative (give 0 for default:
+ *                     i_width)
+ * @i_chromaPitch      as i_lumaPitch, for chroma samples (give 0 for default:
+ *                     chroma width * i_chromaStride)
+ * @i_chromaStride     number of bytes to add to a chroma sample pointer to get
+ *                     next (give 0 for default: 1, or 2 for interleaved CbCr)
+ * @i_pInLuma          input Y' plane, ubyte samples
+ * @i_pInCb            input Cb plane
+ * @i_pInCr            input Cr plane
+ * @o_pOutLuma         output planes, same layout as input
+ * @o_pOutCb           (may point to same planes as input)
+ * @o_pOutCr
+ *
+ * @throws exceptions
+ */
+void whiteBalanceYCbCr
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   const float* i_pInIlluminant3,
+   unsigned int i_options,
+   float        i_strength,
+   udword       i_width,
+   udword       i_height,
+   udword       i_ycbcrFlags,
+   qword        i_lumaPitch,
+   qword        i_chromaPitch,
+   udword       i_chromaStride,
+   const ubyte* i_pInLuma,
+   const ubyte* i_pInCb,
+   const ubyte* i_pInCr,
+   ubyte*       o_pOutLuma,
+   ubyte*       o_pOutCb,
+   ubyte*       o_pOutCr,
+   const volatile bool* i_pIsCancelled = 0
+);
+
+
+/**
+ * Statistics of an image in Ruderman space, for color transfer.<br/><br/>
+ *
+ * Per axis: mean, and sum of squared deviations from it (M2), accumulated in
+ * one pass (Welford's method). Stats of separate parts combine exactly, with
+ * poolStats (Chan's formula), so parts can be summed concurrently.
+ * Start zeroed.
+ */
+struct ColorStats
+{
+   double count;
+   double mean[3];
+   double m2[3];
+};
+
+
+/**
+ * Add a band of rows of an image to color stats.<br/><br/>
+ *
+ * NaN and black pixels are left out (black has no log).
+ *
+ * Parameters as sumIlluminant, plus:
+ * @i_top    first row of the band
+ * @i_rows   number of rows in the band
+ * @io_stats stats to add to
+ *
+ * @throws exceptions
+ */
+void sumStats
+(
+   const float* i_colorSpace6,
+   const float* i_whitePoint2,
+   unsigned int i_options,
+   udword       i_width,
+   udword       i_height,
+   udword       i_inFormatFlags,
+   udword       i_inPixelStride,
+   qword        i_inRowPitch,
+   const void*  i_pInPixels,
+   udword       i_top,
+   udword       i_rows,
+   ColorStats&  io_stats,
+   const volatile bool* i_pIsCancelled = 0
+);
+
+
+/**
+ * Add one color stats to another.
+ *
+ * (Exact in principle, but float rounding depends on order, so pool in a fixed
+ * order, not as threads finish.)
+ */
+void poolStats
+(
+   const ColorStats& i_stats,
+   ColorStats&       io_stats
+);
+
+
+/**
+ * Transfer colors onto a band of rows of an image: map the target stats onto
+ * the reference stats (Reinhard et al. 2001), per Ruderman axis.<br/><br/>
+ *
+ * Each axis is shifted and scaled, so its mean and standard deviation become
+ * the reference's -- luminance included. Black, and NaN, pixels pass through.
+ *
+ * Parameters as whiteBalance, plus:
+ * @i_strength     fraction of the mapping, >= 0 and <= 1
+ *                 (give -1 for default: 1)
+ * @i_target       stats of the whole image being mapped
+ * @i_reference    stats of the look to transfer
+ * @i_top          first row of the band
+ * @i_rows         number of rows in the band
+ *
+ * @throws exceptions
+ */
+void transferColors
+(
+   const float*      i_colorSpace6,
+   const float*      i_whitePoint2,
+   unsigned int      i_options,
+   float             i_strength,
+   const ColorStats& i_target,
+   const ColorStats& i_reference,
+   udword            i_width,
+   udword            i_height,
+   udword            i_inFormatFlags,
+   udword            i_inPixelStride,
+   qword             i_inRowPitch,
+   const void*       i_pInPixels,
+   udword            i_outFormatFlags,
+   udword            i_outPixelStride,
+   qword             i_outRowPitch,
+   float             i_outAlpha,
+   void*             o_pOutPixels,
+   udword            i_top,
+   udword            i_rows,
+   const volatile bool* i_pIsCancelled = 0
+);
+
+
+/**
+ * Exception message thrown when cancelled.
+ */
+extern const char CANCELLED_MESSAGE[];
+
+
 }
 
 
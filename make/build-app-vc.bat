@@ -19,14 +19,21 @@ del /Q application\obj\*
 @echo --- compile ---
 
 %COMPILER% %COMPILE_OPTIONS% application/src/general/DynamicLibraryInterface.cpp /Foapplication/obj/DynamicLibraryInterface.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/general/ScratchMemory.cpp /Foapplication/obj/ScratchMemory.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/general/Threads.cpp /Foapplication/obj/Threads.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/general/FileList.cpp /Foapplication/obj/FileList.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/general/MappedFile.cpp /Foapplication/obj/MappedFile.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/general/ParallelBands.cpp /Foapplication/obj/ParallelBands.obj
 
 %COMPILER% %COMPILE_OPTIONS% application/src/image/exr.cpp /Foapplication/obj/exr.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/png.cpp /Foapplication/obj/png.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/ppm.cpp /Foapplication/obj/ppm.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/image/pfm.cpp /Foapplication/obj/pfm.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/rgbe.cpp /Foapplication/obj/rgbe.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/ImageAdopter.cpp /Foapplication/obj/ImageAdopter.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/ImageFormatter.cpp /Foapplication/obj/ImageFormatter.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/ImageQuantizing.cpp /Foapplication/obj/ImageQuantizing.obj
+%COMPILER% %COMPILE_OPTIONS% application/src/image/IndexedImage.cpp /Foapplication/obj/IndexedImage.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/PixelsPtr.cpp /Foapplication/obj/PixelsPtr.obj
 %COMPILER% %COMPILE_OPTIONS% application/src/image/StreamExceptionSet.cpp /Foapplication/obj/StreamExceptionSet.obj
 
@@ -37,7 +44,7 @@ del /Q application\obj\*
 @echo.
 @echo --- link ---
 
-%LINKER% /LTCG /OPT:REF /OPT:NOWIN98 /VERSION:1.2 /NOLOGO /OUT:p3whitebalancer.exe kernel32.lib advapi32.lib p3whitebalancer.lib application/obj/*.obj
+%LINKER% /LTCG /OPT:REF /OPT:NOWIN98 /VERSION:1.3 /NOLOGO /OUT:p3whitebalancer.exe kernel32.lib advapi32.lib p3whitebalancer.lib application/obj/*.obj
 
 
 del /Q application\obj\*
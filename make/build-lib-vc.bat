@@ -20,6 +20,9 @@ del /Q library\obj\*
 
 %COMPILER% %COMPILE_OPTIONS% library/src/general/LogFast.cpp /Folibrary/obj/LogFast.obj
 %COMPILER% %COMPILE_OPTIONS% library/src/general/PowFast.cpp /Folibrary/obj/PowFast.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/general/Threads.cpp /Folibrary/obj/Threads.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/general/WorkerPool.cpp /Folibrary/obj/WorkerPool.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/general/QuantileSketch.cpp /Folibrary/obj/QuantileSketch.obj
 
 %COMPILER% %COMPILE_OPTIONS% library/src/graphics/ColorConstants.cpp /Folibrary/obj/ColorConstants.obj
 %COMPILER% %COMPILE_OPTIONS% library/src/graphics/ColorConversion.cpp /Folibrary/obj/ColorConversion.obj
@@ -28,8 +31,15 @@ del /Q library\obj\*
 
 %COMPILER% %COMPILE_OPTIONS% library/src/image/ImageWrapper.cpp /Folibrary/obj/ImageWrapper.obj
 %COMPILER% %COMPILE_OPTIONS% library/src/image/ImageWrapperConst.cpp /Folibrary/obj/ImageWrapperConst.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/image/YCbCrWrapper.cpp /Folibrary/obj/YCbCrWrapper.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/image/YCbCrWrapperConst.cpp /Folibrary/obj/YCbCrWrapperConst.obj
 
 %COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/WhiteBalancer.cpp /Folibrary/obj/WhiteBalancer.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/BalanceJob.cpp /Folibrary/obj/BalanceJob.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/BalanceSet.cpp /Folibrary/obj/BalanceSet.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/BalanceSequence.cpp /Folibrary/obj/BalanceSequence.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/BalanceStrips.cpp /Folibrary/obj/BalanceStrips.obj
+%COMPILER% %COMPILE_OPTIONS% library/src/whitebalance/ColorTransfer.cpp /Folibrary/obj/ColorTransfer.obj
 
 %COMPILER% %COMPILE_OPTIONS% library/src/p3wbWhiteBalancer.cpp /Folibrary/obj/p3wbWhiteBalancer.obj
 
@@ -38,7 +48,7 @@ del /Q library\obj\*
 @echo.
 @echo --- link ---
 
-%LINKER% /DLL /DEF:library/p3wbWhiteBalancer.def /LTCG /OPT:REF /OPT:NOWIN98 /VERSION:1.2 /NOLOGO /OUT:p3whitebalancer.dll kernel32.lib library/obj/*.obj
+%LINKER% /DLL /DEF:library/p3wbWhiteBalancer.def /LTCG /OPT:REF /OPT:NOWIN98 /VERSION:1.3 /NOLOGO /OUT:p3whitebalancer.dll kernel32.lib library/obj/*.obj
 
 
 del /Q library\obj\*